@@ -18,6 +18,7 @@
 #include <QFileInfo>
 #include <QDateTime>
 #include <QTimer>
+#include <QThread>
 #include <QSettings>
 #include <QStandardPaths>
 #include <QCoreApplication>
@@ -6,6 +6,8 @@
 // Data classes
 class AppModel;
 class Database;
+class AsyncDatabase;
+class BlockJournal;
 class BlockTimeSettingsModel;
 
 // Core classes
@@ -18,7 +20,9 @@ class WinService;
 // UI classes
 class MainWindow;
 class BlockOverlay;
+class AppListModel;
 
 struct REG_Week;
+struct REG_Interval;
 
 #endif // FORWARD_DECLARATIONS_H 
\ No newline at end of file
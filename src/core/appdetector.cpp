@@ -1,24 +1,48 @@
 #include "appdetector.h"
 #include "../data/appmodel.h"
+#include "../data/pathkey.h"
+#include "installdirectoryindex.h"
+#include "installedappresolver.h"
+#include "installedappcache.h"
 
-#include <QDir>
-#include <QStandardPaths>
-#include <QSettings>
-#include <QFileInfo>
 #include <QDebug>
-#include <Windows.h>
-#include <TlHelp32.h>
+#include <QFileInfo>
+#include <QHash>
 #include <QSet>
-#include <Psapi.h>  // For GetModuleFileNameEx
-#include <ShlObj.h>  // For Shell link interfaces
-#include <comdef.h>  // For COM support
-#include <objbase.h>  // For CoCreateInstance
-#include <QRegularExpression>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThread>
+#include <QVector>
+#include <algorithm>
+
+// Apps are handed to the GUI thread this many at a time while a refresh
+// runs, each batch costs one queued call and one round of icon loading
+static const int kInstalledAppBatchSize = 32;
+
+#ifdef Q_OS_WIN
+AppDetector::AppDetector(const QString& cachePath, QObject *parent)
+    : AppDetector(std::make_unique<WinInstallSource>(), cachePath, parent)
+{
+}
+#endif
 
-AppDetector::AppDetector(QObject *parent) 
-    : QObject(parent)
+AppDetector::AppDetector(std::unique_ptr<InstallSource> installSource, const QString& cachePath, QObject *parent)
+    : QObject(parent),
+      m_installSource(std::move(installSource)),
+      m_cachePath(cachePath),
+      m_refreshGeneration(0),
+      m_runningProcesses(std::make_unique<SystemProcessSource>())
 {
-    refreshInstalledApps();
+    m_pool.setMaxThreadCount(QThread::idealThreadCount() * 2);
+    // One refresh at a time; a new one queues behind the one it cancels
+    m_refreshPool.setMaxThreadCount(1);
+}
+
+AppDetector::~AppDetector()
+{
+    // The refresh uses the source and the pool, and posts to this object
+    cancelRefresh();
+    m_refreshPool.waitForDone();
 }
 
 QList<std::shared_ptr<AppModel>> AppDetector::getInstalledApps() const
@@ -30,296 +54,312 @@ QList<std::shared_ptr<AppModel>> AppDetector::getRunningApps() const
 {
     QList<std::shared_ptr<AppModel>> runningApps;
     
-    // Create a snapshot of the processes
-    HANDLE hSnapshot = CreateToolhelp32Snapshot(TH32CS_SNAPPROCESS, 0);
-    if (hSnapshot == INVALID_HANDLE_VALUE) {
-        return runningApps;
-    }
-    
-    PROCESSENTRY32 pe32;
-    pe32.dwSize = sizeof(PROCESSENTRY32);
+    // Only processes started since the last call are resolved again
+    const QList<const CachedProcess*> processes = m_runningProcesses.refresh();
     
-    // Get the first process
-    if (!Process32First(hSnapshot, &pe32)) {
-        CloseHandle(hSnapshot);
-        return runningApps;
-    }
-    
-    do {
-        QString processName = QString::fromWCharArray(pe32.szExeFile);
-        
+    for (const CachedProcess* process : processes) {
         // Skip system processes
-        if (processName.toLower().startsWith("system") || 
-            processName.toLower() == "explorer.exe" ||
-            processName.toLower() == "foccuss.exe") {
+        if (process->name.startsWith("system", Qt::CaseInsensitive) || 
+            process->name.compare("explorer.exe", Qt::CaseInsensitive) == 0 ||
+            process->name.compare("foccuss.exe", Qt::CaseInsensitive) == 0) {
             continue;
         }
         
-        // Get process path
-        HANDLE hProcess = OpenProcess(PROCESS_QUERY_INFORMATION | PROCESS_VM_READ, FALSE, pe32.th32ProcessID);
-        if (hProcess) {
-            WCHAR szProcessPath[MAX_PATH];
-            if (GetModuleFileNameEx(hProcess, NULL, szProcessPath, MAX_PATH)) {
-                QString processPath = QString::fromWCharArray(szProcessPath);
-                runningApps.append(std::make_shared<AppModel>(processPath, processName, false));
-            }
-            CloseHandle(hProcess);
-        }
-    } while (Process32Next(hSnapshot, &pe32));
+        runningApps.append(std::make_shared<AppModel>(process->path, process->name, false));
+    }
     
-    CloseHandle(hSnapshot);
     return runningApps;
 }
 
+void AppDetector::loadInstalledApps()
+{
+    startRefresh(true);
+}
+
 void AppDetector::refreshInstalledApps()
 {
-    m_installedApps.clear();
-    
-    findAppsInRegistry();
-    
-    std::sort(m_installedApps.begin(), m_installedApps.end(), 
-              [](const std::shared_ptr<AppModel>& a, const std::shared_ptr<AppModel>& b) {
-                  return a->getName().toLower() < b->getName().toLower();
-              });
-    
-    emit installedAppsChanged();
+    startRefresh(false);
 }
 
-void AppDetector::findAppsInRegistry()
+void AppDetector::cancelRefresh()
 {
-    // Read installed applications from HKLM registry - 64-bit applications
-    QSettings uninstallRegistry64("HKEY_LOCAL_MACHINE\\SOFTWARE\\Microsoft\\Windows\\CurrentVersion\\Uninstall", 
-                               QSettings::NativeFormat);
-    
-    // Read installed applications from HKLM registry - 32-bit applications on 64-bit Windows
-    QSettings uninstallRegistry32("HKEY_LOCAL_MACHINE\\SOFTWARE\\WOW6432Node\\Microsoft\\Windows\\CurrentVersion\\Uninstall", 
-                               QSettings::NativeFormat);
+    if (m_refreshCancelled) {
+        m_refreshCancelled->store(true);
+        m_refreshCancelled.reset();
+    }
+    // Whatever it already posted is dropped when it arrives
+    ++m_refreshGeneration;
+}
+
+void AppDetector::startRefresh(bool reuseCache)
+{
+    cancelRefresh();
+    auto cancelled = std::make_shared<std::atomic<bool>>(false);
+    m_refreshCancelled = cancelled;
+    const quint64 generation = m_refreshGeneration;
     
-    // Read per-user installed applications
-    QSettings uninstallRegistryUser("HKEY_CURRENT_USER\\SOFTWARE\\Microsoft\\Windows\\CurrentVersion\\Uninstall", 
-                                 QSettings::NativeFormat);
+    m_installedApps.clear();
+    m_installedAppKeys.clear();
+    emit installedAppsRefreshStarted();
     
-    // Process each registry path
-    processRegistryApps(uninstallRegistry64);
-    processRegistryApps(uninstallRegistry32);
-    processRegistryApps(uninstallRegistryUser);
+    m_refreshPool.start([this, reuseCache, generation, cancelled]() {
+        updateInstalledApps(reuseCache, generation, *cancelled);
+    });
 }
 
-void AppDetector::processRegistryApps(QSettings& registry)
+void AppDetector::updateInstalledApps(bool reuseCache, quint64 generation, const std::atomic<bool>& cancelled)
 {
-    QStringList appKeys = registry.childGroups();
+    const QStringList roots = m_installSource->registryRoots();
     
-    for (const QString& appKey : appKeys) {
-        registry.beginGroup(appKey);
-        
-        QString displayName = registry.value("DisplayName").toString();
-        QString uninstallString = registry.value("UninstallString").toString();
-        QString installLocation = registry.value("InstallLocation").toString();
-        
-        // Also try to get these additional useful keys
-        QString displayIcon = registry.value("DisplayIcon").toString();
-        QString publisher = registry.value("Publisher").toString();
-        
-        // Skip entries with empty display names or system components
-        if (displayName.isEmpty() || registry.value("SystemComponent").toInt() == 1) {
-            registry.endGroup();
-            continue;
-        }
-        
-        // Skip Windows Store apps (they don't have direct executables we can block)
-        if (publisher.contains("Microsoft Corporation") && 
-            displayName.startsWith("Microsoft") && 
-            installLocation.isEmpty()) {
-            registry.endGroup();
-            continue;
-        }
-        
-        // Try different methods to find the executable path
-        QString exePath;
-        
-        // Method 1: Try to extract from DisplayIcon first - this often points to the main executable
-        if (!displayIcon.isEmpty()) {
-            exePath = extractExecutableFromDisplayIcon(displayIcon);
-        }
-        
-        // Method 2: Check InstallLocation if we couldn't find from DisplayIcon
-        if (exePath.isEmpty() && !installLocation.isEmpty()) {
-            exePath = findExecutableInDirectory(installLocation, displayName);
-        }
-        
-        // Method 3: Try to find the path from the app key name (sometimes contains path info)
-        if (exePath.isEmpty()) {
-            exePath = extractExecutableFromAppKey(appKey, displayName);
-        }
-        
-        // Method 4: Extract from UninstallString as a last resort
-        if (exePath.isEmpty() && !uninstallString.isEmpty()) {
-            exePath = inferExecutableFromUninstallString(uninstallString, displayName);
-        }
-        
-        // Method 5: Try looking for the app in common installation directories
-        if (exePath.isEmpty()) {
-            exePath = findCommonExecutablePath(displayName, appKey);
+    // What the last refresh found, per root in the order it was read
+    QHash<QString, QList<CachedInstalledApp>> cached;
+    QList<CachedInstalledApp> apps;
+    const bool cacheLoaded = reuseCache && !m_cachePath.isEmpty()
+                             && InstalledAppCache::load(m_cachePath, apps);
+    for (const CachedInstalledApp& app : apps)
+        cached[app.registryRoot].append(app);
+    
+    // Each root is checked, and read again if it changed, on its own thread
+    QVector<QList<CachedInstalledApp>> records(roots.size());
+    QVector<QList<QPair<int, InstalledAppEntry>>> pending(roots.size());
+    QVector<char> unchanged(roots.size());
+    runParallel(static_cast<int>(roots.size()), [&](int i) {
+        unchanged[i] = readRoot(roots[i], cacheLoaded, cached.value(roots[i]), records[i], pending[i]);
+    });
+    if (cancelled)
+        return;
+    
+    // A root that is gone leaves stale records behind
+    bool changed = false;
+    for (auto it = cached.cbegin(); it != cached.cend(); ++it)
+        changed = changed || !roots.contains(it.key());
+    
+    // All records in the order the keys were read; pending ones are filled
+    // in as they resolve
+    QVector<CachedInstalledApp> ordered;
+    QVector<char> done;
+    QVector<int> slots;
+    QVector<InstalledAppEntry> entries;
+    for (int i = 0; i < roots.size(); ++i) {
+        changed = changed || !unchanged[i];
+        const int base = static_cast<int>(ordered.size());
+        ordered.append(records[i]);
+        done.insert(done.size(), records[i].size(), 1);
+        for (const QPair<int, InstalledAppEntry>& entry : pending[i]) {
+            slots.append(base + entry.first);
+            entries.append(entry.second);
+            done[base + entry.first] = 0;
         }
-        
-        // If we found an executable, add it to our list
-        if (!exePath.isEmpty()) {
-            QString cleanDisplayName = displayName;
-            // Remove any trailing version numbers in parentheses for cleaner display
-            int parenthesisPos = cleanDisplayName.indexOf(" (");
-            if (parenthesisPos > 0) {
-                cleanDisplayName = cleanDisplayName.left(parenthesisPos);
+    }
+    
+    // Records go out in key order however they finish, so the first key
+    // for an executable is always the one that is shown
+    QMutex releaseLock;
+    qsizetype released = 0;
+    QList<CachedInstalledApp> batch;
+    auto flush = [&]() {
+        QMetaObject::invokeMethod(this, [this, generation, batch]() {
+            addInstalledApps(generation, batch);
+        }, Qt::QueuedConnection);
+        batch.clear();
+    };
+    // A run of cached records can release thousands at once; they still
+    // go out kInstalledAppBatchSize at a time
+    auto release = [&]() {
+        while (released < ordered.size() && done[released]) {
+            if (!ordered[released].exePath.isEmpty()) {
+                batch.append(ordered[released]);
+                if (batch.size() == kInstalledAppBatchSize)
+                    flush();
             }
-            
-            m_installedApps.append(std::make_shared<AppModel>(exePath, cleanDisplayName, false));
+            ++released;
         }
-        
-        registry.endGroup();
+        if (!batch.isEmpty() && released == ordered.size())
+            flush();
+    };
+    
+    {
+        QMutexLocker locker(&releaseLock);
+        release();
     }
-}
-
-QString AppDetector::findExecutableInDirectory(const QString& directory, const QString& appName)
-{
-    QDir dir(directory);
-    if (!dir.exists())
-        return QString();
     
-    QString possibleExeName = appName.split(" ").first() + ".exe";
-    if (dir.exists(possibleExeName))
-        return dir.filePath(possibleExeName);
+    if (!entries.isEmpty()) {
+        // Everything learned about the file system is shared by all entries,
+        // but only for this refresh
+        const InstallDirectoryIndex index(*m_installSource);
+        const InstalledAppResolver resolver(index);
+        runParallel(static_cast<int>(entries.size()), [&](int i) {
+            if (cancelled)
+                return;
+            
+            const CachedInstalledApp resolved = resolveEntry(entries[i], resolver, index);
+            CachedInstalledApp& record = ordered[slots[i]];
+            record.exePath = resolved.exePath;
+            record.name = resolved.name;
+            record.directory = resolved.directory;
+            record.directoryModified = resolved.directoryModified;
+            
+            QMutexLocker locker(&releaseLock);
+            done[slots[i]] = 1;
+            release();
+        });
+    }
     
-    QStringList exeFiles = dir.entryList(QStringList() << "*.exe", QDir::Files);
-    if (!exeFiles.isEmpty())
-        return dir.filePath(exeFiles.first());
+    // Part of a list is not worth caching
+    if (cancelled)
+        return;
     
-    QStringList commonSubdirs = {"bin", "program", "app", "programs", "applications"};
-    for (const QString& subdir : commonSubdirs) {
-        QDir subdirectory(dir.filePath(subdir));
-        if (subdirectory.exists()) {
-            exeFiles = subdirectory.entryList(QStringList() << "*.exe", QDir::Files);
-            if (!exeFiles.isEmpty())
-                return subdirectory.filePath(exeFiles.first());
-        }
+    if (changed && !m_cachePath.isEmpty() && !InstalledAppCache::save(m_cachePath, ordered)) {
+        qWarning() << "Failed to save installed app cache:" << m_cachePath;
     }
     
-    return QString();
+    QMetaObject::invokeMethod(this, [this, generation]() {
+        finishRefresh(generation);
+    }, Qt::QueuedConnection);
 }
 
-QString AppDetector::extractExecutableFromDisplayIcon(const QString& displayIcon)
+void AppDetector::addInstalledApps(quint64 generation, const QList<CachedInstalledApp>& records)
 {
-    QString iconPath = displayIcon.split(",").first().trimmed();
+    if (generation != m_refreshGeneration)
+        return;
     
-    if (iconPath.startsWith("\"") && iconPath.endsWith("\"")) {
-        iconPath = iconPath.mid(1, iconPath.length() - 2);
-    }
-    
-    QFileInfo fileInfo(iconPath);
-    if (fileInfo.exists() && fileInfo.suffix().toLower() == "exe") {
-        return iconPath;
+    // Icons load here, QPixmap is GUI thread only
+    QList<std::shared_ptr<AppModel>> added;
+    for (const CachedInstalledApp& record : records) {
+        // The same app is often registered in more than one hive; the first
+        // hive it was found in wins
+        PathKey key(record.exePath);
+        if (m_installedAppKeys.contains(key))
+            continue;
+        m_installedAppKeys.insert(key);
+        
+        auto app = std::make_shared<AppModel>(record.exePath, record.name, false);
+        auto position = std::upper_bound(m_installedApps.begin(), m_installedApps.end(), app, isNamedBefore);
+        m_installedApps.insert(position, app);
+        added.append(app);
     }
     
-    return QString();
+    if (!added.isEmpty())
+        emit installedAppsAdded(added);
 }
 
-QString AppDetector::extractExecutableFromAppKey(const QString& appKey, const QString& displayName)
+void AppDetector::finishRefresh(quint64 generation)
 {
-    if (appKey.contains("\\")) {
-        QStringList parts = appKey.split("\\");
-        if (parts.size() >= 2) {
-            QString possiblePath = parts.join("\\");
-            if (QFileInfo(possiblePath).exists() && QFileInfo(possiblePath).suffix().toLower() == "exe") {
-                return possiblePath;
-            }
-            
-            QDir dir(possiblePath);
-            if (dir.exists()) {
-                return findExecutableInDirectory(possiblePath, displayName);
-            }
-        }
-    }
+    if (generation != m_refreshGeneration)
+        return;
     
-    return QString();
+    m_refreshCancelled.reset();
+    emit installedAppsChanged();
 }
 
-QString AppDetector::inferExecutableFromUninstallString(const QString& uninstallString, const QString& displayName)
+bool AppDetector::isNamedBefore(const std::shared_ptr<AppModel>& a, const std::shared_ptr<AppModel>& b)
 {
-    QRegularExpression quoteRegex("\"([^\"]+)\"");
-    QRegularExpressionMatch match = quoteRegex.match(uninstallString);
-    
-    if (match.hasMatch()) {
-        QString uninstallerPath = match.captured(1);
-        QFileInfo uninstallerInfo(uninstallerPath);
-        
-        if (!uninstallerInfo.exists()) {
-            return QString();
+    return a->getName().compare(b->getName(), Qt::CaseInsensitive) < 0;
+}
+
+bool AppDetector::readRoot(const QString& root, bool cacheLoaded, const QList<CachedInstalledApp>& cached,
+                           QList<CachedInstalledApp>& records,
+                           QList<QPair<int, InstalledAppEntry>>& pending) const
+{
+    // Still the same if it has exactly the cached keys, none of them was
+    // written to and no app directory changed. Only the key stamps are
+    // read for that, none of the values.
+    if (cacheLoaded) {
+        const QHash<QString, qint64> writeTimes = m_installSource->keyWriteTimes(root);
+        bool unchanged = writeTimes.size() == cached.size();
+        for (auto it = cached.cbegin(); unchanged && it != cached.cend(); ++it) {
+            unchanged = writeTimes.value(it->appKey, -1) == it->keyWriteTime
+                        && isDirectoryUnchanged(*it);
         }
-        
-        QDir appDir = uninstallerInfo.dir();
-        
-        QStringList exeFiles = appDir.entryList(QStringList() << "*.exe", QDir::Files);
-        for (const QString& exeFile : exeFiles) {
-            QString lowerExe = exeFile.toLower();
-            
-            if (lowerExe.contains("unins") || 
-                lowerExe.contains("setup") || 
-                lowerExe.contains("install") ||
-                lowerExe == "uninstall.exe") {
-                continue;
-            }
-            
-            QString simpleAppName = displayName.split(" ").first().toLower();
-            if (lowerExe.contains(simpleAppName)) {
-                return appDir.filePath(exeFile);
-            }
+        if (unchanged) {
+            records = cached;
+            return true;
         }
-        
-        QDir parentDir = appDir;
-        if (parentDir.cdUp()) {
-            QString result = findExecutableInDirectory(parentDir.absolutePath(), displayName);
-            if (!result.isEmpty()) {
-                return result;
-            }
+    }
+    
+    QHash<QString, const CachedInstalledApp*> previous;
+    for (const CachedInstalledApp& app : cached)
+        previous.insert(app.appKey, &app);
+    
+    // Keys that did not change keep what they resolved to last time
+    const QList<InstalledAppEntry> entries = m_installSource->readEntries(root);
+    for (const InstalledAppEntry& entry : entries) {
+        const CachedInstalledApp* app = previous.value(entry.appKey);
+        if (app && app->keyWriteTime == entry.lastWriteTime && isDirectoryUnchanged(*app)) {
+            records.append(*app);
+            continue;
         }
         
-        for (const QString& exeFile : exeFiles) {
-            QString lowerExe = exeFile.toLower();
-            if (!lowerExe.contains("unins") && 
-                !lowerExe.contains("setup") && 
-                !lowerExe.contains("install") &&
-                lowerExe != "uninstall.exe") {
-                return appDir.filePath(exeFile);
-            }
-        }
+        CachedInstalledApp record;
+        record.registryRoot = root;
+        record.appKey = entry.appKey;
+        record.keyWriteTime = entry.lastWriteTime;
+        if (isListedApp(entry))
+            pending.append(qMakePair(static_cast<int>(records.size()), entry));
+        records.append(record);
     }
-    
-    return QString();
+    return false;
 }
 
-QString AppDetector::findCommonExecutablePath(const QString& appName, const QString& appKey)
+bool AppDetector::isDirectoryUnchanged(const CachedInstalledApp& app) const
 {
-    QStringList programDirs;
-    programDirs << QDir::fromNativeSeparators(qgetenv("ProgramFiles"))
-                << QDir::fromNativeSeparators(qgetenv("ProgramFiles(x86)"));
+    return app.directory.isEmpty()
+           || m_installSource->lastModified(app.directory) == app.directoryModified;
+}
+
+CachedInstalledApp AppDetector::resolveEntry(const InstalledAppEntry& entry,
+                                             const InstalledAppResolver& resolver,
+                                             const InstallSource& source)
+{
+    CachedInstalledApp app;
+    app.exePath = resolver.resolve(entry);
     
-    QString simplifiedName = appName.split(" ").first();
+    app.name = entry.displayName;
+    // Remove any trailing version numbers in parentheses for cleaner display
+    int parenthesisPos = app.name.indexOf(" (");
+    if (parenthesisPos > 0) {
+        app.name = app.name.left(parenthesisPos);
+    }
     
-    for (const QString& programDir : programDirs) {
-        QDir dir(programDir + "/" + simplifiedName);
-        if (dir.exists()) {
-            QString exePath = findExecutableInDirectory(dir.absolutePath(), simplifiedName);
-            if (!exePath.isEmpty())
-                return exePath;
-        }
-        
-        QStringList dirs = QDir(programDir).entryList(QDir::Dirs | QDir::NoDotAndDotDot);
-        for (const QString& dirname : dirs) {
-            if (dirname.contains(simplifiedName, Qt::CaseInsensitive)) {
-                QString exePath = findExecutableInDirectory(programDir + "/" + dirname, simplifiedName);
-                if (!exePath.isEmpty())
-                    return exePath;
-            }
-        }
+    // Installing, updating or removing the app touches this directory
+    if (!app.exePath.isEmpty())
+        app.directory = QFileInfo(app.exePath).path();
+    else if (!entry.installLocation.isEmpty())
+        app.directory = PathKey::normalized(entry.installLocation);
+    if (!app.directory.isEmpty())
+        app.directoryModified = source.lastModified(app.directory);
+    
+    return app;
+}
+
+bool AppDetector::isListedApp(const InstalledAppEntry& entry)
+{
+    // Skip entries with empty display names or system components
+    if (entry.displayName.isEmpty() || entry.systemComponent) {
+        return false;
     }
     
-    return QString();
-} 
\ No newline at end of file
+    // Skip Windows Store apps (they don't have direct executables we can block)
+    if (entry.publisher.contains("Microsoft Corporation") && 
+        entry.displayName.startsWith("Microsoft") && 
+        entry.installLocation.isEmpty()) {
+        return false;
+    }
+    
+    return true;
+}
+
+void AppDetector::runParallel(int count, const std::function<void(int)>& job)
+{
+    // Workers pull the next index as they go, so one slow entry never
+    // holds up a fixed share of the others
+    std::atomic<int> next(0);
+    const int workers = qMin(count, m_pool.maxThreadCount());
+    for (int worker = 0; worker < workers; ++worker) {
+        m_pool.start([&next, count, &job]() {
+            for (int i = next++; i < count; i = next++)
+                job(i);
+        });
+    }
+    m_pool.waitForDone();
+}
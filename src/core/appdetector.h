@@ -3,35 +3,87 @@
 
 #include <QObject>
 #include <QList>
-#include <QSettings>
+#include <QPair>
+#include <QSet>
+#include <QThreadPool>
+#include <atomic>
+#include <functional>
 #include <memory>
 
+#include "processcache.h"
+#include "installsource.h"
+#include "installedappcache.h"
+#include "../data/pathkey.h"
+
 class AppModel;
+class InstalledAppResolver;
 
 class AppDetector : public QObject
 {
     Q_OBJECT
 
 public:
-    explicit AppDetector(QObject *parent = nullptr);
+#ifdef Q_OS_WIN
+    // Resolved apps are kept in the file at cachePath between runs; pass
+    // an empty path to always resolve everything
+    explicit AppDetector(const QString& cachePath, QObject *parent = nullptr);
+#endif
+    // Installed apps come from installSource, e.g. a RecordedInstallSource
+    AppDetector(std::unique_ptr<InstallSource> installSource, const QString& cachePath, QObject *parent = nullptr);
+    ~AppDetector();
+    // What the running or last refresh has found so far, sorted by name
     QList<std::shared_ptr<AppModel>> getInstalledApps() const;
     QList<std::shared_ptr<AppModel>> getRunningApps() const;
+    
+    // Both refresh off the GUI thread and cancel any refresh still
+    // running. Apps arrive through installedAppsAdded as they resolve.
+    //
+    // Only resolves keys that changed since the cache was written
+    void loadInstalledApps();
+    // Resolves every installed app again, ignoring the cache
     void refreshInstalledApps();
+    void cancelRefresh();
     
 signals:
+    // The installed app list was emptied for a new refresh
+    void installedAppsRefreshStarted();
+    void installedAppsAdded(const QList<std::shared_ptr<AppModel>>& apps);
+    // A refresh finished; the list is complete
     void installedAppsChanged();
     
 private:
-    void findAppsInRegistry();
-    void processRegistryApps(QSettings& registry);
-    
-    QString findExecutableInDirectory(const QString& directory, const QString& appName);
-    QString extractExecutableFromDisplayIcon(const QString& displayIcon);
-    QString extractExecutableFromAppKey(const QString& appKey, const QString& displayName);
-    QString inferExecutableFromUninstallString(const QString& uninstallString, const QString& displayName);
-    QString findCommonExecutablePath(const QString& appName, const QString& appKey);
+    void startRefresh(bool reuseCache);
+    // Runs on m_refreshPool and posts what it finds back to this thread
+    void updateInstalledApps(bool reuseCache, quint64 generation, const std::atomic<bool>& cancelled);
+    void addInstalledApps(quint64 generation, const QList<CachedInstalledApp>& records);
+    void finishRefresh(quint64 generation);
+    static bool isNamedBefore(const std::shared_ptr<AppModel>& a, const std::shared_ptr<AppModel>& b);
+    // Fills records with one record per key of root. Keys that need
+    // resolving go to pending with their slot in records. True if the
+    // cached records were still current.
+    bool readRoot(const QString& root, bool cacheLoaded, const QList<CachedInstalledApp>& cached,
+                  QList<CachedInstalledApp>& records,
+                  QList<QPair<int, InstalledAppEntry>>& pending) const;
+    bool isDirectoryUnchanged(const CachedInstalledApp& app) const;
+    static CachedInstalledApp resolveEntry(const InstalledAppEntry& entry,
+                                           const InstalledAppResolver& resolver,
+                                           const InstallSource& source);
+    static bool isListedApp(const InstalledAppEntry& entry);
+    // Runs job(0) .. job(count - 1) on m_pool and waits for all of them
+    void runParallel(int count, const std::function<void(int)>& job);
 
+    std::unique_ptr<InstallSource> m_installSource;
+    QString m_cachePath;
     QList<std::shared_ptr<AppModel>> m_installedApps;
+    QSet<PathKey> m_installedAppKeys;
+    // Resolution mostly waits on the file system, so it gets more threads
+    // than there are cores
+    QThreadPool m_pool;
+    QThreadPool m_refreshPool;
+    // Bumped for every refresh; batches of an older one are dropped
+    quint64 m_refreshGeneration;
+    std::shared_ptr<std::atomic<bool>> m_refreshCancelled;
+    mutable ProcessCache m_runningProcesses;
 };
 
 #endif // APPDETECTOR_H 
\ No newline at end of file
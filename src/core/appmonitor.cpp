@@ -1,16 +1,16 @@
 #include "appmonitor.h"
 #include "../data/database.h"
 #include "../data/appmodel.h"
+#include "processeventsource.h"
 
 #include <QDebug>
-#include <TlHelp32.h>
-#include <Psapi.h>
 #include <QDateTime>
 #include <QStandardPaths>
 #include <QDir>
 #include <QFile>
+#include <QFileInfo>
 #include <QTextStream>
-#include <QThread>
+#include <QFileSystemWatcher>
 
 static QString s_logFilePath;
 
@@ -34,23 +34,84 @@ void logToFile_(const QString& message)
     }
 }
 
+// Full process snapshot interval when no event source is available
+static const int kPollInterval = 1000;
+// Consistency scan interval while process start events are delivered
+static const int kFallbackScanInterval = 10000;
+// Window sweep over already running blocked processes
+static const int kWindowSweepInterval = 1000;
+// A freshly started blocked process is polled this often for its first window
+static const int kNewProcessPollInterval = 25;
+static const int kNewProcessWatchDuration = 10000;
+
+#ifdef Q_OS_WIN
 AppMonitor::AppMonitor(Database* database, QObject *parent)
+    : AppMonitor(database, std::make_unique<SystemClock>(), parent)
+{
+}
+
+AppMonitor::AppMonitor(Database* database, std::unique_ptr<Clock> clock, QObject *parent)
+    : AppMonitor(database, std::move(clock), std::make_unique<SystemProcessSource>(),
+                 std::make_unique<SystemWindowSource>(), new SystemProcessEventSource(), parent)
+{
+}
+#endif
+
+AppMonitor::AppMonitor(Database* database, std::unique_ptr<Clock> clock,
+                       std::unique_ptr<ProcessSource> processSource,
+                       std::unique_ptr<WindowSource> windowSource,
+                       ProcessEventSource* processEvents, QObject *parent)
     : QObject(parent),
       m_database(database),
-      m_isMonitoring(false)
+      m_clock(std::move(clock)),
+      // Parented so they follow the monitor onto its worker thread
+      m_monitorTimer(this),
+      m_windowTimer(this),
+      m_isMonitoring(false),
+      m_scheduleTimer(this),
+      m_isScanning(false),
+      m_runningAppsCheckQueued(false),
+      m_settingsWatcher(new QFileSystemWatcher(this)),
+      m_processEvents(processEvents),
+      m_processCache(std::move(processSource)),
+      m_windowSource(std::move(windowSource)),
+      m_tickGeneration(0),
+      m_drainPending(false)
 {
-    m_monitorTimer.setInterval(1000);
+    m_processEvents->setParent(this);
+
+    m_monitorTimer.setInterval(kPollInterval);
     connect(&m_monitorTimer, &QTimer::timeout, this, &AppMonitor::checkRunningApps);
+    connect(&m_windowTimer, &QTimer::timeout, this, &AppMonitor::checkBlockedWindows);
+
+    // Coarse timers may slip by a few percent, which is minutes over a
+    // long wait between windows
+    m_scheduleTimer.setSingleShot(true);
+    m_scheduleTimer.setTimerType(Qt::PreciseTimer);
+    connect(&m_scheduleTimer, &QTimer::timeout, this, &AppMonitor::rescheduleBlocking);
+    connect(m_settingsWatcher, &QFileSystemWatcher::fileChanged, this, &AppMonitor::onSettingsFileChanged);
+    connect(m_settingsWatcher, &QFileSystemWatcher::directoryChanged, this, &AppMonitor::onSettingsDirectoryChanged);
+
+    // Changes written through this Database; commits from the other
+    // process are picked up through the watcher and reloadIfChanged()
+    if (m_database) {
+        connect(m_database, &Database::scheduleChanged, this, &AppMonitor::rescheduleBlocking);
+        connect(m_database, &Database::blockedAppsChanged, this, &AppMonitor::onBlockedAppsChanged);
+        connect(m_database, &Database::blockedAppsReloaded, this, &AppMonitor::onBlockedAppsReloaded);
+    }
+
+    connect(m_processEvents, &ProcessEventSource::processStarted, this, &AppMonitor::onProcessStarted);
+    connect(m_processEvents, &ProcessEventSource::processExited, this, &AppMonitor::onProcessExited);
 }
 
 void AppMonitor::startMonitoring()
 {
     if (!m_isMonitoring && m_database && m_database->isInitialized()) {
-        m_monitorTimer.start();
         m_isMonitoring = true;
-        m_HwndCache.clear();
+        watchSettingsFiles();
+        emit monitoringChanged(true);
         
-        QTimer::singleShot(0, this, &AppMonitor::checkRunningApps);
+        rescheduleBlocking();
     } else {
         if (m_isMonitoring) {
             logToFile_("Monitoring already active");
@@ -65,10 +126,110 @@ void AppMonitor::startMonitoring()
 void AppMonitor::stopMonitoring()
 {
     if (m_isMonitoring) {
-        m_monitorTimer.stop();
+        m_nextScheduleCheck = QDateTime();
+        m_clock->wakeAt(m_scheduleTimer, m_nextScheduleCheck);
+        if (!m_settingsWatcher->files().isEmpty())
+            m_settingsWatcher->removePaths(m_settingsWatcher->files());
+        if (!m_settingsWatcher->directories().isEmpty())
+            m_settingsWatcher->removePaths(m_settingsWatcher->directories());
+        stopScanning();
         m_isMonitoring = false;
-        m_HwndCache.clear();
+        emit monitoringChanged(false);
+    }
+}
+
+bool AppMonitor::watchSettingsFiles()
+{
+    // With WAL journaling commits land in the -wal file and only reach
+    // the database file itself on a checkpoint. The -wal file may not
+    // exist yet, and a file that is deleted or replaced drops out of the
+    // watcher, so the directory is watched for either to (re)appear.
+    const QString databasePath = m_database->databasePath();
+    const QStringList paths = { QFileInfo(databasePath).absolutePath(), databasePath, databasePath + "-wal" };
+
+    QStringList added;
+    const QStringList watchedFiles = m_settingsWatcher->files();
+    const QStringList watchedDirectories = m_settingsWatcher->directories();
+    for (const QString& path : paths) {
+        if (!watchedFiles.contains(path) && !watchedDirectories.contains(path) && QFileInfo::exists(path))
+            added.append(path);
     }
+    if (!added.isEmpty())
+        m_settingsWatcher->addPaths(added);
+    return !added.isEmpty();
+}
+
+void AppMonitor::onSettingsFileChanged(const QString& path)
+{
+    Q_UNUSED(path);
+    if (!m_isMonitoring)
+        return;
+
+    watchSettingsFiles();
+    rescheduleBlocking();
+}
+
+void AppMonitor::onSettingsDirectoryChanged(const QString& path)
+{
+    Q_UNUSED(path);
+    if (!m_isMonitoring)
+        return;
+
+    // Anything else written next to the database, like the logs, is of no
+    // interest; only a database file that showed up again is
+    if (watchSettingsFiles())
+        rescheduleBlocking();
+}
+
+void AppMonitor::rescheduleBlocking()
+{
+    if (!m_isMonitoring)
+        return;
+
+    // Pick up settings written by the other process before deciding
+    m_database->reloadIfChanged();
+
+    // The state is always taken from the clock, never toggled, so a timer
+    // that fires early, late or after a clock jump still lands correctly
+    const QDateTime now = m_clock->now();
+    if (m_database->isBlockingAt(now))
+        startScanning();
+    else
+        stopScanning();
+
+    // Never changing leaves it invalid, which stops the timer
+    m_nextScheduleCheck = m_database->nextScheduleTransition(now);
+    m_clock->wakeAt(m_scheduleTimer, m_nextScheduleCheck);
+}
+
+void AppMonitor::startScanning()
+{
+    if (m_isScanning)
+        return;
+
+    bool eventsRunning = m_processEvents->start();
+    if (!eventsRunning)
+        logToFile_("Process start events unavailable, falling back to polling");
+
+    m_monitorTimer.start(eventsRunning ? kFallbackScanInterval : kPollInterval);
+    m_isScanning = true;
+    m_HwndCache.clear();
+
+    QTimer::singleShot(0, this, &AppMonitor::checkRunningApps);
+}
+
+void AppMonitor::stopScanning()
+{
+    if (!m_isScanning)
+        return;
+
+    m_processEvents->stop();
+    m_monitorTimer.stop();
+    m_windowTimer.stop();
+    m_isScanning = false;
+    m_HwndCache.clear();
+    m_blockedProcesses.clear();
+    m_processCache.clear();
 }
 
 bool AppMonitor::isMonitoring() const
@@ -76,73 +237,236 @@ bool AppMonitor::isMonitoring() const
     return m_isMonitoring;
 }
 
-void AppMonitor::checkRunningApps()
+QDateTime AppMonitor::nextScheduleCheck() const
+{
+    return m_nextScheduleCheck;
+}
+
+void AppMonitor::drainDetections()
+{
+    // Clear the flag first so a push racing with this drain schedules
+    // another one instead of being left in the queue
+    m_drainPending = false;
+
+    BlockDetection detection;
+    while (m_detections.pop(detection))
+        emit blockedAppLaunched(detection.window, detection.path, detection.name);
+}
+
+bool AppMonitor::isBlockingWindowOpen() const
 {
     if (!m_database || !m_database->isInitialized())
+        return false;
+
+    return m_database->isBlockingAt(m_clock->now());
+}
+
+bool AppMonitor::shouldBlock(const RuleMatcher& rules, const PathKey& processKey) const
+{
+    // The key is already case-folded, so this neither allocates nor
+    // folds again
+    if (processKey.view().contains(QLatin1String("foccuss")))
+        return false;
+
+    return rules.matches(processKey);
+}
+
+void AppMonitor::checkRunningApps()
+{
+    m_runningAppsCheckQueued = false;
+    if (!m_isScanning)
+        return;
+
+    if (!isBlockingWindowOpen()) {
+        rescheduleBlocking();
+        return;
+    }
+
+    // Pick up rules written by the other process before probing the
+    // index; this check already decides by what it reloads
+    m_runningAppsCheckQueued = true;
+    m_database->reloadIfChanged();
+    m_runningAppsCheckQueued = false;
+
+    // One compiled rule set for the whole snapshot. The revision is read
+    // first, so a concurrent rule change can only cause an extra re-check.
+    const quint64 rulesRevision = m_database->blockedAppsRevision();
+    const std::shared_ptr<const RuleMatcher> rules = m_database->blockRules();
+    const QList<const CachedProcess*> processes = m_processCache.refresh(
+        rulesRevision,
+        [this, &rules](const PathKey& processKey) { return shouldBlock(*rules, processKey); });
+
+    // Rebuild the watch list from the snapshot, keeping the short poll
+    // window of processes we were told about moments ago
+    QHash<quint32, BlockedProcess> blockedProcesses;
+    for (const CachedProcess* process : processes) {
+        if (!process->blocked)
+            continue;
+
+        BlockedProcess blocked = m_blockedProcesses.value(process->pid);
+        blocked.path = process->path;
+        blocked.name = process->name;
+        blockedProcesses.insert(process->pid, blocked);
+    }
+    m_blockedProcesses.swap(blockedProcesses);
+
+    scanBlockedWindows();
+}
+
+void AppMonitor::checkBlockedWindows()
+{
+    if (!m_isScanning)
         return;
 
-    if (!m_database->isBlockingActive() || !m_database->isBlockingNow())
+    if (!isBlockingWindowOpen()) {
+        rescheduleBlocking();
         return;
+    }
+
+    scanBlockedWindows();
+}
 
-    HANDLE hSnapshot = CreateToolhelp32Snapshot(TH32CS_SNAPPROCESS, 0);
-    if (hSnapshot == INVALID_HANDLE_VALUE)
+void AppMonitor::onProcessStarted(quint32 pid)
+{
+    if (!m_isScanning || !isBlockingWindowOpen())
         return;
-    
-    QSet<HWND> currentActiveHwnds;
 
-    PROCESSENTRY32 pe32;
-    pe32.dwSize = sizeof(PROCESSENTRY32);
+    m_database->reloadIfChanged();
 
-    if (!Process32First(hSnapshot, &pe32)) {
-        CloseHandle(hSnapshot);
+    const quint64 rulesRevision = m_database->blockedAppsRevision();
+    const std::shared_ptr<const RuleMatcher> rules = m_database->blockRules();
+    const CachedProcess* process = m_processCache.resolve(
+        pid, rulesRevision,
+        [this, &rules](const PathKey& processKey) { return shouldBlock(*rules, processKey); });
+    if (!process || !process->blocked)
         return;
+
+    BlockedProcess& blocked = m_blockedProcesses[pid];
+    blocked.path = process->path;
+    blocked.name = process->name;
+    blocked.newProcessWatch.setRemainingTime(kNewProcessWatchDuration);
+
+    scanBlockedWindows();
+}
+
+void AppMonitor::onBlockedAppsChanged(quint64 baseRevision, quint64 revision, const QList<BlockedAppChange>& changes)
+{
+    // Nothing is cached outside blocking hours
+    if (!m_isScanning)
+        return;
+
+    QList<BlockRule> addedRules;
+    bool removed = false;
+    for (const BlockedAppChange& change : changes) {
+        if (change.blocked)
+            addedRules.append(BlockRule{change.appPath, change.ruleType});
+        else
+            removed = true;
     }
 
-    do {
-        HANDLE hProcess = OpenProcess(PROCESS_QUERY_INFORMATION | PROCESS_VM_READ, FALSE, pe32.th32ProcessID);
-        if (hProcess) {
-            WCHAR szProcessPath[MAX_PATH];
-            if (GetModuleFileNameEx(hProcess, NULL, szProcessPath, MAX_PATH)) {
-                QString processPath = QString::fromWCharArray(szProcessPath);
-                QString processName = QString::fromWCharArray(pe32.szExeFile);
-
-                if (processPath.toLower().contains("foccuss")) {
-                    CloseHandle(hProcess);
-                    continue;
-                }
-
-                if (m_database->isAppBlocked(processPath)) {
-                    HWND hwnd = GetTopWindow(NULL);
-                    while (hwnd) {
-                        DWORD processId;
-                        GetWindowThreadProcessId(hwnd, &processId);
-
-                        if (processId == pe32.th32ProcessID) {
-                            currentActiveHwnds.insert(hwnd);
-
-                            if (!m_HwndCache.contains(hwnd)) {
-                                m_HwndCache.insert(hwnd);
-
-                                emit blockedAppLaunched(hwnd, processPath, processName);
-                                QThread::msleep(100);
-                            }
-                        }
-                        hwnd = GetNextWindow(hwnd, GW_HWNDNEXT);
-                    }
-                }
-            }
-            CloseHandle(hProcess);
+    // The current rules may already include later changes; those bring
+    // their own event, and re-checking against a newer set is harmless
+    const RuleMatcher added(addedRules);
+    const std::shared_ptr<const RuleMatcher> rules = m_database->blockRules();
+    ProcessCache::BlockDecider addedDecider;
+    ProcessCache::BlockDecider remainingDecider;
+    if (!added.isEmpty())
+        addedDecider = [this, &added](const PathKey& processKey) { return shouldBlock(added, processKey); };
+    if (removed)
+        remainingDecider = [this, &rules](const PathKey& processKey) { return shouldBlock(*rules, processKey); };
+
+    const QList<const CachedProcess*> flipped = m_processCache.applyRuleChange(
+        baseRevision, revision, addedDecider, remainingDecider);
+    if (flipped.isEmpty())
+        return;
+
+    for (const CachedProcess* process : flipped) {
+        if (!process->blocked) {
+            m_blockedProcesses.remove(process->pid);
+            continue;
         }
-    } while (Process32Next(hSnapshot, &pe32));
 
-    CloseHandle(hSnapshot);
+        BlockedProcess& blocked = m_blockedProcesses[process->pid];
+        blocked.path = process->path;
+        blocked.name = process->name;
+    }
+
+    scanBlockedWindows();
+}
+
+void AppMonitor::onBlockedAppsReloaded()
+{
+    // Rules committed by the other process. Which rows changed is not
+    // known, but the cache decides every process again by revision, so a
+    // rule added to a running app takes effect now rather than on the
+    // fallback scan.
+    if (!m_isScanning || m_runningAppsCheckQueued)
+        return;
+
+    m_runningAppsCheckQueued = true;
+    QTimer::singleShot(0, this, &AppMonitor::checkRunningApps);
+}
+
+void AppMonitor::onProcessExited(quint32 pid)
+{
+    if (m_blockedProcesses.remove(pid) && m_blockedProcesses.isEmpty())
+        m_windowTimer.stop();
+}
+
+void AppMonitor::scanBlockedWindows()
+{
+    ++m_tickGeneration;
+    bool watchingNewProcess = false;
+    bool queued = false;
+
+    // One window enumeration per scan, and only when something is blocked
+    if (!m_blockedProcesses.isEmpty())
+        m_windowSource->topLevelWindows(m_windowsByPid);
 
-    QSet<HWND> hwndsToRemove = m_HwndCache;
-    hwndsToRemove.subtract(currentActiveHwnds);
-    
-    if (!hwndsToRemove.empty()) {
-        for (const auto& hwnd : hwndsToRemove) {
-            m_HwndCache.remove(hwnd);
+    for (auto process = m_blockedProcesses.cbegin(); process != m_blockedProcesses.cend(); ++process) {
+        if (!process->newProcessWatch.hasExpired())
+            watchingNewProcess = true;
+
+        const auto windows = m_windowsByPid.equal_range(process.key());
+        for (auto it = windows.first; it != windows.second; ++it) {
+            WindowId hwnd = it.value();
+
+            auto cached = m_HwndCache.find(hwnd);
+            if (cached != m_HwndCache.end()) {
+                cached.value() = m_tickGeneration;
+                continue;
+            }
+
+            // A full queue leaves the window uncached, so the next scan
+            // retries it instead of dropping the detection
+            if (!m_detections.push(BlockDetection{hwnd, process->path, process->name}))
+                continue;
+
+            m_HwndCache.insert(hwnd, m_tickGeneration);
+            queued = true;
         }
     }
-}
\ No newline at end of file
+
+    if (queued && !m_drainPending.exchange(true))
+        emit detectionsAvailable();
+
+    const quint64 generation = m_tickGeneration;
+    m_HwndCache.removeIf([generation](const QHash<WindowId, quint64>::iterator& it) {
+        return it.value() != generation;
+    });
+
+    updateWindowTimer(watchingNewProcess);
+}
+
+void AppMonitor::updateWindowTimer(bool watchingNewProcess)
+{
+    // Without events the full scan already sweeps windows every tick
+    if (!m_processEvents->isRunning() || m_blockedProcesses.isEmpty()) {
+        m_windowTimer.stop();
+        return;
+    }
+
+    int interval = watchingNewProcess ? kNewProcessPollInterval : kWindowSweepInterval;
+    if (!m_windowTimer.isActive() || m_windowTimer.interval() != interval)
+        m_windowTimer.start(interval);
+}
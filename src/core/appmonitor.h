@@ -6,37 +6,135 @@
 #include <QList>
 #include <QHash>
 #include <QString>
-#include <QSet>
+#include <QMultiHash>
+#include <QDeadlineTimer>
+#include <QDateTime>
+#include <atomic>
 #include <memory>
-#include <Windows.h>
+
+#include "clock.h"
+#include "processcache.h"
+#include "spscqueue.h"
+#include "windowsource.h"
+#include "../data/database.h"
 
 class AppModel;
-class Database;
+class ProcessEventSource;
+class QFileSystemWatcher;
 
 class AppMonitor : public QObject
 {
     Q_OBJECT
 
 public:
+#ifdef Q_OS_WIN
     explicit AppMonitor(Database* database, QObject *parent = nullptr);
+    AppMonitor(Database* database, std::unique_ptr<Clock> clock, QObject *parent = nullptr);
+#endif
+    // Everything the monitor learns about the system comes through these,
+    // e.g. fakes in a benchmark. Takes ownership of processEvents.
+    AppMonitor(Database* database, std::unique_ptr<Clock> clock,
+               std::unique_ptr<ProcessSource> processSource,
+               std::unique_ptr<WindowSource> windowSource,
+               ProcessEventSource* processEvents, QObject *parent = nullptr);
+    
+    bool isMonitoring() const;
+    
+    // When the schedule timer is due next, or invalid if it is not armed.
+    // Monitor thread only.
+    QDateTime nextScheduleCheck() const;
     
+    // Called on the consumer (UI) thread after detectionsAvailable() to emit
+    // blockedAppLaunched() for everything queued since the last drain
+    void drainDetections();
+    
+public slots:
     void startMonitoring();
     void stopMonitoring();
-    bool isMonitoring() const;
+    // Re-evaluates the schedule and re-arms the transition timer. Called on
+    // settings changes and whenever the wall clock jumps.
+    void rescheduleBlocking();
     
 signals:
-    void blockedAppLaunched(const HWND targetWindow, const QString& appPath, const QString& appName);
+    void blockedAppLaunched(const WindowId targetWindow, const QString& appPath, const QString& appName);
+    // Emitted once per burst of detections, not once per window
+    void detectionsAvailable();
+    void monitoringChanged(bool monitoring);
     
 private slots:
     void checkRunningApps();
+    void checkBlockedWindows();
+    void onProcessStarted(quint32 pid);
+    void onProcessExited(quint32 pid);
+    void onBlockedAppsChanged(quint64 baseRevision, quint64 revision, const QList<BlockedAppChange>& changes);
+    void onBlockedAppsReloaded();
+    void onSettingsFileChanged(const QString& path);
+    void onSettingsDirectoryChanged(const QString& path);
     
 private:
+    struct BlockedProcess
+    {
+        QString path;
+        QString name;
+        // Polled at a short interval until it had time to open its window
+        QDeadlineTimer newProcessWatch;
+    };
+
+    struct BlockDetection
+    {
+        WindowId window = 0;
+        QString path;
+        QString name;
+    };
+
+    bool isBlockingWindowOpen() const;
+    // Adds the database, its -wal file and their directory to the watcher
+    // where they exist and are not watched yet; true if any was added
+    bool watchSettingsFiles();
+    void startScanning();
+    void stopScanning();
+    bool shouldBlock(const RuleMatcher& rules, const PathKey& processKey) const;
+    void scanBlockedWindows();
+    void updateWindowTimer(bool watchingNewProcess);
+    
     Database* m_database;
+    std::unique_ptr<Clock> m_clock;
     QTimer m_monitorTimer;
-    bool m_isMonitoring;
+    QTimer m_windowTimer;
+    std::atomic<bool> m_isMonitoring;
+    
+    // Single shot at the next schedule transition; outside blocking hours
+    // this is the only thing armed, so the thread stays asleep
+    QTimer m_scheduleTimer;
+    QDateTime m_nextScheduleCheck;
+    bool m_isScanning;
+    // A checkRunningApps() is queued or about to read the rules, so a
+    // reload does not need another one
+    bool m_runningAppsCheckQueued;
+    // Fires when another connection or process commits to the database
+    QFileSystemWatcher* m_settingsWatcher;
+    
+    // Pushes process starts so full scans are only a consistency fallback
+    ProcessEventSource* m_processEvents;
+    
+    // Resolved path and block decision per running process
+    ProcessCache m_processCache;
+    std::unique_ptr<WindowSource> m_windowSource;
+    
+    // Running blocked processes whose windows are being watched
+    QHash<quint32, BlockedProcess> m_blockedProcesses;
+    
+    // Visible, unowned top-level windows by owning PID, rebuilt once per tick
+    QMultiHash<quint32, WindowId> m_windowsByPid;
+    
+    // Cache previously detected windows to avoid repeatedly signaling.
+    // Each entry holds the tick generation it was last seen in.
+    QHash<WindowId, quint64> m_HwndCache;
+    quint64 m_tickGeneration;
     
-    // Cache previously detected processes to avoid repeatedly signaling
-    QSet<HWND> m_HwndCache;
+    // Detections handed from the monitor thread to the UI thread
+    SpscQueue<BlockDetection, 256> m_detections;
+    std::atomic<bool> m_drainPending;
 };
 
 #endif // APPMONITOR_H 
\ No newline at end of file
@@ -0,0 +1,42 @@
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <QDateTime>
+#include <QTimer>
+#include <limits>
+
+// Source of local wall-clock time for schedule decisions. Swapping it out
+// lets a simulated clock step through a week without waiting on it.
+class Clock
+{
+public:
+    virtual ~Clock() = default;
+
+    virtual QDateTime now() const = 0;
+
+    // Starts the single-shot `timer` so it fires once this clock reaches
+    // `at`; an invalid `at` stops it. Timers that wait on the schedule go
+    // through here so a simulated clock can fire them.
+    virtual void wakeAt(QTimer& timer, const QDateTime& at) = 0;
+};
+
+class SystemClock : public Clock
+{
+public:
+    QDateTime now() const override { return QDateTime::currentDateTime(); }
+
+    void wakeAt(QTimer& timer, const QDateTime& at) override
+    {
+        if (!at.isValid()) {
+            timer.stop();
+            return;
+        }
+
+        // Both ends are local times, so the wait is real elapsed time even
+        // when a DST change falls in between
+        qint64 wait = qBound<qint64>(0, now().msecsTo(at), std::numeric_limits<int>::max());
+        timer.start(static_cast<int>(wait));
+    }
+};
+
+#endif // CLOCK_H
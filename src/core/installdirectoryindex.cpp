@@ -0,0 +1,211 @@
+#include "installdirectoryindex.h"
+
+#include <QFileInfo>
+#include <QMutexLocker>
+
+#pragma region NameTrie
+
+InstallDirectoryIndex::NameTrie::NameTrie(const QStringList& names)
+    : m_names(names)
+{
+    m_nodes.append(Node{0, -1, -1, {}});
+
+    for (int i = 0; i < names.size(); ++i) {
+        const QString folded = names[i].toCaseFolded();
+        m_nodes[0].names.append(i);
+
+        // Every suffix of the name, so any substring is a path from the root
+        for (qsizetype start = 0; start < folded.size(); ++start) {
+            int node = 0;
+            for (qsizetype j = start; j < folded.size(); ++j) {
+                const char16_t ch = folded[j].unicode();
+                int next = child(node, ch);
+                if (next < 0)
+                    next = addChild(node, ch);
+                node = next;
+
+                // Suffixes of one name are added one after another, so a
+                // repeat can only be the last one
+                QVector<int>& nodeNames = m_nodes[node].names;
+                if (nodeNames.isEmpty() || nodeNames.last() != i)
+                    nodeNames.append(i);
+            }
+        }
+    }
+}
+
+QStringList InstallDirectoryIndex::NameTrie::namesContaining(const QString& text) const
+{
+    const QString folded = text.toCaseFolded();
+    int node = 0;
+    for (const QChar ch : folded) {
+        node = child(node, ch.unicode());
+        if (node < 0)
+            return QStringList();
+    }
+
+    QStringList names;
+    names.reserve(m_nodes[node].names.size());
+    for (int i : m_nodes[node].names)
+        names.append(m_names[i]);
+    return names;
+}
+
+int InstallDirectoryIndex::NameTrie::child(int node, char16_t ch) const
+{
+    for (int next = m_nodes[node].firstChild; next >= 0; next = m_nodes[next].nextSibling) {
+        if (m_nodes[next].ch == ch)
+            return next;
+    }
+    return -1;
+}
+
+int InstallDirectoryIndex::NameTrie::addChild(int node, char16_t ch)
+{
+    const int next = static_cast<int>(m_nodes.size());
+    m_nodes.append(Node{ch, -1, m_nodes[node].firstChild, {}});
+    m_nodes[node].firstChild = next;
+    return next;
+}
+
+#pragma endregion NameTrie
+
+#pragma region InstallDirectoryIndex
+
+InstallDirectoryIndex::InstallDirectoryIndex(const InstallSource& source)
+    : m_source(source),
+      m_programDirectories(source.programDirectories())
+{
+    // Nearly every unresolved app ends up searching these
+    for (const QString& directory : m_programDirectories) {
+        const std::shared_ptr<const Listing> programListing = listing(directory);
+        m_programTries.insert(PathKey(directory),
+                              std::make_shared<const NameTrie>(programListing->subdirectories));
+    }
+}
+
+QStringList InstallDirectoryIndex::registryRoots() const
+{
+    return m_source.registryRoots();
+}
+
+QList<InstalledAppEntry> InstallDirectoryIndex::readEntries(const QString& registryRoot) const
+{
+    return m_source.readEntries(registryRoot);
+}
+
+QHash<QString, qint64> InstallDirectoryIndex::keyWriteTimes(const QString& registryRoot) const
+{
+    return m_source.keyWriteTimes(registryRoot);
+}
+
+QStringList InstallDirectoryIndex::programDirectories() const
+{
+    return m_programDirectories;
+}
+
+bool InstallDirectoryIndex::isFile(const QString& path) const
+{
+    bool exists = false;
+    if (lookUpInParent(path, false, exists))
+        return exists;
+    return probe(m_files, path, &InstallSource::isFile);
+}
+
+bool InstallDirectoryIndex::isDirectory(const QString& path) const
+{
+    bool exists = false;
+    if (lookUpInParent(path, true, exists))
+        return exists;
+    return probe(m_directories, path, &InstallSource::isDirectory);
+}
+
+qint64 InstallDirectoryIndex::lastModified(const QString& path) const
+{
+    return m_source.lastModified(path);
+}
+
+QStringList InstallDirectoryIndex::executables(const QString& directory) const
+{
+    return listing(directory)->executables;
+}
+
+QStringList InstallDirectoryIndex::subdirectories(const QString& directory) const
+{
+    return listing(directory)->subdirectories;
+}
+
+QStringList InstallDirectoryIndex::subdirectoriesContaining(const QString& directory, const QString& text) const
+{
+    const std::shared_ptr<const NameTrie> trie = m_programTries.value(PathKey(directory));
+    if (trie)
+        return trie->namesContaining(text);
+    return InstallSource::subdirectoriesContaining(directory, text);
+}
+
+std::shared_ptr<const InstallDirectoryIndex::Listing> InstallDirectoryIndex::listing(const QString& directory) const
+{
+    const PathKey key(directory);
+    if (std::shared_ptr<const Listing> cached = cachedListing(key))
+        return cached;
+
+    auto fresh = std::make_shared<Listing>();
+    fresh->executables = m_source.executables(directory);
+    fresh->subdirectories = m_source.subdirectories(directory);
+    for (const QString& name : fresh->executables)
+        fresh->foldedExecutables.insert(name.toCaseFolded());
+    for (const QString& name : fresh->subdirectories)
+        fresh->foldedSubdirectories.insert(name.toCaseFolded());
+
+    // Another thread may have listed it meanwhile; keep whichever came first
+    QMutexLocker locker(&m_lock);
+    auto it = m_listings.constFind(key);
+    if (it == m_listings.cend())
+        it = m_listings.insert(key, fresh);
+    return it.value();
+}
+
+std::shared_ptr<const InstallDirectoryIndex::Listing> InstallDirectoryIndex::cachedListing(const PathKey& directory) const
+{
+    QMutexLocker locker(&m_lock);
+    return m_listings.value(directory);
+}
+
+bool InstallDirectoryIndex::lookUpInParent(const QString& path, bool directory, bool& exists) const
+{
+    const QFileInfo info(path);
+    const QString name = info.fileName();
+    if (name.isEmpty() || name == "." || name == "..")
+        return false;
+    // Listings only hold executables, any other file has to be probed
+    if (!directory && !name.endsWith(".exe", Qt::CaseInsensitive))
+        return false;
+
+    const std::shared_ptr<const Listing> parent = cachedListing(PathKey(info.path()));
+    if (!parent)
+        return false;
+
+    const QSet<QString>& names = directory ? parent->foldedSubdirectories : parent->foldedExecutables;
+    exists = names.contains(name.toCaseFolded());
+    return true;
+}
+
+bool InstallDirectoryIndex::probe(QHash<PathKey, bool>& cache, const QString& path,
+                                  bool (InstallSource::*check)(const QString&) const) const
+{
+    const PathKey key(path);
+    {
+        QMutexLocker locker(&m_lock);
+        auto it = cache.constFind(key);
+        if (it != cache.cend())
+            return it.value();
+    }
+
+    const bool exists = (m_source.*check)(path);
+
+    QMutexLocker locker(&m_lock);
+    cache.insert(key, exists);
+    return exists;
+}
+
+#pragma endregion InstallDirectoryIndex
@@ -0,0 +1,100 @@
+#ifndef INSTALLDIRECTORYINDEX_H
+#define INSTALLDIRECTORYINDEX_H
+
+#include <QHash>
+#include <QSet>
+#include <QMutex>
+#include <QVector>
+#include <memory>
+
+#include "installsource.h"
+#include "../data/pathkey.h"
+
+// What one refresh has learned about the file system, shared by every
+// entry resolved in it. Wraps the real source for the lifetime of a
+// refresh and asks it about each path at most once:
+//
+// - A directory is listed once, and its *.exe files and subdirectories
+//   are kept. Later checks for an executable or a subdirectory directly
+//   in it are answered from that listing.
+// - Any other file or directory check is probed once and remembered.
+// - The Program Files directories are listed up front, and the case
+//   folded names of what they contain go into a suffix trie, so finding
+//   the install directories whose name contains an app's name no longer
+//   walks all of them for every app.
+//
+// Nothing is ever invalidated; build a new index for the next refresh.
+class InstallDirectoryIndex : public InstallSource
+{
+public:
+    explicit InstallDirectoryIndex(const InstallSource& source);
+
+    QStringList registryRoots() const override;
+    QList<InstalledAppEntry> readEntries(const QString& registryRoot) const override;
+    QHash<QString, qint64> keyWriteTimes(const QString& registryRoot) const override;
+
+    QStringList programDirectories() const override;
+    bool isFile(const QString& path) const override;
+    bool isDirectory(const QString& path) const override;
+    qint64 lastModified(const QString& path) const override;
+    QStringList executables(const QString& directory) const override;
+    QStringList subdirectories(const QString& directory) const override;
+    QStringList subdirectoriesContaining(const QString& directory, const QString& text) const override;
+
+private:
+    struct Listing
+    {
+        QStringList executables;
+        QStringList subdirectories;
+        QSet<QString> foldedExecutables;
+        QSet<QString> foldedSubdirectories;
+    };
+
+    // Suffix trie over the folded subdirectory names of one directory.
+    // Every node keeps, in listing order, the names that pass through it,
+    // so the node reached by walking a text holds every name containing it.
+    class NameTrie
+    {
+    public:
+        explicit NameTrie(const QStringList& names);
+        QStringList namesContaining(const QString& text) const;
+
+    private:
+        struct Node
+        {
+            char16_t ch;
+            int firstChild;
+            int nextSibling;
+            QVector<int> names;
+        };
+
+        int child(int node, char16_t ch) const;
+        int addChild(int node, char16_t ch);
+
+        QStringList m_names;
+        QVector<Node> m_nodes;
+    };
+
+    std::shared_ptr<const Listing> listing(const QString& directory) const;
+    std::shared_ptr<const Listing> cachedListing(const PathKey& directory) const;
+    // Answers a check for name directly in directory from its listing,
+    // if that directory has been listed. False if it can not tell.
+    bool lookUpInParent(const QString& path, bool directory, bool& exists) const;
+    bool probe(QHash<PathKey, bool>& cache, const QString& path,
+               bool (InstallSource::*check)(const QString&) const) const;
+
+    const InstallSource& m_source;
+    QStringList m_programDirectories;
+    // Built in the constructor and read only afterwards
+    QHash<PathKey, std::shared_ptr<const NameTrie>> m_programTries;
+
+    // Resolution runs on several threads. The lock only guards the caches,
+    // never a call into the source, so two threads may rarely probe the
+    // same path twice.
+    mutable QMutex m_lock;
+    mutable QHash<PathKey, std::shared_ptr<const Listing>> m_listings;
+    mutable QHash<PathKey, bool> m_files;
+    mutable QHash<PathKey, bool> m_directories;
+};
+
+#endif // INSTALLDIRECTORYINDEX_H
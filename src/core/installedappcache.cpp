@@ -0,0 +1,77 @@
+#include "installedappcache.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+static const int kCacheVersion = 1;
+
+QString InstalledAppCache::pathFor(const QString& databasePath)
+{
+    QFileInfo info(databasePath);
+    return info.dir().filePath(info.completeBaseName() + ".apps");
+}
+
+bool InstalledAppCache::load(const QString& path, QList<CachedInstalledApp>& apps)
+{
+    apps.clear();
+
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    QJsonParseError error;
+    const QJsonDocument document = QJsonDocument::fromJson(file.readAll(), &error);
+    if (error.error != QJsonParseError::NoError || !document.isObject())
+        return false;
+
+    const QJsonObject cache = document.object();
+    if (cache["version"].toInt() != kCacheVersion)
+        return false;
+
+    const QJsonArray records = cache["apps"].toArray();
+    apps.reserve(records.size());
+    for (const QJsonValue& value : records) {
+        const QJsonObject record = value.toObject();
+        CachedInstalledApp app;
+        app.registryRoot = record["registryRoot"].toString();
+        app.appKey = record["appKey"].toString();
+        app.keyWriteTime = record["keyWriteTime"].toInteger();
+        app.exePath = record["exePath"].toString();
+        app.name = record["name"].toString();
+        app.directory = record["directory"].toString();
+        app.directoryModified = record["directoryModified"].toInteger(-1);
+        apps.append(app);
+    }
+    return true;
+}
+
+bool InstalledAppCache::save(const QString& path, const QList<CachedInstalledApp>& apps)
+{
+    QJsonArray records;
+    for (const CachedInstalledApp& app : apps) {
+        QJsonObject record;
+        record["registryRoot"] = app.registryRoot;
+        record["appKey"] = app.appKey;
+        record["keyWriteTime"] = app.keyWriteTime;
+        record["exePath"] = app.exePath;
+        record["name"] = app.name;
+        record["directory"] = app.directory;
+        record["directoryModified"] = app.directoryModified;
+        records.append(record);
+    }
+
+    QJsonObject cache;
+    cache["version"] = kCacheVersion;
+    cache["apps"] = records;
+
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+    file.write(QJsonDocument(cache).toJson(QJsonDocument::Compact));
+    return file.commit();
+}
@@ -0,0 +1,39 @@
+#ifndef INSTALLEDAPPCACHE_H
+#define INSTALLEDAPPCACHE_H
+
+#include <QString>
+#include <QList>
+
+// What one uninstall key resolved to, with the stamps that tell whether
+// it has to be resolved again
+struct CachedInstalledApp
+{
+    QString registryRoot;
+    QString appKey;
+    // Last write to the key, in ms since the epoch
+    qint64 keyWriteTime = 0;
+    // Empty if the key is not listed or nothing was found for it
+    QString exePath;
+    QString name;
+    // The directory of the executable, or the install location if none
+    // was found; empty if there is neither
+    QString directory;
+    // Its last modification in ms since the epoch, -1 if it did not exist
+    qint64 directoryModified = -1;
+};
+
+// The resolved installed apps of the last refresh, saved as JSON next to
+// foccuss.db so a start where nothing was installed or removed skips
+// resolution altogether. Records keep the order the keys were read in,
+// so the first of several keys for the same executable stays first.
+class InstalledAppCache
+{
+public:
+    static QString pathFor(const QString& databasePath);
+
+    static bool load(const QString& path, QList<CachedInstalledApp>& apps);
+    // Replaces the cache atomically
+    static bool save(const QString& path, const QList<CachedInstalledApp>& apps);
+};
+
+#endif // INSTALLEDAPPCACHE_H
@@ -0,0 +1,178 @@
+#include "installedappresolver.h"
+#include "../data/pathkey.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QRegularExpression>
+
+InstalledAppResolver::InstalledAppResolver(const InstallSource& source)
+    : m_source(source)
+{
+}
+
+QString InstalledAppResolver::resolve(const InstalledAppEntry& entry) const
+{
+    // Try different methods to find the executable path
+    QString exePath;
+
+    // Method 1: Try to extract from DisplayIcon first - this often points to the main executable
+    if (!entry.displayIcon.isEmpty()) {
+        exePath = extractExecutableFromDisplayIcon(entry.displayIcon);
+    }
+
+    // Method 2: Check InstallLocation if we couldn't find from DisplayIcon
+    if (exePath.isEmpty() && !entry.installLocation.isEmpty()) {
+        exePath = findExecutableInDirectory(PathKey::normalized(entry.installLocation), entry.displayName);
+    }
+
+    // Method 3: Try to find the path from the app key name (sometimes contains path info)
+    if (exePath.isEmpty()) {
+        exePath = extractExecutableFromAppKey(entry.appKey, entry.displayName);
+    }
+
+    // Method 4: Extract from UninstallString as a last resort
+    if (exePath.isEmpty() && !entry.uninstallString.isEmpty()) {
+        exePath = inferExecutableFromUninstallString(entry.uninstallString, entry.displayName);
+    }
+
+    // Method 5: Try looking for the app in common installation directories
+    if (exePath.isEmpty()) {
+        exePath = findCommonExecutablePath(entry.displayName, entry.appKey);
+    }
+
+    return exePath;
+}
+
+QString InstalledAppResolver::findExecutableInDirectory(const QString& directory, const QString& appName) const
+{
+    if (!m_source.isDirectory(directory))
+        return QString();
+
+    QDir dir(directory);
+    QString possibleExeName = appName.split(" ").first() + ".exe";
+    if (m_source.isFile(dir.filePath(possibleExeName)))
+        return dir.filePath(possibleExeName);
+
+    QStringList exeFiles = m_source.executables(directory);
+    if (!exeFiles.isEmpty())
+        return dir.filePath(exeFiles.first());
+
+    QStringList commonSubdirs = {"bin", "program", "app", "programs", "applications"};
+    for (const QString& subdir : commonSubdirs) {
+        QString subdirectory = dir.filePath(subdir);
+        if (m_source.isDirectory(subdirectory)) {
+            exeFiles = m_source.executables(subdirectory);
+            if (!exeFiles.isEmpty())
+                return QDir(subdirectory).filePath(exeFiles.first());
+        }
+    }
+
+    return QString();
+}
+
+QString InstalledAppResolver::extractExecutableFromDisplayIcon(const QString& displayIcon) const
+{
+    QString iconPath = displayIcon.split(",").first().trimmed();
+
+    if (iconPath.startsWith("\"") && iconPath.endsWith("\"")) {
+        iconPath = iconPath.mid(1, iconPath.length() - 2);
+    }
+
+    iconPath = PathKey::normalized(iconPath);
+    if (QFileInfo(iconPath).suffix().toLower() == "exe" && m_source.isFile(iconPath)) {
+        return iconPath;
+    }
+
+    return QString();
+}
+
+QString InstalledAppResolver::extractExecutableFromAppKey(const QString& appKey, const QString& displayName) const
+{
+    if (appKey.contains("\\")) {
+        QStringList parts = appKey.split("\\");
+        if (parts.size() >= 2) {
+            QString possiblePath = PathKey::normalized(appKey);
+            if (QFileInfo(possiblePath).suffix().toLower() == "exe" && m_source.isFile(possiblePath)) {
+                return possiblePath;
+            }
+
+            return findExecutableInDirectory(possiblePath, displayName);
+        }
+    }
+
+    return QString();
+}
+
+QString InstalledAppResolver::inferExecutableFromUninstallString(const QString& uninstallString, const QString& displayName) const
+{
+    QRegularExpression quoteRegex("\"([^\"]+)\"");
+    QRegularExpressionMatch match = quoteRegex.match(uninstallString);
+
+    if (match.hasMatch()) {
+        QString uninstallerPath = PathKey::normalized(match.captured(1));
+
+        if (!m_source.isFile(uninstallerPath)) {
+            return QString();
+        }
+
+        QString appDir = QFileInfo(uninstallerPath).path();
+
+        QStringList exeFiles = m_source.executables(appDir);
+        for (const QString& exeFile : exeFiles) {
+            QString lowerExe = exeFile.toLower();
+
+            if (isInstallerName(lowerExe)) {
+                continue;
+            }
+
+            QString simpleAppName = displayName.split(" ").first().toLower();
+            if (lowerExe.contains(simpleAppName)) {
+                return QDir(appDir).filePath(exeFile);
+            }
+        }
+
+        QString parentDir = QFileInfo(appDir).path();
+        if (parentDir != appDir) {
+            QString result = findExecutableInDirectory(parentDir, displayName);
+            if (!result.isEmpty()) {
+                return result;
+            }
+        }
+
+        for (const QString& exeFile : exeFiles) {
+            if (!isInstallerName(exeFile.toLower())) {
+                return QDir(appDir).filePath(exeFile);
+            }
+        }
+    }
+
+    return QString();
+}
+
+QString InstalledAppResolver::findCommonExecutablePath(const QString& appName, const QString& appKey) const
+{
+    QString simplifiedName = appName.split(" ").first();
+
+    for (const QString& programDir : m_source.programDirectories()) {
+        QString exePath = findExecutableInDirectory(programDir + "/" + simplifiedName, simplifiedName);
+        if (!exePath.isEmpty())
+            return exePath;
+
+        QStringList dirs = m_source.subdirectoriesContaining(programDir, simplifiedName);
+        for (const QString& dirname : dirs) {
+            exePath = findExecutableInDirectory(programDir + "/" + dirname, simplifiedName);
+            if (!exePath.isEmpty())
+                return exePath;
+        }
+    }
+
+    return QString();
+}
+
+bool InstalledAppResolver::isInstallerName(const QString& lowerExe)
+{
+    return lowerExe.contains("unins") ||
+           lowerExe.contains("setup") ||
+           lowerExe.contains("install") ||
+           lowerExe == "uninstall.exe";
+}
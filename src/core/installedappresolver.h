@@ -0,0 +1,33 @@
+#ifndef INSTALLEDAPPRESOLVER_H
+#define INSTALLEDAPPRESOLVER_H
+
+#include <QString>
+
+#include "installsource.h"
+
+// Finds the main executable of an installed app from its uninstall key,
+// trying five strategies in turn. Everything it learns about the file
+// system comes from the InstallSource, so it runs the same on a recorded
+// machine, and it keeps no state, so entries resolve on any thread.
+//
+// Returned paths use '/' separators.
+class InstalledAppResolver
+{
+public:
+    explicit InstalledAppResolver(const InstallSource& source);
+
+    QString resolve(const InstalledAppEntry& entry) const;
+
+private:
+    QString findExecutableInDirectory(const QString& directory, const QString& appName) const;
+    QString extractExecutableFromDisplayIcon(const QString& displayIcon) const;
+    QString extractExecutableFromAppKey(const QString& appKey, const QString& displayName) const;
+    QString inferExecutableFromUninstallString(const QString& uninstallString, const QString& displayName) const;
+    QString findCommonExecutablePath(const QString& appName, const QString& appKey) const;
+
+    static bool isInstallerName(const QString& lowerExe);
+
+    const InstallSource& m_source;
+};
+
+#endif // INSTALLEDAPPRESOLVER_H
@@ -0,0 +1,154 @@
+#include "installsource.h"
+
+QStringList InstallSource::subdirectoriesContaining(const QString& directory, const QString& text) const
+{
+    QStringList matching;
+    for (const QString& name : subdirectories(directory)) {
+        if (name.contains(text, Qt::CaseInsensitive))
+            matching.append(name);
+    }
+    return matching;
+}
+
+#ifdef Q_OS_WIN
+
+#include <QDir>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QSettings>
+
+#include <Windows.h>
+
+// FILETIME counts 100 ns intervals since 1601
+static qint64 fileTimeToMSecs(const FILETIME& fileTime)
+{
+    const quint64 ticks = (quint64(fileTime.dwHighDateTime) << 32) | fileTime.dwLowDateTime;
+    return static_cast<qint64>(ticks / 10000) - Q_INT64_C(11644473600000);
+}
+
+static bool openRegistryRoot(const QString& registryRoot, HKEY& key)
+{
+    static const struct { const char* name; HKEY hive; } hives[] = {
+        {"HKEY_LOCAL_MACHINE\\", HKEY_LOCAL_MACHINE},
+        {"HKEY_CURRENT_USER\\", HKEY_CURRENT_USER}
+    };
+
+    for (const auto& hive : hives) {
+        const QString prefix = QString::fromLatin1(hive.name);
+        if (registryRoot.startsWith(prefix, Qt::CaseInsensitive)) {
+            const std::wstring subKey = registryRoot.mid(prefix.size()).toStdWString();
+            return RegOpenKeyExW(hive.hive, subKey.c_str(), 0, KEY_READ, &key) == ERROR_SUCCESS;
+        }
+    }
+    return false;
+}
+
+QStringList WinInstallSource::registryRoots() const
+{
+    return {
+        // 64-bit applications
+        "HKEY_LOCAL_MACHINE\\SOFTWARE\\Microsoft\\Windows\\CurrentVersion\\Uninstall",
+        // 32-bit applications on 64-bit Windows
+        "HKEY_LOCAL_MACHINE\\SOFTWARE\\WOW6432Node\\Microsoft\\Windows\\CurrentVersion\\Uninstall",
+        // Per-user installed applications
+        "HKEY_CURRENT_USER\\SOFTWARE\\Microsoft\\Windows\\CurrentVersion\\Uninstall"
+    };
+}
+
+QList<InstalledAppEntry> WinInstallSource::readEntries(const QString& registryRoot) const
+{
+    // Stamped before the values are read, so a write in between shows up
+    // as a change next time rather than being missed
+    const QHash<QString, qint64> writeTimes = keyWriteTimes(registryRoot);
+
+    // A QSettings per call, so roots can be read on different threads
+    QSettings registry(registryRoot, QSettings::NativeFormat);
+    QList<InstalledAppEntry> entries;
+
+    const QStringList appKeys = registry.childGroups();
+    for (const QString& appKey : appKeys) {
+        registry.beginGroup(appKey);
+
+        InstalledAppEntry entry;
+        entry.appKey = appKey;
+        entry.displayName = registry.value("DisplayName").toString();
+        entry.uninstallString = registry.value("UninstallString").toString();
+        entry.installLocation = registry.value("InstallLocation").toString();
+        entry.displayIcon = registry.value("DisplayIcon").toString();
+        entry.publisher = registry.value("Publisher").toString();
+        entry.systemComponent = registry.value("SystemComponent").toInt() == 1;
+        entry.lastWriteTime = writeTimes.value(appKey);
+        entries.append(entry);
+
+        registry.endGroup();
+    }
+
+    return entries;
+}
+
+QHash<QString, qint64> WinInstallSource::keyWriteTimes(const QString& registryRoot) const
+{
+    QHash<QString, qint64> writeTimes;
+    HKEY key;
+    if (!openRegistryRoot(registryRoot, key))
+        return writeTimes;
+
+    // Key names are at most 255 characters
+    wchar_t name[256];
+    for (DWORD index = 0; ; ++index) {
+        DWORD nameLength = 256;
+        FILETIME lastWriteTime;
+        const LONG result = RegEnumKeyExW(key, index, name, &nameLength, nullptr, nullptr, nullptr, &lastWriteTime);
+        if (result == ERROR_NO_MORE_ITEMS)
+            break;
+        if (result != ERROR_SUCCESS)
+            continue;
+        writeTimes.insert(QString::fromWCharArray(name, nameLength), fileTimeToMSecs(lastWriteTime));
+    }
+
+    RegCloseKey(key);
+    return writeTimes;
+}
+
+QStringList WinInstallSource::programDirectories() const
+{
+    QStringList directories;
+    for (const char* variable : {"ProgramFiles", "ProgramFiles(x86)"}) {
+        const QString directory = QDir::fromNativeSeparators(qEnvironmentVariable(variable));
+        if (!directory.isEmpty() && !directories.contains(directory, Qt::CaseInsensitive))
+            directories.append(directory);
+    }
+    return directories;
+}
+
+bool WinInstallSource::isFile(const QString& path) const
+{
+    return QFileInfo(path).isFile();
+}
+
+bool WinInstallSource::isDirectory(const QString& path) const
+{
+    return QFileInfo(path).isDir();
+}
+
+qint64 WinInstallSource::lastModified(const QString& path) const
+{
+    const QFileInfo info(path);
+    return info.exists() ? info.lastModified().toMSecsSinceEpoch() : -1;
+}
+
+QStringList WinInstallSource::executables(const QString& directory) const
+{
+    // Hidden and system entries too: InstallDirectoryIndex answers isFile()
+    // and isDirectory() from these listings, and QFileInfo sees them
+    return QDir(directory).entryList(QStringList() << "*.exe", QDir::Files | QDir::Hidden | QDir::System,
+                                     QDir::Name | QDir::IgnoreCase);
+}
+
+QStringList WinInstallSource::subdirectories(const QString& directory) const
+{
+    return QDir(directory).entryList(QDir::Dirs | QDir::NoDotAndDotDot | QDir::Hidden | QDir::System,
+                                     QDir::Name | QDir::IgnoreCase);
+}
+
+#endif
@@ -0,0 +1,72 @@
+#ifndef INSTALLSOURCE_H
+#define INSTALLSOURCE_H
+
+#include <QString>
+#include <QStringList>
+#include <QList>
+#include <QHash>
+
+// The values of one uninstall registry key
+struct InstalledAppEntry
+{
+    QString appKey;
+    QString displayName;
+    QString uninstallString;
+    QString installLocation;
+    QString displayIcon;
+    QString publisher;
+    bool systemComponent = false;
+    // Last write to the key, in ms since the epoch
+    qint64 lastWriteTime = 0;
+};
+
+// Where installed apps come from: the uninstall keys to enumerate, and
+// the file system their executables are looked up in. Enumeration and
+// resolution only go through here, so a recorded source can replay a
+// machine anywhere. Every call may come from several threads at once.
+class InstallSource
+{
+public:
+    virtual ~InstallSource() = default;
+
+    // Uninstall key roots, in the order duplicates are resolved in
+    virtual QStringList registryRoots() const = 0;
+    virtual QList<InstalledAppEntry> readEntries(const QString& registryRoot) const = 0;
+    // Last write time of every key under registryRoot, by key name. Much
+    // cheaper than readEntries, it does not read any values.
+    virtual QHash<QString, qint64> keyWriteTimes(const QString& registryRoot) const = 0;
+
+    // Program Files directories, 64-bit first
+    virtual QStringList programDirectories() const = 0;
+    virtual bool isFile(const QString& path) const = 0;
+    virtual bool isDirectory(const QString& path) const = 0;
+    // In ms since the epoch, -1 if path does not exist
+    virtual qint64 lastModified(const QString& path) const = 0;
+    // Names of the *.exe files directly in directory, sorted by name
+    // ignoring case
+    virtual QStringList executables(const QString& directory) const = 0;
+    // Names of the directories directly in directory, sorted the same way
+    virtual QStringList subdirectories(const QString& directory) const = 0;
+    // The subdirectories whose name contains text, ignoring case
+    virtual QStringList subdirectoriesContaining(const QString& directory, const QString& text) const;
+};
+
+#ifdef Q_OS_WIN
+// The uninstall keys in the registry and the local file system
+class WinInstallSource : public InstallSource
+{
+public:
+    QStringList registryRoots() const override;
+    QList<InstalledAppEntry> readEntries(const QString& registryRoot) const override;
+    QHash<QString, qint64> keyWriteTimes(const QString& registryRoot) const override;
+
+    QStringList programDirectories() const override;
+    bool isFile(const QString& path) const override;
+    bool isDirectory(const QString& path) const override;
+    qint64 lastModified(const QString& path) const override;
+    QStringList executables(const QString& directory) const override;
+    QStringList subdirectories(const QString& directory) const override;
+};
+#endif
+
+#endif // INSTALLSOURCE_H
@@ -0,0 +1,122 @@
+#include "processcache.h"
+
+#include <QFileInfo>
+
+ProcessCache::ProcessCache(std::unique_ptr<ProcessSource> source)
+    : m_source(std::move(source)),
+      m_generation(0),
+      m_hits(0),
+      m_misses(0)
+{
+}
+
+QList<const CachedProcess*> ProcessCache::refresh(quint64 rulesRevision, const BlockDecider& decider)
+{
+    QList<const CachedProcess*> running;
+
+    if (!m_source || !m_source->snapshot(m_snapshot))
+        return running;
+
+    ++m_generation;
+
+    for (const ProcessEntry& entry : m_snapshot) {
+        CachedProcess& process = m_processes[entry.pid];
+        update(process, entry, rulesRevision, decider);
+        process.generation = m_generation;
+    }
+
+    // Drop processes that exited since the previous refresh. Pointers are
+    // collected afterwards because erasing may move the remaining entries.
+    const quint64 generation = m_generation;
+    m_processes.removeIf([generation](const QHash<quint32, CachedProcess>::iterator& it) {
+        return it->generation != generation;
+    });
+
+    running.reserve(m_processes.size());
+    for (auto it = m_processes.begin(); it != m_processes.end(); ++it) {
+        if (!it->path.isEmpty())
+            running.append(&it.value());
+    }
+
+    return running;
+}
+
+const CachedProcess* ProcessCache::resolve(quint32 pid, quint64 rulesRevision, const BlockDecider& decider)
+{
+    ProcessEntry entry;
+    if (!m_source || !m_source->query(pid, entry))
+        return nullptr;
+
+    CachedProcess& process = m_processes[pid];
+    update(process, entry, rulesRevision, decider);
+    process.generation = m_generation;
+
+    return process.path.isEmpty() ? nullptr : &process;
+}
+
+QList<const CachedProcess*> ProcessCache::applyRuleChange(quint64 baseRevision, quint64 revision,
+                                                          const BlockDecider& added, const BlockDecider& remaining)
+{
+    QList<const CachedProcess*> flipped;
+
+    for (auto it = m_processes.begin(); it != m_processes.end(); ++it) {
+        CachedProcess& process = it.value();
+        if (process.rulesRevision != baseRevision)
+            continue;
+
+        process.rulesRevision = revision;
+        if (process.key.isEmpty())
+            continue;
+
+        const BlockDecider& decider = process.blocked ? remaining : added;
+        if (!decider)
+            continue;
+
+        bool blocked = decider(process.key);
+        if (blocked != process.blocked) {
+            process.blocked = blocked;
+            flipped.append(&process);
+        }
+    }
+
+    return flipped;
+}
+
+void ProcessCache::update(CachedProcess& process, const ProcessEntry& entry, quint64 rulesRevision, const BlockDecider& decider)
+{
+    if (process.generation == 0 || process.startTime != entry.startTime || process.image != entry.image) {
+        // New process, the PID was reused by a different one, or it exec'd
+        // another executable
+        ++m_misses;
+        process.pid = entry.pid;
+        process.startTime = entry.startTime;
+        process.image = entry.image;
+        process.path = m_source->resolvePath(entry);
+        process.name = QFileInfo(process.path).fileName();
+        process.key = PathKey(process.path);
+        process.rulesRevision = rulesRevision;
+        process.blocked = decider && !process.key.isEmpty() && decider(process.key);
+        return;
+    }
+
+    ++m_hits;
+    if (process.rulesRevision != rulesRevision) {
+        process.rulesRevision = rulesRevision;
+        process.blocked = decider && !process.key.isEmpty() && decider(process.key);
+    }
+}
+
+void ProcessCache::clear()
+{
+    m_processes.clear();
+}
+
+quint64 ProcessCache::hits() const
+{
+    return m_hits;
+}
+
+quint64 ProcessCache::misses() const
+{
+    return m_misses;
+}
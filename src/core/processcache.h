@@ -0,0 +1,71 @@
+#ifndef PROCESSCACHE_H
+#define PROCESSCACHE_H
+
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <QVector>
+#include <functional>
+#include <memory>
+
+#include "processsource.h"
+#include "../data/pathkey.h"
+
+struct CachedProcess
+{
+    quint32 pid = 0;
+    quint64 startTime = 0;
+    quint64 image = 0;
+    QString path;
+    QString name;
+    // Normalized form of path, used for rule matching
+    PathKey key;
+    bool blocked = false;
+    quint64 rulesRevision = 0;
+    quint64 generation = 0;
+};
+
+// Remembers the resolved path and block decision of every process seen so
+// far. Only processes that were not running on the previous refresh, or
+// have exec'd another executable since, are resolved through the
+// ProcessSource.
+class ProcessCache
+{
+public:
+    using BlockDecider = std::function<bool(const PathKey& processKey)>;
+
+    explicit ProcessCache(std::unique_ptr<ProcessSource> source);
+
+    // Takes a new snapshot and returns the processes that are currently
+    // running. Block decisions are re-evaluated when rulesRevision changes.
+    QList<const CachedProcess*> refresh(quint64 rulesRevision = 0, const BlockDecider& decider = BlockDecider());
+
+    // Resolves a single process without taking a full snapshot, e.g. when
+    // a process start notification arrives. Returns nullptr if it is gone.
+    const CachedProcess* resolve(quint32 pid, quint64 rulesRevision = 0, const BlockDecider& decider = BlockDecider());
+
+    // Moves processes decided at baseRevision to revision after a rule
+    // change without matching each against every rule again: unblocked
+    // ones are checked against the added rules only, blocked ones against
+    // the remaining rules only if some were removed. Processes decided at
+    // any other revision are left for the next refresh. Returns the
+    // processes whose decision flipped.
+    QList<const CachedProcess*> applyRuleChange(quint64 baseRevision, quint64 revision,
+                                                const BlockDecider& added, const BlockDecider& remaining);
+    void clear();
+
+    quint64 hits() const;
+    quint64 misses() const;
+
+private:
+    void update(CachedProcess& process, const ProcessEntry& entry, quint64 rulesRevision, const BlockDecider& decider);
+
+    std::unique_ptr<ProcessSource> m_source;
+    QHash<quint32, CachedProcess> m_processes;
+    QVector<ProcessEntry> m_snapshot;
+    quint64 m_generation;
+    quint64 m_hits;
+    quint64 m_misses;
+};
+
+#endif // PROCESSCACHE_H
@@ -0,0 +1,423 @@
+#include "processeventsource.h"
+
+#ifdef Q_OS_WIN
+
+#include <QDebug>
+#include <mutex>
+#include <comdef.h>
+#include <Wbemidl.h>
+
+// WMI can hang for a long time on a damaged repository or a stuck
+// provider; the monitor polls rather than wait on it
+static const DWORD kStartTimeout = 5000;
+
+class WmiEventSink : public IWbemObjectSink
+{
+public:
+    WmiEventSink(WmiProcessEventSource* owner, bool started)
+        : m_refCount(1), m_owner(owner), m_started(started)
+    {
+    }
+
+    // Called before the owner goes away; WMI may still deliver a late batch
+    void detach()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_owner = nullptr;
+    }
+
+    ULONG STDMETHODCALLTYPE AddRef() override
+    {
+        return InterlockedIncrement(&m_refCount);
+    }
+
+    ULONG STDMETHODCALLTYPE Release() override
+    {
+        LONG refCount = InterlockedDecrement(&m_refCount);
+        if (refCount == 0)
+            delete this;
+        return refCount;
+    }
+
+    HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** ppv) override
+    {
+        if (riid == IID_IUnknown || riid == IID_IWbemObjectSink) {
+            *ppv = static_cast<IWbemObjectSink*>(this);
+            AddRef();
+            return WBEM_S_NO_ERROR;
+        }
+        *ppv = nullptr;
+        return E_NOINTERFACE;
+    }
+
+    HRESULT STDMETHODCALLTYPE Indicate(LONG objectCount, IWbemClassObject** objects) override
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_owner)
+            return WBEM_S_NO_ERROR;
+
+        for (LONG i = 0; i < objectCount; ++i) {
+            VARIANT processId;
+            VariantInit(&processId);
+            if (SUCCEEDED(objects[i]->Get(L"ProcessID", 0, &processId, NULL, NULL))) {
+                // WMI reports uint32 properties as VT_I4
+                quint32 pid = static_cast<quint32>(processId.lVal);
+                if (m_started)
+                    emit m_owner->processStarted(pid);
+                else
+                    emit m_owner->processExited(pid);
+            }
+            VariantClear(&processId);
+        }
+        return WBEM_S_NO_ERROR;
+    }
+
+    HRESULT STDMETHODCALLTYPE SetStatus(LONG, HRESULT, BSTR, IWbemClassObject*) override
+    {
+        return WBEM_S_NO_ERROR;
+    }
+
+private:
+    LONG m_refCount;
+    std::mutex m_mutex;
+    WmiProcessEventSource* m_owner;
+    bool m_started;
+};
+
+WmiProcessEventSource::WmiProcessEventSource(QObject *parent)
+    : ProcessEventSource(parent),
+      m_startedEvent(CreateEvent(NULL, TRUE, FALSE, NULL)),
+      m_stopEvent(CreateEvent(NULL, TRUE, FALSE, NULL)),
+      m_subscribed(false),
+      m_running(false),
+      m_services(nullptr),
+      m_startStub(nullptr),
+      m_stopStub(nullptr),
+      m_startSink(nullptr),
+      m_stopSink(nullptr)
+{
+}
+
+WmiProcessEventSource::~WmiProcessEventSource()
+{
+    stop();
+    // A start that timed out may still be inside WMI
+    if (m_thread.joinable())
+        m_thread.join();
+
+    if (m_startedEvent)
+        CloseHandle(m_startedEvent);
+    if (m_stopEvent)
+        CloseHandle(m_stopEvent);
+}
+
+bool WmiProcessEventSource::start()
+{
+    if (m_running)
+        return true;
+
+    if (!m_startedEvent || !m_stopEvent)
+        return false;
+
+    // The thread of a start that timed out exits once WMI returns; until
+    // then there is nothing to retry
+    if (m_thread.joinable()) {
+        if (WaitForSingleObject(m_startedEvent, 0) != WAIT_OBJECT_0)
+            return false;
+        m_thread.join();
+    }
+
+    ResetEvent(m_startedEvent);
+    ResetEvent(m_stopEvent);
+    m_subscribed = false;
+
+    // COM lives on its own MTA thread so it never depends on the apartment
+    // or event loop of whoever owns the monitor
+    m_thread = std::thread(&WmiProcessEventSource::eventThread, this);
+    if (WaitForSingleObject(m_startedEvent, kStartTimeout) != WAIT_OBJECT_0) {
+        // Told to unsubscribe as soon as it gets there
+        qDebug() << "WMI process events: no subscription after" << kStartTimeout << "ms";
+        SetEvent(m_stopEvent);
+        return false;
+    }
+
+    if (!m_subscribed) {
+        m_thread.join();
+        return false;
+    }
+
+    m_running = true;
+    return true;
+}
+
+void WmiProcessEventSource::stop()
+{
+    if (!m_thread.joinable())
+        return;
+
+    SetEvent(m_stopEvent);
+    // Not joined while it is still stuck in a start that timed out
+    if (!m_running && WaitForSingleObject(m_startedEvent, 0) != WAIT_OBJECT_0)
+        return;
+
+    m_thread.join();
+    m_running = false;
+}
+
+bool WmiProcessEventSource::isRunning() const
+{
+    return m_running;
+}
+
+void WmiProcessEventSource::eventThread()
+{
+    HRESULT hr = CoInitializeEx(NULL, COINIT_MULTITHREADED);
+    if (FAILED(hr)) {
+        qDebug() << "WMI process events: CoInitializeEx failed" << Qt::hex << hr;
+        SetEvent(m_startedEvent);
+        return;
+    }
+
+    m_subscribed = subscribe();
+    SetEvent(m_startedEvent);
+
+    if (m_subscribed)
+        WaitForSingleObject(m_stopEvent, INFINITE);
+
+    unsubscribe();
+    CoUninitialize();
+}
+
+bool WmiProcessEventSource::subscribe()
+{
+    // Fails with RPC_E_TOO_LATE when the process already set its security
+    // defaults, which is fine for our purposes
+    CoInitializeSecurity(NULL, -1, NULL, NULL, RPC_C_AUTHN_LEVEL_DEFAULT,
+                         RPC_C_IMP_LEVEL_IMPERSONATE, NULL, EOAC_NONE, NULL);
+
+    IWbemLocator* locator = nullptr;
+    HRESULT hr = CoCreateInstance(CLSID_WbemLocator, NULL, CLSCTX_INPROC_SERVER,
+                                  IID_IWbemLocator, reinterpret_cast<void**>(&locator));
+    if (FAILED(hr)) {
+        qDebug() << "WMI process events: no locator" << Qt::hex << hr;
+        return false;
+    }
+
+    hr = locator->ConnectServer(_bstr_t(L"ROOT\\CIMV2"), NULL, NULL, NULL, 0, NULL, NULL, &m_services);
+    locator->Release();
+    if (FAILED(hr)) {
+        qDebug() << "WMI process events: ConnectServer failed" << Qt::hex << hr;
+        return false;
+    }
+
+    hr = CoSetProxyBlanket(m_services, RPC_C_AUTHN_WINNT, RPC_C_AUTHZ_NONE, NULL,
+                           RPC_C_AUTHN_LEVEL_CALL, RPC_C_IMP_LEVEL_IMPERSONATE, NULL, EOAC_NONE);
+    if (FAILED(hr))
+        return false;
+
+    // Unsecured apartment stubs let WMI call back without us opening up
+    // the process-wide COM security settings
+    IUnsecuredApartment* apartment = nullptr;
+    hr = CoCreateInstance(CLSID_UnsecuredApartment, NULL, CLSCTX_LOCAL_SERVER,
+                          IID_IUnsecuredApartment, reinterpret_cast<void**>(&apartment));
+    if (FAILED(hr))
+        return false;
+
+    auto createStub = [apartment](WmiEventSink* sink, IWbemObjectSink** stub) {
+        IUnknown* stubUnknown = nullptr;
+        if (FAILED(apartment->CreateObjectStub(sink, &stubUnknown)))
+            return false;
+        HRESULT result = stubUnknown->QueryInterface(IID_IWbemObjectSink, reinterpret_cast<void**>(stub));
+        stubUnknown->Release();
+        return SUCCEEDED(result);
+    };
+
+    m_startSink = new WmiEventSink(this, true);
+    m_stopSink = new WmiEventSink(this, false);
+    bool stubsCreated = createStub(m_startSink, &m_startStub) && createStub(m_stopSink, &m_stopStub);
+    apartment->Release();
+    if (!stubsCreated)
+        return false;
+
+    hr = m_services->ExecNotificationQueryAsync(
+        _bstr_t(L"WQL"), _bstr_t(L"SELECT ProcessID FROM Win32_ProcessStartTrace"),
+        WBEM_FLAG_SEND_STATUS, NULL, m_startStub);
+    if (FAILED(hr)) {
+        qDebug() << "WMI process events: start trace query failed" << Qt::hex << hr;
+        return false;
+    }
+
+    hr = m_services->ExecNotificationQueryAsync(
+        _bstr_t(L"WQL"), _bstr_t(L"SELECT ProcessID FROM Win32_ProcessStopTrace"),
+        WBEM_FLAG_SEND_STATUS, NULL, m_stopStub);
+    if (FAILED(hr)) {
+        qDebug() << "WMI process events: stop trace query failed" << Qt::hex << hr;
+        return false;
+    }
+
+    return true;
+}
+
+void WmiProcessEventSource::unsubscribe()
+{
+    if (m_services) {
+        if (m_startStub)
+            m_services->CancelAsyncCall(m_startStub);
+        if (m_stopStub)
+            m_services->CancelAsyncCall(m_stopStub);
+    }
+
+    if (m_startSink)
+        m_startSink->detach();
+    if (m_stopSink)
+        m_stopSink->detach();
+
+    if (m_startStub)
+        m_startStub->Release();
+    if (m_stopStub)
+        m_stopStub->Release();
+    if (m_startSink)
+        m_startSink->Release();
+    if (m_stopSink)
+        m_stopSink->Release();
+    if (m_services)
+        m_services->Release();
+
+    m_startStub = nullptr;
+    m_stopStub = nullptr;
+    m_startSink = nullptr;
+    m_stopSink = nullptr;
+    m_services = nullptr;
+}
+
+#elif defined(Q_OS_LINUX)
+
+#include <QDebug>
+#include <QSocketNotifier>
+#include <cerrno>
+#include <cstring>
+#include <linux/cn_proc.h>
+#include <linux/connector.h>
+#include <linux/netlink.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// Values of proc_event::what. Older kernel headers nest the enum in the
+// struct and newer ones do not, so they are spelled out here.
+static const quint32 kProcEventExec = 0x00000002;
+static const quint32 kProcEventExit = 0x80000000;
+
+NetlinkProcessEventSource::NetlinkProcessEventSource(QObject *parent)
+    : ProcessEventSource(parent),
+      m_socket(-1),
+      m_notifier(nullptr)
+{
+}
+
+NetlinkProcessEventSource::~NetlinkProcessEventSource()
+{
+    stop();
+}
+
+bool NetlinkProcessEventSource::start()
+{
+    if (m_socket >= 0)
+        return true;
+
+    m_socket = socket(PF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_CONNECTOR);
+    if (m_socket < 0) {
+        qDebug() << "Proc connector: no netlink socket:" << strerror(errno);
+        return false;
+    }
+
+    sockaddr_nl address;
+    memset(&address, 0, sizeof(address));
+    address.nl_family = AF_NETLINK;
+    address.nl_groups = CN_IDX_PROC;
+    // Fails with EPERM without CAP_NET_ADMIN
+    if (bind(m_socket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0
+        || !sendControl(PROC_CN_MCAST_LISTEN)) {
+        qDebug() << "Proc connector: subscribing failed:" << strerror(errno);
+        close(m_socket);
+        m_socket = -1;
+        return false;
+    }
+
+    m_notifier = new QSocketNotifier(m_socket, QSocketNotifier::Read, this);
+    connect(m_notifier, &QSocketNotifier::activated, this, &NetlinkProcessEventSource::readEvents);
+    return true;
+}
+
+void NetlinkProcessEventSource::stop()
+{
+    if (m_socket < 0)
+        return;
+
+    delete m_notifier;
+    m_notifier = nullptr;
+    sendControl(PROC_CN_MCAST_IGNORE);
+    close(m_socket);
+    m_socket = -1;
+}
+
+bool NetlinkProcessEventSource::isRunning() const
+{
+    return m_socket >= 0;
+}
+
+bool NetlinkProcessEventSource::sendControl(int operation)
+{
+    alignas(nlmsghdr) char buffer[NLMSG_SPACE(sizeof(cn_msg) + sizeof(proc_cn_mcast_op))];
+    memset(buffer, 0, sizeof(buffer));
+
+    nlmsghdr* header = reinterpret_cast<nlmsghdr*>(buffer);
+    header->nlmsg_len = NLMSG_LENGTH(sizeof(cn_msg) + sizeof(proc_cn_mcast_op));
+    header->nlmsg_type = NLMSG_DONE;
+
+    cn_msg* message = static_cast<cn_msg*>(NLMSG_DATA(header));
+    message->id.idx = CN_IDX_PROC;
+    message->id.val = CN_VAL_PROC;
+    message->len = sizeof(proc_cn_mcast_op);
+    const proc_cn_mcast_op op = static_cast<proc_cn_mcast_op>(operation);
+    memcpy(message->data, &op, sizeof(op));
+
+    return send(m_socket, buffer, header->nlmsg_len, 0) >= 0;
+}
+
+void NetlinkProcessEventSource::readEvents()
+{
+    alignas(nlmsghdr) char buffer[8192];
+
+    // Everything that queued up since the last wakeup
+    for (;;) {
+        const ssize_t received = recv(m_socket, buffer, sizeof(buffer), 0);
+        if (received <= 0)
+            return;
+
+        int remaining = static_cast<int>(received);
+        for (const nlmsghdr* header = reinterpret_cast<const nlmsghdr*>(buffer);
+             NLMSG_OK(header, remaining); header = NLMSG_NEXT(header, remaining)) {
+            if (header->nlmsg_type == NLMSG_ERROR || header->nlmsg_type == NLMSG_NOOP)
+                continue;
+
+            const cn_msg* message = static_cast<const cn_msg*>(NLMSG_DATA(header));
+            if (message->id.idx != CN_IDX_PROC || message->id.val != CN_VAL_PROC)
+                continue;
+
+            // A fork still runs its parent's image, so a process counts as
+            // started once it execs. Threads exec and exit too; only the
+            // thread group leader is the process.
+            const proc_event* event = reinterpret_cast<const proc_event*>(message->data);
+            const quint32 what = static_cast<quint32>(event->what);
+            if (what == kProcEventExec
+                && event->event_data.exec.process_pid == event->event_data.exec.process_tgid) {
+                emit processStarted(static_cast<quint32>(event->event_data.exec.process_pid));
+            } else if (what == kProcEventExit
+                       && event->event_data.exit.process_pid == event->event_data.exit.process_tgid) {
+                emit processExited(static_cast<quint32>(event->event_data.exit.process_pid));
+            }
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,101 @@
+#ifndef PROCESSEVENTSOURCE_H
+#define PROCESSEVENTSOURCE_H
+
+#include <QObject>
+#include <memory>
+#include <thread>
+
+#ifdef Q_OS_WIN
+#include <Windows.h>
+#endif
+
+class QSocketNotifier;
+
+// Pushes process start/exit notifications. Signals may be emitted from a
+// backend thread, so receivers get them queued onto their own thread.
+class ProcessEventSource : public QObject
+{
+    Q_OBJECT
+
+public:
+    using QObject::QObject;
+
+    virtual bool start() = 0;
+    virtual void stop() = 0;
+    virtual bool isRunning() const = 0;
+
+signals:
+    void processStarted(quint32 pid);
+    void processExited(quint32 pid);
+};
+
+#ifdef Q_OS_WIN
+class WmiEventSink;
+struct IWbemServices;
+struct IWbemObjectSink;
+
+// Subscribes to Win32_ProcessStartTrace/Win32_ProcessStopTrace, which WMI
+// serves from the kernel process trace. Needs administrator rights, which
+// both the elevated GUI and the LocalSystem service have.
+class WmiProcessEventSource : public ProcessEventSource
+{
+    Q_OBJECT
+
+public:
+    explicit WmiProcessEventSource(QObject *parent = nullptr);
+    ~WmiProcessEventSource() override;
+
+    bool start() override;
+    void stop() override;
+    bool isRunning() const override;
+
+private:
+    void eventThread();
+    bool subscribe();
+    void unsubscribe();
+
+    std::thread m_thread;
+    HANDLE m_startedEvent;
+    HANDLE m_stopEvent;
+    bool m_subscribed;
+    bool m_running;
+
+    // COM objects, owned by the event thread
+    IWbemServices* m_services;
+    IWbemObjectSink* m_startStub;
+    IWbemObjectSink* m_stopStub;
+    WmiEventSink* m_startSink;
+    WmiEventSink* m_stopSink;
+};
+
+using SystemProcessEventSource = WmiProcessEventSource;
+#elif defined(Q_OS_LINUX)
+// Listens to the kernel proc connector, a netlink multicast of process
+// exec and exit events, on the owning thread's event loop. Joining it
+// needs CAP_NET_ADMIN, so like WMI it only starts for root.
+class NetlinkProcessEventSource : public ProcessEventSource
+{
+    Q_OBJECT
+
+public:
+    explicit NetlinkProcessEventSource(QObject *parent = nullptr);
+    ~NetlinkProcessEventSource() override;
+
+    bool start() override;
+    void stop() override;
+    bool isRunning() const override;
+
+private slots:
+    void readEvents();
+
+private:
+    bool sendControl(int operation);
+
+    int m_socket;
+    QSocketNotifier* m_notifier;
+};
+
+using SystemProcessEventSource = NetlinkProcessEventSource;
+#endif
+
+#endif // PROCESSEVENTSOURCE_H
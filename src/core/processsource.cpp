@@ -0,0 +1,173 @@
+#include "processsource.h"
+
+#ifdef Q_OS_WIN
+
+#include <Windows.h>
+#include <TlHelp32.h>
+
+static bool queryStartTime(HANDLE hProcess, quint64& startTime)
+{
+    FILETIME creationTime, exitTime, kernelTime, userTime;
+    if (!GetProcessTimes(hProcess, &creationTime, &exitTime, &kernelTime, &userTime))
+        return false;
+
+    startTime = (quint64(creationTime.dwHighDateTime) << 32) | creationTime.dwLowDateTime;
+    return true;
+}
+
+bool WinProcessSource::snapshot(QVector<ProcessEntry>& processes)
+{
+    processes.clear();
+
+    HANDLE hSnapshot = CreateToolhelp32Snapshot(TH32CS_SNAPPROCESS, 0);
+    if (hSnapshot == INVALID_HANDLE_VALUE)
+        return false;
+
+    PROCESSENTRY32 pe32;
+    pe32.dwSize = sizeof(PROCESSENTRY32);
+
+    if (!Process32First(hSnapshot, &pe32)) {
+        CloseHandle(hSnapshot);
+        return false;
+    }
+
+    do {
+        // Limited access is enough for GetProcessTimes and, unlike
+        // PROCESS_VM_READ, is granted for most elevated processes too
+        HANDLE hProcess = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, pe32.th32ProcessID);
+        if (!hProcess)
+            continue;
+
+        ProcessEntry entry;
+        entry.pid = pe32.th32ProcessID;
+        if (queryStartTime(hProcess, entry.startTime))
+            processes.append(entry);
+
+        CloseHandle(hProcess);
+    } while (Process32Next(hSnapshot, &pe32));
+
+    CloseHandle(hSnapshot);
+    return true;
+}
+
+bool WinProcessSource::query(quint32 pid, ProcessEntry& process)
+{
+    HANDLE hProcess = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, pid);
+    if (!hProcess)
+        return false;
+
+    process.pid = pid;
+    process.image = 0;
+    bool found = queryStartTime(hProcess, process.startTime);
+
+    CloseHandle(hProcess);
+    return found;
+}
+
+QString WinProcessSource::resolvePath(const ProcessEntry& process)
+{
+    HANDLE hProcess = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, process.pid);
+    if (!hProcess)
+        return QString();
+
+    QString processPath;
+    quint64 startTime = 0;
+
+    // Make sure the PID was not recycled since the snapshot was taken
+    if (queryStartTime(hProcess, startTime) && startTime == process.startTime) {
+        WCHAR szProcessPath[MAX_PATH];
+        DWORD size = MAX_PATH;
+        if (QueryFullProcessImageNameW(hProcess, 0, szProcessPath, &size))
+            processPath = QString::fromWCharArray(szProcessPath, int(size));
+    }
+
+    CloseHandle(hProcess);
+    return processPath;
+}
+
+#elif defined(Q_OS_LINUX)
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+
+#include <sys/stat.h>
+
+static bool readStartTime(quint32 pid, quint64& startTime)
+{
+    QFile stat(QString("/proc/%1/stat").arg(pid));
+    if (!stat.open(QIODevice::ReadOnly))
+        return false;
+
+    // The command name in field 2 may contain spaces and parentheses, so
+    // the fields are counted from the last ')'
+    const QByteArray line = stat.readAll();
+    const qsizetype commEnd = line.lastIndexOf(')');
+    if (commEnd < 0)
+        return false;
+
+    const QList<QByteArray> fields = line.mid(commEnd + 2).split(' ');
+    // fields[0] is field 3 (state), so field 22 (starttime) is fields[19]
+    if (fields.size() < 20)
+        return false;
+
+    bool ok = false;
+    startTime = fields[19].toULongLong(&ok);
+    return ok;
+}
+
+// The executable behind /proc/<pid>/exe, 0 if it can not be read
+static quint64 readImage(quint32 pid)
+{
+    struct stat info;
+    if (stat(QString("/proc/%1/exe").arg(pid).toLocal8Bit().constData(), &info) != 0)
+        return 0;
+    return (quint64(info.st_dev) << 40) ^ quint64(info.st_ino);
+}
+
+bool ProcProcessSource::snapshot(QVector<ProcessEntry>& processes)
+{
+    processes.clear();
+
+    const QDir proc("/proc");
+    if (!proc.exists())
+        return false;
+
+    const QStringList names = proc.entryList(QDir::Dirs | QDir::NoDotAndDotDot);
+    for (const QString& name : names) {
+        bool isPid = false;
+        const quint32 pid = name.toUInt(&isPid);
+        if (!isPid)
+            continue;
+
+        // Gone between the listing and the read
+        ProcessEntry entry;
+        entry.pid = pid;
+        if (readStartTime(pid, entry.startTime)) {
+            entry.image = readImage(pid);
+            processes.append(entry);
+        }
+    }
+
+    return true;
+}
+
+bool ProcProcessSource::query(quint32 pid, ProcessEntry& process)
+{
+    process.pid = pid;
+    process.image = readImage(pid);
+    return readStartTime(pid, process.startTime);
+}
+
+QString ProcProcessSource::resolvePath(const ProcessEntry& process)
+{
+    const QString processPath = QFileInfo(QString("/proc/%1/exe").arg(process.pid)).symLinkTarget();
+
+    // Make sure the PID was not recycled since the snapshot was taken
+    quint64 startTime = 0;
+    if (!readStartTime(process.pid, startTime) || startTime != process.startTime)
+        return QString();
+    return processPath;
+}
+
+#endif
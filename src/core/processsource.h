@@ -0,0 +1,57 @@
+#ifndef PROCESSSOURCE_H
+#define PROCESSSOURCE_H
+
+#include <QString>
+#include <QVector>
+
+struct ProcessEntry
+{
+    quint32 pid;
+    quint64 startTime;
+    // The executable the process runs, where exec can replace it without
+    // changing the pid or start time; 0 where it can not or is unknown
+    quint64 image = 0;
+};
+
+// Enumerates running processes. (pid, startTime, image) identifies a
+// process and the executable it runs, so callers can cache anything
+// resolved from it.
+class ProcessSource
+{
+public:
+    virtual ~ProcessSource() = default;
+
+    virtual bool snapshot(QVector<ProcessEntry>& processes) = 0;
+    virtual bool query(quint32 pid, ProcessEntry& process) = 0;
+    virtual QString resolvePath(const ProcessEntry& process) = 0;
+};
+
+#ifdef Q_OS_WIN
+// Toolhelp snapshot, with the creation time from GetProcessTimes
+class WinProcessSource : public ProcessSource
+{
+public:
+    bool snapshot(QVector<ProcessEntry>& processes) override;
+    bool query(quint32 pid, ProcessEntry& process) override;
+    QString resolvePath(const ProcessEntry& process) override;
+};
+
+using SystemProcessSource = WinProcessSource;
+#elif defined(Q_OS_LINUX)
+// Reads /proc. The start time is field 22 of /proc/<pid>/stat, in clock
+// ticks since boot, and the path is the target of /proc/<pid>/exe, which
+// kernel threads and processes of other users without ptrace access
+// lack. execve keeps both pid and start time, so the image is the device
+// and inode /proc/<pid>/exe points at.
+class ProcProcessSource : public ProcessSource
+{
+public:
+    bool snapshot(QVector<ProcessEntry>& processes) override;
+    bool query(quint32 pid, ProcessEntry& process) override;
+    QString resolvePath(const ProcessEntry& process) override;
+};
+
+using SystemProcessSource = ProcProcessSource;
+#endif
+
+#endif // PROCESSSOURCE_H
@@ -0,0 +1,280 @@
+#include "recordedinstallsource.h"
+
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QMutexLocker>
+
+static QJsonObject entryToJson(const InstalledAppEntry& entry)
+{
+    QJsonObject json;
+    json["appKey"] = entry.appKey;
+    json["displayName"] = entry.displayName;
+    json["uninstallString"] = entry.uninstallString;
+    json["installLocation"] = entry.installLocation;
+    json["displayIcon"] = entry.displayIcon;
+    json["publisher"] = entry.publisher;
+    json["systemComponent"] = entry.systemComponent;
+    json["lastWriteTime"] = entry.lastWriteTime;
+    return json;
+}
+
+static InstalledAppEntry entryFromJson(const QJsonObject& json)
+{
+    InstalledAppEntry entry;
+    entry.appKey = json["appKey"].toString();
+    entry.displayName = json["displayName"].toString();
+    entry.uninstallString = json["uninstallString"].toString();
+    entry.installLocation = json["installLocation"].toString();
+    entry.displayIcon = json["displayIcon"].toString();
+    entry.publisher = json["publisher"].toString();
+    entry.systemComponent = json["systemComponent"].toBool();
+    entry.lastWriteTime = json["lastWriteTime"].toInteger();
+    return entry;
+}
+
+static QStringList sortedNames(const QJsonArray& names)
+{
+    QStringList result;
+    for (const QJsonValue& name : names)
+        result.append(name.toString());
+    result.sort(Qt::CaseInsensitive);
+    return result;
+}
+
+#pragma region RecordedInstallSource
+
+bool RecordedInstallSource::load(const QString& fixturePath)
+{
+    QFile file(fixturePath);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    QJsonParseError error;
+    QJsonDocument document = QJsonDocument::fromJson(file.readAll(), &error);
+    if (error.error != QJsonParseError::NoError || !document.isObject())
+        return false;
+
+    return load(document.object());
+}
+
+bool RecordedInstallSource::load(const QJsonObject& fixture)
+{
+    m_registryRoots.clear();
+    m_entries.clear();
+    m_programDirectories.clear();
+    m_directories.clear();
+    m_files.clear();
+    m_modified.clear();
+
+    for (const QJsonValue& directory : fixture["programDirectories"].toArray())
+        m_programDirectories.append(directory.toString());
+
+    // Roots replay in the order they were recorded in
+    const QJsonObject registry = fixture["registry"].toObject();
+    for (const QJsonValue& root : fixture["registryRoots"].toArray()) {
+        QList<InstalledAppEntry> entries;
+        for (const QJsonValue& entry : registry[root.toString()].toArray())
+            entries.append(entryFromJson(entry.toObject()));
+        m_registryRoots.append(root.toString());
+        m_entries.insert(root.toString(), entries);
+    }
+
+    const QJsonObject directories = fixture["directories"].toObject();
+    for (auto it = directories.constBegin(); it != directories.constEnd(); ++it) {
+        const QJsonObject listing = it.value().toObject();
+        Directory directory;
+        directory.executables = sortedNames(listing["executables"].toArray());
+        directory.subdirectories = sortedNames(listing["subdirectories"].toArray());
+
+        // A listed executable is a file, whether or not it was checked
+        const QDir dir(it.key());
+        for (const QString& executable : directory.executables)
+            m_files.insert(PathKey(dir.filePath(executable)));
+        m_directories.insert(PathKey(it.key()), directory);
+    }
+
+    for (const QJsonValue& file : fixture["files"].toArray())
+        m_files.insert(PathKey(file.toString()));
+
+    const QJsonObject modified = fixture["modified"].toObject();
+    for (auto it = modified.constBegin(); it != modified.constEnd(); ++it)
+        m_modified.insert(PathKey(it.key()), it.value().toInteger(-1));
+
+    return true;
+}
+
+QStringList RecordedInstallSource::registryRoots() const
+{
+    return m_registryRoots;
+}
+
+QList<InstalledAppEntry> RecordedInstallSource::readEntries(const QString& registryRoot) const
+{
+    return m_entries.value(registryRoot);
+}
+
+QHash<QString, qint64> RecordedInstallSource::keyWriteTimes(const QString& registryRoot) const
+{
+    QHash<QString, qint64> writeTimes;
+    for (const InstalledAppEntry& entry : m_entries.value(registryRoot))
+        writeTimes.insert(entry.appKey, entry.lastWriteTime);
+    return writeTimes;
+}
+
+QStringList RecordedInstallSource::programDirectories() const
+{
+    return m_programDirectories;
+}
+
+bool RecordedInstallSource::isFile(const QString& path) const
+{
+    return m_files.contains(PathKey(path));
+}
+
+bool RecordedInstallSource::isDirectory(const QString& path) const
+{
+    return m_directories.contains(PathKey(path));
+}
+
+qint64 RecordedInstallSource::lastModified(const QString& path) const
+{
+    return m_modified.value(PathKey(path), -1);
+}
+
+QStringList RecordedInstallSource::executables(const QString& directory) const
+{
+    return m_directories.value(PathKey(directory)).executables;
+}
+
+QStringList RecordedInstallSource::subdirectories(const QString& directory) const
+{
+    return m_directories.value(PathKey(directory)).subdirectories;
+}
+
+#pragma endregion RecordedInstallSource
+
+#pragma region InstallSourceRecorder
+
+InstallSourceRecorder::InstallSourceRecorder(const InstallSource& source)
+    : m_source(source)
+{
+}
+
+QJsonObject InstallSourceRecorder::fixture() const
+{
+    QMutexLocker locker(&m_lock);
+
+    QJsonObject fixture;
+    fixture["programDirectories"] = QJsonArray::fromStringList(m_programDirectories);
+    fixture["registryRoots"] = QJsonArray::fromStringList(m_source.registryRoots());
+    fixture["registry"] = m_registry;
+    fixture["directories"] = m_directories;
+
+    QStringList files = m_files.values();
+    files.sort(Qt::CaseInsensitive);
+    fixture["files"] = QJsonArray::fromStringList(files);
+    fixture["modified"] = m_modified;
+    return fixture;
+}
+
+bool InstallSourceRecorder::save(const QString& fixturePath) const
+{
+    QSaveFile file(fixturePath);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+    file.write(QJsonDocument(fixture()).toJson(QJsonDocument::Indented));
+    return file.commit();
+}
+
+QStringList InstallSourceRecorder::registryRoots() const
+{
+    return m_source.registryRoots();
+}
+
+QList<InstalledAppEntry> InstallSourceRecorder::readEntries(const QString& registryRoot) const
+{
+    const QList<InstalledAppEntry> entries = m_source.readEntries(registryRoot);
+
+    QJsonArray recorded;
+    for (const InstalledAppEntry& entry : entries)
+        recorded.append(entryToJson(entry));
+
+    QMutexLocker locker(&m_lock);
+    m_registry[registryRoot] = recorded;
+    return entries;
+}
+
+QHash<QString, qint64> InstallSourceRecorder::keyWriteTimes(const QString& registryRoot) const
+{
+    // Replayed from the recorded entries, so a root has to be read once
+    // for its stamps to be in the fixture
+    return m_source.keyWriteTimes(registryRoot);
+}
+
+QStringList InstallSourceRecorder::programDirectories() const
+{
+    const QStringList directories = m_source.programDirectories();
+
+    QMutexLocker locker(&m_lock);
+    m_programDirectories = directories;
+    return directories;
+}
+
+bool InstallSourceRecorder::isFile(const QString& path) const
+{
+    // Only what exists is recorded; anything else replays as missing
+    if (!m_source.isFile(path))
+        return false;
+
+    QMutexLocker locker(&m_lock);
+    m_files.insert(path);
+    return true;
+}
+
+bool InstallSourceRecorder::isDirectory(const QString& path) const
+{
+    if (!m_source.isDirectory(path))
+        return false;
+
+    // Listed right away, so the replay can answer whatever comes next
+    recordDirectory(path);
+    return true;
+}
+
+qint64 InstallSourceRecorder::lastModified(const QString& path) const
+{
+    const qint64 modified = m_source.lastModified(path);
+
+    QMutexLocker locker(&m_lock);
+    m_modified[path] = modified;
+    return modified;
+}
+
+QStringList InstallSourceRecorder::executables(const QString& directory) const
+{
+    return recordDirectory(directory).first;
+}
+
+QStringList InstallSourceRecorder::subdirectories(const QString& directory) const
+{
+    return recordDirectory(directory).second;
+}
+
+QPair<QStringList, QStringList> InstallSourceRecorder::recordDirectory(const QString& directory) const
+{
+    const QStringList executables = m_source.executables(directory);
+    const QStringList subdirectories = m_source.subdirectories(directory);
+
+    QJsonObject listing;
+    listing["executables"] = QJsonArray::fromStringList(executables);
+    listing["subdirectories"] = QJsonArray::fromStringList(subdirectories);
+
+    QMutexLocker locker(&m_lock);
+    m_directories[directory] = listing;
+    return qMakePair(executables, subdirectories);
+}
+
+#pragma endregion InstallSourceRecorder
@@ -0,0 +1,97 @@
+#ifndef RECORDEDINSTALLSOURCE_H
+#define RECORDEDINSTALLSOURCE_H
+
+#include <QHash>
+#include <QSet>
+#include <QMutex>
+#include <QPair>
+#include <QJsonObject>
+
+#include "installsource.h"
+#include "../data/pathkey.h"
+
+// Replays a machine captured by InstallSourceRecorder: the uninstall
+// entries of every root, plus each directory resolution looked into and
+// each file it checked. Lookups ignore case and separators like Windows
+// does, so detection runs deterministically on any platform.
+//
+// Fixture layout (JSON):
+//   "programDirectories": ["C:/Program Files", ...]
+//   "registryRoots": [root, ...]
+//   "registry":    { root: [{ "appKey", "displayName", "uninstallString",
+//                             "installLocation", "displayIcon",
+//                             "publisher", "systemComponent",
+//                             "lastWriteTime" }, ...] }
+//   "directories": { path: { "executables": [...], "subdirectories": [...] } }
+//   "files":       [path, ...]
+//   "modified":    { path: msecsSinceEpoch }
+class RecordedInstallSource : public InstallSource
+{
+public:
+    bool load(const QString& fixturePath);
+    bool load(const QJsonObject& fixture);
+
+    QStringList registryRoots() const override;
+    QList<InstalledAppEntry> readEntries(const QString& registryRoot) const override;
+    QHash<QString, qint64> keyWriteTimes(const QString& registryRoot) const override;
+
+    QStringList programDirectories() const override;
+    bool isFile(const QString& path) const override;
+    bool isDirectory(const QString& path) const override;
+    qint64 lastModified(const QString& path) const override;
+    QStringList executables(const QString& directory) const override;
+    QStringList subdirectories(const QString& directory) const override;
+
+private:
+    struct Directory
+    {
+        QStringList executables;
+        QStringList subdirectories;
+    };
+
+    QStringList m_registryRoots;
+    QHash<QString, QList<InstalledAppEntry>> m_entries;
+    QStringList m_programDirectories;
+    QHash<PathKey, Directory> m_directories;
+    QSet<PathKey> m_files;
+    QHash<PathKey, qint64> m_modified;
+};
+
+// Passes every call through to another source and keeps what it
+// answered, so one detection run on a real machine yields a fixture that
+// replays exactly that run
+class InstallSourceRecorder : public InstallSource
+{
+public:
+    explicit InstallSourceRecorder(const InstallSource& source);
+
+    QJsonObject fixture() const;
+    bool save(const QString& fixturePath) const;
+
+    QStringList registryRoots() const override;
+    QList<InstalledAppEntry> readEntries(const QString& registryRoot) const override;
+    QHash<QString, qint64> keyWriteTimes(const QString& registryRoot) const override;
+
+    QStringList programDirectories() const override;
+    bool isFile(const QString& path) const override;
+    bool isDirectory(const QString& path) const override;
+    qint64 lastModified(const QString& path) const override;
+    QStringList executables(const QString& directory) const override;
+    QStringList subdirectories(const QString& directory) const override;
+
+private:
+    // Lists both, so one call records everything replay needs about it
+    QPair<QStringList, QStringList> recordDirectory(const QString& directory) const;
+
+    const InstallSource& m_source;
+
+    // Calls arrive from the detector's worker threads
+    mutable QMutex m_lock;
+    mutable QJsonObject m_registry;
+    mutable QJsonObject m_directories;
+    mutable QSet<QString> m_files;
+    mutable QStringList m_programDirectories;
+    mutable QJsonObject m_modified;
+};
+
+#endif // RECORDEDINSTALLSOURCE_H
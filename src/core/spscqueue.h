@@ -0,0 +1,51 @@
+#ifndef SPSCQUEUE_H
+#define SPSCQUEUE_H
+
+#include <QtGlobal>
+#include <array>
+#include <atomic>
+#include <utility>
+
+// Bounded, lock-free queue for exactly one producer thread and one
+// consumer thread. push() fails instead of blocking when the queue is full.
+template <typename T, quint32 Capacity>
+class SpscQueue
+{
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0,
+                  "SpscQueue capacity must be a power of two");
+
+public:
+    bool push(T value)
+    {
+        const quint32 tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_head.load(std::memory_order_acquire) == Capacity)
+            return false;
+
+        m_items[tail & (Capacity - 1)] = std::move(value);
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T& value)
+    {
+        const quint32 head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tail.load(std::memory_order_acquire))
+            return false;
+
+        value = std::move(m_items[head & (Capacity - 1)]);
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool isEmpty() const
+    {
+        return m_head.load(std::memory_order_acquire) == m_tail.load(std::memory_order_acquire);
+    }
+
+private:
+    std::array<T, Capacity> m_items;
+    alignas(64) std::atomic<quint32> m_head{0};
+    alignas(64) std::atomic<quint32> m_tail{0};
+};
+
+#endif // SPSCQUEUE_H
@@ -0,0 +1,24 @@
+#include "windowsource.h"
+
+#ifdef Q_OS_WIN
+
+static BOOL CALLBACK collectTopLevelWindow(HWND hwnd, LPARAM lParam)
+{
+    // Overlays are only shown over visible main windows, so skip hidden
+    // helper windows and owned popups/dialogs
+    if (!IsWindowVisible(hwnd) || GetWindow(hwnd, GW_OWNER) != NULL)
+        return TRUE;
+
+    DWORD processId = 0;
+    GetWindowThreadProcessId(hwnd, &processId);
+    reinterpret_cast<QMultiHash<quint32, WindowId>*>(lParam)->insert(processId, hwnd);
+    return TRUE;
+}
+
+void WinWindowSource::topLevelWindows(QMultiHash<quint32, WindowId>& windowsByPid)
+{
+    windowsByPid.clear();
+    EnumWindows(collectTopLevelWindow, reinterpret_cast<LPARAM>(&windowsByPid));
+}
+
+#endif
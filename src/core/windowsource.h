@@ -0,0 +1,36 @@
+#ifndef WINDOWSOURCE_H
+#define WINDOWSOURCE_H
+
+#include <QMultiHash>
+#include <QtGlobal>
+
+#ifdef Q_OS_WIN
+#include <Windows.h>
+
+using WindowId = HWND;
+#else
+using WindowId = quintptr;
+#endif
+
+// Enumerates the top-level windows an overlay may be shown over
+class WindowSource
+{
+public:
+    virtual ~WindowSource() = default;
+
+    // Replaces windowsByPid with the visible, unowned top-level windows,
+    // keyed by owning process, in one pass
+    virtual void topLevelWindows(QMultiHash<quint32, WindowId>& windowsByPid) = 0;
+};
+
+#ifdef Q_OS_WIN
+class WinWindowSource : public WindowSource
+{
+public:
+    void topLevelWindows(QMultiHash<quint32, WindowId>& windowsByPid) override;
+};
+
+using SystemWindowSource = WinWindowSource;
+#endif
+
+#endif // WINDOWSOURCE_H
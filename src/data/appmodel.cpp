@@ -3,9 +3,14 @@
 #include <QFileInfo>
 #include <QFileIconProvider>
 #include <QProcess>
+#include <QDebug>
+
+#ifdef Q_OS_WIN
 #include <Windows.h>
 #include <TlHelp32.h>
-#include <QDebug>
+#else
+#include "../core/processsource.h"
+#endif
 
 AppModel::AppModel(const QString& path, const QString& name, const bool active)
     : m_path(path), m_name(name), m_active(active)
@@ -35,6 +40,11 @@ bool AppModel::getActive() const
     return m_active;
 }
 
+RuleType AppModel::getRuleType() const
+{
+    return m_ruleType;
+}
+
 void AppModel::setPath(const QString& path)
 {
     m_path = path;
@@ -56,6 +66,11 @@ void AppModel::setActive(const bool active)
     m_active = active;
 }
 
+void AppModel::setRuleType(const RuleType ruleType)
+{
+    m_ruleType = ruleType;
+}
+
 bool AppModel::isRunning() const
 {
     if (!isValid()) {
@@ -66,6 +81,7 @@ bool AppModel::isRunning() const
     QFileInfo fileInfo(m_path);
     QString exeName = fileInfo.fileName().toLower();
     
+#ifdef Q_OS_WIN
     // Create a snapshot of the processes
     HANDLE hSnapshot = CreateToolhelp32Snapshot(TH32CS_SNAPPROCESS, 0);
     if (hSnapshot == INVALID_HANDLE_VALUE) {
@@ -92,6 +108,20 @@ bool AppModel::isRunning() const
     
     CloseHandle(hSnapshot);
     return false;
+#elif defined(Q_OS_LINUX)
+    SystemProcessSource source;
+    QVector<ProcessEntry> processes;
+    if (!source.snapshot(processes))
+        return false;
+
+    for (const ProcessEntry& process : processes) {
+        if (QFileInfo(source.resolvePath(process)).fileName().toLower() == exeName)
+            return true;
+    }
+    return false;
+#else
+    return false;
+#endif
 }
 
 void AppModel::loadIcon()
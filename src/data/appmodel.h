@@ -5,6 +5,8 @@
 #include <QIcon>
 #include <QMetaType>
 
+#include "rulematcher.h"
+
 class AppModel
 {
 public:
@@ -14,10 +16,12 @@ public:
     QString getName() const;
     QIcon getIcon() const;
     bool getActive() const;
+    RuleType getRuleType() const;
     
     void setPath(const QString& path);
     void setName(const QString& name);
     void setActive(const bool active);
+    void setRuleType(const RuleType ruleType);
 
     bool isValid() const;
     bool isRunning() const;
@@ -29,6 +33,7 @@ private:
     QString m_name;
     QIcon m_icon;
     bool m_active = false;
+    RuleType m_ruleType = RuleType::Exact;
 };
 
 // Register AppModel for QVariant
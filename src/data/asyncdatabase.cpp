@@ -0,0 +1,90 @@
+#include "asyncdatabase.h"
+#include "blockTimeSettingsModel.h"
+
+#include <QThread>
+
+AsyncDatabase::AsyncDatabase(Database* database, QObject *parent)
+    : QObject(parent),
+      m_database(database),
+      m_thread(new QThread(this)),
+      m_worker(new QObject()),
+      m_jobCount(0),
+      m_busyNsecs(0)
+{
+    m_thread->setObjectName("Database");
+    m_worker->moveToThread(m_thread);
+    connect(m_thread, &QThread::finished, m_worker, &QObject::deleteLater);
+    m_thread->start();
+}
+
+AsyncDatabase::~AsyncDatabase()
+{
+    m_thread->quit();
+    m_thread->wait();
+}
+
+Database* AsyncDatabase::database() const
+{
+    return m_database;
+}
+
+QFuture<QList<BlockedAppChange>> AsyncDatabase::getBlockedAppEntries(bool activeOnly)
+{
+    return run([activeOnly](Database& database) {
+        return database.getBlockedAppEntries(activeOnly);
+    });
+}
+
+QFuture<bool> AsyncDatabase::addBlockedApp(const QString& appPath, const QString& appName, RuleType ruleType)
+{
+    return run([appPath, appName, ruleType](Database& database) {
+        return database.addBlockedApp(appPath, appName, ruleType);
+    });
+}
+
+QFuture<bool> AsyncDatabase::removeBlockedApp(const QString& appPath)
+{
+    return run([appPath](Database& database) {
+        return database.removeBlockedApp(appPath);
+    });
+}
+
+QFuture<BlockedAppBatchResult> AsyncDatabase::applyBlockedAppBatch(const QList<BlockedAppChange>& changes)
+{
+    return run([changes](Database& database) {
+        return database.applyBlockedAppBatch(changes);
+    });
+}
+
+QFuture<std::shared_ptr<BlockTimeSettingsModel>> AsyncDatabase::getBlockTimeSettings()
+{
+    return run([](Database& database) {
+        return database.getBlockTimeSettings();
+    });
+}
+
+QFuture<bool> AsyncDatabase::updateBlockTimeSettings(const std::shared_ptr<BlockTimeSettingsModel>& settings)
+{
+    // The caller keeps editing its own copy on the UI thread
+    auto snapshot = settings ? std::make_shared<BlockTimeSettingsModel>(*settings) : nullptr;
+    return run([snapshot](Database& database) {
+        return database.updateBlockTimeSettings(snapshot);
+    });
+}
+
+QFuture<QList<BlockEventCount>> AsyncDatabase::getDailyBlockEventCounts(const QDate& from, const QDate& to)
+{
+    return run([from, to](Database& database) {
+        return database.getDailyBlockEventCounts(from, to);
+    });
+}
+
+quint64 AsyncDatabase::jobCount() const
+{
+    return m_jobCount;
+}
+
+qint64 AsyncDatabase::busyTime() const
+{
+    return m_busyNsecs / 1000000;
+}
@@ -0,0 +1,91 @@
+#ifndef ASYNCDATABASE_H
+#define ASYNCDATABASE_H
+
+#include <QObject>
+#include <QFuture>
+#include <QPromise>
+#include <QElapsedTimer>
+#include <QMetaObject>
+#include <atomic>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+#include "database.h"
+
+class QThread;
+
+// Runs Database work on a thread of its own, with its own connection, and
+// hands results back as futures. Jobs run one at a time in the order they
+// were queued, so a read queued after a write sees it. Attach
+// continuations with QFuture::then(context, ...) to get back onto the
+// caller's thread.
+//
+// The synchronous Database API stays for the service, which has no UI
+// thread to protect.
+class AsyncDatabase : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit AsyncDatabase(Database* database, QObject *parent = nullptr);
+    ~AsyncDatabase();
+
+    Database* database() const;
+
+    // Queues function(Database&) on the database thread
+    template <typename Function>
+    auto run(Function function) -> QFuture<std::invoke_result_t<Function, Database&>>;
+
+    QFuture<QList<BlockedAppChange>> getBlockedAppEntries(bool activeOnly = false);
+    QFuture<bool> addBlockedApp(const QString& appPath, const QString& appName, RuleType ruleType = RuleType::Exact);
+    QFuture<bool> removeBlockedApp(const QString& appPath);
+    QFuture<BlockedAppBatchResult> applyBlockedAppBatch(const QList<BlockedAppChange>& changes);
+    QFuture<std::shared_ptr<BlockTimeSettingsModel>> getBlockTimeSettings();
+    QFuture<bool> updateBlockTimeSettings(const std::shared_ptr<BlockTimeSettingsModel>& settings);
+    QFuture<QList<BlockEventCount>> getDailyBlockEventCounts(const QDate& from, const QDate& to);
+
+    // Jobs run so far and the time spent running them
+    quint64 jobCount() const;
+    qint64 busyTime() const;
+
+private:
+    Database* m_database;
+    QThread* m_thread;
+    // Lives on m_thread, jobs are queued to it
+    QObject* m_worker;
+
+    std::atomic<quint64> m_jobCount;
+    std::atomic<qint64> m_busyNsecs;
+};
+
+template <typename Function>
+auto AsyncDatabase::run(Function function) -> QFuture<std::invoke_result_t<Function, Database&>>
+{
+    using Result = std::invoke_result_t<Function, Database&>;
+
+    auto promise = std::make_shared<QPromise<Result>>();
+    QFuture<Result> future = promise->future();
+    promise->start();
+
+    // A job still queued when the thread stops is dropped, and destroying
+    // its promise cancels the future
+    QMetaObject::invokeMethod(m_worker, [this, promise, function = std::move(function)]() mutable {
+        QElapsedTimer timer;
+        timer.start();
+
+        if constexpr (std::is_void_v<Result>) {
+            function(*m_database);
+        } else {
+            promise->addResult(function(*m_database));
+        }
+        promise->finish();
+
+        ++m_jobCount;
+        m_busyNsecs += timer.nsecsElapsed();
+    }, Qt::QueuedConnection);
+
+    return future;
+}
+
+#endif // ASYNCDATABASE_H
@@ -27,6 +27,11 @@ bool BlockTimeSettingsModel::getActive()
   return m_active;
 }
 
+QList<REG_Interval> BlockTimeSettingsModel::getIntervals()
+{
+  return m_intervals;
+}
+
 void BlockTimeSettingsModel::setStartTime(const QTime& startTime)
 {
   m_startTime = startTime;
@@ -46,3 +51,8 @@ void BlockTimeSettingsModel::setActive(const bool active)
 {
   m_active = active;
 }
+
+void BlockTimeSettingsModel::setIntervals(const QList<REG_Interval>& intervals)
+{
+  m_intervals = intervals;
+}
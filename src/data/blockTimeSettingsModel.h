@@ -4,6 +4,7 @@
 #include <QString>
 #include <QMetaType>
 #include <QTime>
+#include <QList>
 
 struct REG_Week
 {
@@ -16,6 +17,15 @@ struct REG_Week
   bool sunday;
 };
 
+// An extra blocking window on a single day (1 = Monday ... 7 = Sunday).
+// An end at or before the start runs on into the following day.
+struct REG_Interval
+{
+  int dayOfWeek;
+  QTime startTime;
+  QTime endTime;
+};
+
 class BlockTimeSettingsModel
 {
 public:
@@ -25,17 +35,20 @@ public:
     QTime getEndTime();
     REG_Week getWeek();
     bool getActive();
+    QList<REG_Interval> getIntervals();
 
     void setStartTime(const QTime& startTime);
     void setEndTime(const QTime& endTime);
     void setWeek(const REG_Week& week);
     void setActive(const bool active);
+    void setIntervals(const QList<REG_Interval>& intervals);
 
 private:
     QTime m_startTime;
     QTime m_endTime;
     REG_Week m_week = { 0 };
     bool m_active = true;
+    QList<REG_Interval> m_intervals;
 };
 
 // Register BlockTimeSettingsModel for QVariant
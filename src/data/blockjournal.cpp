@@ -0,0 +1,84 @@
+#include "blockjournal.h"
+#include "asyncdatabase.h"
+
+#include <QDateTime>
+#include <QDebug>
+
+BlockJournal::BlockJournal(AsyncDatabase* database, QObject *parent)
+    : QObject(parent),
+      m_database(database),
+      m_events(std::make_shared<EventQueue>()),
+      m_unflushed(0),
+      m_dropped(0)
+{
+    m_flushTimer.setSingleShot(true);
+    m_flushTimer.setInterval(kFlushInterval);
+    connect(&m_flushTimer, &QTimer::timeout, this, &BlockJournal::flush);
+
+    m_compactTimer.setInterval(kCompactDelay);
+    connect(&m_compactTimer, &QTimer::timeout, this, &BlockJournal::compact);
+    m_compactTimer.start();
+}
+
+BlockJournal::~BlockJournal()
+{
+    m_flush.waitForFinished();
+    flush();
+    m_flush.waitForFinished();
+}
+
+void BlockJournal::record(BlockEventKind kind, const QString& appPath, const QString& appName)
+{
+    if (!m_events->push(BlockEvent{QDateTime::currentMSecsSinceEpoch(), kind, appPath, appName})) {
+        ++m_dropped;
+        return;
+    }
+
+    // An idle journal keeps no timer running
+    if (++m_unflushed >= kFlushThreshold)
+        flush();
+    else if (!m_flushTimer.isActive())
+        m_flushTimer.start();
+}
+
+void BlockJournal::flush()
+{
+    m_flushTimer.stop();
+    if (m_unflushed == 0)
+        return;
+
+    // One write at a time; the running one may already have taken part
+    // of what is buffered, the rest goes with the next
+    if (!m_flush.isFinished()) {
+        m_flushTimer.start();
+        return;
+    }
+
+    m_unflushed = 0;
+    m_flush = m_database->run([events = m_events](Database& database) {
+        QList<BlockEvent> batch;
+        BlockEvent event;
+        while (events->pop(event))
+            batch.append(std::move(event));
+        return database.appendBlockEvents(batch) ? 0 : static_cast<int>(batch.size());
+    });
+    m_flush.then(this, [this](int lost) {
+        if (lost > 0) {
+            m_dropped += lost;
+            qDebug() << "Block journal lost" << lost << "events";
+        }
+    });
+}
+
+void BlockJournal::compact()
+{
+    m_compactTimer.setInterval(kCompactInterval);
+    m_database->run([](Database& database) {
+        return database.compactBlockEvents(QDateTime::currentDateTime());
+    });
+}
+
+quint64 BlockJournal::droppedEvents() const
+{
+    return m_dropped;
+}
@@ -0,0 +1,64 @@
+#ifndef BLOCKJOURNAL_H
+#define BLOCKJOURNAL_H
+
+#include <QObject>
+#include <QTimer>
+#include <QFuture>
+#include <memory>
+
+#include "database.h"
+#include "../core/spscqueue.h"
+
+class AsyncDatabase;
+
+// Records block events without touching the disk on the caller's thread.
+// record() only stamps the event and pushes it into a ring buffer; the
+// buffer is drained on the database thread every few seconds, or sooner
+// when it fills up, and written in one transaction per flush.
+//
+// record() and flush() belong to the thread that owns the journal (the
+// UI thread); the database thread is the only consumer. The journal
+// also runs the hourly compaction of old events on the database thread.
+class BlockJournal : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit BlockJournal(AsyncDatabase* database, QObject *parent = nullptr);
+    // Writes whatever is still buffered before returning
+    ~BlockJournal();
+
+    void record(BlockEventKind kind, const QString& appPath, const QString& appName);
+
+    // Queues a write of everything recorded so far
+    void flush();
+
+    // Events lost because the buffer was full or a write failed
+    quint64 droppedEvents() const;
+
+private slots:
+    void compact();
+
+private:
+    static constexpr int kFlushInterval = 2000;
+    // A quarter of the buffer; a burst gets written long before it fills
+    static constexpr int kFlushThreshold = 4096;
+    static constexpr quint32 kCapacity = 16384;
+    // The first pass waits until startup work is done
+    static constexpr int kCompactDelay = 60 * 1000;
+    static constexpr int kCompactInterval = 60 * 60 * 1000;
+
+    using EventQueue = SpscQueue<BlockEvent, kCapacity>;
+
+    AsyncDatabase* m_database;
+    // Shared with the queued flush jobs, which drain it on the database thread
+    std::shared_ptr<EventQueue> m_events;
+    QTimer m_flushTimer;
+    QTimer m_compactTimer;
+    QFuture<int> m_flush;
+    // Recorded since the last flush was queued
+    int m_unflushed;
+    quint64 m_dropped;
+};
+
+#endif // BLOCKJOURNAL_H
@@ -0,0 +1,184 @@
+#include "blocklistimage.h"
+
+#include <QFile>
+#include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QDateTime>
+#include <QByteArray>
+#include <cstring>
+
+namespace {
+
+const quint32 kMagic = 0x49424346; // "FCBI"
+const quint32 kFormatVersion = 2;
+
+struct ImageHeader
+{
+    quint32 magic;
+    quint32 formatVersion;
+    qint64 sourceStamp;
+    quint64 sourceRevision;
+    quint64 checksum;
+    quint32 payloadSize;
+    quint32 ruleCount;
+    quint32 scheduleActive;
+    quint32 reserved;
+};
+
+struct RuleHeader
+{
+    quint16 type;
+    quint16 length;
+};
+
+quint64 checksum(const char* data, qsizetype size)
+{
+    quint64 hash = 14695981039346656037ULL;
+    for (qsizetype i = 0; i < size; ++i)
+        hash = (hash ^ static_cast<uchar>(data[i])) * 1099511628211ULL;
+    return hash;
+}
+
+} // namespace
+
+QString BlocklistImage::pathFor(const QString& databasePath)
+{
+    QFileInfo info(databasePath);
+    return info.dir().filePath(info.completeBaseName() + ".blocklist");
+}
+
+qint64 BlocklistImage::databaseStamp(const QString& databasePath)
+{
+    qint64 stamp = QFileInfo(databasePath).lastModified().toMSecsSinceEpoch();
+    QFileInfo wal(databasePath + "-wal");
+    if (wal.exists())
+        stamp = qMax(stamp, wal.lastModified().toMSecsSinceEpoch());
+    return stamp;
+}
+
+bool BlocklistImage::write(const QString& path, qint64 sourceStamp, quint64 sourceRevision,
+                           const QList<BlockRule>& rules, const CompiledSchedule& schedule)
+{
+    QByteArray payload;
+    payload.append(reinterpret_cast<const char*>(schedule.week().words()),
+                   WeekSchedule::WordCount * sizeof(quint64));
+
+    quint32 ruleCount = 0;
+    for (const BlockRule& rule : rules) {
+        // Paths are far shorter; anything that does not fit is not a path
+        if (rule.pattern.size() > 0xFFFF)
+            continue;
+
+        RuleHeader header{static_cast<quint16>(rule.type), static_cast<quint16>(rule.pattern.size())};
+        payload.append(reinterpret_cast<const char*>(&header), sizeof(header));
+        payload.append(reinterpret_cast<const char*>(rule.pattern.utf16()), rule.pattern.size() * sizeof(char16_t));
+        ++ruleCount;
+    }
+
+    ImageHeader header{};
+    header.magic = kMagic;
+    header.formatVersion = kFormatVersion;
+    header.sourceStamp = sourceStamp;
+    header.sourceRevision = sourceRevision;
+    header.checksum = checksum(payload.constData(), payload.size());
+    header.payloadSize = static_cast<quint32>(payload.size());
+    header.ruleCount = ruleCount;
+    header.scheduleActive = schedule.isActive() ? 1 : 0;
+
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(payload);
+    return file.commit();
+}
+
+bool BlocklistImage::load(const QString& path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly) || file.size() < static_cast<qint64>(sizeof(ImageHeader)))
+        return false;
+
+    const qint64 size = file.size();
+    const uchar* data = file.map(0, size);
+    if (!data)
+        return false;
+
+    // Copy the header out, the mapping gives no alignment guarantee
+    ImageHeader header;
+    std::memcpy(&header, data, sizeof(header));
+
+    const char* payload = reinterpret_cast<const char*>(data) + sizeof(header);
+    const qint64 scheduleSize = WeekSchedule::WordCount * sizeof(quint64);
+    bool valid = header.magic == kMagic
+        && header.formatVersion == kFormatVersion
+        && header.payloadSize == size - static_cast<qint64>(sizeof(header))
+        && header.payloadSize >= scheduleSize
+        && checksum(payload, header.payloadSize) == header.checksum;
+
+    QList<BlockRule> rules;
+    std::shared_ptr<const CompiledSchedule> schedule;
+    if (valid) {
+        quint64 words[WeekSchedule::WordCount];
+        std::memcpy(words, payload, scheduleSize);
+        schedule = std::make_shared<CompiledSchedule>(header.scheduleActive != 0, WeekSchedule::fromWords(words));
+
+        rules.reserve(header.ruleCount);
+        qint64 offset = scheduleSize;
+        for (quint32 i = 0; i < header.ruleCount; ++i) {
+            RuleHeader rule;
+            if (offset + static_cast<qint64>(sizeof(rule)) > header.payloadSize) {
+                valid = false;
+                break;
+            }
+            std::memcpy(&rule, payload + offset, sizeof(rule));
+            offset += sizeof(rule);
+
+            qint64 bytes = rule.length * static_cast<qint64>(sizeof(char16_t));
+            if (offset + bytes > header.payloadSize || rule.type > static_cast<quint16>(RuleType::Glob)) {
+                valid = false;
+                break;
+            }
+
+            QString pattern(rule.length, Qt::Uninitialized);
+            std::memcpy(pattern.data(), payload + offset, bytes);
+            offset += bytes;
+            rules.append(BlockRule{pattern, static_cast<RuleType>(rule.type)});
+        }
+    }
+
+    // Nothing refers to the mapping past this point, so the writer is
+    // free to replace the file again
+    file.unmap(const_cast<uchar*>(data));
+    file.close();
+
+    if (!valid)
+        return false;
+
+    m_sourceStamp = header.sourceStamp;
+    m_sourceRevision = header.sourceRevision;
+    m_rules = rules;
+    m_schedule = schedule;
+    return true;
+}
+
+qint64 BlocklistImage::sourceStamp() const
+{
+    return m_sourceStamp;
+}
+
+quint64 BlocklistImage::sourceRevision() const
+{
+    return m_sourceRevision;
+}
+
+const QList<BlockRule>& BlocklistImage::rules() const
+{
+    return m_rules;
+}
+
+std::shared_ptr<const CompiledSchedule> BlocklistImage::schedule() const
+{
+    return m_schedule;
+}
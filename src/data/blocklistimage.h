@@ -0,0 +1,56 @@
+#ifndef BLOCKLISTIMAGE_H
+#define BLOCKLISTIMAGE_H
+
+#include <QString>
+#include <QList>
+#include <memory>
+
+#include "rulematcher.h"
+#include "compiledschedule.h"
+
+// Compact, checksummed copy of the active block rules and the compiled
+// schedule, written next to foccuss.db after every change. The service
+// maps it at startup and only opens SQLite when the image is missing,
+// damaged or older than the database.
+//
+// The source stamp is the time the database files had when the image was
+// written; while they keep it, nothing can have been committed since. A
+// checkpoint also moves it, so once it moved the source revision decides:
+// the content revision of the database, which only rules and schedule
+// writes bump.
+//
+// Layout (native byte order, the image never leaves the machine):
+//   header: magic, format version, source stamp, source revision, FNV-1a
+//           checksum of the payload, payload size, rule count, schedule
+//           active flag
+//   payload: the WeekSchedule bitmap, then per rule its type, length and
+//            case-folded UTF-16 pattern
+class BlocklistImage
+{
+public:
+    static QString pathFor(const QString& databasePath);
+
+    // Newest modification time of the database and its WAL, in ms since
+    // the epoch. An image stamped earlier than this may be stale.
+    static qint64 databaseStamp(const QString& databasePath);
+
+    // Replaces the image atomically, so a reader never sees half of it
+    static bool write(const QString& path, qint64 sourceStamp, quint64 sourceRevision,
+                      const QList<BlockRule>& rules, const CompiledSchedule& schedule);
+
+    // Maps the image just long enough to validate and copy it out
+    bool load(const QString& path);
+
+    qint64 sourceStamp() const;
+    quint64 sourceRevision() const;
+    const QList<BlockRule>& rules() const;
+    std::shared_ptr<const CompiledSchedule> schedule() const;
+
+private:
+    qint64 m_sourceStamp = 0;
+    quint64 m_sourceRevision = 0;
+    QList<BlockRule> m_rules;
+    std::shared_ptr<const CompiledSchedule> m_schedule;
+};
+
+#endif // BLOCKLISTIMAGE_H
@@ -0,0 +1,95 @@
+#include "compiledschedule.h"
+#include "blockTimeSettingsModel.h"
+
+CompiledSchedule::CompiledSchedule()
+    : m_active(false)
+{
+}
+
+CompiledSchedule::CompiledSchedule(BlockTimeSettingsModel& settings)
+    : m_active(settings.getActive())
+{
+    int startMinute = settings.getStartTime().msecsSinceStartOfDay() / 60000;
+    int endMinute = settings.getEndTime().msecsSinceStartOfDay() / 60000;
+
+    // The primary window keeps its original meaning: on every enabled day,
+    // block between start and end, or outside end..start when it wraps
+    REG_Week week = settings.getWeek();
+    const bool days[] = { week.monday, week.tuesday, week.wednesday, week.thursday,
+                          week.friday, week.saturday, week.sunday };
+    for (int day = 1; day <= 7; ++day) {
+        if (!days[day - 1])
+            continue;
+
+        int dayStart = WeekSchedule::minuteOfWeek(day, 0);
+        if (startMinute < endMinute) {
+            m_week.addRange(dayStart + startMinute, dayStart + endMinute);
+        } else {
+            if (endMinute > 0)
+                m_week.addRange(dayStart, dayStart + endMinute);
+            m_week.addRange(dayStart + startMinute, dayStart + WeekSchedule::MinutesPerDay);
+        }
+    }
+
+    // Extra windows run from start to end, continuing into the next day
+    // when the end is not after the start
+    for (const REG_Interval& interval : settings.getIntervals()) {
+        if (interval.dayOfWeek < 1 || interval.dayOfWeek > 7)
+            continue;
+
+        int start = WeekSchedule::minuteOfWeek(interval.dayOfWeek, interval.startTime.msecsSinceStartOfDay() / 60000);
+        int end = WeekSchedule::minuteOfWeek(interval.dayOfWeek, interval.endTime.msecsSinceStartOfDay() / 60000);
+        if (end <= start)
+            end += WeekSchedule::MinutesPerDay;
+        m_week.addRange(start, end);
+    }
+}
+
+CompiledSchedule::CompiledSchedule(bool active, const WeekSchedule& week)
+    : m_active(active),
+      m_week(week)
+{
+}
+
+bool CompiledSchedule::isActive() const
+{
+    return m_active;
+}
+
+const WeekSchedule& CompiledSchedule::week() const
+{
+    return m_week;
+}
+
+bool CompiledSchedule::isBlockingAt(const QDateTime& localTime) const
+{
+    return m_active && m_week.isBlockedAt(minuteOfWeek(localTime));
+}
+
+QDateTime CompiledSchedule::nextTransition(const QDateTime& localTime) const
+{
+    if (!m_active)
+        return QDateTime();
+
+    int current = minuteOfWeek(localTime);
+    int next = m_week.nextTransition(current);
+    if (next < 0)
+        return QDateTime();
+
+    int minutesAhead = next - current;
+    if (minutesAhead <= 0)
+        minutesAhead += WeekSchedule::MinutesPerWeek;
+
+    // Step in local wall-clock minutes so DST shifts land on the right
+    // wall time rather than a fixed number of elapsed seconds later
+    int minuteOfDay = localTime.time().msecsSinceStartOfDay() / 60000 + minutesAhead;
+    QDate date = localTime.date().addDays(minuteOfDay / WeekSchedule::MinutesPerDay);
+    minuteOfDay %= WeekSchedule::MinutesPerDay;
+    return QDateTime(date, QTime(minuteOfDay / 60, minuteOfDay % 60));
+}
+
+int CompiledSchedule::minuteOfWeek(const QDateTime& localTime)
+{
+    return WeekSchedule::minuteOfWeek(localTime.date().dayOfWeek(),
+                                      localTime.time().msecsSinceStartOfDay() / 60000);
+}
@@ -0,0 +1,37 @@
+#ifndef COMPILEDSCHEDULE_H
+#define COMPILEDSCHEDULE_H
+
+#include <QDateTime>
+#include <QtGlobal>
+
+#include "weekschedule.h"
+
+class BlockTimeSettingsModel;
+
+// Immutable, pre-digested form of BlockTimeSettingsModel that the monitor
+// can evaluate every tick without touching SQLite or allocating.
+class CompiledSchedule
+{
+public:
+    CompiledSchedule();
+    explicit CompiledSchedule(BlockTimeSettingsModel& settings);
+    CompiledSchedule(bool active, const WeekSchedule& week);
+
+    bool isActive() const;
+    const WeekSchedule& week() const;
+    // Windows block from their start minute up to, not including, their
+    // end minute; seconds are dropped, so 08:00-17:00 stops at 17:00:00
+    bool isBlockingAt(const QDateTime& localTime) const;
+
+    // Local time of the next switch between blocking and not blocking,
+    // or an invalid QDateTime if the state never changes
+    QDateTime nextTransition(const QDateTime& localTime) const;
+
+private:
+    static int minuteOfWeek(const QDateTime& localTime);
+
+    bool m_active;
+    WeekSchedule m_week;
+};
+
+#endif // COMPILEDSCHEDULE_H
@@ -0,0 +1,103 @@
+#include "connectionpool.h"
+
+#include <QSqlError>
+#include <QDebug>
+
+ConnectionPool::ConnectionPool()
+    : m_nextId(0),
+      m_openConnections(0)
+{
+}
+
+ConnectionPool::~ConnectionPool()
+{
+    // Only the destroying thread's connection can be closed safely here
+    m_connections.setLocalData(nullptr);
+}
+
+void ConnectionPool::configure(const QString& driver, const QString& databaseName,
+                               const QString& connectOptions, const Profile& profile)
+{
+    m_driver = driver;
+    m_databaseName = databaseName;
+    m_connectOptions = connectOptions;
+    m_profile = profile;
+}
+
+QSqlDatabase ConnectionPool::connection() const
+{
+    return threadConnection()->db;
+}
+
+QSqlQuery& ConnectionPool::statement(const QString& sql) const
+{
+    ThreadConnection* connection = threadConnection();
+
+    std::shared_ptr<QSqlQuery>& cached = connection->statements[sql];
+    if (!cached) {
+        cached = std::make_shared<QSqlQuery>(connection->db);
+        if (!cached->prepare(sql))
+            qDebug() << "Error preparing statement:" << cached->lastError().text();
+    }
+    return *cached;
+}
+
+int ConnectionPool::openConnections() const
+{
+    return m_openConnections;
+}
+
+ConnectionPool::ThreadConnection* ConnectionPool::threadConnection() const
+{
+    ThreadConnection* connection = m_connections.hasLocalData() ? m_connections.localData() : nullptr;
+    if (connection && connection->db.isOpen())
+        return connection;
+
+    if (!connection) {
+        connection = new ThreadConnection();
+        connection->name = QString("foccuss_%1_%2")
+                               .arg(reinterpret_cast<quintptr>(this), 0, 16)
+                               .arg(++m_nextId);
+        connection->openConnections = &m_openConnections;
+        connection->db = QSqlDatabase::addDatabase(m_driver, connection->name);
+        connection->db.setDatabaseName(m_databaseName);
+        connection->db.setConnectOptions(m_connectOptions);
+        m_connections.setLocalData(connection);
+    }
+
+    if (open(connection)) {
+        // Statements prepared while the connection was down are useless
+        connection->statements.clear();
+    }
+    return connection;
+}
+
+bool ConnectionPool::open(ThreadConnection* connection) const
+{
+    if (!connection->db.open()) {
+        qDebug() << "Error opening connection" << connection->name << ":" << connection->db.lastError().text();
+        return false;
+    }
+
+    if (m_profile && !m_profile(connection->db)) {
+        qDebug() << "Error configuring connection" << connection->name;
+        connection->db.close();
+        return false;
+    }
+
+    ++m_openConnections;
+    return true;
+}
+
+ConnectionPool::ThreadConnection::~ThreadConnection()
+{
+    // Runs on the owning thread as it exits. Queries and handles keep the
+    // connection alive, so they go before it is removed.
+    statements.clear();
+    if (db.isOpen()) {
+        db.close();
+        --*openConnections;
+    }
+    db = QSqlDatabase();
+    QSqlDatabase::removeDatabase(name);
+}
@@ -0,0 +1,70 @@
+#ifndef CONNECTIONPOOL_H
+#define CONNECTIONPOOL_H
+
+#include <QString>
+#include <QHash>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QThreadStorage>
+#include <atomic>
+#include <functional>
+#include <memory>
+
+// Hands every thread its own named connection to one database file. A Qt
+// SQL connection may only be used by the thread that opened it, so
+// connections are opened on a thread's first use and closed when that
+// thread exits. Names are never reused, so a new thread that happens to
+// get a finished thread's id cannot pick up its connection.
+//
+// Statements are prepared per connection from the SQL text callers share,
+// and each thread's statement cache is its own, so readers on different
+// threads never wait on each other here.
+class ConnectionPool
+{
+public:
+    using Profile = std::function<bool(QSqlDatabase&)>;
+
+    ConnectionPool();
+    ~ConnectionPool();
+
+    // Applies to connections opened afterwards. The profile runs once on
+    // every new connection, e.g. to set pragmas.
+    void configure(const QString& driver, const QString& databaseName,
+                   const QString& connectOptions, const Profile& profile);
+
+    // The calling thread's connection, opened on first use. Not open if
+    // opening or the profile failed; the next call tries again.
+    QSqlDatabase connection() const;
+    // Prepared once per thread for each SQL text, then only rebound and
+    // re-executed
+    QSqlQuery& statement(const QString& sql) const;
+
+    int openConnections() const;
+
+private:
+    struct ThreadConnection
+    {
+        QString name;
+        QSqlDatabase db;
+        QHash<QString, std::shared_ptr<QSqlQuery>> statements;
+        std::atomic<int>* openConnections = nullptr;
+
+        ~ThreadConnection();
+    };
+
+    ThreadConnection* threadConnection() const;
+    bool open(ThreadConnection* connection) const;
+
+    QString m_driver;
+    QString m_databaseName;
+    QString m_connectOptions;
+    Profile m_profile;
+
+    // Destroying this leaks the connections of threads that are still
+    // running instead of closing them from the wrong thread
+    mutable QThreadStorage<ThreadConnection*> m_connections;
+    mutable std::atomic<quint64> m_nextId;
+    mutable std::atomic<int> m_openConnections;
+};
+
+#endif // CONNECTIONPOOL_H
@@ -1,6 +1,9 @@
 #include "database.h"
 #include "appmodel.h"
 #include "blockTimeSettingsModel.h"
+#include "compiledschedule.h"
+#include "blocklistimage.h"
+#include "eventarchive.h"
 
 #include <QDir>
 #include <QStandardPaths>
@@ -11,6 +14,14 @@
 #include <QFileInfo>
 #include <QFile>
 #include <QTime>
+#include <QTimeZone>
+#include <QThread>
+#include <QReadLocker>
+#include <QWriteLocker>
+#include <QMutexLocker>
+#include <QSet>
+#include <QPair>
+#include <algorithm>
 
 static QString s_logFilePath;
 
@@ -33,7 +44,80 @@ void _logToFile(const QString& message) {
     }
 }
 
-Database::Database() : m_initialized(false)
+namespace {
+
+const qint64 kMsecsPerHour = 3600000;
+// Hourly buckets only serve recent, fine grained views
+const int kHourlyRollupRetentionDays = 30;
+
+// A partition on its way into the archive, see archiveBlockEventPartition()
+const char* const kArchivingSuffix = "_archiving";
+// A segment written but not yet installed in place of the old one
+const char* const kPendingSuffix = ".pending";
+
+const char* const kRollupUpsert =
+    "INSERT INTO %1 (bucket, appId, kind, count) VALUES (:bucket, :appId, :kind, :count) "
+    "ON CONFLICT (bucket, appId, kind) DO UPDATE SET count = count + excluded.count";
+
+struct RollupKey
+{
+    qint64 bucket;
+    qint64 appId;
+    int kind;
+
+    bool operator==(const RollupKey& other) const
+    {
+        return bucket == other.bucket && appId == other.appId && kind == other.kind;
+    }
+};
+
+size_t qHash(const RollupKey& key, size_t seed = 0)
+{
+    return qHashMulti(seed, key.bucket, key.appId, key.kind);
+}
+
+// Counts summed per bucket before they reach SQLite, so a burst from one
+// app costs one upsert per bucket rather than one per event
+struct BlockEventRollups
+{
+    // Hours since the epoch, UTC
+    QHash<RollupKey, int> hourly;
+    // Julian day of the local calendar date
+    QHash<RollupKey, int> daily;
+
+    void add(qint64 timestamp, qint64 appId, int kind)
+    {
+        ++hourly[RollupKey{timestamp / kMsecsPerHour, appId, kind}];
+        ++daily[RollupKey{QDateTime::fromMSecsSinceEpoch(timestamp).date().toJulianDay(), appId, kind}];
+    }
+};
+
+bool upsertRollups(QSqlQuery& query, const QHash<RollupKey, int>& counts)
+{
+    for (auto it = counts.cbegin(); it != counts.cend(); ++it) {
+        query.bindValue(":bucket", it.key().bucket);
+        query.bindValue(":appId", it.key().appId);
+        query.bindValue(":kind", it.key().kind);
+        query.bindValue(":count", it.value());
+        if (!query.exec())
+            return false;
+    }
+    return true;
+}
+
+} // namespace
+
+Database::Database(QObject *parent)
+    : QObject(parent),
+      m_guardedThread(nullptr),
+      m_guardedThreadQueries(0),
+      m_initialized(false),
+      m_blockRules(std::make_shared<const RuleMatcher>()),
+      m_blockedAppsRevision(1),
+      m_revision(1),
+      m_schedule(std::make_shared<const CompiledSchedule>()),
+      m_imageBacked(false),
+      m_imageStamp(0)
 {
     // Set up database path in AppData location
     QString dataLocation = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
@@ -45,13 +129,15 @@ Database::Database() : m_initialized(false)
     
     m_dbPath = dir.filePath("foccuss.db");
     // %appdata%/foccuss/foccuss
+
+    // Wait for the other process' write instead of failing with SQLITE_BUSY.
+    // Nothing is opened until the first query, so an image backed start
+    // that never needs SQLite never touches it.
+    m_connections.configure("QSQLITE", m_dbPath, "QSQLITE_BUSY_TIMEOUT=5000", &Database::applyConnectionProfile);
 }
 
 Database::~Database()
 {
-    if (m_db.isOpen()) {
-        m_db.close();
-    }
 }
 
 bool Database::initialize()
@@ -67,11 +153,9 @@ bool Database::initialize()
         file.close();
     }
     
-    m_db = QSqlDatabase::addDatabase("QSQLITE");
-    m_db.setDatabaseName(m_dbPath);
-    
-    if (!m_db.open()) {
-        qDebug() << "Error opening database:" << m_db.lastError().text();
+    QSqlDatabase db = connection();
+    if (!db.isOpen()) {
+        qDebug() << "Error opening database:" << db.lastError().text();
         return false;
     }
     
@@ -80,7 +164,41 @@ bool Database::initialize()
         return false;
     }
     
+    if (!migrateSchema()) {
+        qDebug() << "Error migrating database schema";
+        return false;
+    }
+
+    // Read before the rules, so the image written below can only claim
+    // to be older than it is
+    quint64 contentRevision = 0;
+    if (!readContentRevision(&contentRevision)) {
+        qDebug() << "Error reading the content revision";
+        return false;
+    }
+    
+    if (!rebuildBlockedAppIndex()) {
+        qDebug() << "Error loading blocked apps";
+        return false;
+    }
+    
+    m_initialized = true;
+    reloadSchedule();
+
+    // Refresh the image in case it went stale while nothing wrote through
+    // this process, e.g. after a crash before the write
+    m_imageBacked = false;
+    writeImage(contentRevision);
+    return true;
+}
+
+bool Database::initializeFromImage()
+{
+    if (!loadImage())
+        return false;
+
     m_initialized = true;
+    m_imageBacked = true;
     return true;
 }
 
@@ -89,9 +207,76 @@ bool Database::isInitialized() const
     return m_initialized;
 }
 
+QString Database::databasePath() const
+{
+    return m_dbPath;
+}
+
+void Database::setGuardedThread(QThread* thread)
+{
+    m_guardedThread = thread;
+}
+
+quint64 Database::guardedThreadQueries() const
+{
+    return m_guardedThreadQueries;
+}
+
+void Database::checkGuardedThread() const
+{
+    // connection() and statement() are the only ways to SQLite, so this
+    // sees all of it
+    if (QThread::currentThread() == m_guardedThread) {
+        ++m_guardedThreadQueries;
+        _logToFile("SQLite used on guarded thread " + QThread::currentThread()->objectName());
+    }
+}
+
+QSqlDatabase Database::connection() const
+{
+    checkGuardedThread();
+
+    // Each thread (GUI, database, monitor, service worker) gets its own
+    QSqlDatabase db = m_connections.connection();
+    if (!db.isOpen())
+        _logToFile("Error opening thread connection: " + db.lastError().text());
+    return db;
+}
+
+bool Database::applyConnectionProfile(QSqlDatabase& db)
+{
+    // WAL lets the GUI and the service read while the other one writes,
+    // and with it NORMAL sync only gives up durability on power loss, not
+    // on a crash. The file is small, so map all of it and keep temporary
+    // sort data in memory within a bounded page cache.
+    static const char* const pragmas[] = {
+        "PRAGMA journal_mode = WAL",
+        "PRAGMA synchronous = NORMAL",
+        "PRAGMA mmap_size = 67108864",
+        "PRAGMA temp_store = MEMORY",
+        "PRAGMA cache_size = -2048"
+    };
+
+    QSqlQuery query(db);
+    for (const char* pragma : pragmas) {
+        if (!query.exec(pragma)) {
+            _logToFile(QString("%1 failed: %2").arg(pragma, query.lastError().text()));
+            return false;
+        }
+    }
+    return true;
+}
+
+QSqlQuery& Database::statement(const QString& sql) const
+{
+    checkGuardedThread();
+
+    return m_connections.statement(sql);
+}
+
 bool Database::createTables()
 {
-    QSqlQuery query(m_db);
+    QSqlQuery query(connection());
     
     if (!query.exec("CREATE TABLE IF NOT EXISTS blocked_apps ("
                    "appPath TEXT PRIMARY KEY, "
@@ -119,6 +304,59 @@ bool Database::createTables()
         return false;
     }
     
+    if (!query.exec("CREATE TABLE IF NOT EXISTS block_time_intervals ("
+                   "id INTEGER PRIMARY KEY AUTOINCREMENT, "
+                   "settingsId INTEGER NOT NULL DEFAULT 1, "
+                   "dayOfWeek INTEGER NOT NULL, "
+                   "startMinute INTEGER NOT NULL, "
+                   "endMinute INTEGER NOT NULL)"))
+    {
+        return false;
+    }
+    
+    // Block events refer to apps by id, so each path is stored once
+    if (!query.exec("CREATE TABLE IF NOT EXISTS event_apps ("
+                   "id INTEGER PRIMARY KEY, "
+                   "pathKey TEXT NOT NULL UNIQUE, "
+                   "appPath TEXT NOT NULL, "
+                   "appName TEXT NOT NULL)"))
+    {
+        return false;
+    }
+
+    // Block event counts per app and kind, kept up to date with every
+    // append so reports never read raw events
+    for (const char* table : {"block_event_hourly", "block_event_daily"}) {
+        if (!query.exec(QString("CREATE TABLE IF NOT EXISTS %1 ("
+                                "bucket INTEGER NOT NULL, "
+                                "appId INTEGER NOT NULL, "
+                                "kind INTEGER NOT NULL, "
+                                "count INTEGER NOT NULL, "
+                                "PRIMARY KEY (bucket, appId, kind)) WITHOUT ROWID").arg(table)))
+        {
+            return false;
+        }
+    }
+
+    if (!query.exec("CREATE TABLE IF NOT EXISTS event_retention ("
+                   "id INTEGER PRIMARY KEY, "
+                   "rawDays INTEGER NOT NULL, "
+                   "archiveDays INTEGER NOT NULL)")
+        || !query.exec("INSERT OR IGNORE INTO event_retention (id, rawDays, archiveDays) VALUES (1, 90, 0)"))
+    {
+        return false;
+    }
+
+    // Bumped by every rules or schedule write, so the blocklist image can
+    // tell a commit it misses from a checkpoint
+    if (!query.exec("CREATE TABLE IF NOT EXISTS meta ("
+                   "key TEXT PRIMARY KEY, "
+                   "value INTEGER NOT NULL)")
+        || !query.exec("INSERT OR IGNORE INTO meta (key, value) VALUES ('contentRevision', 0)"))
+    {
+        return false;
+    }
+
     if (!query.exec("INSERT OR IGNORE INTO block_time_settings ("
                         "id, startHour, startMinute, endHour, endMinute, "
                         "monday, tuesday, wednesday, thursday, friday, "
@@ -134,24 +372,390 @@ bool Database::createTables()
     return true;
 }
 
+bool Database::migrateSchema()
+{
+    QSqlDatabase db = connection();
+    QSqlQuery query(db);
+    if (!query.exec("PRAGMA user_version") || !query.next()) {
+        _logToFile("migrateSchema failed: " + query.lastError().text());
+        return false;
+    }
+    int version = query.value(0).toInt();
+    query.finish();
+
+    // Each step runs in its own transaction together with its version
+    // bump, so an interrupted upgrade resumes where it stopped
+    for (int target = version + 1; target <= 3; ++target) {
+        if (!db.transaction()) {
+            _logToFile("migrateSchema transaction failed: " + db.lastError().text());
+            return false;
+        }
+
+        bool migrated = false;
+        switch (target) {
+            case 1:
+                migrated = query.exec("ALTER TABLE blocked_apps ADD COLUMN ruleType INTEGER NOT NULL DEFAULT 0");
+                break;
+            case 2:
+                migrated = migrateToPathKeys(query);
+                break;
+            case 3:
+                migrated = migrateToBlockEventRollups(query);
+                break;
+        }
+
+        // A step may rewrite rule rows, so images written before it are stale
+        if (!migrated
+            || !query.exec("UPDATE meta SET value = value + 1 WHERE key = 'contentRevision'")
+            || !query.exec(QString("PRAGMA user_version = %1").arg(target))) {
+            _logToFile(QString("migrateSchema to version %1 failed: %2").arg(target).arg(query.lastError().text()));
+            db.rollback();
+            return false;
+        }
+        if (!db.commit()) {
+            _logToFile("migrateSchema commit failed: " + db.lastError().text());
+            db.rollback();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool Database::migrateToPathKeys(QSqlQuery& query)
+{
+    // appPath is case-sensitive and was matched with LIKE, which scans the
+    // table. pathKey holds the PathKey form and gets a unique index, so
+    // lookups become exact matches and paths that differ only in case or
+    // separators collapse into one row.
+    if (!query.exec("ALTER TABLE blocked_apps ADD COLUMN pathKey TEXT"))
+        return false;
+
+    if (!query.exec("SELECT rowid, appPath, isBlocked FROM blocked_apps ORDER BY isBlocked DESC, rowid DESC"))
+        return false;
+
+    // Rows come active-first and newest-first, so the first one seen for a
+    // key is the one kept
+    QList<QPair<qint64, QString>> keys;
+    QList<qint64> duplicates;
+    QSet<PathKey> seen;
+    while (query.next()) {
+        qint64 rowId = query.value(0).toLongLong();
+        PathKey key(query.value(1).toString());
+        if (seen.contains(key)) {
+            duplicates.append(rowId);
+            continue;
+        }
+        seen.insert(key);
+        keys.append(qMakePair(rowId, key.toString()));
+    }
+    query.finish();
+
+    query.prepare("DELETE FROM blocked_apps WHERE rowid = :rowId");
+    for (qint64 rowId : duplicates) {
+        query.bindValue(":rowId", rowId);
+        if (!query.exec())
+            return false;
+    }
+
+    query.prepare("UPDATE blocked_apps SET pathKey = :pathKey WHERE rowid = :rowId");
+    for (const auto& key : keys) {
+        query.bindValue(":pathKey", key.second);
+        query.bindValue(":rowId", key.first);
+        if (!query.exec())
+            return false;
+    }
+
+    // The active list is read in name order; carrying appPath and ruleType
+    // lets both the list and the rule index load from the index alone
+    return query.exec("CREATE UNIQUE INDEX IF NOT EXISTS idx_blocked_apps_pathKey "
+                      "ON blocked_apps (pathKey)")
+        && query.exec("CREATE INDEX IF NOT EXISTS idx_blocked_apps_active_name "
+                      "ON blocked_apps (isBlocked, appName, appPath, ruleType)");
+}
+
+bool Database::migrateToBlockEventRollups(QSqlQuery& query)
+{
+    // Events journaled before the rollups existed
+    if (!query.exec("SELECT name FROM sqlite_master WHERE type = 'table' AND name GLOB 'block_events_[0-9]*'"))
+        return false;
+
+    QStringList partitions;
+    while (query.next())
+        partitions.append(query.value(0).toString());
+    query.finish();
+
+    BlockEventRollups rollups;
+    for (const QString& partition : partitions) {
+        if (!query.exec(QString("SELECT timestamp, appId, kind FROM %1").arg(partition)))
+            return false;
+        while (query.next())
+            rollups.add(query.value(0).toLongLong(), query.value(1).toLongLong(), query.value(2).toInt());
+        query.finish();
+    }
+
+    return query.prepare(QString(kRollupUpsert).arg("block_event_hourly"))
+        && upsertRollups(query, rollups.hourly)
+        && query.prepare(QString(kRollupUpsert).arg("block_event_daily"))
+        && upsertRollups(query, rollups.daily);
+}
+
 #pragma region BlockedApp
 
-bool Database::addBlockedApp(const QString& appPath, const QString& appName)
+bool Database::rebuildBlockedAppIndex(bool* changed)
+{
+    QSqlDatabase db = connection();
+    QSqlQuery& version = statement("PRAGMA data_version");
+    if (!version.exec()) {
+        _logToFile("rebuildBlockedAppIndex failed: " + version.lastError().text());
+        return false;
+    }
+    qint64 dataVersion = version.next() ? version.value(0).toLongLong() : -1;
+    version.finish();
+
+    QSqlQuery& query = statement("SELECT appPath, ruleType FROM blocked_apps WHERE isBlocked = 1");
+    if (!query.exec()) {
+        _logToFile("rebuildBlockedAppIndex failed: " + query.lastError().text());
+        return false;
+    }
+
+    QHash<PathKey, RuleType> index;
+    while (query.next())
+        index.insert(PathKey(query.value(0).toString()), static_cast<RuleType>(query.value(1).toInt()));
+    query.finish();
+
+    QWriteLocker locker(&m_indexLock);
+    m_dataVersions.insert(db.connectionName(), dataVersion);
+    // Commits on the other connections of this process were already
+    // applied to the index, only recompile when the rules really differ
+    bool differs = index != m_blockedAppIndex;
+    if (differs) {
+        m_blockedAppIndex.swap(index);
+        publishBlockRules();
+    }
+    if (changed)
+        *changed = differs;
+    return true;
+}
+
+quint64 Database::publishBlockRules()
+{
+    // Called with m_indexLock held for writing
+    QList<BlockRule> rules;
+    rules.reserve(m_blockedAppIndex.size());
+    for (auto it = m_blockedAppIndex.cbegin(); it != m_blockedAppIndex.cend(); ++it)
+        rules.append(BlockRule{it.key().toString(), it.value()});
+
+    std::atomic_store(&m_blockRules, std::shared_ptr<const RuleMatcher>(std::make_shared<RuleMatcher>(rules)));
+    m_blockedAppsRevision = ++m_revision;
+    return m_blockedAppsRevision;
+}
+
+bool Database::reloadIfChanged()
+{
+    if (!m_initialized) return false;
+
+    if (m_imageBacked) {
+        // A stat of the database and its WAL, SQLite stays closed until
+        // the files changed after the image was found current
+        if (BlocklistImage::databaseStamp(m_dbPath) <= m_imageStamp)
+            return false;
+
+        bool changed = false;
+        if (!loadImage(&changed)) {
+            // The image lags behind the database: its writer has not
+            // replaced it yet, or crashed before it could.
+            // Read this change from SQLite, which rewrites the image, and
+            // go on from that image so the next change is a stat again.
+            quint64 revision = blockedAppsRevision();
+            if (!initialize())
+                return false;
+            changed = blockedAppsRevision() != revision;
+            m_imageBacked = loadImage();
+        }
+
+        if (changed)
+            emit blockedAppsReloaded(blockedAppsRevision());
+        return true;
+    }
+
+    // data_version only moves when another connection (the GUI, the
+    // service process or another thread) commits, so our own writes on
+    // this connection never trigger a reload
+    QSqlDatabase db = connection();
+    QSqlQuery& query = statement("PRAGMA data_version");
+    if (!query.exec() || !query.next())
+        return false;
+    qint64 dataVersion = query.value(0).toLongLong();
+    query.finish();
+
+    {
+        QReadLocker locker(&m_indexLock);
+        auto known = m_dataVersions.constFind(db.connectionName());
+        if (known != m_dataVersions.cend() && known.value() == dataVersion)
+            return false;
+    }
+
+    reloadSchedule();
+
+    bool changed = false;
+    if (!rebuildBlockedAppIndex(&changed))
+        return false;
+
+    if (changed)
+        emit blockedAppsReloaded(blockedAppsRevision());
+    return true;
+}
+
+bool Database::loadImage(bool* changed)
+{
+    // Taken before the image is read, so a commit racing this check moves
+    // the files past it and is looked at on the next reload
+    const qint64 stamp = BlocklistImage::databaseStamp(m_dbPath);
+
+    BlocklistImage image;
+    if (!image.load(BlocklistImage::pathFor(m_dbPath)))
+        return false;
+    // The files changed after the image was written, by a commit it may
+    // miss or only by a checkpoint. The content revision tells which.
+    if (image.sourceStamp() < stamp) {
+        quint64 revision = 0;
+        if (!readContentRevision(&revision) || image.sourceRevision() != revision)
+            return false;
+    }
+
+    QHash<PathKey, RuleType> index;
+    index.reserve(image.rules().size());
+    for (const BlockRule& rule : image.rules())
+        index.insert(PathKey(rule.pattern), rule.type);
+
+    bool differs = false;
+    {
+        QWriteLocker locker(&m_indexLock);
+        differs = index != m_blockedAppIndex;
+        if (differs) {
+            m_blockedAppIndex.swap(index);
+            // The trie holds pointers, so it is rebuilt rather than mapped
+            publishBlockRules();
+        }
+    }
+
+    std::atomic_store(&m_schedule, image.schedule());
+    m_imageStamp = qMax(image.sourceStamp(), stamp);
+    if (changed)
+        *changed = differs;
+    return true;
+}
+
+void Database::writeImage(quint64 contentRevision)
+{
+    QMutexLocker imageLocker(&m_imageLock);
+
+    // Taken before the rules are read, like the content revision that was
+    // read in the write transaction, so the image can only claim to be
+    // older than it is, which at worst sends the service to SQLite
+    const qint64 stamp = BlocklistImage::databaseStamp(m_dbPath);
+
+    QList<BlockRule> rules;
+    {
+        QReadLocker locker(&m_indexLock);
+        rules.reserve(m_blockedAppIndex.size());
+        for (auto it = m_blockedAppIndex.cbegin(); it != m_blockedAppIndex.cend(); ++it)
+            rules.append(BlockRule{it.key().toString(), it.value()});
+    }
+
+    const QString path = BlocklistImage::pathFor(m_dbPath);
+    if (!BlocklistImage::write(path, stamp, contentRevision, rules, *std::atomic_load(&m_schedule)))
+        _logToFile("writeImage failed: " + path);
+}
+
+bool Database::bumpContentRevision(quint64* revision)
+{
+    // Called inside the write transaction, so the revision commits
+    // together with the rows it stands for
+    QSqlQuery& query = statement("UPDATE meta SET value = value + 1 WHERE key = 'contentRevision'");
+    if (!query.exec()) {
+        _logToFile("bumpContentRevision failed: " + query.lastError().text());
+        return false;
+    }
+    return readContentRevision(revision);
+}
+
+bool Database::readContentRevision(quint64* revision) const
+{
+    QSqlQuery& query = statement("SELECT value FROM meta WHERE key = 'contentRevision'");
+    if (!query.exec() || !query.next()) {
+        _logToFile("readContentRevision failed: " + query.lastError().text());
+        return false;
+    }
+    *revision = query.value(0).toULongLong();
+    query.finish();
+    return true;
+}
+
+quint64 Database::blockedAppsRevision() const
+{
+    QReadLocker locker(&m_indexLock);
+    return m_blockedAppsRevision;
+}
+
+bool Database::addBlockedApp(const QString& appPath, const QString& appName, RuleType ruleType)
 {
     if (!m_initialized) return false;
     
-    QString normalizedPath = QDir::cleanPath(appPath).replace("\\", "/");
+    QString normalizedPath = PathKey::normalized(appPath);
+
+    PathKey key(normalizedPath);
 
-    QSqlQuery query(m_db);
-    query.prepare("INSERT OR REPLACE INTO blocked_apps (appPath, appName, isBlocked) VALUES (:normalizedPath, :appPath, 1)");
+    QSqlDatabase db = connection();
+    if (!db.transaction()) {
+        _logToFile("addBlockedApp transaction failed: " + db.lastError().text());
+        return false;
+    }
+
+    // The unique pathKey index makes this replace an existing row for the
+    // same path even when it was stored with different case
+    QSqlQuery& query = statement("INSERT OR REPLACE INTO blocked_apps (appPath, appName, isBlocked, ruleType, pathKey) "
+                                 "VALUES (:normalizedPath, :appPath, 1, :ruleType, :pathKey)");
     query.bindValue(":normalizedPath", normalizedPath);
     query.bindValue(":appPath", appName);
+    query.bindValue(":ruleType", static_cast<int>(ruleType));
+    query.bindValue(":pathKey", key.toString());
     
     if (!query.exec()) {
         qDebug() << "Error adding blocked app:" << query.lastError().text();
+        db.rollback();
+        return false;
+    }
+
+    quint64 contentRevision = 0;
+    if (!bumpContentRevision(&contentRevision)) {
+        db.rollback();
+        return false;
+    }
+    if (!db.commit()) {
+        _logToFile("addBlockedApp commit failed: " + db.lastError().text());
+        db.rollback();
         return false;
     }
     
+    QList<BlockedAppChange> changes;
+    quint64 baseRevision = 0;
+    quint64 revision = 0;
+    {
+        QWriteLocker locker(&m_indexLock);
+        auto existing = m_blockedAppIndex.constFind(key);
+        if (existing != m_blockedAppIndex.cend() && existing.value() != ruleType)
+            changes.append(BlockedAppChange{normalizedPath, appName, existing.value(), false});
+        changes.append(BlockedAppChange{normalizedPath, appName, ruleType, true});
+
+        m_blockedAppIndex.insert(key, ruleType);
+        baseRevision = m_blockedAppsRevision;
+        revision = publishBlockRules();
+    }
+
+    writeImage(contentRevision);
+    emit blockedAppsChanged(baseRevision, revision, changes);
     return true;
 }
 
@@ -159,54 +763,254 @@ bool Database::removeBlockedApp(const QString& appPath)
 {
     if (!m_initialized) return false;
     
-    QSqlQuery query(m_db);
-    query.prepare("UPDATE blocked_apps SET isBlocked = 0 WHERE appPath LIKE :path");
-    query.bindValue(":path", appPath);
+    PathKey key(appPath);
+    QSqlDatabase db = connection();
+    if (!db.transaction()) {
+        _logToFile("removeBlockedApp transaction failed: " + db.lastError().text());
+        return false;
+    }
+
+    // Only an active row is a change worth a new content revision
+    QSqlQuery& query = statement("UPDATE blocked_apps SET isBlocked = 0 WHERE pathKey = :pathKey AND isBlocked = 1");
+    query.bindValue(":pathKey", key.toString());
     
     if (!query.exec()) {
         qDebug() << "Error removing blocked app:" << query.lastError().text();
+        db.rollback();
+        return false;
+    }
+
+    quint64 contentRevision = 0;
+    if (query.numRowsAffected() > 0 && !bumpContentRevision(&contentRevision)) {
+        db.rollback();
+        return false;
+    }
+    if (!db.commit()) {
+        _logToFile("removeBlockedApp commit failed: " + db.lastError().text());
+        db.rollback();
         return false;
     }
     
+    quint64 baseRevision = 0;
+    quint64 revision = 0;
+    RuleType ruleType = RuleType::Exact;
+    {
+        QWriteLocker locker(&m_indexLock);
+        auto existing = m_blockedAppIndex.find(key);
+        if (existing == m_blockedAppIndex.end())
+            return true;
+
+        ruleType = existing.value();
+        m_blockedAppIndex.erase(existing);
+        baseRevision = m_blockedAppsRevision;
+        revision = publishBlockRules();
+    }
+
+    writeImage(contentRevision);
+    emit blockedAppsChanged(baseRevision, revision, {BlockedAppChange{appPath, QString(), ruleType, false}});
     return true;
 }
 
+BlockedAppBatchResult Database::applyBlockedAppBatch(const QList<BlockedAppChange>& changes)
+{
+    BlockedAppBatchResult result;
+    if (!m_initialized) return result;
+
+    struct StoredApp
+    {
+        QString appName;
+        RuleType ruleType;
+        bool blocked;
+    };
+
+    QSqlDatabase db = connection();
+    if (!db.transaction()) {
+        _logToFile("applyBlockedAppBatch transaction failed: " + db.lastError().text());
+        return result;
+    }
+
+    // Read the current rows once so each change can be classified without
+    // a lookup per change
+    QSqlQuery& select = statement("SELECT appPath, appName, isBlocked, ruleType FROM blocked_apps");
+    if (!select.exec()) {
+        _logToFile("applyBlockedAppBatch failed: " + select.lastError().text());
+        db.rollback();
+        return result;
+    }
+    QHash<PathKey, StoredApp> stored;
+    while (select.next()) {
+        stored.insert(PathKey(select.value(0).toString()),
+                      StoredApp{select.value(1).toString(),
+                                static_cast<RuleType>(select.value(3).toInt()),
+                                select.value(2).toBool()});
+    }
+    select.finish();
+
+    QSqlQuery& insert = statement("INSERT INTO blocked_apps (appPath, appName, isBlocked, ruleType, pathKey) "
+                                  "VALUES (:appPath, :appName, 1, :ruleType, :pathKey)");
+    QSqlQuery& update = statement("UPDATE blocked_apps SET appName = :appName, isBlocked = 1, ruleType = :ruleType "
+                                  "WHERE pathKey = :pathKey");
+    QSqlQuery& deactivate = statement("UPDATE blocked_apps SET isBlocked = 0 WHERE pathKey = :pathKey");
+
+    // Only the rows that were actually written are reported
+    QList<BlockedAppChange> applied;
+
+    for (const BlockedAppChange& change : changes) {
+        PathKey key(change.appPath);
+        if (key.isEmpty()) {
+            ++result.unchanged;
+            continue;
+        }
+
+        auto existing = stored.find(key);
+        QSqlQuery* query = nullptr;
+
+        if (change.blocked) {
+            if (existing == stored.end()) {
+                QString appPath = PathKey::normalized(change.appPath);
+                insert.bindValue(":appPath", appPath);
+                insert.bindValue(":appName", change.appName);
+                insert.bindValue(":ruleType", static_cast<int>(change.ruleType));
+                insert.bindValue(":pathKey", key.toString());
+                query = &insert;
+                stored.insert(key, StoredApp{change.appName, change.ruleType, true});
+                applied.append(BlockedAppChange{appPath, change.appName, change.ruleType, true});
+                ++result.inserted;
+            } else if (existing->blocked && existing->appName == change.appName
+                       && existing->ruleType == change.ruleType) {
+                ++result.unchanged;
+            } else {
+                update.bindValue(":appName", change.appName);
+                update.bindValue(":ruleType", static_cast<int>(change.ruleType));
+                update.bindValue(":pathKey", key.toString());
+                query = &update;
+                if (existing->blocked && existing->ruleType != change.ruleType)
+                    applied.append(BlockedAppChange{change.appPath, existing->appName, existing->ruleType, false});
+                applied.append(BlockedAppChange{change.appPath, change.appName, change.ruleType, true});
+                *existing = StoredApp{change.appName, change.ruleType, true};
+                ++result.updated;
+            }
+        } else {
+            if (existing == stored.end() || !existing->blocked) {
+                ++result.unchanged;
+            } else {
+                deactivate.bindValue(":pathKey", key.toString());
+                query = &deactivate;
+                applied.append(BlockedAppChange{change.appPath, existing->appName, existing->ruleType, false});
+                existing->blocked = false;
+                ++result.deactivated;
+            }
+        }
+
+        if (query && !query->exec()) {
+            _logToFile("applyBlockedAppBatch failed: " + query->lastError().text());
+            db.rollback();
+            return BlockedAppBatchResult();
+        }
+    }
+
+    quint64 contentRevision = 0;
+    if (result.inserted + result.updated + result.deactivated > 0 && !bumpContentRevision(&contentRevision)) {
+        db.rollback();
+        return BlockedAppBatchResult();
+    }
+
+    if (!db.commit()) {
+        _logToFile("applyBlockedAppBatch commit failed: " + db.lastError().text());
+        db.rollback();
+        return BlockedAppBatchResult();
+    }
+
+    result.success = true;
+    if (result.inserted + result.updated + result.deactivated == 0)
+        return result;
+
+    QHash<PathKey, RuleType> index;
+    for (auto it = stored.cbegin(); it != stored.cend(); ++it) {
+        if (it->blocked)
+            index.insert(it.key(), it->ruleType);
+    }
+
+    quint64 baseRevision = 0;
+    quint64 revision = 0;
+    {
+        QWriteLocker locker(&m_indexLock);
+        m_blockedAppIndex.swap(index);
+        baseRevision = m_blockedAppsRevision;
+        revision = publishBlockRules();
+    }
+
+    writeImage(contentRevision);
+    result.revision = revision;
+    emit blockedAppsChanged(baseRevision, revision, applied);
+    return result;
+}
+
 bool Database::isAppBlocked(const QString& appPath) const
 {
     if (!m_initialized) return false;
 
-    QString normalizedPath = QDir::cleanPath(appPath).replace("\\", "/");
-
-    QSqlQuery query(m_db);
-    query.prepare("SELECT 1 FROM blocked_apps WHERE appPath LIKE :path;");
-    query.bindValue(":path", QVariant(normalizedPath));
-    
-    if (!query.exec() || !query.next())
-        return false;
+    return std::atomic_load(&m_blockRules)->matches(appPath);
+}
 
-    return true;
+std::shared_ptr<const RuleMatcher> Database::blockRules() const
+{
+    return std::atomic_load(&m_blockRules);
 }
 
-QList<std::shared_ptr<AppModel>> Database::getBlockedApps() const
+QList<std::shared_ptr<AppModel>> Database::getBlockedApps(bool activeOnly) const
 {
     QList<std::shared_ptr<AppModel>> result;
     
     if (!m_initialized) return result;
     
-    QSqlQuery query(m_db);
-    query.exec("SELECT appPath, appName, isBlocked FROM blocked_apps ORDER BY appName");
+    // The active list is served in order straight from idx_blocked_apps_active_name
+    QSqlQuery& query = activeOnly
+        ? statement("SELECT appPath, appName, isBlocked, ruleType FROM blocked_apps "
+                    "WHERE isBlocked = 1 ORDER BY appName")
+        : statement("SELECT appPath, appName, isBlocked, ruleType FROM blocked_apps ORDER BY appName");
+    query.exec();
     
     while (query.next()) {
         QString appPath = query.value(0).toString();
         QString appName = query.value(1).toString();
         bool isBlocked = query.value(2).toBool();
         
-        result.append(std::make_shared<AppModel>(appPath, appName, isBlocked));
+        auto app = std::make_shared<AppModel>(appPath, appName, isBlocked);
+        app->setRuleType(static_cast<RuleType>(query.value(3).toInt()));
+        result.append(app);
     }
+    query.finish();
     
     return result;
 }
 
+QList<BlockedAppChange> Database::getBlockedAppEntries(bool activeOnly) const
+{
+    QList<BlockedAppChange> result;
+
+    if (!m_initialized) return result;
+
+    QSqlQuery& query = activeOnly
+        ? statement("SELECT appPath, appName, isBlocked, ruleType FROM blocked_apps "
+                    "WHERE isBlocked = 1 ORDER BY appName")
+        : statement("SELECT appPath, appName, isBlocked, ruleType FROM blocked_apps ORDER BY appName");
+    if (!query.exec()) {
+        _logToFile("getBlockedAppEntries failed: " + query.lastError().text());
+        return result;
+    }
+
+    while (query.next()) {
+        result.append(BlockedAppChange{query.value(0).toString(),
+                                       query.value(1).toString(),
+                                       static_cast<RuleType>(query.value(3).toInt()),
+                                       query.value(2).toBool()});
+    }
+    query.finish();
+
+    return result;
+}
+
 #pragma endregion BlockedApp
 
 #pragma region BlockTimeSettings
@@ -215,10 +1019,10 @@ std::shared_ptr<BlockTimeSettingsModel> Database::getBlockTimeSettings() const
 {
     if (!m_initialized) return nullptr;
     
-    QSqlQuery query(m_db);
-    if (!query.exec("SELECT startHour, startMinute, endHour, endMinute, "
-                    "monday, tuesday, wednesday, thursday, friday, saturday, sunday, isActive "
-                    "FROM block_time_settings WHERE id = 1")) {
+    QSqlQuery& query = statement("SELECT startHour, startMinute, endHour, endMinute, "
+                                 "monday, tuesday, wednesday, thursday, friday, saturday, sunday, isActive "
+                                 "FROM block_time_settings WHERE id = 1");
+    if (!query.exec()) {
         _logToFile("getBlockTimeSettings failed: " + query.lastError().text());
         return nullptr;
     }
@@ -239,13 +1043,34 @@ std::shared_ptr<BlockTimeSettingsModel> Database::getBlockTimeSettings() const
         week.sunday = query.value(10).toBool();
         
         bool isActive = query.value(11).toBool();
+        query.finish();
         
         QTime startTime(startHour, startMinute);
         QTime endTime(endHour, endMinute);
         
-        return std::make_shared<BlockTimeSettingsModel>(startTime, endTime, week, isActive);
+        auto settings = std::make_shared<BlockTimeSettingsModel>(startTime, endTime, week, isActive);
+
+        QList<REG_Interval> intervals;
+        QSqlQuery& intervalQuery = statement("SELECT dayOfWeek, startMinute, endMinute "
+                                             "FROM block_time_intervals WHERE settingsId = 1 ORDER BY id");
+        if (!intervalQuery.exec()) {
+            _logToFile("getBlockTimeSettings intervals failed: " + intervalQuery.lastError().text());
+            return settings;
+        }
+        while (intervalQuery.next()) {
+            REG_Interval interval;
+            interval.dayOfWeek = intervalQuery.value(0).toInt();
+            interval.startTime = QTime(0, 0).addSecs(intervalQuery.value(1).toInt() * 60);
+            interval.endTime = QTime(0, 0).addSecs(intervalQuery.value(2).toInt() * 60);
+            intervals.append(interval);
+        }
+        intervalQuery.finish();
+        settings->setIntervals(intervals);
+
+        return settings;
     }
 
+    query.finish();
     return nullptr;
 }
 
@@ -258,21 +1083,26 @@ bool Database::updateBlockTimeSettings(const std::shared_ptr<BlockTimeSettingsMo
     REG_Week week = settings->getWeek();
     bool isActive = settings->getActive();
     
-    QSqlQuery query(m_db);
-    query.prepare("UPDATE block_time_settings SET "
-                 "startHour = :startHour, "
-                 "startMinute = :startMinute, "
-                 "endHour = :endHour, "
-                 "endMinute = :endMinute, "
-                 "monday = :monday, "
-                 "tuesday = :tuesday, "
-                 "wednesday = :wednesday, "
-                 "thursday = :thursday, "
-                 "friday = :friday, "
-                 "saturday = :saturday, "
-                 "sunday = :sunday, "
-                 "isActive = :isActive "
-                 "WHERE id = 1");
+    QSqlDatabase db = connection();
+    if (!db.transaction()) {
+        _logToFile("updateBlockTimeSettings transaction failed: " + db.lastError().text());
+        return false;
+    }
+
+    QSqlQuery& query = statement("UPDATE block_time_settings SET "
+                                 "startHour = :startHour, "
+                                 "startMinute = :startMinute, "
+                                 "endHour = :endHour, "
+                                 "endMinute = :endMinute, "
+                                 "monday = :monday, "
+                                 "tuesday = :tuesday, "
+                                 "wednesday = :wednesday, "
+                                 "thursday = :thursday, "
+                                 "friday = :friday, "
+                                 "saturday = :saturday, "
+                                 "sunday = :sunday, "
+                                 "isActive = :isActive "
+                                 "WHERE id = 1");
     
     query.bindValue(":startHour", startTime.hour());
     query.bindValue(":startMinute", startTime.minute());
@@ -289,66 +1119,425 @@ bool Database::updateBlockTimeSettings(const std::shared_ptr<BlockTimeSettingsMo
     
     if (!query.exec()) {
         _logToFile("updateBlockTimeSettings failed: " + query.lastError().text());
+        db.rollback();
+        return false;
+    }
+
+    QSqlQuery& clearIntervals = statement("DELETE FROM block_time_intervals WHERE settingsId = 1");
+    if (!clearIntervals.exec()) {
+        _logToFile("updateBlockTimeSettings intervals failed: " + clearIntervals.lastError().text());
+        db.rollback();
+        return false;
+    }
+
+    QSqlQuery& insertInterval = statement("INSERT INTO block_time_intervals (settingsId, dayOfWeek, startMinute, endMinute) "
+                                          "VALUES (1, :dayOfWeek, :startMinute, :endMinute)");
+    for (const REG_Interval& interval : settings->getIntervals()) {
+        insertInterval.bindValue(":dayOfWeek", interval.dayOfWeek);
+        insertInterval.bindValue(":startMinute", interval.startTime.msecsSinceStartOfDay() / 60000);
+        insertInterval.bindValue(":endMinute", interval.endTime.msecsSinceStartOfDay() / 60000);
+        if (!insertInterval.exec()) {
+            _logToFile("updateBlockTimeSettings intervals failed: " + insertInterval.lastError().text());
+            db.rollback();
+            return false;
+        }
+    }
+
+    quint64 contentRevision = 0;
+    if (!bumpContentRevision(&contentRevision)) {
+        db.rollback();
+        return false;
+    }
+
+    if (!db.commit()) {
+        _logToFile("updateBlockTimeSettings commit failed: " + db.lastError().text());
+        db.rollback();
         return false;
     }
     
+    std::atomic_store(&m_schedule, std::shared_ptr<const CompiledSchedule>(
+                                       std::make_shared<CompiledSchedule>(*settings)));
+    writeImage(contentRevision);
+    emit scheduleChanged(++m_revision);
     return true;
 }
 
+void Database::reloadSchedule()
+{
+    auto settings = getBlockTimeSettings();
+    std::shared_ptr<const CompiledSchedule> schedule = settings
+        ? std::make_shared<CompiledSchedule>(*settings)
+        : std::make_shared<CompiledSchedule>();
+    std::atomic_store(&m_schedule, schedule);
+}
+
 bool Database::isBlockingActive() const
 {
     if (!m_initialized) return false;
 
-    QSqlQuery query(m_db);
-    if (!query.exec("SELECT isActive FROM block_time_settings WHERE id = 1")) {
-        _logToFile("isBlockingActive failed: " + query.lastError().text());
+    return std::atomic_load(&m_schedule)->isActive();
+}
+
+bool Database::isBlockingNow() const
+{
+    return isBlockingAt(QDateTime::currentDateTime());
+}
+
+bool Database::isBlockingAt(const QDateTime& localTime) const
+{
+    if (!m_initialized) return false;
+
+    return std::atomic_load(&m_schedule)->isBlockingAt(localTime);
+}
+
+QDateTime Database::nextScheduleTransition(const QDateTime& localTime) const
+{
+    if (!m_initialized) return QDateTime();
+
+    return std::atomic_load(&m_schedule)->nextTransition(localTime);
+}
+
+#pragma endregion BlockTimeSettings
+
+#pragma region BlockEvents
+
+QString Database::blockEventPartition(qint64 timestamp)
+{
+    const QDate date = QDateTime::fromMSecsSinceEpoch(timestamp, QTimeZone::UTC).date();
+    return QString("block_events_%1%2").arg(date.year(), 4, 10, QChar('0')).arg(date.month(), 2, 10, QChar('0'));
+}
+
+bool Database::appendBlockEvents(const QList<BlockEvent>& events)
+{
+    if (!m_initialized) return false;
+    if (events.isEmpty()) return true;
+
+    QMutexLocker locker(&m_eventLock);
+
+    QSqlDatabase db = connection();
+    if (!db.transaction()) {
+        _logToFile("appendBlockEvents transaction failed: " + db.lastError().text());
         return false;
     }
-    
-    if (query.next())
-        return query.value(0).toBool();
 
-    return false;
+    // Only become visible to later batches if this one commits
+    QSet<QString> createdPartitions;
+    QHash<PathKey, qint64> createdAppIds;
+    BlockEventRollups rollups;
+
+    QSqlQuery& insertApp = statement("INSERT OR IGNORE INTO event_apps (pathKey, appPath, appName) "
+                                     "VALUES (:pathKey, :appPath, :appName)");
+    QSqlQuery& selectApp = statement("SELECT id FROM event_apps WHERE pathKey = :pathKey");
+
+    for (const BlockEvent& event : events) {
+        PathKey key(event.appPath);
+        qint64 appId = m_eventAppIds.value(key, createdAppIds.value(key, -1));
+        if (appId < 0) {
+            insertApp.bindValue(":pathKey", key.toString());
+            insertApp.bindValue(":appPath", event.appPath);
+            insertApp.bindValue(":appName", event.appName);
+            selectApp.bindValue(":pathKey", key.toString());
+            if (!insertApp.exec() || !selectApp.exec() || !selectApp.next()) {
+                _logToFile("appendBlockEvents app failed: " + insertApp.lastError().text() + selectApp.lastError().text());
+                selectApp.finish();
+                db.rollback();
+                return false;
+            }
+            appId = selectApp.value(0).toLongLong();
+            selectApp.finish();
+            createdAppIds.insert(key, appId);
+        }
+
+        const QString partition = blockEventPartition(event.timestamp);
+        if (!m_eventPartitions.contains(partition) && !createdPartitions.contains(partition)) {
+            // Rows go in in time order, so the rowid order doubles as the
+            // time index within a month
+            QSqlQuery create(db);
+            if (!create.exec(QString("CREATE TABLE IF NOT EXISTS %1 ("
+                                     "timestamp INTEGER NOT NULL, "
+                                     "appId INTEGER NOT NULL, "
+                                     "kind INTEGER NOT NULL)").arg(partition))) {
+                _logToFile("appendBlockEvents partition failed: " + create.lastError().text());
+                db.rollback();
+                return false;
+            }
+            createdPartitions.insert(partition);
+        }
+
+        QSqlQuery& insertEvent = statement(QString("INSERT INTO %1 (timestamp, appId, kind) "
+                                                   "VALUES (:timestamp, :appId, :kind)").arg(partition));
+        insertEvent.bindValue(":timestamp", event.timestamp);
+        insertEvent.bindValue(":appId", appId);
+        insertEvent.bindValue(":kind", static_cast<int>(event.kind));
+        if (!insertEvent.exec()) {
+            _logToFile("appendBlockEvents failed: " + insertEvent.lastError().text());
+            db.rollback();
+            return false;
+        }
+        rollups.add(event.timestamp, appId, static_cast<int>(event.kind));
+    }
+
+    QSqlQuery& upsertHourly = statement(QString(kRollupUpsert).arg("block_event_hourly"));
+    QSqlQuery& upsertDaily = statement(QString(kRollupUpsert).arg("block_event_daily"));
+    if (!upsertRollups(upsertHourly, rollups.hourly) || !upsertRollups(upsertDaily, rollups.daily)) {
+        _logToFile("appendBlockEvents rollups failed: " + upsertHourly.lastError().text() + upsertDaily.lastError().text());
+        db.rollback();
+        return false;
+    }
+
+    if (!db.commit()) {
+        _logToFile("appendBlockEvents commit failed: " + db.lastError().text());
+        db.rollback();
+        return false;
+    }
+
+    m_eventPartitions.unite(createdPartitions);
+    m_eventAppIds.insert(createdAppIds);
+    return true;
 }
 
-bool Database::isBlockingNow() const
+QList<BlockEventCount> Database::getHourlyBlockEventCounts(const QDateTime& from, const QDateTime& to) const
+{
+    return getBlockEventCounts(true, from.toMSecsSinceEpoch() / kMsecsPerHour, to.toMSecsSinceEpoch() / kMsecsPerHour);
+}
+
+QList<BlockEventCount> Database::getDailyBlockEventCounts(const QDate& from, const QDate& to) const
+{
+    return getBlockEventCounts(false, from.toJulianDay(), to.toJulianDay());
+}
+
+QList<BlockEventCount> Database::getBlockEventCounts(bool hourly, qint64 from, qint64 to) const
+{
+    QList<BlockEventCount> result;
+    if (!m_initialized) return result;
+
+    // A range scan of the rollup's primary key
+    QSqlQuery& query = statement(QString("SELECT r.bucket, r.kind, r.count, a.appPath, a.appName "
+                                         "FROM %1 r JOIN event_apps a ON a.id = r.appId "
+                                         "WHERE r.bucket BETWEEN :from AND :to "
+                                         "ORDER BY r.bucket, a.appName")
+                                     .arg(hourly ? "block_event_hourly" : "block_event_daily"));
+    query.bindValue(":from", from);
+    query.bindValue(":to", to);
+    if (!query.exec()) {
+        _logToFile("getBlockEventCounts failed: " + query.lastError().text());
+        return result;
+    }
+
+    while (query.next()) {
+        BlockEventCount count;
+        const qint64 bucket = query.value(0).toLongLong();
+        count.bucketStart = hourly ? QDateTime::fromMSecsSinceEpoch(bucket * kMsecsPerHour)
+                                   : QDate::fromJulianDay(bucket).startOfDay();
+        count.kind = static_cast<BlockEventKind>(query.value(1).toInt());
+        count.count = query.value(2).toInt();
+        count.appPath = query.value(3).toString();
+        count.appName = query.value(4).toString();
+        result.append(count);
+    }
+    query.finish();
+    return result;
+}
+
+bool Database::compactBlockEvents(const QDateTime& now)
 {
     if (!m_initialized) return false;
 
-    auto settings = getBlockTimeSettings();
-    if (!settings || !settings->getActive()) {
+    const EventRetention retention = getEventRetention();
+
+    QMutexLocker locker(&m_eventLock);
+
+    QSqlDatabase db = connection();
+    QSqlQuery query(db);
+    if (!query.exec("SELECT name FROM sqlite_master WHERE type = 'table' AND name GLOB 'block_events_[0-9]*'")) {
+        _logToFile("compactBlockEvents failed: " + query.lastError().text());
         return false;
     }
 
-    QTime currentTime = QTime::currentTime();
-    QTime startTime = settings->getStartTime();
-    QTime endTime = settings->getEndTime();
+    // Partition names sort by month. Only months that lie wholly before
+    // the cutoff go, so no report range loses part of a month's rows.
+    const QString cutoffPartition = blockEventPartition(now.addDays(-retention.rawDays).toMSecsSinceEpoch());
+    QStringList expired;
+    QStringList handOffs;
+    while (query.next()) {
+        const QString partition = query.value(0).toString();
+        if (partition.endsWith(kArchivingSuffix))
+            handOffs.append(partition);
+        else if (partition < cutoffPartition)
+            expired.append(partition);
+    }
+    query.finish();
 
-    // Check if current time is within blocking hours
-    bool isWithinTimeRange = false;
-    if (startTime < endTime)
-        isWithinTimeRange = (currentTime >= startTime && currentTime <= endTime);
-    else
-        isWithinTimeRange = (currentTime >= startTime || currentTime <= endTime);
-    
-    if (!isWithinTimeRange)
+    // Hand-offs a crash interrupted come first, so a month's old rows
+    // are out of the way before its next partition is renamed
+    finishArchiveHandOffs(QSet<QString>(handOffs.cbegin(), handOffs.cend()));
+    QSet<QString> stuck;
+    for (const QString& handOff : handOffs) {
+        if (!archiveBlockEventPartition(handOff)) {
+            _logToFile("compactBlockEvents archive failed: " + handOff);
+            stuck.insert(handOff);
+        }
+    }
+
+    for (const QString& partition : expired) {
+        // Renamed first, so the rows being archived are told apart from
+        // late events, which go into a new partition for the month
+        const QString handOff = partition + kArchivingSuffix;
+        if (stuck.contains(handOff))
+            continue;
+        if (!query.exec(QString("ALTER TABLE %1 RENAME TO %2").arg(partition, handOff))) {
+            _logToFile("compactBlockEvents rename failed: " + query.lastError().text());
+            continue;
+        }
+        m_eventPartitions.remove(partition);
+        if (!archiveBlockEventPartition(handOff))
+            _logToFile("compactBlockEvents archive failed: " + handOff);
+    }
+
+    query.prepare("DELETE FROM block_event_hourly WHERE bucket < :cutoff");
+    query.bindValue(":cutoff", now.addDays(-kHourlyRollupRetentionDays).toMSecsSinceEpoch() / kMsecsPerHour);
+    if (!query.exec()) {
+        _logToFile("compactBlockEvents hourly failed: " + query.lastError().text());
         return false;
+    }
 
-    // Check if current day is enabled
-    QDate currentDate = QDate::currentDate();
-    int currentDay = currentDate.dayOfWeek();
-    REG_Week week = settings->getWeek();
-    
-    switch (currentDay) {
-        case 1: return week.monday;
-        case 2: return week.tuesday;
-        case 3: return week.wednesday;
-        case 4: return week.thursday;
-        case 5: return week.friday;
-        case 6: return week.saturday;
-        case 7: return week.sunday;
-        default: return false;
+    if (retention.archiveDays > 0) {
+        // Segment names sort by month just like the partitions
+        const QString cutoffSegment = QFileInfo(EventArchive::segmentPath(eventArchivePath(),
+                                          now.addDays(-retention.archiveDays).date())).fileName();
+        const QDir archive(eventArchivePath());
+        for (const QString& segment : archive.entryList({"block_events_*.fea"}, QDir::Files)) {
+            if (segment < cutoffSegment)
+                QFile::remove(archive.filePath(segment));
+        }
+    }
+    return true;
+}
+
+bool Database::archiveBlockEventPartition(const QString& handOff)
+{
+    // Called with m_eventLock held, for a partition renamed to
+    // block_events_YYYYMM_archiving
+    const QDate month = QDate::fromString(handOff.section('_', 2, 2) + "01", "yyyyMMdd");
+    if (!month.isValid())
+        return false;
+
+    QSqlQuery query(connection());
+    if (!query.exec(QString("SELECT e.timestamp, e.kind, a.appPath, a.appName "
+                            "FROM %1 e JOIN event_apps a ON a.id = e.appId "
+                            "ORDER BY e.timestamp").arg(handOff))) {
+        _logToFile("archiveBlockEventPartition failed: " + query.lastError().text());
+        return false;
+    }
+
+    QList<BlockEvent> events;
+    while (query.next()) {
+        BlockEvent event;
+        event.timestamp = query.value(0).toLongLong();
+        event.kind = static_cast<BlockEventKind>(query.value(1).toInt());
+        event.appPath = query.value(2).toString();
+        event.appName = query.value(3).toString();
+        events.append(event);
+    }
+    query.finish();
+
+    if (!QDir().mkpath(eventArchivePath()))
+        return false;
+
+    // Late events for a month that was archived before are merged rather
+    // than overwritten. A pending segment left by a failed install holds
+    // rows that are no longer in SQLite, so it goes in place first.
+    const QString path = EventArchive::segmentPath(eventArchivePath(), month);
+    if (QFileInfo::exists(path + kPendingSuffix) && !installPendingSegment(path))
+        return false;
+    if (QFileInfo::exists(path)) {
+        EventArchiveReader reader;
+        if (!reader.open(path))
+            return false;
+        BlockEvent event;
+        while (reader.next(event))
+            events.append(event);
+        if (reader.hasError())
+            return false;
+        std::stable_sort(events.begin(), events.end(), [](const BlockEvent& a, const BlockEvent& b) {
+            return a.timestamp < b.timestamp;
+        });
+    }
+
+    // The merged segment waits next to the old one until the drop
+    // commits. Until then the rows live in SQLite, afterwards only in the
+    // pending segment; finishArchiveHandOffs() tells which after a crash.
+    const QString pending = path + kPendingSuffix;
+    if (!EventArchive::write(pending, events))
+        return false;
+    if (!query.exec(QString("DROP TABLE %1").arg(handOff))) {
+        _logToFile("archiveBlockEventPartition drop failed: " + query.lastError().text());
+        QFile::remove(pending);
+        return false;
     }
+    return installPendingSegment(path);
+}
+
+void Database::finishArchiveHandOffs(const QSet<QString>& handOffs)
+{
+    const QDir archive(eventArchivePath());
+    const QString pendingPattern = QString("block_events_*.fea") + kPendingSuffix;
+    for (const QString& pending : archive.entryList({pendingPattern}, QDir::Files)) {
+        const QString path = archive.filePath(pending.chopped(int(qstrlen(kPendingSuffix))));
+        const QString handOff = QFileInfo(path).completeBaseName() + kArchivingSuffix;
+        if (handOffs.contains(handOff)) {
+            // Never dropped, the partition is archived again
+            QFile::remove(archive.filePath(pending));
+        } else if (!installPendingSegment(path)) {
+            _logToFile("finishArchiveHandOffs failed: " + path);
+        }
+    }
+}
+
+bool Database::installPendingSegment(const QString& path)
+{
+    // A crash between the two steps leaves only the pending segment,
+    // which finishArchiveHandOffs() installs on the next pass
+    if (QFileInfo::exists(path) && !QFile::remove(path))
+        return false;
+    return QFile::rename(path + kPendingSuffix, path);
+}
+
+EventRetention Database::getEventRetention() const
+{
+    EventRetention retention;
+    if (!m_initialized) return retention;
+
+    QSqlQuery& query = statement("SELECT rawDays, archiveDays FROM event_retention WHERE id = 1");
+    if (!query.exec()) {
+        _logToFile("getEventRetention failed: " + query.lastError().text());
+        return retention;
+    }
+    if (query.next()) {
+        retention.rawDays = query.value(0).toInt();
+        retention.archiveDays = query.value(1).toInt();
+    }
+    query.finish();
+    return retention;
+}
+
+bool Database::updateEventRetention(const EventRetention& retention)
+{
+    if (!m_initialized || retention.rawDays < 1 || retention.archiveDays < 0) return false;
+
+    QSqlQuery& query = statement("UPDATE event_retention SET rawDays = :rawDays, archiveDays = :archiveDays WHERE id = 1");
+    query.bindValue(":rawDays", retention.rawDays);
+    query.bindValue(":archiveDays", retention.archiveDays);
+    if (!query.exec()) {
+        _logToFile("updateEventRetention failed: " + query.lastError().text());
+        return false;
+    }
+    return true;
+}
+
+QString Database::eventArchivePath() const
+{
+    return QFileInfo(m_dbPath).dir().filePath("archive");
 }
 
-#pragma endregion BlockTimeSettings
\ No newline at end of file
+#pragma endregion BlockEvents
@@ -1,40 +1,229 @@
 #ifndef DATABASE_H
 #define DATABASE_H
 
+#include <QObject>
 #include <QString>
 #include <QSqlDatabase>
 #include <QList>
+#include <QHash>
+#include <QSet>
+#include <QReadWriteLock>
+#include <QMutex>
+#include <QSqlQuery>
+#include <QMetaType>
+#include <QDateTime>
 #include <memory>
+#include <atomic>
+
+#include "rulematcher.h"
+#include "connectionpool.h"
 
 class AppModel;
+class QThread;
 class BlockTimeSettingsModel;
+class CompiledSchedule;
 struct REG_Week;
 
-class Database
+// One entry of a bulk write: upsert the app as blocked, or deactivate it.
+// Also used for the rows reported by Database::blockedAppsChanged().
+struct BlockedAppChange
+{
+    QString appPath;
+    QString appName;
+    RuleType ruleType = RuleType::Exact;
+    bool blocked = true;
+};
+
+Q_DECLARE_METATYPE(BlockedAppChange)
+
+// Stored in the block_events partitions, keep the values stable
+enum class BlockEventKind : int
+{
+    // A blocked app opened a window and got the overlay
+    Launched = 0,
+    // The overlay was closed with the app left running
+    Dismissed = 1,
+    // The app was terminated from the overlay
+    ForceClosed = 2
+};
+
+struct BlockEvent
 {
+    // UTC, ms since the epoch
+    qint64 timestamp = 0;
+    BlockEventKind kind = BlockEventKind::Launched;
+    QString appPath;
+    QString appName;
+};
+
+// One row of a block event report: how often an app hit kind within the
+// bucket that starts at bucketStart (an hour, or a local calendar day)
+struct BlockEventCount
+{
+    QDateTime bucketStart;
+    QString appPath;
+    QString appName;
+    BlockEventKind kind = BlockEventKind::Launched;
+    int count = 0;
+};
+
+// How long block events stay in each tier. Raw rows move from SQLite
+// into archive segments after rawDays; segments are deleted after
+// archiveDays, or kept for good when it is 0.
+struct EventRetention
+{
+    int rawDays = 90;
+    int archiveDays = 0;
+};
+
+struct BlockedAppBatchResult
+{
+    bool success = false;
+    int inserted = 0;
+    int updated = 0;
+    int deactivated = 0;
+    int unchanged = 0;
+    // Revision of the blockedAppsChanged() this batch emitted, 0 if it
+    // wrote nothing
+    quint64 revision = 0;
+};
+
+class Database : public QObject
+{
+    Q_OBJECT
+
 public:
-    Database();
+    explicit Database(QObject *parent = nullptr);
     ~Database();
 
     bool initialize();
+    // Serves the rules and the schedule from the compiled blocklist image.
+    // SQLite stays closed unless the database files changed since the
+    // image was written, and then only reads the content revision. Fails
+    // if the image is missing, damaged or older than the database;
+    // initialize() is the fallback. Nothing else may be queried until
+    // reloadIfChanged() or initialize() opens SQLite.
+    bool initializeFromImage();
     bool isInitialized() const;
+    QString databasePath() const;
     
-    bool addBlockedApp(const QString& appPath, const QString& appName);
+    bool addBlockedApp(const QString& appPath, const QString& appName, RuleType ruleType = RuleType::Exact);
     bool removeBlockedApp(const QString& appPath);
+    // Applies every change in one transaction; nothing is written if any fails
+    BlockedAppBatchResult applyBlockedAppBatch(const QList<BlockedAppChange>& changes);
     bool isAppBlocked(const QString& appPath) const;
-    QList<std::shared_ptr<AppModel>> getBlockedApps() const;
+    std::shared_ptr<const RuleMatcher> blockRules() const;
+    QList<std::shared_ptr<AppModel>> getBlockedApps(bool activeOnly = false) const;
+    // Every row, without building an AppModel (and loading an icon) for each
+    QList<BlockedAppChange> getBlockedAppEntries(bool activeOnly = false) const;
+    bool reloadIfChanged();
+    quint64 blockedAppsRevision() const;
 
     std::shared_ptr<BlockTimeSettingsModel> getBlockTimeSettings() const;
     bool updateBlockTimeSettings(const std::shared_ptr<BlockTimeSettingsModel>& settings);
     bool isBlockingActive() const;
     bool isBlockingNow() const;
+    bool isBlockingAt(const QDateTime& localTime) const;
+    QDateTime nextScheduleTransition(const QDateTime& localTime) const;
+
+    // Appends the events in one transaction, each to the monthly
+    // block_events_YYYYMM partition of its timestamp, and adds them to
+    // the hourly and daily rollups in the same transaction
+    bool appendBlockEvents(const QList<BlockEvent>& events);
+    // Reports read only the rollups, so they cost one row per bucket, app
+    // and kind however much history there is. Both ends are inclusive.
+    QList<BlockEventCount> getHourlyBlockEventCounts(const QDateTime& from, const QDateTime& to) const;
+    QList<BlockEventCount> getDailyBlockEventCounts(const QDate& from, const QDate& to) const;
+    // Moves raw partitions past the retention into archive segments and
+    // drops hourly rollups past theirs; the daily rollups already hold
+    // the counts and are kept
+    bool compactBlockEvents(const QDateTime& now);
+    EventRetention getEventRetention() const;
+    bool updateEventRetention(const EventRetention& retention);
+    // Directory of the monthly archive segments, see EventArchive
+    QString eventArchivePath() const;
+
+    // Counts (and logs) every use of SQLite from the given thread, which
+    // is expected to stay off it, e.g. the GUI thread once AsyncDatabase
+    // is in place. Schedule and rule checks never touch SQLite.
+    void setGuardedThread(QThread* thread);
+    quint64 guardedThreadQueries() const;
+
+    // Pragmas every connection to the database file is opened with
+    static bool applyConnectionProfile(QSqlDatabase& db);
+
+signals:
+    // Every change gets the next revision from one counter. A consumer
+    // that mirrors the blocked apps applies a change only on top of the
+    // revision it last saw (baseRevision) and reloads otherwise.
+    //
+    // Rows written on this Database. A rule type change is reported as a
+    // deactivation followed by the new row; a deactivation may carry an
+    // empty appName.
+    void blockedAppsChanged(quint64 baseRevision, quint64 revision, const QList<BlockedAppChange>& changes);
+    // Rows changed through another connection, e.g. the other process.
+    // Which rows is unknown, so mirrors have to reload.
+    void blockedAppsReloaded(quint64 revision);
+    void scheduleChanged(quint64 revision);
 
 private:
+    void checkGuardedThread() const;
+    QSqlDatabase connection() const;
+    QSqlQuery& statement(const QString& sql) const;
     bool createTables();
+    bool migrateSchema();
+    static bool migrateToPathKeys(QSqlQuery& query);
+    static bool migrateToBlockEventRollups(QSqlQuery& query);
+    bool rebuildBlockedAppIndex(bool* changed = nullptr);
+    quint64 publishBlockRules();
+    void reloadSchedule();
+    bool loadImage(bool* changed = nullptr);
+    void writeImage(quint64 contentRevision);
+    bool bumpContentRevision(quint64* revision);
+    bool readContentRevision(quint64* revision) const;
+    static QString blockEventPartition(qint64 timestamp);
+    bool archiveBlockEventPartition(const QString& handOff);
+    void finishArchiveHandOffs(const QSet<QString>& handOffs);
+    static bool installPendingSegment(const QString& path);
+    QList<BlockEventCount> getBlockEventCounts(bool hourly, qint64 from, qint64 to) const;
     
-    QSqlDatabase m_db;
+    // One connection and statement cache per thread
+    ConnectionPool m_connections;
+    std::atomic<QThread*> m_guardedThread;
+    mutable std::atomic<quint64> m_guardedThreadQueries;
     bool m_initialized;
     QString m_dbPath;
+
+    // Normalized pattern and type of every active rule, compiled into
+    // m_blockRules whenever it changes. Guarded by m_indexLock.
+    mutable QReadWriteLock m_indexLock;
+    QHash<PathKey, RuleType> m_blockedAppIndex;
+    // Swapped atomically, keeps isAppBlocked() off SQLite and lock free
+    // on the monitor hot path
+    std::shared_ptr<const RuleMatcher> m_blockRules;
+    // Revision of the last change to the active rules
+    quint64 m_blockedAppsRevision;
+    std::atomic<quint64> m_revision;
+    // Last PRAGMA data_version seen per connection name
+    QHash<QString, qint64> m_dataVersions;
+
+    // Swapped atomically whenever the settings row changes, so
+    // isBlockingActive()/isBlockingNow() never query SQLite
+    std::shared_ptr<const CompiledSchedule> m_schedule;
+
+    // Set while the rules come from the blocklist image rather than
+    // SQLite, with the database stamp that image was last found current at
+    bool m_imageBacked;
+    qint64 m_imageStamp;
+    // Keeps writers on different threads from interleaving image updates
+    QMutex m_imageLock;
+
+    // Partitions known to exist and event_apps ids by path, only updated
+    // once the transaction that created them committed. Guarded by
+    // m_eventLock, which also keeps appends one at a time.
+    QMutex m_eventLock;
+    QSet<QString> m_eventPartitions;
+    QHash<PathKey, qint64> m_eventAppIds;
 };
 
 #endif // DATABASE_H 
\ No newline at end of file
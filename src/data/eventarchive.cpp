@@ -0,0 +1,266 @@
+#include "eventarchive.h"
+
+#include <QDir>
+#include <QHash>
+#include <QSaveFile>
+#include <limits>
+
+namespace {
+
+const quint32 kMagic = 0x41454346; // "FCEA"
+const quint32 kFormatVersion = 1;
+
+struct SegmentHeader
+{
+    quint32 magic;
+    quint32 formatVersion;
+    qint64 eventCount;
+    quint32 appCount;
+    quint32 blockCount;
+    // Compressed size of the dictionary that follows the header
+    quint32 dictionarySize;
+    quint32 reserved;
+};
+
+struct BlockHeader
+{
+    qint64 firstTimestamp;
+    qint64 lastTimestamp;
+    quint32 eventCount;
+    quint32 compressedSize;
+};
+
+void appendVarint(QByteArray& out, quint64 value)
+{
+    while (value >= 0x80) {
+        out.append(static_cast<char>(value | 0x80));
+        value >>= 7;
+    }
+    out.append(static_cast<char>(value));
+}
+
+bool readVarint(const uchar*& cursor, const uchar* end, quint64& value)
+{
+    value = 0;
+    for (int shift = 0; shift < 64 && cursor < end; shift += 7) {
+        const uchar byte = *cursor++;
+        value |= static_cast<quint64>(byte & 0x7F) << shift;
+        if (!(byte & 0x80))
+            return true;
+    }
+    return false;
+}
+
+void appendString(QByteArray& out, const QString& value)
+{
+    const QByteArray utf8 = value.toUtf8();
+    appendVarint(out, utf8.size());
+    out.append(utf8);
+}
+
+bool readString(const uchar*& cursor, const uchar* end, QString& value)
+{
+    quint64 size = 0;
+    if (!readVarint(cursor, end, size) || size > static_cast<quint64>(end - cursor))
+        return false;
+    value = QString::fromUtf8(reinterpret_cast<const char*>(cursor), static_cast<qsizetype>(size));
+    cursor += size;
+    return true;
+}
+
+} // namespace
+
+QString EventArchive::segmentPath(const QString& directory, const QDate& month)
+{
+    return QDir(directory).filePath(month.toString("'block_events_'yyyyMM'.fea'"));
+}
+
+bool EventArchive::write(const QString& path, const QList<BlockEvent>& events)
+{
+    QHash<PathKey, quint32> appIndexes;
+    QByteArray dictionary;
+    QByteArray blocks;
+    quint32 blockCount = 0;
+
+    for (qsizetype start = 0; start < events.size(); start += kBlockSize) {
+        const qsizetype end = qMin<qsizetype>(start + kBlockSize, events.size());
+
+        QByteArray body;
+        body.reserve((end - start) * 4);
+        qint64 previous = events[start].timestamp;
+        for (qsizetype i = start; i < end; ++i) {
+            const BlockEvent& event = events[i];
+            if (event.timestamp < previous)
+                return false;
+
+            const PathKey key(event.appPath);
+            auto index = appIndexes.constFind(key);
+            if (index == appIndexes.cend()) {
+                index = appIndexes.insert(key, static_cast<quint32>(appIndexes.size()));
+                appendString(dictionary, event.appPath);
+                appendString(dictionary, event.appName);
+            }
+
+            appendVarint(body, static_cast<quint64>(event.timestamp - previous));
+            appendVarint(body, (static_cast<quint64>(index.value()) << 2) | static_cast<quint64>(event.kind));
+            previous = event.timestamp;
+        }
+
+        const QByteArray compressed = qCompress(body);
+        BlockHeader header{events[start].timestamp, events[end - 1].timestamp,
+                           static_cast<quint32>(end - start), static_cast<quint32>(compressed.size())};
+        blocks.append(reinterpret_cast<const char*>(&header), sizeof(header));
+        blocks.append(compressed);
+        ++blockCount;
+    }
+
+    const QByteArray compressedDictionary = qCompress(dictionary);
+
+    SegmentHeader header{};
+    header.magic = kMagic;
+    header.formatVersion = kFormatVersion;
+    header.eventCount = events.size();
+    header.appCount = static_cast<quint32>(appIndexes.size());
+    header.blockCount = blockCount;
+    header.dictionarySize = static_cast<quint32>(compressedDictionary.size());
+
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(compressedDictionary);
+    file.write(blocks);
+    return file.commit();
+}
+
+EventArchiveReader::EventArchiveReader()
+    : m_eventCount(0),
+      m_blocksLeft(0),
+      m_from(std::numeric_limits<qint64>::min()),
+      m_to(std::numeric_limits<qint64>::max()),
+      m_error(false),
+      m_cursor(nullptr),
+      m_end(nullptr),
+      m_eventsLeft(0),
+      m_timestamp(0)
+{
+}
+
+bool EventArchiveReader::open(const QString& path)
+{
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::ReadOnly))
+        return fail();
+
+    SegmentHeader header;
+    if (m_file.read(reinterpret_cast<char*>(&header), sizeof(header)) != sizeof(header)
+        || header.magic != kMagic
+        || header.formatVersion != kFormatVersion)
+    {
+        return fail();
+    }
+
+    const QByteArray dictionary = qUncompress(m_file.read(header.dictionarySize));
+    const uchar* cursor = reinterpret_cast<const uchar*>(dictionary.constData());
+    const uchar* end = cursor + dictionary.size();
+    m_apps.reserve(header.appCount);
+    for (quint32 i = 0; i < header.appCount; ++i) {
+        ArchivedApp app;
+        if (!readString(cursor, end, app.appPath) || !readString(cursor, end, app.appName))
+            return fail();
+        m_apps.append(app);
+    }
+
+    m_eventCount = header.eventCount;
+    m_blocksLeft = header.blockCount;
+    return true;
+}
+
+void EventArchiveReader::setRange(qint64 from, qint64 to)
+{
+    m_from = from;
+    m_to = to;
+}
+
+bool EventArchiveReader::next(BlockEvent& event)
+{
+    for (;;) {
+        while (m_eventsLeft == 0) {
+            if (m_blocksLeft == 0 || !readBlock())
+                return false;
+        }
+
+        quint64 delta = 0;
+        quint64 code = 0;
+        if (!readVarint(m_cursor, m_end, delta) || !readVarint(m_cursor, m_end, code)
+            || (code >> 2) >= static_cast<quint64>(m_apps.size()))
+        {
+            return fail();
+        }
+        m_timestamp += static_cast<qint64>(delta);
+        --m_eventsLeft;
+
+        if (m_timestamp < m_from)
+            continue;
+        if (m_timestamp > m_to) {
+            // Events are in time order, nothing later can match
+            m_eventsLeft = 0;
+            m_blocksLeft = 0;
+            return false;
+        }
+
+        const ArchivedApp& app = m_apps[static_cast<qsizetype>(code >> 2)];
+        event.timestamp = m_timestamp;
+        event.kind = static_cast<BlockEventKind>(code & 3);
+        event.appPath = app.appPath;
+        event.appName = app.appName;
+        return true;
+    }
+}
+
+bool EventArchiveReader::hasError() const
+{
+    return m_error;
+}
+
+qint64 EventArchiveReader::eventCount() const
+{
+    return m_eventCount;
+}
+
+bool EventArchiveReader::readBlock()
+{
+    BlockHeader header;
+    if (m_file.read(reinterpret_cast<char*>(&header), sizeof(header)) != sizeof(header))
+        return fail();
+    --m_blocksLeft;
+
+    // Blocks outside the range are never decompressed
+    if (header.lastTimestamp < m_from) {
+        if (m_file.skip(header.compressedSize) != static_cast<qint64>(header.compressedSize))
+            return fail();
+        return true;
+    }
+    if (header.firstTimestamp > m_to) {
+        m_blocksLeft = 0;
+        return false;
+    }
+
+    m_block = qUncompress(m_file.read(header.compressedSize));
+    if (m_block.isEmpty())
+        return fail();
+
+    m_cursor = reinterpret_cast<const uchar*>(m_block.constData());
+    m_end = m_cursor + m_block.size();
+    m_eventsLeft = header.eventCount;
+    m_timestamp = header.firstTimestamp;
+    return true;
+}
+
+bool EventArchiveReader::fail()
+{
+    m_error = true;
+    m_eventsLeft = 0;
+    m_blocksLeft = 0;
+    return false;
+}
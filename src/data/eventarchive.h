@@ -0,0 +1,75 @@
+#ifndef EVENTARCHIVE_H
+#define EVENTARCHIVE_H
+
+#include <QString>
+#include <QList>
+#include <QFile>
+#include <QByteArray>
+#include <QDate>
+
+#include "database.h"
+
+// Long-term storage for block events that aged out of SQLite. One segment
+// file per month, next to the database in an "archive" directory.
+//
+// A segment starts with a header and a compressed dictionary of the apps
+// it mentions, followed by blocks of up to kBlockSize events in time
+// order. Each block header carries its first and last timestamp, so a
+// range scan skips whole blocks without decompressing them. Inside a
+// block every event is two varints: the delta to the previous timestamp,
+// and the app's dictionary index shifted left by two with the kind in
+// the low bits. The block body is then zlib compressed.
+class EventArchive
+{
+public:
+    static constexpr int kBlockSize = 4096;
+
+    static QString segmentPath(const QString& directory, const QDate& month);
+
+    // events must be sorted by timestamp. Replaces the segment atomically.
+    static bool write(const QString& path, const QList<BlockEvent>& events);
+};
+
+// Streams the events of one segment without holding more than one block
+// in memory
+class EventArchiveReader
+{
+public:
+    EventArchiveReader();
+
+    bool open(const QString& path);
+    // Only events with from <= timestamp <= to are returned
+    void setRange(qint64 from, qint64 to);
+    // False at the end of the segment or on a damaged one, see hasError()
+    bool next(BlockEvent& event);
+
+    bool hasError() const;
+    qint64 eventCount() const;
+
+private:
+    struct ArchivedApp
+    {
+        QString appPath;
+        QString appName;
+    };
+
+    bool readBlock();
+    bool fail();
+
+    QFile m_file;
+    QList<ArchivedApp> m_apps;
+    qint64 m_eventCount;
+    quint32 m_blocksLeft;
+    qint64 m_from;
+    qint64 m_to;
+    bool m_error;
+
+    // Decompressed body of the current block and the decoder's position
+    QByteArray m_block;
+    const uchar* m_cursor;
+    const uchar* m_end;
+    quint32 m_eventsLeft;
+    qint64 m_timestamp;
+};
+
+#endif // EVENTARCHIVE_H
@@ -0,0 +1,249 @@
+#include "pathkey.h"
+
+#include <QDir>
+#include <QHash>
+#include <QReadWriteLock>
+#include <QReadLocker>
+#include <QWriteLocker>
+#include <QVarLengthArray>
+
+static const quint64 kFnvOffset = 14695981039346656037ULL;
+static const quint64 kFnvPrime = 1099511628211ULL;
+
+// Chained by hash; entries unlink themselves when their last key goes
+struct PathKey::Table
+{
+    QReadWriteLock lock;
+    QHash<quint64, Entry*> heads;
+    int count = 0;
+};
+
+PathKey::Table& PathKey::table()
+{
+    // Never destroyed, so keys held in other statics can outlive it
+    static Table* table = new Table();
+    return *table;
+}
+
+static quint64 hashKey(QStringView key)
+{
+    quint64 hash = kFnvOffset;
+    for (QChar ch : key)
+        hash = (hash ^ ch.unicode()) * kFnvPrime;
+    return hash;
+}
+
+// Folds plain ASCII paths that QDir::cleanPath() would leave untouched
+// without allocating. Anything else (non-ASCII, "//", "." or ".."
+// segments, a trailing separator) is left to the full normalization.
+static bool foldAsciiPath(QStringView path, QVarLengthArray<char16_t, 260>& folded, quint64& hash)
+{
+    folded.resize(path.size());
+    hash = kFnvOffset;
+
+    char16_t previous = u'/';
+    for (qsizetype i = 0; i < path.size(); ++i) {
+        char16_t ch = path[i].unicode();
+        if (ch >= 0x80)
+            return false;
+
+        if (ch == u'\\')
+            ch = u'/';
+        else if (ch >= u'A' && ch <= u'Z')
+            ch += u'a' - u'A';
+
+        if (ch == u'/' && previous == u'/' && i > 0)
+            return false;
+
+        if (ch == u'.' && previous == u'/') {
+            char16_t next = i + 1 < path.size() ? path[i + 1].unicode() : u'/';
+            if (next == u'/' || next == u'\\' || next == u'.')
+                return false;
+        }
+
+        folded[i] = ch;
+        hash = (hash ^ ch) * kFnvPrime;
+        previous = ch;
+    }
+
+    return path.size() <= 1 || previous != u'/';
+}
+
+PathKey::PathKey()
+    : m_entry(emptyEntry())
+{
+}
+
+PathKey::PathKey(QStringView path)
+    : m_entry(emptyEntry())
+{
+    if (path.isEmpty())
+        return;
+
+    QVarLengthArray<char16_t, 260> folded;
+    quint64 hash = 0;
+    if (foldAsciiPath(path, folded, hash)) {
+        m_entry = intern(QStringView(folded.constData(), folded.size()), hash);
+        return;
+    }
+
+    QString key = normalized(path).toCaseFolded();
+    if (!key.isEmpty())
+        m_entry = intern(key, hashKey(key));
+}
+
+PathKey::PathKey(const QString& path)
+    : PathKey(QStringView(path))
+{
+}
+
+PathKey::PathKey(const PathKey& other)
+    : m_entry(other.m_entry)
+{
+    retain(m_entry);
+}
+
+PathKey::PathKey(PathKey&& other) noexcept
+    : m_entry(other.m_entry)
+{
+    other.m_entry = emptyEntry();
+}
+
+PathKey::~PathKey()
+{
+    release(m_entry);
+}
+
+PathKey& PathKey::operator=(const PathKey& other)
+{
+    if (m_entry != other.m_entry) {
+        retain(other.m_entry);
+        release(m_entry);
+        m_entry = other.m_entry;
+    }
+    return *this;
+}
+
+PathKey& PathKey::operator=(PathKey&& other) noexcept
+{
+    if (this != &other) {
+        release(m_entry);
+        m_entry = other.m_entry;
+        other.m_entry = emptyEntry();
+    }
+    return *this;
+}
+
+QString PathKey::normalized(QStringView path)
+{
+    // Registry values and user input use '\', which is no separator to
+    // cleanPath() outside Windows, so it is replaced first
+    return QDir::cleanPath(path.toString().replace(u'\\', u'/'));
+}
+
+int PathKey::internedCount()
+{
+    Table& table = PathKey::table();
+    QReadLocker locker(&table.lock);
+    return table.count;
+}
+
+bool PathKey::isEmpty() const
+{
+    return m_entry->key.isEmpty();
+}
+
+QStringView PathKey::view() const
+{
+    return m_entry->key;
+}
+
+const QString& PathKey::toString() const
+{
+    return m_entry->key;
+}
+
+quint64 PathKey::hash() const
+{
+    return m_entry->hash;
+}
+
+PathKey::Entry* PathKey::emptyEntry()
+{
+    static Entry entry{QString(), kFnvOffset, nullptr, {0}};
+    return &entry;
+}
+
+PathKey::Entry* PathKey::intern(QStringView key, quint64 hash)
+{
+    Table& table = PathKey::table();
+
+    // A reference taken under the read lock keeps the entry alive: it is
+    // only unlinked under the write lock, and only once it has none
+    {
+        QReadLocker locker(&table.lock);
+        for (Entry* entry = table.heads.value(hash); entry; entry = entry->next) {
+            if (entry->key == key) {
+                entry->refs.fetch_add(1, std::memory_order_relaxed);
+                return entry;
+            }
+        }
+    }
+
+    QWriteLocker locker(&table.lock);
+    Entry* head = table.heads.value(hash);
+    for (Entry* entry = head; entry; entry = entry->next) {
+        if (entry->key == key) {
+            entry->refs.fetch_add(1, std::memory_order_relaxed);
+            return entry;
+        }
+    }
+
+    Entry* entry = new Entry{key.toString(), hash, head, {1}};
+    table.heads.insert(hash, entry);
+    ++table.count;
+    return entry;
+}
+
+void PathKey::retain(Entry* entry)
+{
+    if (entry != emptyEntry())
+        entry->refs.fetch_add(1, std::memory_order_relaxed);
+}
+
+void PathKey::release(Entry* entry)
+{
+    if (entry == emptyEntry())
+        return;
+
+    const quint64 hash = entry->hash;
+    if (entry->refs.fetch_sub(1, std::memory_order_acq_rel) != 1)
+        return;
+
+    // Until the lock is held another key may pick the entry up again, or
+    // a release racing with this one may already have freed it, so it is
+    // looked up by address before anything is read from it
+    Table& table = PathKey::table();
+    QWriteLocker locker(&table.lock);
+    auto head = table.heads.find(hash);
+    if (head == table.heads.end())
+        return;
+
+    Entry* previous = nullptr;
+    Entry* current = head.value();
+    while (current && current != entry) {
+        previous = current;
+        current = current->next;
+    }
+    if (!current || current->refs.load(std::memory_order_acquire) != 0)
+        return;
+
+    if (previous)
+        previous->next = current->next;
+    else if (current->next)
+        head.value() = current->next;
+    else
+        table.heads.erase(head);
+    --table.count;
+    delete current;
+}
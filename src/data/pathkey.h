@@ -0,0 +1,68 @@
+#ifndef PATHKEY_H
+#define PATHKEY_H
+
+#include <QString>
+#include <QStringView>
+#include <QtGlobal>
+#include <atomic>
+
+// Normalized, case-folded file path, interned in a process-wide table.
+// Two keys for the same path share one entry, so comparing them is a
+// pointer compare and hashing reads a precomputed value. Building a key
+// for a path that is still held elsewhere does not allocate. Entries are
+// reference counted and leave the table with the last key that uses them.
+class PathKey
+{
+public:
+    PathKey();
+    explicit PathKey(QStringView path);
+    explicit PathKey(const QString& path);
+    PathKey(const PathKey& other);
+    PathKey(PathKey&& other) noexcept;
+    ~PathKey();
+
+    PathKey& operator=(const PathKey& other);
+    PathKey& operator=(PathKey&& other) noexcept;
+
+    // The one spelling used for paths shown and stored: '/' separators,
+    // no "." or ".." segments, case kept
+    static QString normalized(QStringView path);
+
+    // Distinct paths currently interned
+    static int internedCount();
+
+    bool isEmpty() const;
+    QStringView view() const;
+    const QString& toString() const;
+    quint64 hash() const;
+
+    bool operator==(const PathKey& other) const { return m_entry == other.m_entry; }
+    bool operator!=(const PathKey& other) const { return m_entry != other.m_entry; }
+
+private:
+    struct Entry
+    {
+        QString key;
+        quint64 hash;
+        // Next entry whose hash falls into the same table slot
+        Entry* next;
+        std::atomic<int> refs;
+    };
+
+    struct Table;
+
+    static Table& table();
+    static Entry* emptyEntry();
+    static Entry* intern(QStringView key, quint64 hash);
+    static void retain(Entry* entry);
+    static void release(Entry* entry);
+
+    Entry* m_entry;
+};
+
+inline size_t qHash(const PathKey& key, size_t seed = 0) noexcept
+{
+    return static_cast<size_t>(key.hash()) ^ seed;
+}
+
+#endif // PATHKEY_H
@@ -0,0 +1,217 @@
+#include "rulematcher.h"
+
+static int firstWildcard(QStringView pattern)
+{
+    for (int i = 0; i < pattern.size(); ++i) {
+        if (pattern[i] == u'*' || pattern[i] == u'?')
+            return i;
+    }
+    return -1;
+}
+
+static int lastWildcard(QStringView pattern)
+{
+    for (int i = pattern.size() - 1; i >= 0; --i) {
+        if (pattern[i] == u'*' || pattern[i] == u'?')
+            return i;
+    }
+    return -1;
+}
+
+RuleMatcher::RuleMatcher()
+    : m_forward(1),
+      m_reverse(1),
+      m_ruleCount(0)
+{
+}
+
+RuleMatcher::RuleMatcher(const QList<BlockRule>& rules)
+    : RuleMatcher()
+{
+    for (const BlockRule& rule : rules)
+        addRule(rule);
+}
+
+bool RuleMatcher::isEmpty() const
+{
+    return m_ruleCount == 0;
+}
+
+bool RuleMatcher::matches(const QString& path) const
+{
+    if (m_ruleCount == 0 || path.isEmpty())
+        return false;
+
+    return matches(PathKey(path));
+}
+
+bool RuleMatcher::matches(const PathKey& path) const
+{
+    if (m_ruleCount == 0 || path.isEmpty())
+        return false;
+
+    QStringView key = path.view();
+    if (matchForward(key) || matchReverse(key))
+        return true;
+
+    for (int glob : m_floatingGlobs) {
+        if (globMatch(m_globs[glob], key))
+            return true;
+    }
+    return false;
+}
+
+void RuleMatcher::addRule(const BlockRule& rule)
+{
+    QString pattern = PathKey(rule.pattern).toString();
+    if (pattern.isEmpty())
+        return;
+
+    ++m_ruleCount;
+
+    if (rule.type == RuleType::Prefix) {
+        // "C:/" and "C:" both mean the whole drive; the match below
+        // requires a '/' or the end of the path after the prefix
+        while (pattern.endsWith(u'/'))
+            pattern.chop(1);
+        int node = insert(m_forward, m_forwardEdges, pattern, false);
+        m_forward[node].directory = true;
+        return;
+    }
+
+    int first = rule.type == RuleType::Glob ? firstWildcard(pattern) : -1;
+    if (first < 0) {
+        int node = insert(m_forward, m_forwardEdges, pattern, false);
+        m_forward[node].terminal = true;
+        return;
+    }
+
+    if (first > 0) {
+        int glob = m_globs.size();
+        m_globs.append(pattern);
+        int node = insert(m_forward, m_forwardEdges, QStringView(pattern).left(first), false);
+        m_forward[node].globs.append(glob);
+        return;
+    }
+
+    int last = lastWildcard(pattern);
+    QStringView tail = QStringView(pattern).mid(last + 1);
+
+    // "*tail" needs nothing beyond the reverse walk itself
+    if (last == 0 && pattern[0] == u'*') {
+        int node = insert(m_reverse, m_reverseEdges, tail, true);
+        m_reverse[node].terminal = true;
+        return;
+    }
+
+    int glob = m_globs.size();
+    m_globs.append(pattern);
+    if (tail.isEmpty()) {
+        m_floatingGlobs.append(glob);
+        return;
+    }
+
+    int node = insert(m_reverse, m_reverseEdges, tail, true);
+    m_reverse[node].globs.append(glob);
+}
+
+int RuleMatcher::insert(QVector<Node>& nodes, QHash<quint64, int>& edges, QStringView literal, bool reversed)
+{
+    int node = 0;
+    for (int i = 0; i < literal.size(); ++i) {
+        QChar ch = reversed ? literal[literal.size() - 1 - i] : literal[i];
+        auto edge = edges.find(edgeKey(node, ch));
+        if (edge != edges.end()) {
+            node = edge.value();
+            continue;
+        }
+
+        int child = nodes.size();
+        nodes.append(Node());
+        edges.insert(edgeKey(node, ch), child);
+        node = child;
+    }
+    return node;
+}
+
+quint64 RuleMatcher::edgeKey(int node, QChar ch)
+{
+    return (static_cast<quint64>(node) << 16) | ch.unicode();
+}
+
+bool RuleMatcher::globMatch(QStringView pattern, QStringView text)
+{
+    // Greedy match that backtracks only to the most recent '*', which is
+    // enough since '*' also crosses '/'
+    qsizetype p = 0;
+    qsizetype t = 0;
+    qsizetype star = -1;
+    qsizetype resume = 0;
+
+    while (t < text.size()) {
+        if (p < pattern.size() && (pattern[p] == u'?' || pattern[p] == text[t])) {
+            ++p;
+            ++t;
+        } else if (p < pattern.size() && pattern[p] == u'*') {
+            star = p++;
+            resume = t;
+        } else if (star >= 0) {
+            p = star + 1;
+            t = ++resume;
+        } else {
+            return false;
+        }
+    }
+
+    while (p < pattern.size() && pattern[p] == u'*')
+        ++p;
+    return p == pattern.size();
+}
+
+bool RuleMatcher::matchForward(QStringView key) const
+{
+    int node = 0;
+    for (qsizetype i = 0; ; ++i) {
+        const Node& current = m_forward[node];
+
+        if (current.directory && (i == key.size() || key[i] == u'/'))
+            return true;
+
+        for (int glob : current.globs) {
+            if (globMatch(QStringView(m_globs[glob]).mid(i), key.mid(i)))
+                return true;
+        }
+
+        if (i == key.size())
+            return current.terminal;
+
+        auto edge = m_forwardEdges.constFind(edgeKey(node, key[i]));
+        if (edge == m_forwardEdges.cend())
+            return false;
+        node = edge.value();
+    }
+}
+
+bool RuleMatcher::matchReverse(QStringView key) const
+{
+    int node = 0;
+    for (qsizetype i = 0; ; ++i) {
+        const Node& current = m_reverse[node];
+
+        if (current.terminal)
+            return true;
+
+        for (int glob : current.globs) {
+            if (globMatch(QStringView(m_globs[glob]).chopped(i), key.chopped(i)))
+                return true;
+        }
+
+        if (i == key.size())
+            return false;
+
+        auto edge = m_reverseEdges.constFind(edgeKey(node, key[key.size() - 1 - i]));
+        if (edge == m_reverseEdges.cend())
+            return false;
+        node = edge.value();
+    }
+}
@@ -0,0 +1,73 @@
+#ifndef RULEMATCHER_H
+#define RULEMATCHER_H
+
+#include <QString>
+#include <QStringView>
+#include <QList>
+#include <QVector>
+#include <QHash>
+
+#include "pathkey.h"
+
+// Stored in blocked_apps.ruleType, keep the values stable
+enum class RuleType : int
+{
+    Exact = 0,
+    // The path itself or anything below it, e.g. C:/Games
+    Prefix = 1,
+    // '*' matches any run of characters, including '/', '?' matches one
+    Glob = 2
+};
+
+struct BlockRule
+{
+    QString pattern;
+    RuleType type;
+};
+
+// Immutable, compiled set of block rules. Exact and prefix rules, and
+// globs with a literal head, share a case-folded path trie walked once
+// from the front. Globs that start with a wildcard are anchored on their
+// literal tail in a trie of reversed tails, walked once from the back.
+// Only globs with no literal anchor at either end are tried one by one.
+class RuleMatcher
+{
+public:
+    RuleMatcher();
+    explicit RuleMatcher(const QList<BlockRule>& rules);
+
+    bool isEmpty() const;
+    bool matches(const QString& path) const;
+    bool matches(const PathKey& key) const;
+
+private:
+    struct Node
+    {
+        // Forward trie: an exact rule ends here. Reverse trie: a "*tail"
+        // rule ends here.
+        bool terminal = false;
+        // Forward trie only: a prefix rule ends here
+        bool directory = false;
+        // Globs anchored at this node, checked on the unmatched remainder
+        QVector<int> globs;
+    };
+
+    void addRule(const BlockRule& rule);
+    static int insert(QVector<Node>& nodes, QHash<quint64, int>& edges, QStringView literal, bool reversed);
+    static quint64 edgeKey(int node, QChar ch);
+    static bool globMatch(QStringView pattern, QStringView text);
+
+    bool matchForward(QStringView key) const;
+    bool matchReverse(QStringView key) const;
+
+    QVector<Node> m_forward;
+    QHash<quint64, int> m_forwardEdges;
+    QVector<Node> m_reverse;
+    QHash<quint64, int> m_reverseEdges;
+
+    QVector<QString> m_globs;
+    QVector<int> m_floatingGlobs;
+    int m_ruleCount;
+};
+
+#endif // RULEMATCHER_H
@@ -0,0 +1,133 @@
+#ifndef WEEKSCHEDULE_H
+#define WEEKSCHEDULE_H
+
+#include <QtGlobal>
+
+// One bit per minute of the week, Monday 00:00 = minute 0. Any number of
+// intervals compile into the same 158-word bitmap, and both lookups below
+// are bounded word scans, independent of how many intervals were added.
+class WeekSchedule
+{
+public:
+    static constexpr int MinutesPerDay = 24 * 60;
+    static constexpr int MinutesPerWeek = 7 * MinutesPerDay;
+    static constexpr int WordCount = (MinutesPerWeek + 63) / 64;
+
+    constexpr WeekSchedule() : m_words{} {}
+
+    // dayOfWeek follows QDate::dayOfWeek(): 1 = Monday ... 7 = Sunday
+    static constexpr int minuteOfWeek(int dayOfWeek, int minuteOfDay)
+    {
+        return (dayOfWeek - 1) * MinutesPerDay + minuteOfDay;
+    }
+
+    // Marks [startMinute, endMinute) of the week as blocked, wrapping past
+    // Sunday midnight when endMinute <= startMinute
+    constexpr void addRange(int startMinute, int endMinute)
+    {
+        startMinute = normalize(startMinute);
+        endMinute = normalize(endMinute);
+        if (endMinute <= startMinute) {
+            setBits(startMinute, MinutesPerWeek);
+            setBits(0, endMinute);
+        } else {
+            setBits(startMinute, endMinute);
+        }
+    }
+
+    // Raw bitmap, WordCount words, for storing a compiled schedule as is
+    const quint64* words() const { return m_words; }
+
+    static WeekSchedule fromWords(const quint64* words)
+    {
+        WeekSchedule week;
+        for (int i = 0; i < WordCount; ++i)
+            week.m_words[i] = words[i];
+        return week;
+    }
+
+    constexpr bool isEmpty() const
+    {
+        for (int i = 0; i < WordCount; ++i) {
+            if (m_words[i])
+                return false;
+        }
+        return true;
+    }
+
+    constexpr bool isBlockedAt(int minute) const
+    {
+        minute = normalize(minute);
+        return (m_words[minute / 64] >> (minute % 64)) & 1u;
+    }
+
+    // First minute after `minute` whose state differs from the state at
+    // `minute`, wrapping around the week. -1 if the state never changes.
+    constexpr int nextTransition(int minute) const
+    {
+        minute = normalize(minute);
+        const bool blocked = isBlockedAt(minute);
+
+        int found = findState(!blocked, minute + 1, MinutesPerWeek);
+        if (found < 0)
+            found = findState(!blocked, 0, minute + 1);
+        return found;
+    }
+
+private:
+    static constexpr int normalize(int minute)
+    {
+        minute %= MinutesPerWeek;
+        return minute < 0 ? minute + MinutesPerWeek : minute;
+    }
+
+    static constexpr quint64 bitsFrom(int bit)
+    {
+        return bit >= 64 ? 0 : ~quint64(0) << bit;
+    }
+
+    static constexpr int lowestSetBit(quint64 value)
+    {
+        // De Bruijn multiplication: branch-free and usable in constexpr
+        constexpr quint64 debruijn = 0x03f79d71b4cb0a89ULL;
+        constexpr int table[64] = {
+             0,  1, 48,  2, 57, 49, 28,  3, 61, 58, 50, 42, 38, 29, 17,  4,
+            62, 55, 59, 36, 53, 51, 43, 22, 45, 39, 33, 30, 24, 18, 12,  5,
+            63, 47, 56, 27, 60, 41, 37, 16, 54, 35, 52, 21, 44, 32, 23, 11,
+            46, 26, 40, 15, 34, 20, 31, 10, 25, 14, 19,  9, 13,  8,  7,  6
+        };
+        return table[((value & (~value + 1)) * debruijn) >> 58];
+    }
+
+    constexpr void setBits(int begin, int end)
+    {
+        for (int word = begin / 64; begin < end; ++word) {
+            int wordEnd = (word + 1) * 64;
+            int stop = end < wordEnd ? end : wordEnd;
+            m_words[word] |= bitsFrom(begin % 64) & ~bitsFrom(stop - word * 64);
+            begin = stop;
+        }
+    }
+
+    // First minute in [begin, end) whose bit equals `state`, or -1
+    constexpr int findState(bool state, int begin, int end) const
+    {
+        if (begin >= end)
+            return -1;
+
+        for (int word = begin / 64; word * 64 < end; ++word) {
+            quint64 bits = state ? m_words[word] : ~m_words[word];
+            if (word == begin / 64)
+                bits &= bitsFrom(begin % 64);
+            if (end - word * 64 < 64)
+                bits &= ~bitsFrom(end - word * 64);
+            if (bits)
+                return word * 64 + lowestSetBit(bits);
+        }
+        return -1;
+    }
+
+    quint64 m_words[WordCount];
+};
+
+#endif // WEEKSCHEDULE_H
@@ -59,9 +59,10 @@ int main(int argc, char *argv[])
 
     // Check if running as service
     if (argc > 1 && QString(argv[1]) == "--service") {
-        // Initialize database
+        // Initialize database. The compiled blocklist image is enough to
+        // start enforcing; SQLite is only opened once something changes.
         Database* database = new Database();
-        if (!database->initialize()) {
+        if (!database->initializeFromImage() && !database->initialize()) {
             qDebug() << "Failed to initialize database";
             delete database;
             return 1;
@@ -1,5 +1,5 @@
 #include "apiservice.h"
-#include "../data/appmodel.h"
+#include "../data/asyncdatabase.h"
 #include "../data/blockTimeSettingsModel.h"
 #include <QNetworkRequest>
 #include <QJsonDocument>
@@ -8,6 +8,8 @@
 #include <QDebug>
 #include <QStandardPaths>
 #include <QDir>
+#include <QSet>
+#include <algorithm>
 
 static QString s_logFilePath;
 
@@ -30,11 +32,28 @@ void logToFileAS(const QString& message) {
     }
 }
 
-ApiService::ApiService(Database* database, QObject *parent)
+// Local block/unblock bursts within this window go up as one upload
+static const int kSyncDebounceInterval = 500;
+
+ApiService::ApiService(AsyncDatabase* database, QObject *parent)
     : QObject(parent)
     , m_networkManager(new QNetworkAccessManager(this))
     , m_database(database)
+    , m_blockedAppsRevision(0)
+    , m_blockedAppsLoaded(false)
+    , m_blockedAppsLoading(false)
+    , m_syncAfterLoad(false)
+    , m_syncTimer(this)
+    , m_pendingFetchWrites(0)
 {
+    m_syncTimer.setSingleShot(true);
+    m_syncTimer.setInterval(kSyncDebounceInterval);
+    connect(&m_syncTimer, &QTimer::timeout, this, &ApiService::syncBlockedApps);
+
+    connect(m_database->database(), &Database::blockedAppsChanged, this, &ApiService::onBlockedAppsChanged);
+    connect(m_database->database(), &Database::blockedAppsReloaded, this, [this]() {
+        m_blockedAppsLoaded = false;
+    });
 }
 
 ApiService::~ApiService()
@@ -53,6 +72,17 @@ void ApiService::syncBlockedApps()
         return;
     }
 
+    if (!m_blockedAppsLoaded) {
+        m_syncAfterLoad = true;
+        loadBlockedApps();
+        return;
+    }
+
+    postBlockedApps();
+}
+
+void ApiService::postBlockedApps()
+{
     QNetworkRequest request(QUrl(m_baseUrl + "/blocked-apps/windows"));
     request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
 
@@ -88,16 +118,18 @@ void ApiService::syncTimeSettings()
         return;
     }
 
-    QNetworkRequest request(QUrl(m_baseUrl + "/block-time-settings/windows"));
-    request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
+    m_database->getBlockTimeSettings().then(this, [this](const std::shared_ptr<BlockTimeSettingsModel>& settings) {
+        QNetworkRequest request(QUrl(m_baseUrl + "/block-time-settings/windows"));
+        request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
 
-    QJsonObject settingsJson = timeSettingsToJson();
-    QJsonDocument doc(settingsJson);
-    QByteArray data = doc.toJson();
+        QJsonObject settingsJson = timeSettingsToJson(settings);
+        QJsonDocument doc(settingsJson);
+        QByteArray data = doc.toJson();
 
-    QNetworkReply* reply = m_networkManager->post(request, data);
-    connect(reply, &QNetworkReply::finished, this, [this, reply]() {
-        onTimeSettingsSyncFinished(reply);
+        QNetworkReply* reply = m_networkManager->post(request, data);
+        connect(reply, &QNetworkReply::finished, this, [this, reply]() {
+            onTimeSettingsSyncFinished(reply);
+        });
     });
 }
 
@@ -176,26 +208,88 @@ void ApiService::onTimeSettingsFetchFinished(QNetworkReply* reply)
     }
 }
 
+void ApiService::onBlockedAppsChanged(quint64 baseRevision, quint64 revision, const QList<BlockedAppChange>& changes)
+{
+    // Nothing is applied while a load is in flight: database jobs run in
+    // order, so everything reported before it completes is part of it
+    if (m_blockedAppsLoaded && baseRevision == m_blockedAppsRevision) {
+        for (const BlockedAppChange& change : changes) {
+            PathKey key(change.appPath);
+            auto existing = m_blockedApps.find(key);
+            if (change.blocked) {
+                if (existing == m_blockedApps.end()) {
+                    m_blockedApps.insert(key, change);
+                } else {
+                    // Keep the path as stored
+                    existing->appName = change.appName;
+                    existing->ruleType = change.ruleType;
+                    existing->blocked = true;
+                }
+            } else if (existing != m_blockedApps.end()) {
+                existing->blocked = false;
+            }
+        }
+        m_blockedAppsRevision = revision;
+    } else {
+        m_blockedAppsLoaded = false;
+    }
+
+    // What a fetch wrote came from the server, don't send it back
+    if (m_fetchRevisions.remove(revision))
+        return;
+    if (m_pendingFetchWrites > 0)
+        m_revisionsDuringFetch.append(revision);
+    else
+        m_syncTimer.start();
+}
+
+void ApiService::loadBlockedApps()
+{
+    if (m_blockedAppsLoading)
+        return;
+
+    m_blockedAppsLoading = true;
+    m_database->run([](Database& database) {
+        quint64 revision = database.blockedAppsRevision();
+        return qMakePair(revision, database.getBlockedAppEntries());
+    }).then(this, [this](const QPair<quint64, QList<BlockedAppChange>>& loaded) {
+        m_blockedAppsRevision = loaded.first;
+        m_blockedApps.clear();
+        for (const BlockedAppChange& entry : loaded.second)
+            m_blockedApps.insert(PathKey(entry.appPath), entry);
+        m_blockedAppsLoading = false;
+        m_blockedAppsLoaded = true;
+
+        if (m_syncAfterLoad) {
+            m_syncAfterLoad = false;
+            postBlockedApps();
+        }
+    });
+}
+
 QJsonArray ApiService::blockedAppsToJson() const
 {
-    QJsonArray appsArray;
-    QList<std::shared_ptr<AppModel>> blockedApps = m_database->getBlockedApps();
+    QList<BlockedAppChange> blockedApps = m_blockedApps.values();
+    std::sort(blockedApps.begin(), blockedApps.end(), [](const BlockedAppChange& a, const BlockedAppChange& b) {
+        return a.appName < b.appName;
+    });
 
-    for (const auto& app : blockedApps) {
+    QJsonArray appsArray;
+    for (const BlockedAppChange& app : blockedApps) {
         QJsonObject appObj;
-        appObj["appPath"] = app->getPath();
-        appObj["appName"] = app->getName();
-        appObj["isBlocked"] = app->getActive();
+        appObj["appPath"] = app.appPath;
+        appObj["appName"] = app.appName;
+        appObj["isBlocked"] = app.blocked;
+        appObj["ruleType"] = static_cast<int>(app.ruleType);
         appsArray.append(appObj);
     }
 
     return appsArray;
 }
 
-QJsonObject ApiService::timeSettingsToJson() const
+QJsonObject ApiService::timeSettingsToJson(const std::shared_ptr<BlockTimeSettingsModel>& settings)
 {
     QJsonObject settingsObj;
-    auto settings = m_database->getBlockTimeSettings();
 
     if (settings) {
         settingsObj["startHour"] = settings->getStartTime().hour();
@@ -213,6 +307,18 @@ QJsonObject ApiService::timeSettingsToJson() const
         settingsObj["sunday"] = week.sunday;
         
         settingsObj["isActive"] = settings->getActive();
+
+        QJsonArray intervalsArray;
+        for (const REG_Interval& interval : settings->getIntervals()) {
+            QJsonObject intervalObj;
+            intervalObj["dayOfWeek"] = interval.dayOfWeek;
+            intervalObj["startHour"] = interval.startTime.hour();
+            intervalObj["startMinute"] = interval.startTime.minute();
+            intervalObj["endHour"] = interval.endTime.hour();
+            intervalObj["endMinute"] = interval.endTime.minute();
+            intervalsArray.append(intervalObj);
+        }
+        settingsObj["intervals"] = intervalsArray;
     }
 
     return settingsObj;
@@ -220,11 +326,10 @@ QJsonObject ApiService::timeSettingsToJson() const
 
 void ApiService::processBlockedAppsResponse(const QJsonArray& apps)
 {
-    QList<std::shared_ptr<AppModel>> currentApps = m_database->getBlockedApps();
-    for (const auto& app : currentApps) {
-        m_database->removeBlockedApp(app->getPath());
-    }
-
+    // Compare by PathKey so the same app written with different case or
+    // separators on either side is not removed and re-added
+    QList<BlockedAppChange> changes;
+    QSet<PathKey> fetched;
     for (const QJsonValue& appValue : apps) {
         QJsonObject appObj = appValue.toObject();
         QString path = appObj["appPath"].toString();
@@ -233,11 +338,49 @@ void ApiService::processBlockedAppsResponse(const QJsonArray& apps)
             continue;
 
         int isBlocked = appObj["isBlocked"].toInt();
+        int ruleType = appObj["ruleType"].toInt(static_cast<int>(RuleType::Exact));
+        if (ruleType < static_cast<int>(RuleType::Exact) || ruleType > static_cast<int>(RuleType::Glob))
+            continue;
+
+        PathKey key(path);
+        if (fetched.contains(key))
+            continue;
+
         if (isBlocked == 1)
-            m_database->addBlockedApp(path, name);
-        else
-            m_database->removeBlockedApp(path);
+            fetched.insert(key);
+        changes.append(BlockedAppChange{path, name, static_cast<RuleType>(ruleType), isBlocked == 1});
     }
+
+    // Local rules missing from the server are deactivated; the active set
+    // is read on the database thread in the same job as the write
+    ++m_pendingFetchWrites;
+    m_database->run([changes, fetched](Database& database) mutable {
+        for (const BlockedAppChange& entry : database.getBlockedAppEntries(true)) {
+            if (!fetched.contains(PathKey(entry.appPath)))
+                changes.append(BlockedAppChange{entry.appPath, entry.appName, entry.ruleType, false});
+        }
+        return database.applyBlockedAppBatch(changes);
+    }).then(this, [this](const BlockedAppBatchResult& result) {
+        --m_pendingFetchWrites;
+        if (result.revision != 0 && !m_revisionsDuringFetch.removeOne(result.revision))
+            m_fetchRevisions.insert(result.revision);
+        // Anything else reported meanwhile was a local change
+        if (m_pendingFetchWrites == 0 && !m_revisionsDuringFetch.isEmpty()) {
+            m_revisionsDuringFetch.clear();
+            m_syncTimer.start();
+        }
+
+        if (!result.success) {
+            logToFileAS("Failed to apply fetched blocked apps");
+            return;
+        }
+
+        logToFileAS(QString("Blocked apps synced: %1 added, %2 updated, %3 deactivated, %4 unchanged")
+                        .arg(result.inserted)
+                        .arg(result.updated)
+                        .arg(result.deactivated)
+                        .arg(result.unchanged));
+    });
 }
 
 void ApiService::processTimeSettingsResponse(const QJsonObject& settings)
@@ -258,5 +401,30 @@ void ApiService::processTimeSettingsResponse(const QJsonObject& settings)
     bool isActive = settings["isActive"].toBool();
     
     auto timeSettings = std::make_shared<BlockTimeSettingsModel>(startTime, endTime, week, isActive);
-    m_database->updateBlockTimeSettings(timeSettings);
+
+    // Servers that predate extra intervals omit the field; keep the local ones then
+    bool keepIntervals = !settings.contains("intervals");
+    if (!keepIntervals) {
+        QList<REG_Interval> intervals;
+        for (const QJsonValue& intervalValue : settings["intervals"].toArray()) {
+            QJsonObject intervalObj = intervalValue.toObject();
+            REG_Interval interval;
+            interval.dayOfWeek = intervalObj["dayOfWeek"].toInt();
+            interval.startTime = QTime(intervalObj["startHour"].toInt(), intervalObj["startMinute"].toInt());
+            interval.endTime = QTime(intervalObj["endHour"].toInt(), intervalObj["endMinute"].toInt());
+            if (interval.dayOfWeek < 1 || interval.dayOfWeek > 7
+                || !interval.startTime.isValid() || !interval.endTime.isValid())
+                continue;
+            intervals.append(interval);
+        }
+        timeSettings->setIntervals(intervals);
+    }
+
+    m_database->run([timeSettings, keepIntervals](Database& database) {
+        if (keepIntervals) {
+            if (auto current = database.getBlockTimeSettings())
+                timeSettings->setIntervals(current->getIntervals());
+        }
+        return database.updateBlockTimeSettings(timeSettings);
+    });
 } 
\ No newline at end of file
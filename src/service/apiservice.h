@@ -7,15 +7,20 @@
 #include <QJsonDocument>
 #include <QJsonArray>
 #include <QJsonObject>
+#include <QHash>
+#include <QTimer>
+#include <QSet>
 #include <memory>
 #include "../data/database.h"
 
+class AsyncDatabase;
+
 class ApiService : public QObject
 {
     Q_OBJECT
 
 public:
-    explicit ApiService(Database* database, QObject *parent = nullptr);
+    explicit ApiService(AsyncDatabase* database, QObject *parent = nullptr);
     ~ApiService();
 
     void setBaseUrl(const QString& url);
@@ -36,14 +41,35 @@ private slots:
     void onBlockedAppsFetchFinished(QNetworkReply* reply);
     void onTimeSettingsSyncFinished(QNetworkReply* reply);
     void onTimeSettingsFetchFinished(QNetworkReply* reply);
+    void onBlockedAppsChanged(quint64 baseRevision, quint64 revision, const QList<BlockedAppChange>& changes);
 
 private:
     QNetworkAccessManager* m_networkManager;
-    Database* m_database;
+    AsyncDatabase* m_database;
     QString m_baseUrl;
 
+    // Copy of every blocked_apps row kept current from the database change
+    // feed, so uploads neither query SQLite nor build an AppModel per row.
+    // Loaded on first use and after a missed change.
+    QHash<PathKey, BlockedAppChange> m_blockedApps;
+    quint64 m_blockedAppsRevision;
+    bool m_blockedAppsLoaded;
+    bool m_blockedAppsLoading;
+    bool m_syncAfterLoad;
+    // Coalesces local changes into one upload
+    QTimer m_syncTimer;
+    // Fetched changes still being written. What a fetch wrote is not sent
+    // back, but only its own revision is skipped: revisions reported while
+    // a fetch is pending wait until its result names the one it produced.
+    int m_pendingFetchWrites;
+    QList<quint64> m_revisionsDuringFetch;
+    // Fetch revisions whose change had not been reported yet
+    QSet<quint64> m_fetchRevisions;
+
+    void loadBlockedApps();
+    void postBlockedApps();
     QJsonArray blockedAppsToJson() const;
-    QJsonObject timeSettingsToJson() const;
+    static QJsonObject timeSettingsToJson(const std::shared_ptr<BlockTimeSettingsModel>& settings);
     void processBlockedAppsResponse(const QJsonArray& apps);
     void processTimeSettingsResponse(const QJsonObject& settings);
 };
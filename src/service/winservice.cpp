@@ -6,7 +6,7 @@
 #include <QDebug>
 #include <QCoreApplication>
 #include <QDir>
-#include <thread>
+#include <QThread>
 #include <QMessageBox>
 #include <windows.h>
 #include <winerror.h>
@@ -52,6 +52,7 @@ WinService::WinService(Database* database, QObject *parent)
       m_serviceDisplayName("Foccuss Service"),
       m_database(database),
       m_appMonitor(nullptr),
+      m_monitorThread(nullptr),
       m_serviceStopEvent(nullptr)
 {
     s_instance = this;
@@ -59,7 +60,7 @@ WinService::WinService(Database* database, QObject *parent)
     // Initialize service status
     m_serviceStatus.dwServiceType = SERVICE_WIN32_OWN_PROCESS;
     m_serviceStatus.dwCurrentState = SERVICE_START_PENDING;
-    m_serviceStatus.dwControlsAccepted = SERVICE_ACCEPT_STOP | SERVICE_ACCEPT_SHUTDOWN;
+    m_serviceStatus.dwControlsAccepted = SERVICE_ACCEPT_STOP | SERVICE_ACCEPT_SHUTDOWN | SERVICE_ACCEPT_TIMECHANGE;
     m_serviceStatus.dwWin32ExitCode = NO_ERROR;
     m_serviceStatus.dwServiceSpecificExitCode = 0;
     m_serviceStatus.dwCheckPoint = 0;
@@ -69,7 +70,7 @@ WinService::WinService(Database* database, QObject *parent)
 WinService::~WinService()
 {
     if (m_appMonitor) {
-        m_appMonitor->stopMonitoring();
+        stopMonitorThread();
         delete m_appMonitor;
     }
     
@@ -93,11 +94,15 @@ bool WinService::initialize()
         return false;
     }
     
-    m_appMonitor = new AppMonitor(m_database, this);
+    // Unparented so it can move to its thread; deleted in the destructor
+    m_appMonitor = new AppMonitor(m_database);
     if (!m_appMonitor) {
         logToFile("Failed to create AppMonitor");
         return false;
     }
+    m_monitorThread = new QThread(this);
+    m_monitorThread->setObjectName("AppMonitor");
+    m_appMonitor->moveToThread(m_monitorThread);
     
     logToFile("AppMonitor created successfully");
     
@@ -359,9 +364,10 @@ VOID WINAPI WinService::ServiceMain(DWORD argc, LPWSTR* argv)
     if (!s_instance)
         return;
 
-    s_instance->m_serviceStatusHandle = RegisterServiceCtrlHandler(
+    s_instance->m_serviceStatusHandle = RegisterServiceCtrlHandlerEx(
         (const wchar_t*)s_instance->m_serviceName.utf16(),
-        ServiceCtrlHandler);
+        ServiceCtrlHandler,
+        NULL);
     
     if (s_instance->m_serviceStatusHandle == NULL) {
         logToFile(QString("m_serviceStatusHandle == NULL"));
@@ -387,7 +393,7 @@ VOID WINAPI WinService::ServiceMain(DWORD argc, LPWSTR* argv)
     
     s_instance->reportServiceStatus(SERVICE_RUNNING, NO_ERROR, 0);
     
-    std::thread workerThread(&WinService::serviceWorkerThread, s_instance);
+    s_instance->startMonitorThread();
     
     WaitForSingleObject(s_instance->m_serviceStopEvent, INFINITE);
     if (s_instance->m_serviceStopEvent == NULL) {
@@ -396,16 +402,17 @@ VOID WINAPI WinService::ServiceMain(DWORD argc, LPWSTR* argv)
         return;
     }
 
-    if (s_instance->m_appMonitor) {
-        s_instance->m_appMonitor->stopMonitoring();
-    }
-    workerThread.join();
+    s_instance->stopMonitorThread();
     
     s_instance->reportServiceStatus(SERVICE_STOPPED, NO_ERROR, 0);
 }
 
-VOID WINAPI WinService::ServiceCtrlHandler(DWORD control)
+DWORD WINAPI WinService::ServiceCtrlHandler(DWORD control, DWORD eventType, LPVOID eventData, LPVOID context)
 {
+    Q_UNUSED(eventType);
+    Q_UNUSED(eventData);
+    Q_UNUSED(context);
+
     switch (control) {
         case SERVICE_CONTROL_STOP:
         case SERVICE_CONTROL_SHUTDOWN:
@@ -414,9 +421,19 @@ VOID WINAPI WinService::ServiceCtrlHandler(DWORD control)
                 SetEvent(s_instance->m_serviceStopEvent);
             }
             reportServiceStatus(SERVICE_STOPPED);
-            break;
+            return NO_ERROR;
+        case SERVICE_CONTROL_TIMECHANGE:
+            // The monitor sleeps until the next schedule transition on an
+            // elapsed-time timer, so a wall clock change has to re-arm it
+            if (s_instance && s_instance->m_appMonitor) {
+                QMetaObject::invokeMethod(s_instance->m_appMonitor, &AppMonitor::rescheduleBlocking,
+                                          Qt::QueuedConnection);
+            }
+            return NO_ERROR;
+        case SERVICE_CONTROL_INTERROGATE:
+            return NO_ERROR;
         default:
-            break;
+            return ERROR_CALL_NOT_IMPLEMENTED;
     }
 }
 
@@ -442,7 +459,7 @@ void WinService::reportServiceStatus(DWORD currentState, DWORD exitCode, DWORD w
     if (currentState == SERVICE_START_PENDING) {
         m_serviceStatus.dwControlsAccepted = 0;
     } else {
-        m_serviceStatus.dwControlsAccepted = SERVICE_ACCEPT_STOP | SERVICE_ACCEPT_SHUTDOWN;
+        m_serviceStatus.dwControlsAccepted = SERVICE_ACCEPT_STOP | SERVICE_ACCEPT_SHUTDOWN | SERVICE_ACCEPT_TIMECHANGE;
     }
     
     if ((currentState == SERVICE_RUNNING) || (currentState == SERVICE_STOPPED)) {
@@ -460,30 +477,26 @@ void WinService::reportServiceStatus(DWORD currentState, DWORD exitCode, DWORD w
     SetServiceStatus(m_serviceStatusHandle, &m_serviceStatus);
 }
 
-void WinService::serviceWorkerThread()
+void WinService::startMonitorThread()
 {
     if (!m_appMonitor)
         return;
 
-    // Start monitoring
+    // The monitor arms its own timers; they fire in the thread's event loop
     logToFile("Starting AppMonitor...");
-    m_appMonitor->startMonitoring();
+    m_monitorThread->start();
+    QMetaObject::invokeMethod(m_appMonitor, &AppMonitor::startMonitoring, Qt::BlockingQueuedConnection);
     logToFile("AppMonitor started: " + QString(m_appMonitor->isMonitoring() ? "true" : "false"));
-    
-    // Main service loop
-    logToFile("Entering service main loop");
-    int checkCounter = 0;
-    while (WaitForSingleObject(m_serviceStopEvent, 0) != WAIT_OBJECT_0) {
-        Sleep(1000);
-        
-        // Every 5 seconds, explicitly check running apps as a fallback
-        // This helps in case the timer isn't working properly in service context
-        // checkCounter++;
-        // if (checkCounter >= 5) {
-        //     QMetaObject::invokeMethod(m_appMonitor, "checkRunningApps", Qt::DirectConnection);
-        //     checkCounter = 0;
-        // }
-    }
-    
-    logToFile("Service worker thread exiting");
-} 
\ No newline at end of file
+}
+
+void WinService::stopMonitorThread()
+{
+    if (!m_monitorThread || !m_monitorThread->isRunning())
+        return;
+
+    // Timers must be stopped on the thread that owns them
+    QMetaObject::invokeMethod(m_appMonitor, &AppMonitor::stopMonitoring, Qt::BlockingQueuedConnection);
+    m_monitorThread->quit();
+    m_monitorThread->wait();
+    logToFile("AppMonitor thread exited");
+}
@@ -8,6 +8,7 @@
 
 class AppMonitor;
 class Database;
+class QThread;
 
 class WinService : public QObject
 {
@@ -31,12 +32,13 @@ public:
     static VOID WINAPI ServiceMain(DWORD argc, LPWSTR* argv);
     
 private:
-    static VOID WINAPI ServiceCtrlHandler(DWORD control);
+    static DWORD WINAPI ServiceCtrlHandler(DWORD control, DWORD eventType, LPVOID eventData, LPVOID context);
     static WinService* s_instance;
     static std::unique_ptr<QCoreApplication> s_appInstance;
     
     static void reportServiceStatus(DWORD currentState, DWORD exitCode = NO_ERROR, DWORD waitHint = 0);
-    void serviceWorkerThread();
+    void startMonitorThread();
+    void stopMonitorThread();
     
     // Service name and status
     QString m_serviceName;
@@ -47,6 +49,9 @@ private:
     // Service components
     Database* m_database;
     AppMonitor* m_appMonitor;
+    // Runs the monitor's event loop, so its timers, file watcher and
+    // process events are delivered while the service waits for a stop
+    QThread* m_monitorThread;
     
     // Control event
     HANDLE m_serviceStopEvent;
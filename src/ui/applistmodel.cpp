@@ -12,10 +12,36 @@ void AppListModel::setApps(const QList<std::shared_ptr<AppModel>>& apps)
     clear();
     
     for (const auto& app : apps) {
-        QStandardItem *item = new QStandardItem();
-        item->setText(app->getName());
-        item->setIcon(app->getIcon());
-        item->setData(QVariant::fromValue(app), Qt::UserRole + 1);
-        appendRow(item);
+        appendRow(createItem(app));
     }
-} 
\ No newline at end of file
+}
+
+void AppListModel::insertApp(int row, const std::shared_ptr<AppModel>& app)
+{
+    insertRow(row, createItem(app));
+}
+
+void AppListModel::updateApp(int row, const std::shared_ptr<AppModel>& app)
+{
+    QStandardItem *item = this->item(row);
+    if (!item) {
+        return;
+    }
+
+    item->setText(app->getName());
+    item->setData(QVariant::fromValue(app), Qt::UserRole + 1);
+}
+
+void AppListModel::removeApp(int row)
+{
+    removeRow(row);
+}
+
+QStandardItem* AppListModel::createItem(const std::shared_ptr<AppModel>& app)
+{
+    QStandardItem *item = new QStandardItem();
+    item->setText(app->getName());
+    item->setIcon(app->getIcon());
+    item->setData(QVariant::fromValue(app), Qt::UserRole + 1);
+    return item;
+}
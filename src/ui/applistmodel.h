@@ -14,6 +14,14 @@ public:
     explicit AppListModel(QObject *parent = nullptr);
     
     void setApps(const QList<std::shared_ptr<AppModel>>& apps);
+
+    // Single row edits, so a change to one app does not rebuild the list
+    void insertApp(int row, const std::shared_ptr<AppModel>& app);
+    void updateApp(int row, const std::shared_ptr<AppModel>& app);
+    void removeApp(int row);
+
+private:
+    static QStandardItem* createItem(const std::shared_ptr<AppModel>& app);
 };
 
-#endif // APPLISTMODEL_H 
\ No newline at end of file
+#endif // APPLISTMODEL_H 
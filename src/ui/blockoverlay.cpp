@@ -114,6 +114,7 @@ bool BlockOverlay::nativeEvent(const QByteArray &eventType, void *message, qintp
 
 void BlockOverlay::onCloseClicked()
 {
+    emit dismissed(m_appPath, m_appName);
     close();
 }
 
@@ -133,6 +134,7 @@ void BlockOverlay::onKillAppClicked()
         }
     }
     
+    emit appKilled(m_appPath, m_appName);
     close();
 }
 
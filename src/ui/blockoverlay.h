@@ -17,6 +17,12 @@ public:
     
     void showOverWindow();
     
+signals:
+    // The user closed the overlay and left the app running
+    void dismissed(const QString& appPath, const QString& appName);
+    // The user terminated the app from the overlay
+    void appKilled(const QString& appPath, const QString& appName);
+    
 protected:
     void paintEvent(QPaintEvent *event) override;
     void closeEvent(QCloseEvent *event) override;
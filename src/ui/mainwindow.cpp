@@ -2,8 +2,11 @@
 #include "blockoverlay.h"
 #include "applistmodel.h"
 #include "../core/appdetector.h"
+#include "../core/installedappcache.h"
 #include "../core/appmonitor.h"
 #include "../data/database.h"
+#include "../data/asyncdatabase.h"
+#include "../data/blockjournal.h"
 #include "../data/appmodel.h"
 #include "../data/blockTimeSettingsModel.h"
 #include "../service/winservice.h"
@@ -34,6 +37,7 @@
 #include <QRegularExpression>
 #include <QStandardPaths>
 #include <QDir>
+#include <QThread>
 
 static QString s_logFilePath;
 
@@ -56,6 +60,24 @@ void logToFileMW(const QString& message) {
     }
 }
 
+// The search box matches its words in order, anywhere in the name
+static QRegularExpression searchExpression(const QString& searchText)
+{
+    QString pattern = searchText;
+    pattern.replace(" ", "*");
+    if (!pattern.startsWith("*")) pattern = "*" + pattern;
+    if (!pattern.endsWith("*")) pattern = pattern + "*";
+    
+    return QRegularExpression(QRegularExpression::wildcardToRegularExpression(pattern), 
+                              QRegularExpression::CaseInsensitiveOption);
+}
+
+// Same order as AppDetector::getInstalledApps()
+static bool isInstalledAppBefore(const std::shared_ptr<AppModel>& a, const std::shared_ptr<AppModel>& b)
+{
+    return a->getName().compare(b->getName(), Qt::CaseInsensitive) < 0;
+}
+
 MainWindow::MainWindow(Database* database, QWidget *parent)
     : QMainWindow(parent),
       m_installedAppsView(nullptr),
@@ -71,14 +93,35 @@ MainWindow::MainWindow(Database* database, QWidget *parent)
       m_trayMenu(nullptr),
       m_appDetector(nullptr),
       m_appMonitor(nullptr),
+      m_monitorThread(nullptr),
       m_database(database),
+      m_asyncDatabase(nullptr),
+      m_blockJournal(nullptr),
       m_service(nullptr),
-      m_apiService(nullptr)
+      m_apiService(nullptr),
+      m_blockedAppsRevision(0),
+      m_pendingBlockedAppLoads(0)
 {
-    m_appDetector = new AppDetector(this);
-    
-    m_appMonitor = new AppMonitor(m_database, this);
+    m_appDetector = new AppDetector(InstalledAppCache::pathFor(m_database->databasePath()), this);
+
+    // From here on all SQLite work of this window runs on the database
+    // thread; anything that still reaches it from here gets counted
+    m_asyncDatabase = new AsyncDatabase(m_database, this);
+    m_database->setGuardedThread(thread());
+    m_blockJournal = new BlockJournal(m_asyncDatabase, this);
+    
+    // The monitor runs on its own thread; detections come back through its
+    // queue and are drained here in one go per burst
+    m_monitorThread = new QThread(this);
+    m_monitorThread->setObjectName("AppMonitor");
+    m_appMonitor = new AppMonitor(m_database);
+    m_appMonitor->moveToThread(m_monitorThread);
+    connect(m_appMonitor, &AppMonitor::detectionsAvailable, this, [this]() {
+        m_appMonitor->drainDetections();
+    });
     connect(m_appMonitor, &AppMonitor::blockedAppLaunched, this, &MainWindow::onBlockedAppLaunched);
+    connect(m_appMonitor, &AppMonitor::monitoringChanged, this, &MainWindow::updateServiceStatus);
+    m_monitorThread->start();
     
     m_filteredInstalledApps.clear();
     m_filteredBlockedApps.clear();
@@ -87,9 +130,19 @@ MainWindow::MainWindow(Database* database, QWidget *parent)
     setupTrayIcon();
     setupApiService();
     
+    // Installed apps fill in while they resolve in the background
+    connect(m_appDetector, &AppDetector::installedAppsRefreshStarted, this, &MainWindow::onInstalledAppsRefreshStarted);
+    connect(m_appDetector, &AppDetector::installedAppsAdded, this, &MainWindow::onInstalledAppsAdded);
+    m_appDetector->loadInstalledApps();
+    
+    // Rows written from here on arrive as changes; a reload from another
+    // process says nothing about which rows moved, so that one is read again
+    connect(m_database, &Database::blockedAppsChanged, this, &MainWindow::onBlockedAppsChanged);
+    connect(m_database, &Database::blockedAppsReloaded, this, &MainWindow::loadBlockedApps);
+    connect(m_database, &Database::scheduleChanged, this, &MainWindow::loadTimeSettings);
     loadBlockedApps();
 
-    m_appMonitor->startMonitoring();
+    QMetaObject::invokeMethod(m_appMonitor, &AppMonitor::startMonitoring, Qt::QueuedConnection);
 
     updateServiceStatus();
 
@@ -99,8 +152,13 @@ MainWindow::MainWindow(Database* database, QWidget *parent)
 
 MainWindow::~MainWindow()
 {
+    // Its last flush needs the database thread, which goes with m_asyncDatabase
+    delete m_blockJournal;
     if (m_appMonitor) {
-        m_appMonitor->stopMonitoring();
+        // Timers must be stopped on the thread that owns them
+        QMetaObject::invokeMethod(m_appMonitor, &AppMonitor::stopMonitoring, Qt::BlockingQueuedConnection);
+        m_monitorThread->quit();
+        m_monitorThread->wait();
         delete m_appMonitor;
     }
     if (m_appDetector) {
@@ -112,6 +170,12 @@ MainWindow::~MainWindow()
     if (m_apiService) {
         delete m_apiService;
     }
+    if (m_asyncDatabase) {
+        logToFileMW(QString("SQLite queries on the GUI thread: %1, database thread jobs: %2 (%3 ms)")
+                        .arg(m_database->guardedThreadQueries())
+                        .arg(m_asyncDatabase->jobCount())
+                        .arg(m_asyncDatabase->busyTime()));
+    }
 }
 
 void MainWindow::closeEvent(QCloseEvent *event)
@@ -123,10 +187,25 @@ void MainWindow::closeEvent(QCloseEvent *event)
         hide();
         event->ignore();
     } else {
+        // Nobody is left to see the list
+        m_appDetector->cancelRefresh();
         event->accept();
     }
 }
 
+bool MainWindow::nativeEvent(const QByteArray &eventType, void *message, qintptr *result)
+{
+    MSG* msg = static_cast<MSG*>(message);
+    
+    // The monitor sleeps on an elapsed-time timer until the next schedule
+    // transition, so a wall clock change has to re-arm it
+    if (msg->message == WM_TIMECHANGE && m_appMonitor) {
+        QMetaObject::invokeMethod(m_appMonitor, &AppMonitor::rescheduleBlocking, Qt::QueuedConnection);
+    }
+    
+    return QMainWindow::nativeEvent(eventType, message, result);
+}
+
 void MainWindow::setupUi()
 {
     QWidget *centralWidget = new QWidget(this);
@@ -389,7 +468,7 @@ void MainWindow::setupSettingsTab()
 
 void MainWindow::setupApiService()
 {
-    m_apiService = new ApiService(m_database, this);
+    m_apiService = new ApiService(m_asyncDatabase, this);
 
     m_apiService->setBaseUrl("http://ec2-18-219-89-146.us-east-2.compute.amazonaws.com:3000");
 
@@ -404,13 +483,34 @@ void MainWindow::setupApiService()
 
 void MainWindow::loadBlockedApps()
 {
-    m_blockedApps = m_database->getBlockedApps();
-    m_blockedApps.erase(
-        std::remove_if(m_blockedApps.begin(), m_blockedApps.end(), [](const auto app) {
-            return !app->getActive();
-        }),
-        m_blockedApps.end()
-    );
+    // Jobs run in order, so every change reported before the result
+    // arrives was committed before the read and is already part of it
+    ++m_pendingBlockedAppLoads;
+    m_asyncDatabase->run([](Database& database) {
+        // The revision is read first, so a change committed in between is
+        // applied once more on top of rows that already have it, not lost
+        quint64 revision = database.blockedAppsRevision();
+        return qMakePair(revision, database.getBlockedAppEntries(true));
+    }).then(this, [this](const QPair<quint64, QList<BlockedAppChange>>& loaded) {
+        --m_pendingBlockedAppLoads;
+        showBlockedApps(loaded.first, loaded.second);
+    });
+}
+
+void MainWindow::showBlockedApps(quint64 revision, const QList<BlockedAppChange>& entries)
+{
+    m_blockedAppsRevision = revision;
+    m_blockedApps.clear();
+    m_blockedAppsByKey.clear();
+
+    // Icons are loaded here rather than on the database thread, QPixmap
+    // is GUI thread only
+    for (const BlockedAppChange& entry : entries) {
+        auto app = std::make_shared<AppModel>(entry.appPath, entry.appName, true);
+        app->setRuleType(entry.ruleType);
+        m_blockedApps.append(app);
+        m_blockedAppsByKey.insert(PathKey(entry.appPath), app);
+    }
 
     if (m_blockedSearchEdit && !m_blockedSearchEdit->text().isEmpty()) {
         filterAppList(m_blockedSearchEdit->text(), false);
@@ -424,6 +524,114 @@ void MainWindow::loadBlockedApps()
     }
 }
 
+void MainWindow::onBlockedAppsChanged(quint64 baseRevision, quint64 revision, const QList<BlockedAppChange>& changes)
+{
+    if (m_pendingBlockedAppLoads > 0) {
+        return;
+    }
+
+    // A change on top of anything but what the list shows means one was
+    // missed; only then is the whole list read again
+    if (baseRevision != m_blockedAppsRevision) {
+        loadBlockedApps();
+        return;
+    }
+    m_blockedAppsRevision = revision;
+
+    // While searching the view shows a subset, which is filtered again
+    // from the updated list in memory afterwards
+    bool searching = m_blockedSearchEdit && !m_blockedSearchEdit->text().isEmpty();
+    AppListModel *model = searching ? nullptr : qobject_cast<AppListModel*>(m_blockedAppsView->model());
+
+    for (const BlockedAppChange& change : changes) {
+        applyBlockedAppChange(change, model);
+    }
+
+    if (searching) {
+        filterAppList(m_blockedSearchEdit->text(), false);
+    } else {
+        m_filteredBlockedApps = m_blockedApps;
+    }
+}
+
+void MainWindow::applyBlockedAppChange(const BlockedAppChange& change, AppListModel* model)
+{
+    PathKey key(change.appPath);
+    auto existing = m_blockedAppsByKey.find(key);
+
+    if (!change.blocked) {
+        if (existing == m_blockedAppsByKey.end()) {
+            return;
+        }
+
+        int row = blockedAppRow(existing.value());
+        if (m_selectedBlockedApp == existing.value()) {
+            m_selectedBlockedApp = nullptr;
+            m_unblockButton->setEnabled(false);
+        }
+        m_blockedApps.removeAt(row);
+        if (model) {
+            model->removeApp(row);
+        }
+        m_blockedAppsByKey.erase(existing);
+        return;
+    }
+
+    if (existing != m_blockedAppsByKey.end()) {
+        std::shared_ptr<AppModel> app = existing.value();
+        app->setRuleType(change.ruleType);
+        if (change.appName.isEmpty() || app->getName() == change.appName) {
+            return;
+        }
+
+        // Renamed, move it to where the new name sorts
+        int row = blockedAppRow(app);
+        m_blockedApps.removeAt(row);
+        if (model) {
+            model->removeApp(row);
+        }
+        app->setName(change.appName);
+        insertBlockedApp(app, model);
+        return;
+    }
+
+    // The only icon loaded for this change
+    auto app = std::make_shared<AppModel>(change.appPath, change.appName, true);
+    app->setRuleType(change.ruleType);
+    m_blockedAppsByKey.insert(key, app);
+    insertBlockedApp(app, model);
+}
+
+void MainWindow::insertBlockedApp(const std::shared_ptr<AppModel>& app, AppListModel* model)
+{
+    // Same order as getBlockedApps(), which sorts by name
+    auto position = std::upper_bound(m_blockedApps.begin(), m_blockedApps.end(), app->getName(),
+        [](const QString& name, const std::shared_ptr<AppModel>& other) {
+            return name < other->getName();
+        });
+    int row = static_cast<int>(position - m_blockedApps.begin());
+
+    m_blockedApps.insert(row, app);
+    if (model) {
+        model->insertApp(row, app);
+    }
+}
+
+int MainWindow::blockedAppRow(const std::shared_ptr<AppModel>& app) const
+{
+    auto position = std::lower_bound(m_blockedApps.cbegin(), m_blockedApps.cend(), app->getName(),
+        [](const std::shared_ptr<AppModel>& other, const QString& name) {
+            return other->getName() < name;
+        });
+    for (; position != m_blockedApps.cend() && (*position)->getName() == app->getName(); ++position) {
+        if (*position == app) {
+            return static_cast<int>(position - m_blockedApps.cbegin());
+        }
+    }
+
+    return static_cast<int>(m_blockedApps.indexOf(app));
+}
+
 void MainWindow::updateServiceStatus()
 {
     bool isMonitoring = m_appMonitor->isMonitoring();
@@ -442,59 +650,85 @@ void MainWindow::updateServiceStatus()
 
 void MainWindow::onRefreshApps()
 {
+    // Replaces a refresh that is still running
     m_appDetector->refreshInstalledApps();
-    m_installedApps = m_appDetector->getInstalledApps();
+    m_apiService->fetchBlockedApps();
+}
+
+void MainWindow::onInstalledAppsRefreshStarted()
+{
+    m_installedApps.clear();
+    m_filteredInstalledApps.clear();
     
-    if (m_installedSearchEdit && !m_installedSearchEdit->text().isEmpty()) {
-        filterAppList(m_installedSearchEdit->text(), true);
-    } else {
-        m_filteredInstalledApps = m_installedApps;
-        
-        AppListModel *model = qobject_cast<AppListModel*>(m_installedAppsView->model());
-        if (model) {
-            model->setApps(m_filteredInstalledApps);
-        }
+    AppListModel *model = qobject_cast<AppListModel*>(m_installedAppsView->model());
+    if (model) {
+        model->setApps(m_filteredInstalledApps);
     }
     
     m_selectedInstalledApp = nullptr;
     m_blockButton->setEnabled(false);
-    m_apiService->fetchBlockedApps();
+}
+
+void MainWindow::onInstalledAppsAdded(const QList<std::shared_ptr<AppModel>>& apps)
+{
+    // Each app goes straight to its sorted row; rows already there, and
+    // the selection, stay as they are
+    const QString searchText = m_installedSearchEdit ? m_installedSearchEdit->text() : QString();
+    const QRegularExpression regex = searchExpression(searchText);
+    AppListModel *model = qobject_cast<AppListModel*>(m_installedAppsView->model());
+    
+    for (const std::shared_ptr<AppModel>& app : apps) {
+        auto position = std::upper_bound(m_installedApps.begin(), m_installedApps.end(), app, isInstalledAppBefore);
+        m_installedApps.insert(position, app);
+        
+        if (!searchText.isEmpty() && !regex.match(app->getName()).hasMatch()) {
+            continue;
+        }
+        
+        auto filteredPosition = std::upper_bound(m_filteredInstalledApps.begin(), m_filteredInstalledApps.end(),
+                                                 app, isInstalledAppBefore);
+        int row = static_cast<int>(filteredPosition - m_filteredInstalledApps.begin());
+        m_filteredInstalledApps.insert(row, app);
+        if (model) {
+            model->insertApp(row, app);
+        }
+    }
 }
 
 void MainWindow::onBlockApp()
 {
     if (m_selectedInstalledApp && m_selectedInstalledApp->isValid()) {
-        if (m_database->addBlockedApp(m_selectedInstalledApp->getPath(), 
-                                     m_selectedInstalledApp->getName())) {
-            loadBlockedApps();
-            m_apiService->syncBlockedApps();
-            
-            QMessageBox::information(this, "Success", 
-                                   "Application has been blocked: " + 
-                                   m_selectedInstalledApp->getName());
-        } else {
-            QMessageBox::warning(this, "Error", 
-                               "Failed to block application: " + 
-                               m_selectedInstalledApp->getName());
-        }
+        std::shared_ptr<AppModel> app = m_selectedInstalledApp;
+        m_asyncDatabase->addBlockedApp(app->getPath(), app->getName()).then(this, [this, app](bool added) {
+            if (added) {
+                QMessageBox::information(this, "Success", 
+                                       "Application has been blocked: " + 
+                                       app->getName());
+            } else {
+                QMessageBox::warning(this, "Error", 
+                                   "Failed to block application: " + 
+                                   app->getName());
+            }
+        });
     }
 }
 
 void MainWindow::onUnblockApp()
 {
     if (m_selectedBlockedApp && m_selectedBlockedApp->isValid()) {
-        if (m_database->removeBlockedApp(m_selectedBlockedApp->getPath())) {
-            loadBlockedApps();
-            m_apiService->syncBlockedApps();
-            
-            QMessageBox::information(this, "Success", 
-                                   "Application has been unblocked: " + 
-                                   m_selectedBlockedApp->getName());
-        } else {
-            QMessageBox::warning(this, "Error", 
-                               "Failed to unblock application: " + 
-                               m_selectedBlockedApp->getName());
-        }
+        // The change feed clears the selection when the row goes away
+        std::shared_ptr<AppModel> app = m_selectedBlockedApp;
+        m_asyncDatabase->removeBlockedApp(app->getPath()).then(this, [this, app](bool removed) {
+            if (removed) {
+                QMessageBox::information(this, "Success", 
+                                       "Application has been unblocked: " + 
+                                       app->getName());
+            } else {
+                QMessageBox::warning(this, "Error", 
+                                   "Failed to unblock application: " + 
+                                   app->getName());
+            }
+        });
     }
 }
 
@@ -533,8 +767,16 @@ void MainWindow::onAppSelected(const QModelIndex &index)
 
 void MainWindow::onBlockedAppLaunched(const HWND targetWindow, const QString& appPath, const QString& appName)
 {
+    m_blockJournal->record(BlockEventKind::Launched, appPath, appName);
+
     BlockOverlay *overlay = new BlockOverlay(targetWindow, appPath, appName);
     overlay->setAttribute(Qt::WA_DeleteOnClose);
+    connect(overlay, &BlockOverlay::dismissed, this, [this](const QString& path, const QString& name) {
+        m_blockJournal->record(BlockEventKind::Dismissed, path, name);
+    });
+    connect(overlay, &BlockOverlay::appKilled, this, [this](const QString& path, const QString& name) {
+        m_blockJournal->record(BlockEventKind::ForceClosed, path, name);
+    });
     overlay->showOverWindow();
 }
 
@@ -552,13 +794,12 @@ void MainWindow::onTrayIconActivated(QSystemTrayIcon::ActivationReason reason)
 
 void MainWindow::onServiceStatusToggled(bool checked)
 {
+    // updateServiceStatus() runs once the monitor reports the change
     if (checked) {
-        m_appMonitor->startMonitoring();
+        QMetaObject::invokeMethod(m_appMonitor, &AppMonitor::startMonitoring, Qt::QueuedConnection);
     } else {
-        m_appMonitor->stopMonitoring();
+        QMetaObject::invokeMethod(m_appMonitor, &AppMonitor::stopMonitoring, Qt::QueuedConnection);
     }
-
-    updateServiceStatus();
 }
 
 void MainWindow::updateServiceButtons()
@@ -624,14 +865,7 @@ void MainWindow::onStopService()
 
 void MainWindow::onInstalledAppsSearchChanged(const QString& text)
 {
-    if (m_installedApps.isEmpty() && text.isEmpty()) {
-        return;
-    }
-    
-    if (m_installedApps.isEmpty() && !text.isEmpty()) {
-        onRefreshApps();
-    }
-    
+    // Apps still resolving are filtered as they arrive
     filterAppList(text, true);
 }
 
@@ -680,12 +914,14 @@ void MainWindow::onSaveTimeSettings()
     }
     
     // Save to database
-    if (m_database->updateBlockTimeSettings(m_timeSettings)) {
-        m_apiService->syncTimeSettings();
-        QMessageBox::information(this, "Success", "Time settings saved successfully");
-    } else {
-        QMessageBox::warning(this, "Error", "Failed to save time settings");
-    }
+    m_asyncDatabase->updateBlockTimeSettings(m_timeSettings).then(this, [this](bool saved) {
+        if (saved) {
+            m_apiService->syncTimeSettings();
+            QMessageBox::information(this, "Success", "Time settings saved successfully");
+        } else {
+            QMessageBox::warning(this, "Error", "Failed to save time settings");
+        }
+    });
 }
 
 void MainWindow::onSyncCompleted(bool success)
@@ -704,9 +940,8 @@ void MainWindow::onSyncFailed(const QString& error)
 void MainWindow::onDataFetched(bool success)
 {
     if (success) {
+        // Whatever the fetch wrote already came through the change feed
         qDebug() << "Fetch completed successfully";
-        loadBlockedApps();
-        loadTimeSettings();
     }
 }
 
@@ -721,13 +956,7 @@ void MainWindow::filterAppList(const QString& searchText, bool isInstalledList)
     if (searchText.isEmpty()) {
         filteredList = sourceList;
     } else {
-        QString pattern = searchText;
-        pattern.replace(" ", "*");
-        if (!pattern.startsWith("*")) pattern = "*" + pattern;
-        if (!pattern.endsWith("*")) pattern = pattern + "*";
-        
-        QRegularExpression regex(QRegularExpression::wildcardToRegularExpression(pattern), 
-                                QRegularExpression::CaseInsensitiveOption);
+        const QRegularExpression regex = searchExpression(searchText);
         
         for (const auto& app : sourceList) {
             if (regex.match(app->getName()).hasMatch()) {
@@ -744,7 +973,14 @@ void MainWindow::filterAppList(const QString& searchText, bool isInstalledList)
 
 void MainWindow::loadTimeSettings()
 {
-    m_timeSettings = m_database->getBlockTimeSettings();
+    m_asyncDatabase->getBlockTimeSettings().then(this, [this](const std::shared_ptr<BlockTimeSettingsModel>& settings) {
+        showTimeSettings(settings);
+    });
+}
+
+void MainWindow::showTimeSettings(const std::shared_ptr<BlockTimeSettingsModel>& settings)
+{
+    m_timeSettings = settings;
     
     // If settings exist, populate UI elements
     if (m_timeSettings) {
@@ -821,10 +1057,12 @@ void MainWindow::saveTimeSettings()
     }
     
     // Save to database
-    if (m_database->updateBlockTimeSettings(m_timeSettings)) {
-        QMessageBox::information(this, "Success", "Time settings saved successfully");
-    } else {
-        QMessageBox::warning(this, "Error", "Failed to save time settings");
-    }
+    m_asyncDatabase->updateBlockTimeSettings(m_timeSettings).then(this, [this](bool saved) {
+        if (saved) {
+            QMessageBox::information(this, "Success", "Time settings saved successfully");
+        } else {
+            QMessageBox::warning(this, "Error", "Failed to save time settings");
+        }
+    });
 }
 
@@ -15,9 +15,12 @@ public:
 
 protected:
     void closeEvent(QCloseEvent *event) override;
+    bool nativeEvent(const QByteArray &eventType, void *message, qintptr *result) override;
 
 private slots:
     void onRefreshApps();
+    void onInstalledAppsRefreshStarted();
+    void onInstalledAppsAdded(const QList<std::shared_ptr<AppModel>>& apps);
     void onBlockApp();
     void onUnblockApp();
     void onAppSelected(const QModelIndex &index);
@@ -34,6 +37,7 @@ private slots:
     void onSyncCompleted(bool success);
     void onSyncFailed(const QString& error);
     void onDataFetched(bool success);
+    void onBlockedAppsChanged(quint64 baseRevision, quint64 revision, const QList<BlockedAppChange>& changes);
 
 private:
     void setupUi();
@@ -41,10 +45,15 @@ private:
     void setupAppsTab();
     void setupSettingsTab();
     void loadBlockedApps();
+    void showBlockedApps(quint64 revision, const QList<BlockedAppChange>& entries);
+    void applyBlockedAppChange(const BlockedAppChange& change, AppListModel* model);
+    void insertBlockedApp(const std::shared_ptr<AppModel>& app, AppListModel* model);
+    int blockedAppRow(const std::shared_ptr<AppModel>& app) const;
     void updateServiceStatus();
     void updateServiceButtons();
     void filterAppList(const QString& searchText, bool isInstalledList);
     void loadTimeSettings();
+    void showTimeSettings(const std::shared_ptr<BlockTimeSettingsModel>& settings);
     void saveTimeSettings();
     void setupApiService();
     
@@ -88,11 +97,20 @@ private:
     QList<std::shared_ptr<AppModel>> m_blockedApps;
     QList<std::shared_ptr<AppModel>> m_filteredInstalledApps;
     QList<std::shared_ptr<AppModel>> m_filteredBlockedApps;
+    // m_blockedApps by path, and the rule revision it reflects; changes
+    // from the database are applied on top of it one row at a time
+    QHash<PathKey, std::shared_ptr<AppModel>> m_blockedAppsByKey;
+    quint64 m_blockedAppsRevision;
+    // Loads still in flight; changes reported meanwhile are part of them
+    int m_pendingBlockedAppLoads;
 
     // Core components
     AppDetector *m_appDetector;
     AppMonitor *m_appMonitor;
+    QThread *m_monitorThread;
     Database *m_database;
+    AsyncDatabase *m_asyncDatabase;
+    BlockJournal *m_blockJournal;
     WinService *m_service;
     ApiService *m_apiService;
 
@@ -0,0 +1,250 @@
+#include <QtTest>
+#include <QElapsedTimer>
+#include <QSignalSpy>
+#include <QThread>
+#include <algorithm>
+#include <atomic>
+
+#include "core/appdetector.h"
+#include "core/installdirectoryindex.h"
+#include "core/installedappresolver.h"
+#include "core/recordedinstallsource.h"
+#include "data/appmodel.h"
+#include "testfakes.h"
+
+// A replayed machine that counts what it is asked, each call standing for
+// a registry read or a file system call on a real one. Every call can
+// wait latency microseconds first, the way a cold disk or registry would.
+class CountingInstallSource : public InstallSource
+{
+public:
+    explicit CountingInstallSource(unsigned long latency = 0) : m_latency(latency) {}
+
+    bool load(const QJsonObject& fixture) { return m_source.load(fixture); }
+
+    // Registry reads
+    int registryCalls() const { return m_registryCalls; }
+    // isFile(), isDirectory() and lastModified()
+    int probes() const { return m_probes; }
+    // executables() and subdirectories(), each one directory listing
+    int listings() const { return m_listings; }
+    void resetCounts()
+    {
+        m_registryCalls = 0;
+        m_probes = 0;
+        m_listings = 0;
+    }
+
+    QStringList registryRoots() const override { count(m_registryCalls); return m_source.registryRoots(); }
+    QList<InstalledAppEntry> readEntries(const QString& registryRoot) const override
+    {
+        count(m_registryCalls);
+        return m_source.readEntries(registryRoot);
+    }
+    QHash<QString, qint64> keyWriteTimes(const QString& registryRoot) const override
+    {
+        count(m_registryCalls);
+        return m_source.keyWriteTimes(registryRoot);
+    }
+
+    // Read from the environment, not the file system
+    QStringList programDirectories() const override { return m_source.programDirectories(); }
+    bool isFile(const QString& path) const override { count(m_probes); return m_source.isFile(path); }
+    bool isDirectory(const QString& path) const override { count(m_probes); return m_source.isDirectory(path); }
+    qint64 lastModified(const QString& path) const override { count(m_probes); return m_source.lastModified(path); }
+    QStringList executables(const QString& directory) const override
+    {
+        count(m_listings);
+        return m_source.executables(directory);
+    }
+    QStringList subdirectories(const QString& directory) const override
+    {
+        count(m_listings);
+        return m_source.subdirectories(directory);
+    }
+
+private:
+    void count(std::atomic<int>& calls) const
+    {
+        ++calls;
+        if (m_latency > 0)
+            QThread::usleep(m_latency);
+    }
+
+    RecordedInstallSource m_source;
+    unsigned long m_latency;
+    mutable std::atomic<int> m_registryCalls{0};
+    mutable std::atomic<int> m_probes{0};
+    mutable std::atomic<int> m_listings{0};
+};
+
+// Resolves every listed entry of source on this thread, the way refreshes
+// used to, and returns the executables found
+static QSet<PathKey> resolveSerially(const InstallSource& source)
+{
+    const InstalledAppResolver resolver(source);
+    QSet<PathKey> found;
+    for (const QString& root : source.registryRoots()) {
+        for (const InstalledAppEntry& entry : source.readEntries(root)) {
+            if (entry.displayName.isEmpty() || entry.systemComponent)
+                continue;
+            const QString exePath = resolver.resolve(entry);
+            if (!exePath.isEmpty())
+                found.insert(PathKey(exePath));
+        }
+    }
+    return found;
+}
+
+// A full refresh of generated machines, replayed through
+// RecordedInstallSource so every run sees the same keys and directories.
+//
+// replay times refreshInstalledApps() until installedAppsChanged, with no
+// cache, and reports the median of its rounds. serialAndParallel resolves
+// a 400 key machine once on one thread and once through the detector's
+// pools; both go through a directory index, so only the threading
+// differs. callsPerRefresh counts what the resolver asks the system for,
+// straight and through InstallDirectoryIndex.
+class BenchAppDetector : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void replay_data();
+    void replay();
+    void serialAndParallel_data();
+    void serialAndParallel();
+    void callsPerRefresh_data();
+    void callsPerRefresh();
+};
+
+static const int kRounds = 5;
+
+void BenchAppDetector::replay_data()
+{
+    QTest::addColumn<int>("entries");
+    QTest::newRow("100 entries") << 100;
+    QTest::newRow("1k entries") << 1000;
+    QTest::newRow("10k entries") << 10000;
+}
+
+void BenchAppDetector::replay()
+{
+    QFETCH(int, entries);
+
+    QStringList expected;
+    auto source = std::make_unique<RecordedInstallSource>();
+    QVERIFY(source->load(generatedInstallFixture(entries, &expected)));
+    QSet<PathKey> expectedKeys;
+    for (const QString& path : expected)
+        expectedKeys.insert(PathKey(path));
+
+    AppDetector detector(std::move(source), QString());
+    QSignalSpy finished(&detector, &AppDetector::installedAppsChanged);
+    QVector<double> refreshes;
+    for (int round = 0; round < kRounds; ++round) {
+        finished.clear();
+        QElapsedTimer elapsed;
+        elapsed.start();
+        detector.refreshInstalledApps();
+        QVERIFY(finished.wait(60000));
+        refreshes.append(elapsed.nsecsElapsed() / 1e6);
+
+        // Every resolvable entry once, duplicate keys included
+        QSet<PathKey> found;
+        for (const std::shared_ptr<AppModel>& app : detector.getInstalledApps())
+            found.insert(PathKey(app->getPath()));
+        QCOMPARE(int(found.size()), int(expectedKeys.size()));
+        QVERIFY(found == expectedKeys);
+    }
+
+    std::sort(refreshes.begin(), refreshes.end());
+    const double median = refreshes[refreshes.size() / 2];
+    qInfo("%s: %d apps, median %.2f ms (%.0f entries/s), min %.2f ms, max %.2f ms over %d rounds",
+          QTest::currentDataTag(), int(expectedKeys.size()), median, entries * 1000.0 / median,
+          refreshes.first(), refreshes.last(), kRounds);
+}
+
+void BenchAppDetector::serialAndParallel_data()
+{
+    QTest::addColumn<int>("latency");
+    QTest::newRow("no latency") << 0;
+    QTest::newRow("200 us per call") << 200;
+}
+
+void BenchAppDetector::serialAndParallel()
+{
+    QFETCH(int, latency);
+
+    QStringList expected;
+    const QJsonObject fixture = generatedInstallFixture(400, &expected);
+
+    CountingInstallSource serialSource(latency);
+    QVERIFY(serialSource.load(fixture));
+    QElapsedTimer elapsed;
+    elapsed.start();
+    const QSet<PathKey> serial = resolveSerially(InstallDirectoryIndex(serialSource));
+    const double serialTime = elapsed.nsecsElapsed() / 1e6;
+    QCOMPARE(int(serial.size()), int(expected.size()));
+
+    auto parallelSource = std::make_unique<CountingInstallSource>(latency);
+    QVERIFY(parallelSource->load(fixture));
+    AppDetector detector(std::move(parallelSource), QString());
+    QSignalSpy finished(&detector, &AppDetector::installedAppsChanged);
+    elapsed.restart();
+    detector.refreshInstalledApps();
+    QVERIFY(finished.wait(60000));
+    const double parallelTime = elapsed.nsecsElapsed() / 1e6;
+    QCOMPARE(int(detector.getInstalledApps().size()), int(expected.size()));
+
+    qInfo("%s: %d apps, serial %.2f ms, parallel %.2f ms on %d threads (%.1fx)",
+          QTest::currentDataTag(), int(expected.size()), serialTime, parallelTime,
+          QThread::idealThreadCount() * 2, serialTime / parallelTime);
+}
+
+void BenchAppDetector::callsPerRefresh_data()
+{
+    QTest::addColumn<int>("entries");
+    QTest::newRow("100 entries") << 100;
+    QTest::newRow("1k entries") << 1000;
+    QTest::newRow("10k entries") << 10000;
+}
+
+void BenchAppDetector::callsPerRefresh()
+{
+    QFETCH(int, entries);
+
+    QStringList expected;
+    CountingInstallSource source;
+    QVERIFY(source.load(generatedInstallFixture(entries, &expected)));
+
+    QCOMPARE(int(resolveSerially(source).size()), int(expected.size()));
+    const int straightProbes = source.probes();
+    const int straightListings = source.listings();
+
+    source.resetCounts();
+    QCOMPARE(int(resolveSerially(InstallDirectoryIndex(source)).size()), int(expected.size()));
+    const int indexedProbes = source.probes();
+    const int indexedListings = source.listings();
+
+    // A whole refresh also stamps every app with its directory's mtime
+    auto refreshSource = std::make_unique<CountingInstallSource>();
+    QVERIFY(refreshSource->load(generatedInstallFixture(entries)));
+    const CountingInstallSource& refreshed = *refreshSource;
+    AppDetector detector(std::move(refreshSource), QString());
+    QSignalSpy finished(&detector, &AppDetector::installedAppsChanged);
+    detector.refreshInstalledApps();
+    QVERIFY(finished.wait(60000));
+
+    qInfo("%s: without the index %d probes and %d listings (%.1f per entry), "
+          "with it %d probes and %d listings (%.1f per entry); a refresh makes %d registry reads, "
+          "%d probes and %d listings",
+          QTest::currentDataTag(),
+          straightProbes, straightListings, double(straightProbes + straightListings) / entries,
+          indexedProbes, indexedListings, double(indexedProbes + indexedListings) / entries,
+          refreshed.registryCalls(), refreshed.probes(), refreshed.listings());
+    QVERIFY(indexedProbes + indexedListings <= straightProbes + straightListings);
+}
+
+QTEST_GUILESS_MAIN(BenchAppDetector)
+#include "bench_appdetector.moc"
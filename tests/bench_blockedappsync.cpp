@@ -0,0 +1,96 @@
+#include <QtTest>
+#include <QElapsedTimer>
+
+#include "data/database.h"
+#include "testfakes.h"
+
+// A server sync over an existing block list, the way
+// ApiService::processBlockedAppsResponse applies one: the server lists as
+// many rules as are stored, a tenth of them new, and a tenth of the
+// stored ones are no longer listed and get deactivated.
+//
+// "per row" is what the sync did before applyBlockedAppBatch: one
+// addBlockedApp per listed rule and one removeBlockedApp per dropped one,
+// each its own transaction that republishes the rules. "batch" applies
+// the same changes in one applyBlockedAppBatch. Per row at 10k rules
+// takes long enough that every row runs once.
+class BenchBlockedAppSync : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void sync_data();
+    void sync();
+};
+
+static QString appPath(int i)
+{
+    return QString("C:/Program Files/App %1/app%1.exe").arg(i);
+}
+
+void BenchBlockedAppSync::sync_data()
+{
+    QTest::addColumn<int>("rules");
+    QTest::addColumn<bool>("batch");
+
+    for (int rules : { 1000, 10000 }) {
+        QTest::addRow("per row, %d rules", rules) << rules << false;
+        QTest::addRow("batch, %d rules", rules) << rules << true;
+    }
+}
+
+void BenchBlockedAppSync::sync()
+{
+    QFETCH(int, rules);
+    QFETCH(bool, batch);
+
+    resetTestData();
+    Database database;
+    QVERIFY(database.initialize());
+    QList<BlockedAppChange> stored;
+    for (int i = 0; i < rules; ++i)
+        stored.append(BlockedAppChange{appPath(i), QString("app%1.exe").arg(i)});
+    QVERIFY(database.applyBlockedAppBatch(stored).success);
+
+    // The server lists apps dropped .. rules + dropped - 1, so the first
+    // dropped stored ones are gone from it
+    const int dropped = rules / 10;
+    QList<BlockedAppChange> changes;
+    for (int i = dropped; i < rules + dropped; ++i)
+        changes.append(BlockedAppChange{appPath(i), QString("app%1.exe").arg(i)});
+    for (int i = 0; i < dropped; ++i)
+        changes.append(BlockedAppChange{appPath(i), QString("app%1.exe").arg(i), RuleType::Exact, false});
+
+    QElapsedTimer elapsed;
+    elapsed.start();
+    BlockedAppBatchResult result;
+    if (batch) {
+        result = database.applyBlockedAppBatch(changes);
+        QVERIFY(result.success);
+    } else {
+        for (const BlockedAppChange& change : changes) {
+            if (change.blocked)
+                QVERIFY(database.addBlockedApp(change.appPath, change.appName, change.ruleType));
+            else
+                QVERIFY(database.removeBlockedApp(change.appPath));
+        }
+    }
+    const double time = elapsed.nsecsElapsed() / 1e6;
+
+    // Both leave the same rules behind
+    QCOMPARE(int(database.getBlockedAppEntries(true).size()), rules);
+    QVERIFY(database.isAppBlocked(appPath(rules + dropped - 1)));
+    QVERIFY(!database.isAppBlocked(appPath(0)));
+
+    if (batch) {
+        qInfo("%s: %.2f ms for %d changes (%d added, %d updated, %d deactivated, %d unchanged)",
+              QTest::currentDataTag(), time, int(changes.size()),
+              result.inserted, result.updated, result.deactivated, result.unchanged);
+    } else {
+        qInfo("%s: %.2f ms for %d changes (%.3f ms each)",
+              QTest::currentDataTag(), time, int(changes.size()), time / changes.size());
+    }
+}
+
+QTEST_GUILESS_MAIN(BenchBlockedAppSync)
+#include "bench_blockedappsync.moc"
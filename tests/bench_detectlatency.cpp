@@ -0,0 +1,172 @@
+#include <QtTest>
+#include <QElapsedTimer>
+#include <QProcess>
+#include <algorithm>
+
+#include "core/appmonitor.h"
+#include "data/database.h"
+#include "testfakes.h"
+
+// Time from a blocked app's window appearing to AppMonitor::detectionsAvailable,
+// with process start events and with the one second polling fallback. The
+// monitor runs on fakes, so this measures the monitor and its timers; the
+// last case measures how fast the Linux proc connector reports a start.
+class BenchDetectLatency : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void eventLatency_data();
+    void eventLatency();
+    void pollingLatency();
+    void procConnectorLatency();
+
+private:
+    // Samples in ms; returns the median and logs it with the maximum
+    static double report(const char* what, QVector<double> samples);
+    void measure(bool events, int windowDelay, int samples, QVector<double>& latencies);
+};
+
+static const QString kBlockedPath = QStringLiteral("C:/Games/game.exe");
+
+double BenchDetectLatency::report(const char* what, QVector<double> samples)
+{
+    std::sort(samples.begin(), samples.end());
+    const double median = samples[samples.size() / 2];
+    qInfo("%s: median %.2f ms, max %.2f ms over %d samples",
+          what, median, samples.last(), int(samples.size()));
+    return median;
+}
+
+void BenchDetectLatency::measure(bool events, int windowDelay, int samples, QVector<double>& latencies)
+{
+    resetTestData();
+    Database database;
+    QVERIFY(database.initialize());
+    QVERIFY(database.addBlockedApp(kBlockedPath, "game.exe"));
+
+    auto ownedProcesses = std::make_unique<FakeProcessSource>();
+    FakeProcessSource* processes = ownedProcesses.get();
+    auto ownedWindows = std::make_unique<FakeWindowSource>();
+    FakeWindowSource* windows = ownedWindows.get();
+    FakeProcessEventSource* processEvents = new FakeProcessEventSource(events);
+
+    // A Monday morning, inside the default 08:00-17:00 weekday window
+    AppMonitor monitor(&database, std::make_unique<FakeClock>(QDateTime(QDate(2024, 1, 8), QTime(10, 0))),
+                       std::move(ownedProcesses), std::move(ownedWindows), processEvents);
+    monitor.startMonitoring();
+
+    QElapsedTimer clock;
+    clock.start();
+    qint64 shownAt = -1;
+    qint64 detectedAt = -1;
+    connect(&monitor, &AppMonitor::detectionsAvailable, this, [&]() {
+        detectedAt = clock.nsecsElapsed();
+        monitor.drainDetections();
+    });
+
+    for (int sample = 0; sample < samples; ++sample) {
+        const quint32 pid = quint32(2000 + sample * 4);
+        const quintptr window = quintptr(0x20000 + sample);
+        shownAt = -1;
+        detectedAt = -1;
+
+        processes->add(pid, kBlockedPath);
+        auto show = [&, pid, window]() {
+            windows->add(pid, window);
+            shownAt = clock.nsecsElapsed();
+        };
+
+        if (windowDelay == 0)
+            show();
+        if (events)
+            emit processEvents->processStarted(pid);
+        if (windowDelay > 0)
+            QTimer::singleShot(windowDelay, this, show);
+
+        QTRY_VERIFY_WITH_TIMEOUT(detectedAt >= 0 && shownAt >= 0, 3000);
+        latencies.append((detectedAt - shownAt) / 1e6);
+
+        // Gone before the next sample, so each one starts from nothing
+        processes->remove(pid);
+        if (events)
+            emit processEvents->processExited(pid);
+    }
+
+    monitor.stopMonitoring();
+}
+
+void BenchDetectLatency::eventLatency_data()
+{
+    QTest::addColumn<int>("windowDelay");
+    QTest::newRow("window open at start") << 0;
+    QTest::newRow("window after 30 ms") << 30;
+    QTest::newRow("window after 200 ms") << 200;
+}
+
+void BenchDetectLatency::eventLatency()
+{
+    QFETCH(int, windowDelay);
+    QVector<double> latencies;
+    measure(true, windowDelay, 20, latencies);
+    if (QTest::currentTestFailed())
+        return;
+
+    // A window that shows up after the start event is caught by the
+    // short poll of the new process
+    const double median = report(QTest::currentDataTag(), latencies);
+    QVERIFY2(median < 50, "median detection latency over 50 ms");
+}
+
+void BenchDetectLatency::pollingLatency()
+{
+    // No events: the process is only found by the next full scan
+    QVector<double> latencies;
+    measure(false, 0, 5, latencies);
+    if (QTest::currentTestFailed())
+        return;
+
+    report("polling", latencies);
+}
+
+void BenchDetectLatency::procConnectorLatency()
+{
+#ifdef Q_OS_LINUX
+    NetlinkProcessEventSource source;
+    if (!source.start())
+        QSKIP("The proc connector needs CAP_NET_ADMIN");
+
+    QElapsedTimer clock;
+    clock.start();
+    qint64 startedAt = -1;
+    qint64 reportedAt = -1;
+    quint32 expected = 0;
+    connect(&source, &ProcessEventSource::processStarted, this, [&](quint32 pid) {
+        if (pid == expected && reportedAt < 0)
+            reportedAt = clock.nsecsElapsed();
+    });
+
+    QVector<double> latencies;
+    for (int sample = 0; sample < 10; ++sample) {
+        QProcess process;
+        reportedAt = -1;
+        startedAt = clock.nsecsElapsed();
+        process.start("/bin/true", QStringList());
+        QVERIFY(process.waitForStarted());
+        expected = quint32(process.processId());
+
+        // Sandboxes may accept the subscription and never deliver
+        if (!QTest::qWaitFor([&]() { return reportedAt >= 0; }, 2000))
+            QSKIP("No proc connector events delivered");
+        latencies.append((reportedAt - startedAt) / 1e6);
+        process.waitForFinished();
+    }
+
+    report("proc connector exec event", latencies);
+#else
+    QSKIP("Linux only");
+#endif
+}
+
+QTEST_GUILESS_MAIN(BenchDetectLatency)
+#include "bench_detectlatency.moc"
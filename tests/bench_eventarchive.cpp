@@ -0,0 +1,152 @@
+#include <QtTest>
+#include <QRandomGenerator>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <algorithm>
+
+#include "data/database.h"
+#include "data/eventarchive.h"
+#include "testfakes.h"
+
+// A synthetic year of block events, 2000 a day between 08:00 and 22:00
+// across 50 apps, archived into twelve monthly segments.
+//
+// The size is compared with the same rows in a SQLite table shaped like
+// a block_events partition. Scans read every segment in full, and one
+// day out of a month, which skips the blocks outside it.
+class BenchEventArchive : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void compressionRatio();
+    void fullScan();
+    void dayScan();
+
+private:
+    QString m_directory;
+    QList<QList<BlockEvent>> m_months;
+    qint64 m_eventCount = 0;
+};
+
+static const int kEventsPerDay = 2000;
+static const int kApps = 50;
+
+void BenchEventArchive::initTestCase()
+{
+    resetTestData();
+    m_directory = QDir(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation)).filePath("archive");
+    QVERIFY(QDir().mkpath(m_directory));
+
+    QRandomGenerator random(2023);
+    QStringList paths;
+    for (int i = 0; i < kApps; ++i)
+        paths.append(QString("C:/Program Files/Vendor %1/App %1/app%1.exe").arg(i));
+
+    for (int month = 1; month <= 12; ++month) {
+        QList<BlockEvent> events;
+        const QDate first(2023, month, 1);
+        for (QDate day = first; day.month() == month; day = day.addDays(1)) {
+            const qint64 opens = QDateTime(day, QTime(8, 0)).toMSecsSinceEpoch();
+            QList<qint64> times;
+            for (int i = 0; i < kEventsPerDay; ++i)
+                times.append(opens + random.bounded(14 * 3600 * 1000));
+            std::sort(times.begin(), times.end());
+            for (qint64 timestamp : times) {
+                // A few apps get most of the attempts, most launches are
+                // dismissed rather than killed
+                const int app = qMin(random.bounded(kApps), random.bounded(kApps));
+                const quint32 roll = random.bounded(10);
+                const BlockEventKind kind = roll < 6 ? BlockEventKind::Launched
+                                          : roll < 9 ? BlockEventKind::Dismissed
+                                                     : BlockEventKind::ForceClosed;
+                events.append(BlockEvent{timestamp, kind, paths[app], QString("app%1.exe").arg(app)});
+            }
+        }
+        QVERIFY(EventArchive::write(EventArchive::segmentPath(m_directory, first), events));
+        m_eventCount += events.size();
+        m_months.append(events);
+    }
+}
+
+void BenchEventArchive::compressionRatio()
+{
+    qint64 archived = 0;
+    for (int month = 1; month <= 12; ++month)
+        archived += QFileInfo(EventArchive::segmentPath(m_directory, QDate(2023, month, 1))).size();
+
+    // The same rows as the partitions hold them, in a scratch database
+    qint64 sqlite = 0;
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", "bench_eventarchive");
+        db.setDatabaseName(QDir(m_directory).filePath("partition.db"));
+        QVERIFY(db.open());
+        QSqlQuery query(db);
+        QVERIFY(query.exec("CREATE TABLE block_events (timestamp INTEGER NOT NULL, "
+                           "appId INTEGER NOT NULL, kind INTEGER NOT NULL)"));
+        QVERIFY(db.transaction());
+        QVERIFY(query.prepare("INSERT INTO block_events (timestamp, appId, kind) VALUES (?, ?, ?)"));
+        QHash<QString, int> appIds;
+        for (const QList<BlockEvent>& events : m_months) {
+            for (const BlockEvent& event : events) {
+                if (!appIds.contains(event.appPath))
+                    appIds.insert(event.appPath, int(appIds.size()) + 1);
+                query.addBindValue(event.timestamp);
+                query.addBindValue(appIds.value(event.appPath));
+                query.addBindValue(int(event.kind));
+                QVERIFY(query.exec());
+            }
+        }
+        QVERIFY(db.commit());
+        QVERIFY(query.exec("PRAGMA page_count") && query.next());
+        sqlite = query.value(0).toLongLong();
+        QVERIFY(query.exec("PRAGMA page_size") && query.next());
+        sqlite *= query.value(0).toLongLong();
+    }
+    QSqlDatabase::removeDatabase("bench_eventarchive");
+    QFile::remove(QDir(m_directory).filePath("partition.db"));
+
+    qInfo("%lld events: %lld bytes archived (%.2f bytes/event), %lld bytes in SQLite, %.1fx smaller",
+          m_eventCount, archived, double(archived) / m_eventCount, sqlite, double(sqlite) / archived);
+}
+
+void BenchEventArchive::fullScan()
+{
+    qint64 read = 0;
+    QBENCHMARK {
+        read = 0;
+        for (int month = 1; month <= 12; ++month) {
+            EventArchiveReader reader;
+            QVERIFY(reader.open(EventArchive::segmentPath(m_directory, QDate(2023, month, 1))));
+            BlockEvent event;
+            while (reader.next(event))
+                ++read;
+            QVERIFY(!reader.hasError());
+        }
+    }
+    QCOMPARE(read, m_eventCount);
+}
+
+void BenchEventArchive::dayScan()
+{
+    const QDate day(2023, 6, 15);
+    const qint64 from = day.startOfDay().toMSecsSinceEpoch();
+    const qint64 to = day.addDays(1).startOfDay().toMSecsSinceEpoch() - 1;
+
+    qint64 read = 0;
+    QBENCHMARK {
+        read = 0;
+        EventArchiveReader reader;
+        QVERIFY(reader.open(EventArchive::segmentPath(m_directory, QDate(2023, 6, 1))));
+        reader.setRange(from, to);
+        BlockEvent event;
+        while (reader.next(event))
+            ++read;
+        QVERIFY(!reader.hasError());
+    }
+    QCOMPARE(read, qint64(kEventsPerDay));
+}
+
+QTEST_GUILESS_MAIN(BenchEventArchive)
+#include "bench_eventarchive.moc"
@@ -0,0 +1,95 @@
+#include <QtTest>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <algorithm>
+
+#include "data/asyncdatabase.h"
+#include "data/blockjournal.h"
+#include "data/database.h"
+#include "testfakes.h"
+
+// The block journal under a sustained load, recorded from a timer on the
+// test thread the way the overlay and the monitor record from the UI
+// thread. Each row records its rate for three seconds, spread over 100
+// apps, and reports what record() cost the caller, how long the database
+// thread was busy writing and whether anything was dropped.
+class BenchJournal : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void sustainedRate_data();
+    void sustainedRate();
+};
+
+static const int kTick = 10;
+static const int kDuration = 3000;
+static const int kApps = 100;
+
+void BenchJournal::sustainedRate_data()
+{
+    QTest::addColumn<int>("perSecond");
+    QTest::newRow("1k events/s") << 1000;
+    QTest::newRow("10k events/s") << 10000;
+    QTest::newRow("50k events/s") << 50000;
+}
+
+void BenchJournal::sustainedRate()
+{
+    QFETCH(int, perSecond);
+    resetTestData();
+
+    Database database;
+    QVERIFY(database.initialize());
+    AsyncDatabase async(&database);
+    QStringList paths;
+    for (int i = 0; i < kApps; ++i)
+        paths.append(QString("C:/Program Files/App %1/app%1.exe").arg(i));
+
+    const int perTick = perSecond * kTick / 1000;
+    const int ticks = kDuration / kTick;
+    QVector<double> costs;
+    costs.reserve(perTick * ticks);
+    quint64 dropped = 0;
+    QElapsedTimer wall;
+    {
+        BlockJournal journal(&async);
+        QEventLoop loop;
+        QTimer timer;
+        timer.setTimerType(Qt::PreciseTimer);
+        int tick = 0;
+        connect(&timer, &QTimer::timeout, &loop, [&]() {
+            for (int i = 0; i < perTick; ++i) {
+                const QString& path = paths[(tick * perTick + i) % kApps];
+                QElapsedTimer cost;
+                cost.start();
+                journal.record(BlockEventKind::Launched, path, QStringLiteral("app.exe"));
+                costs.append(cost.nsecsElapsed() / 1e3);
+            }
+            if (++tick == ticks)
+                loop.quit();
+        });
+        wall.start();
+        timer.start(kTick);
+        loop.exec();
+        dropped = journal.droppedEvents();
+    }
+    const qint64 elapsed = wall.elapsed();
+
+    const QDateTime now = QDateTime::currentDateTime();
+    int written = 0;
+    for (const BlockEventCount& count : database.getHourlyBlockEventCounts(now.addDays(-1), now.addDays(1)))
+        written += count.count;
+
+    std::sort(costs.begin(), costs.end());
+    auto percentile = [&costs](double p) { return costs[qMin(int(costs.size() * p), int(costs.size()) - 1)]; };
+    qInfo("%s: %d recorded in %lld ms, %d written, %llu dropped; record() p50 %.2f us, p99 %.2f us, max %.2f us; "
+          "database thread busy %lld ms in %llu jobs",
+          QTest::currentDataTag(), int(costs.size()), elapsed, written, dropped,
+          percentile(0.5), percentile(0.99), costs.last(),
+          async.busyTime(), async.jobCount());
+    QCOMPARE(quint64(written) + dropped, quint64(costs.size()));
+}
+
+QTEST_GUILESS_MAIN(BenchJournal)
+#include "bench_journal.moc"
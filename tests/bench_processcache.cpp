@@ -0,0 +1,172 @@
+#include <QtTest>
+
+#include "core/processcache.h"
+#include "data/rulematcher.h"
+
+// A machine with a fixed number of processes where the oldest ones exit
+// and new ones start between ticks. Counts how often a path is resolved,
+// which is what OpenProcess/QueryFullProcessImageName cost for real.
+class ChurningProcessSource : public ProcessSource
+{
+public:
+    explicit ChurningProcessSource(int count)
+    {
+        for (int i = 0; i < count; ++i)
+            spawn();
+    }
+
+    void churn(int count)
+    {
+        for (int i = 0; i < count && !m_processes.isEmpty(); ++i) {
+            m_processes.removeFirst();
+            spawn();
+        }
+    }
+
+    int resolves() const { return m_resolves; }
+
+    bool snapshot(QVector<ProcessEntry>& processes) override
+    {
+        processes = m_processes;
+        return true;
+    }
+
+    bool query(quint32 pid, ProcessEntry& process) override
+    {
+        for (const ProcessEntry& entry : m_processes) {
+            if (entry.pid == pid) {
+                process = entry;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    QString resolvePath(const ProcessEntry& process) override
+    {
+        ++m_resolves;
+        return QString("C:/Program Files/App %1/app%1.exe").arg(process.pid % 500);
+    }
+
+private:
+    void spawn()
+    {
+        m_processes.append(ProcessEntry{m_nextPid, quint64(m_nextPid) * 7919});
+        m_nextPid += 4;
+    }
+
+    QVector<ProcessEntry> m_processes;
+    quint32 m_nextPid = 4;
+    int m_resolves = 0;
+};
+
+// One monitor tick is a refresh of the cache against the current rules.
+// "uncached" clears the cache before every tick, which is what resolving
+// every process on every tick used to cost.
+class BenchProcessCache : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void hitRate();
+    void fakeTick_data();
+    void fakeTick();
+    void systemTick_data();
+    void systemTick();
+
+private:
+    static RuleMatcher rules();
+};
+
+static const int kProcessCount = 300;
+// Processes replaced per one second tick
+static const int kChurnPerTick = 3;
+
+RuleMatcher BenchProcessCache::rules()
+{
+    QList<BlockRule> blocked;
+    for (int i = 0; i < 100; ++i)
+        blocked.append(BlockRule{QString("C:/Program Files/App %1/app%1.exe").arg(i * 5), RuleType::Exact});
+    return RuleMatcher(blocked);
+}
+
+void BenchProcessCache::hitRate()
+{
+    auto owned = std::make_unique<ChurningProcessSource>(kProcessCount);
+    ChurningProcessSource* source = owned.get();
+    ProcessCache cache(std::move(owned));
+    const RuleMatcher matcher = rules();
+    const ProcessCache::BlockDecider decider = [&matcher](const PathKey& key) { return matcher.matches(key); };
+
+    // Ten minutes of one second ticks
+    const int ticks = 600;
+    for (int tick = 0; tick < ticks; ++tick) {
+        source->churn(kChurnPerTick);
+        QCOMPARE(int(cache.refresh(1, decider).size()), kProcessCount);
+    }
+
+    const double hitRate = double(cache.hits()) / double(cache.hits() + cache.misses());
+    qInfo("%d processes, %d replaced per tick: hit rate %.4f, %.2f resolves per tick",
+          kProcessCount, kChurnPerTick, hitRate, double(source->resolves()) / ticks);
+    // Only the processes started since the previous tick are resolved
+    QCOMPARE(source->resolves(), kProcessCount + (ticks - 1) * kChurnPerTick);
+}
+
+void BenchProcessCache::fakeTick_data()
+{
+    QTest::addColumn<bool>("cached");
+    QTest::newRow("cached") << true;
+    QTest::newRow("uncached") << false;
+}
+
+void BenchProcessCache::fakeTick()
+{
+    QFETCH(bool, cached);
+    auto owned = std::make_unique<ChurningProcessSource>(kProcessCount);
+    ChurningProcessSource* source = owned.get();
+    ProcessCache cache(std::move(owned));
+    const RuleMatcher matcher = rules();
+    const ProcessCache::BlockDecider decider = [&matcher](const PathKey& key) { return matcher.matches(key); };
+    cache.refresh(1, decider);
+
+    QBENCHMARK {
+        source->churn(kChurnPerTick);
+        if (!cached)
+            cache.clear();
+        cache.refresh(1, decider);
+    }
+}
+
+void BenchProcessCache::systemTick_data()
+{
+    fakeTick_data();
+}
+
+void BenchProcessCache::systemTick()
+{
+#if defined(Q_OS_WIN) || defined(Q_OS_LINUX)
+    // The processes running on this machine, through the real backend
+    QFETCH(bool, cached);
+    ProcessCache cache(std::make_unique<SystemProcessSource>());
+    const RuleMatcher matcher = rules();
+    const ProcessCache::BlockDecider decider = [&matcher](const PathKey& key) { return matcher.matches(key); };
+    const int running = int(cache.refresh(1, decider).size());
+    QVERIFY(running > 0);
+
+    QBENCHMARK {
+        if (!cached)
+            cache.clear();
+        cache.refresh(1, decider);
+    }
+
+    if (cached) {
+        const double hitRate = double(cache.hits()) / double(cache.hits() + cache.misses());
+        qInfo("%d processes with a path: hit rate %.4f", running, hitRate);
+    }
+#else
+    QSKIP("No process source for this platform");
+#endif
+}
+
+QTEST_GUILESS_MAIN(BenchProcessCache)
+#include "bench_processcache.moc"
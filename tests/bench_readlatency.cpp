@@ -0,0 +1,127 @@
+#include <QtTest>
+#include <QElapsedTimer>
+#include <QThread>
+#include <algorithm>
+#include <atomic>
+
+#include "data/connectionpool.h"
+#include "data/database.h"
+#include "testfakes.h"
+
+// Reads of the active rules while another connection keeps committing
+// 50-row updates, the way the GUI and the service share foccuss.db.
+//
+// "rollback journal" opens both connections with SQLite's defaults, as
+// before the connection profile; "wal" with Database's own profile. Each
+// row runs for two seconds and reports how many reads finished and their
+// latency percentiles.
+class BenchReadLatency : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void readUnderWriter_data();
+    void readUnderWriter();
+};
+
+static const int kRuleCount = 2000;
+static const int kBatchSize = 50;
+static const qint64 kDuration = 2000;
+
+static bool rollbackProfile(QSqlDatabase& db)
+{
+    QSqlQuery query(db);
+    return query.exec("PRAGMA journal_mode = DELETE") && query.exec("PRAGMA synchronous = FULL");
+}
+
+void BenchReadLatency::initTestCase()
+{
+    resetTestData();
+
+    // Schema and rules through the real Database, then closed again so
+    // each row can pick its journal mode
+    Database database;
+    QVERIFY(database.initialize());
+    QList<BlockedAppChange> changes;
+    for (int i = 0; i < kRuleCount; ++i)
+        changes.append(BlockedAppChange{QString("C:/Program Files/App %1/app%1.exe").arg(i), QString("app%1.exe").arg(i)});
+    QVERIFY(database.applyBlockedAppBatch(changes).success);
+}
+
+void BenchReadLatency::readUnderWriter_data()
+{
+    QTest::addColumn<bool>("wal");
+    QTest::newRow("rollback journal") << false;
+    QTest::newRow("wal") << true;
+}
+
+void BenchReadLatency::readUnderWriter()
+{
+    QFETCH(bool, wal);
+    const QString path = QDir(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation)).filePath("foccuss.db");
+    const ConnectionPool::Profile profile = wal ? ConnectionPool::Profile(&Database::applyConnectionProfile)
+                                                : ConnectionPool::Profile(&rollbackProfile);
+
+    // Separate pools stand in for the two processes
+    ConnectionPool readers;
+    readers.configure("QSQLITE", path, "QSQLITE_BUSY_TIMEOUT=5000", profile);
+    ConnectionPool writers;
+    writers.configure("QSQLITE", path, "QSQLITE_BUSY_TIMEOUT=5000", profile);
+    QVERIFY(readers.connection().isOpen());
+
+    std::atomic<bool> stop(false);
+    std::atomic<int> commits(0);
+    QThread* writer = QThread::create([&]() {
+        QSqlDatabase db = writers.connection();
+        int round = 0;
+        while (!stop) {
+            db.transaction();
+            QSqlQuery& update = writers.statement("UPDATE blocked_apps SET appName = :appName WHERE pathKey = :pathKey");
+            for (int i = 0; i < kBatchSize; ++i) {
+                const int rule = (round * kBatchSize + i) % kRuleCount;
+                update.bindValue(":appName", QString("app%1 (%2).exe").arg(rule).arg(round));
+                update.bindValue(":pathKey", QString("c:/program files/app %1/app%1.exe").arg(rule));
+                update.exec();
+            }
+            if (db.commit())
+                ++commits;
+            ++round;
+        }
+    });
+    writer->start();
+
+    QVector<double> latencies;
+    QElapsedTimer elapsed;
+    elapsed.start();
+    int failed = 0;
+    while (elapsed.elapsed() < kDuration) {
+        QElapsedTimer read;
+        read.start();
+        QSqlQuery& select = readers.statement("SELECT pathKey, ruleType FROM blocked_apps WHERE isBlocked = 1");
+        int rows = 0;
+        if (select.exec()) {
+            while (select.next())
+                ++rows;
+        }
+        select.finish();
+        if (rows == kRuleCount)
+            latencies.append(read.nsecsElapsed() / 1e6);
+        else
+            ++failed;
+    }
+
+    stop = true;
+    QVERIFY(writer->wait());
+    delete writer;
+
+    QVERIFY(!latencies.isEmpty());
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&latencies](double p) { return latencies[qMin(int(latencies.size() * p), int(latencies.size()) - 1)]; };
+    qInfo("%s: %d reads (%d failed) against %d commits, p50 %.2f ms, p99 %.2f ms, max %.2f ms",
+          QTest::currentDataTag(), int(latencies.size()), failed, int(commits),
+          percentile(0.5), percentile(0.99), latencies.last());
+}
+
+QTEST_GUILESS_MAIN(BenchReadLatency)
+#include "bench_readlatency.moc"
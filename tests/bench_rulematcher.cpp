@@ -0,0 +1,244 @@
+#include <QtTest>
+#include <QElapsedTimer>
+#include <QRegularExpression>
+
+#include "data/rulematcher.h"
+#include "data/pathkey.h"
+
+// Lookups against the compiled rule set, the way the monitor checks every
+// running process. Each iteration looks up the same 1000 process paths,
+// a quarter of which are blocked. mixedRules runs 10k exact, prefix and
+// glob rules, compiled and checked one rule at a time.
+class BenchRuleMatcher : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void lookupKey_data();
+    void lookupKey();
+    void lookupPath_data();
+    void lookupPath();
+    void mixedRules_data();
+    void mixedRules();
+
+private:
+    static QList<BlockRule> exactRules(int count);
+    static QStringList processPaths(int ruleCount);
+    static QList<BlockRule> mixedRuleSet(int count);
+    static bool matchesOneByOne(const QList<BlockRule>& rules, const QString& key);
+    static void reportRate(const char* what, qint64 lookups, qint64 nsecs);
+};
+
+static const int kProcessCount = 1000;
+
+QList<BlockRule> BenchRuleMatcher::exactRules(int count)
+{
+    QList<BlockRule> rules;
+    rules.reserve(count);
+    for (int i = 0; i < count; ++i)
+        rules.append(BlockRule{QString("C:/Program Files/Vendor %1/App %1/app%1.exe").arg(i), RuleType::Exact});
+    return rules;
+}
+
+QStringList BenchRuleMatcher::processPaths(int ruleCount)
+{
+    QStringList paths;
+    paths.reserve(kProcessCount);
+    for (int i = 0; i < kProcessCount; ++i) {
+        // Same spelling the rule was stored with, in a different case
+        if (i % 4 == 0)
+            paths.append(QString("c:\\program files\\vendor %1\\app %1\\APP%1.EXE").arg(i % ruleCount));
+        else
+            paths.append(QString("C:/Windows/System32/svchost%1.exe").arg(i));
+    }
+    return paths;
+}
+
+void BenchRuleMatcher::reportRate(const char* what, qint64 lookups, qint64 nsecs)
+{
+    qInfo("%s: %.0f lookups/sec", what, nsecs > 0 ? lookups * 1e9 / nsecs : 0.0);
+}
+
+void BenchRuleMatcher::lookupKey_data()
+{
+    QTest::addColumn<int>("ruleCount");
+    QTest::newRow("10 rules") << 10;
+    QTest::newRow("1k rules") << 1000;
+    QTest::newRow("100k rules") << 100000;
+}
+
+void BenchRuleMatcher::lookupKey()
+{
+    // The monitor keeps a PathKey per cached process, so a tick only probes
+    QFETCH(int, ruleCount);
+    const RuleMatcher matcher(exactRules(ruleCount));
+
+    QVector<PathKey> keys;
+    for (const QString& path : processPaths(ruleCount))
+        keys.append(PathKey(path));
+
+    int blocked = 0;
+    for (const PathKey& key : keys)
+        blocked += matcher.matches(key);
+    QCOMPARE(blocked, kProcessCount / 4);
+
+    QBENCHMARK {
+        for (const PathKey& key : keys)
+            blocked += matcher.matches(key);
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    qint64 lookups = 0;
+    while (timer.elapsed() < 200) {
+        for (const PathKey& key : keys)
+            blocked += matcher.matches(key);
+        lookups += keys.size();
+    }
+    reportRate(QTest::currentDataTag(), lookups, timer.nsecsElapsed());
+}
+
+void BenchRuleMatcher::lookupPath_data()
+{
+    lookupKey_data();
+}
+
+void BenchRuleMatcher::lookupPath()
+{
+    // Database::isAppBlocked(), which normalizes the path on every call
+    QFETCH(int, ruleCount);
+    const RuleMatcher matcher(exactRules(ruleCount));
+    const QStringList paths = processPaths(ruleCount);
+
+    int blocked = 0;
+    for (const QString& path : paths)
+        blocked += matcher.matches(path);
+    QCOMPARE(blocked, kProcessCount / 4);
+
+    QBENCHMARK {
+        for (const QString& path : paths)
+            blocked += matcher.matches(path);
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    qint64 lookups = 0;
+    while (timer.elapsed() < 200) {
+        for (const QString& path : paths)
+            blocked += matcher.matches(path);
+        lookups += paths.size();
+    }
+    reportRate(QTest::currentDataTag(), lookups, timer.nsecsElapsed());
+}
+
+QList<BlockRule> BenchRuleMatcher::mixedRuleSet(int count)
+{
+    // 70% exact, 20% prefix, 10% glob, the globs split between a literal
+    // head, a literal tail and no anchor at all
+    QList<BlockRule> rules;
+    rules.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        switch (i % 10) {
+        case 7:
+        case 8:
+            rules.append(BlockRule{QString("C:/Program Files/Vendor %1/App %1").arg(i), RuleType::Prefix});
+            break;
+        case 9:
+            if (i % 30 == 9)
+                rules.append(BlockRule{QString("C:/Program Files/Vendor %1/*.exe").arg(i), RuleType::Glob});
+            else if (i % 30 == 19)
+                rules.append(BlockRule{QString("*/App %1/app?%1.exe").arg(i), RuleType::Glob});
+            else
+                rules.append(BlockRule{QString("*vendor %1/*/tool%1*").arg(i), RuleType::Glob});
+            break;
+        default:
+            rules.append(BlockRule{QString("C:/Program Files/Vendor %1/App %1/app%1.exe").arg(i), RuleType::Exact});
+            break;
+        }
+    }
+    return rules;
+}
+
+bool BenchRuleMatcher::matchesOneByOne(const QList<BlockRule>& rules, const QString& key)
+{
+    // Rules and key are already normalized; a glob goes through a regular
+    // expression as it would without a matcher of its own
+    for (const BlockRule& rule : rules) {
+        switch (rule.type) {
+        case RuleType::Exact:
+            if (key == rule.pattern)
+                return true;
+            break;
+        case RuleType::Prefix:
+            if (key.startsWith(rule.pattern)
+                && (key.size() == rule.pattern.size() || key[rule.pattern.size()] == u'/'))
+                return true;
+            break;
+        case RuleType::Glob: {
+            static QHash<QString, QRegularExpression> expressions;
+            auto expression = expressions.find(rule.pattern);
+            if (expression == expressions.end()) {
+                QString regex = QRegularExpression::escape(rule.pattern);
+                regex.replace("\\*", ".*").replace("\\?", ".");
+                expression = expressions.insert(rule.pattern, QRegularExpression(QRegularExpression::anchoredPattern(regex)));
+            }
+            if (expression->match(key).hasMatch())
+                return true;
+            break;
+        }
+        }
+    }
+    return false;
+}
+
+void BenchRuleMatcher::mixedRules_data()
+{
+    QTest::addColumn<bool>("compiled");
+    QTest::newRow("compiled") << true;
+    QTest::newRow("one by one") << false;
+}
+
+void BenchRuleMatcher::mixedRules()
+{
+    QFETCH(bool, compiled);
+    const int ruleCount = 10000;
+    const RuleMatcher matcher(mixedRuleSet(ruleCount));
+
+    QList<BlockRule> normalized = mixedRuleSet(ruleCount);
+    for (BlockRule& rule : normalized)
+        rule.pattern = PathKey(rule.pattern).toString();
+
+    // Exact hits, prefix hits below the directory, glob hits and misses
+    QVector<PathKey> keys;
+    for (int i = 0; i < kProcessCount; ++i) {
+        const int rule = (i * 37) % ruleCount;
+        if (i % 2 == 0)
+            keys.append(PathKey(QString("C:/Program Files/Vendor %1/App %1/bin/app%1.exe").arg(rule)));
+        else
+            keys.append(PathKey(QString("C:/Windows/System32/svchost%1.exe").arg(i)));
+    }
+
+    int blocked = 0;
+    int agreed = 0;
+    for (const PathKey& key : keys) {
+        const bool expected = matchesOneByOne(normalized, key.toString());
+        blocked += expected;
+        agreed += matcher.matches(key) == expected;
+    }
+    QCOMPARE(agreed, kProcessCount);
+    QVERIFY(blocked > 0);
+
+    QElapsedTimer timer;
+    timer.start();
+    qint64 lookups = 0;
+    QBENCHMARK {
+        for (const PathKey& key : keys) {
+            blocked += compiled ? matcher.matches(key) : matchesOneByOne(normalized, key.toString());
+        }
+        lookups += keys.size();
+    }
+    reportRate(QTest::currentDataTag(), lookups, timer.nsecsElapsed());
+}
+
+QTEST_GUILESS_MAIN(BenchRuleMatcher)
+#include "bench_rulematcher.moc"
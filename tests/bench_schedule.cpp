@@ -0,0 +1,147 @@
+#include <QtTest>
+
+#include "data/blockTimeSettingsModel.h"
+#include "data/compiledschedule.h"
+#include "data/database.h"
+#include "testfakes.h"
+
+// The "is it blocking now" check the monitor makes on every tick.
+//
+// "old" is Database::isBlockingNow() as it was before the schedule was
+// compiled: a read of the settings row from SQLite, then a time and day
+// comparison. "compiled" is the same question through the database's
+// compiled schedule, and "bitmap" the bare schedule with a growing number
+// of extra intervals, which all land in the same bitmap.
+class BenchSchedule : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void oldIsBlockingNow();
+    void compiledIsBlockingAt();
+    void bitmap_data();
+    void bitmap();
+    void nextTransition();
+
+private:
+    static bool oldIsBlockingAt(Database& database, const QDateTime& localTime);
+};
+
+static const QDateTime kMondayMorning(QDate(2024, 1, 8), QTime(10, 0));
+
+void BenchSchedule::initTestCase()
+{
+    resetTestData();
+}
+
+bool BenchSchedule::oldIsBlockingAt(Database& database, const QDateTime& localTime)
+{
+    if (!database.isInitialized()) return false;
+
+    auto settings = database.getBlockTimeSettings();
+    if (!settings || !settings->getActive()) {
+        return false;
+    }
+
+    QTime currentTime = localTime.time();
+    QTime startTime = settings->getStartTime();
+    QTime endTime = settings->getEndTime();
+
+    bool isWithinTimeRange = false;
+    if (startTime < endTime)
+        isWithinTimeRange = (currentTime >= startTime && currentTime <= endTime);
+    else
+        isWithinTimeRange = (currentTime >= startTime || currentTime <= endTime);
+
+    if (!isWithinTimeRange)
+        return false;
+
+    REG_Week week = settings->getWeek();
+    switch (localTime.date().dayOfWeek()) {
+        case 1: return week.monday;
+        case 2: return week.tuesday;
+        case 3: return week.wednesday;
+        case 4: return week.thursday;
+        case 5: return week.friday;
+        case 6: return week.saturday;
+        case 7: return week.sunday;
+        default: return false;
+    }
+}
+
+void BenchSchedule::oldIsBlockingNow()
+{
+    Database database;
+    QVERIFY(database.initialize());
+    QVERIFY(oldIsBlockingAt(database, kMondayMorning));
+
+    bool blocking = false;
+    QBENCHMARK {
+        blocking = oldIsBlockingAt(database, kMondayMorning);
+    }
+    QVERIFY(blocking);
+}
+
+void BenchSchedule::compiledIsBlockingAt()
+{
+    Database database;
+    QVERIFY(database.initialize());
+    QVERIFY(database.isBlockingAt(kMondayMorning));
+
+    bool blocking = false;
+    QBENCHMARK {
+        blocking = database.isBlockingAt(kMondayMorning);
+    }
+    QVERIFY(blocking);
+}
+
+void BenchSchedule::bitmap_data()
+{
+    QTest::addColumn<int>("intervals");
+    QTest::newRow("0 intervals") << 0;
+    QTest::newRow("10 intervals") << 10;
+    QTest::newRow("1000 intervals") << 1000;
+}
+
+void BenchSchedule::bitmap()
+{
+    QFETCH(int, intervals);
+    const REG_Week weekdays = { true, true, true, true, true, false, false };
+    BlockTimeSettingsModel settings(QTime(8, 0), QTime(17, 0), weekdays, true);
+    QList<REG_Interval> extra;
+    for (int i = 0; i < intervals; ++i) {
+        const QTime start = QTime(18, 0).addSecs((i % 300) * 60);
+        extra.append(REG_Interval{1 + i % 7, start, start.addSecs(30 * 60)});
+    }
+    settings.setIntervals(extra);
+    const CompiledSchedule schedule(settings);
+
+    // Walk the week a minute at a time so the lookups are not all the same
+    QDateTime time = kMondayMorning;
+    int blocked = 0;
+    QBENCHMARK {
+        blocked += schedule.isBlockingAt(time) ? 1 : 0;
+        time = time.addSecs(60);
+    }
+    Q_UNUSED(blocked);
+}
+
+void BenchSchedule::nextTransition()
+{
+    // Computed once per transition by the monitor instead of a poll a second
+    const REG_Week weekdays = { true, true, true, true, true, false, false };
+    BlockTimeSettingsModel settings(QTime(8, 0), QTime(17, 0), weekdays, true);
+    const CompiledSchedule schedule(settings);
+
+    // Friday evening: the scan runs over the whole weekend
+    const QDateTime fridayEvening(QDate(2024, 1, 12), QTime(17, 0));
+    QDateTime next;
+    QBENCHMARK {
+        next = schedule.nextTransition(fridayEvening);
+    }
+    QCOMPARE(next, QDateTime(QDate(2024, 1, 15), QTime(8, 0)));
+}
+
+QTEST_GUILESS_MAIN(BenchSchedule)
+#include "bench_schedule.moc"
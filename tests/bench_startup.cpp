@@ -0,0 +1,82 @@
+#include <QtTest>
+#include <QElapsedTimer>
+#include <QThread>
+#include <algorithm>
+
+#include "data/database.h"
+#include "testfakes.h"
+
+// Time from a fresh Database to the first rule enforced, the way the
+// service starts: "sqlite" opens the database, migrates and builds the
+// index from blocked_apps, "image" maps the compiled blocklist image and
+// reads the content revision to check it once the writer's checkpoint
+// moved the database files past the image's stamp.
+//
+// Every round starts on its own thread, so the connection it opens is
+// closed again with the thread, and reports the median of its rounds.
+class BenchStartup : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void firstEnforcement_data();
+    void firstEnforcement();
+};
+
+static const int kRounds = 20;
+
+void BenchStartup::firstEnforcement_data()
+{
+    QTest::addColumn<int>("rules");
+    QTest::addColumn<bool>("image");
+
+    for (int rules : { 100, 1000, 10000 }) {
+        QTest::addRow("sqlite, %d rules", rules) << rules << false;
+        QTest::addRow("image, %d rules", rules) << rules << true;
+    }
+}
+
+void BenchStartup::firstEnforcement()
+{
+    QFETCH(int, rules);
+    QFETCH(bool, image);
+
+    resetTestData();
+    const QString probe = QString("C:/Program Files/App %1/app%1.exe").arg(rules - 1);
+    {
+        // Closed before the first round, so its connection checkpoints the
+        // database behind the image the way a GUI that exited does
+        Database writer;
+        QVERIFY(writer.initialize());
+        QList<BlockedAppChange> changes;
+        for (int i = 0; i < rules; ++i)
+            changes.append(BlockedAppChange{QString("C:/Program Files/App %1/app%1.exe").arg(i), QString("app%1.exe").arg(i)});
+        QVERIFY(writer.applyBlockedAppBatch(changes).success);
+    }
+
+    QVector<double> startups;
+    int failed = 0;
+    for (int round = 0; round < kRounds; ++round) {
+        QThread* thread = QThread::create([&]() {
+            QElapsedTimer elapsed;
+            elapsed.start();
+            Database database;
+            const bool ready = image ? database.initializeFromImage() : database.initialize();
+            if (ready && database.isAppBlocked(probe))
+                startups.append(elapsed.nsecsElapsed() / 1e6);
+            else
+                ++failed;
+        });
+        thread->start();
+        QVERIFY(thread->wait());
+        delete thread;
+    }
+
+    QCOMPARE(failed, 0);
+    std::sort(startups.begin(), startups.end());
+    qInfo("%s: median %.2f ms, min %.2f ms, max %.2f ms over %d rounds",
+          QTest::currentDataTag(), startups[startups.size() / 2], startups.first(), startups.last(), kRounds);
+}
+
+QTEST_GUILESS_MAIN(BenchStartup)
+#include "bench_startup.moc"
@@ -0,0 +1,144 @@
+#include <QtTest>
+#include <QSet>
+
+#include "core/appmonitor.h"
+#include "data/database.h"
+#include "testfakes.h"
+
+// One window sweep with 2000 top-level windows, 50 of 300 processes
+// blocked and 4 windows open per blocked process.
+//
+// "old" replays the sweep as it was before the PID index, over the same
+// fake windows: a walk of the whole Z-order per blocked process, then a
+// copy and subtract of the seen-window set. "new" is the monitor's own
+// sweep (AppMonitor::checkBlockedWindows), one enumeration indexed by PID.
+// Both only cover the windows; bench_processcache covers the processes.
+class BenchWindowScan : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void oldSweep();
+    void newSweep();
+
+private:
+    static QString processPath(int i);
+    void addWindows(FakeWindowSource& windows) const;
+
+    QHash<quint32, QString> m_blocked;
+};
+
+static const int kWindowCount = 2000;
+static const int kProcessCount = 300;
+static const int kBlockedCount = 50;
+static const int kWindowsPerBlocked = 4;
+
+QString BenchWindowScan::processPath(int i)
+{
+    return QString("C:/Program Files/App %1/app%1.exe").arg(i);
+}
+
+void BenchWindowScan::initTestCase()
+{
+    for (int i = 0; i < kBlockedCount; ++i)
+        m_blocked.insert(quint32(1000 + i * 4), processPath(i));
+}
+
+void BenchWindowScan::addWindows(FakeWindowSource& windows) const
+{
+    // Blocked windows are spread through the Z-order, and a quarter of
+    // the rest are hidden or owned like tool windows and dialogs
+    const int blockedWindows = kBlockedCount * kWindowsPerBlocked;
+    const int stride = kWindowCount / blockedWindows;
+    int blocked = 0;
+    for (int i = 0; i < kWindowCount; ++i) {
+        if (i % stride == 0 && blocked < blockedWindows) {
+            windows.add(quint32(1000 + (blocked % kBlockedCount) * 4), quintptr(0x10000 + i));
+            ++blocked;
+            continue;
+        }
+        const quint32 pid = quint32(1000 + (kBlockedCount + i % (kProcessCount - kBlockedCount)) * 4);
+        windows.add(pid, quintptr(0x10000 + i), i % 8 != 0, i % 8 == 1);
+    }
+}
+
+void BenchWindowScan::oldSweep()
+{
+    FakeWindowSource windows;
+    addWindows(windows);
+
+    QSet<WindowId> seen;
+    int detected = 0;
+    auto sweep = [&]() {
+        QSet<WindowId> current;
+        for (auto process = m_blocked.cbegin(); process != m_blocked.cend(); ++process) {
+            // GetTopWindow/GetNextWindow with GetWindowThreadProcessId on
+            // every window, whether visible or not
+            for (const FakeWindowSource::Window& window : windows.zOrder()) {
+                if (window.pid != process.key())
+                    continue;
+                current.insert(window.id);
+                if (!seen.contains(window.id)) {
+                    seen.insert(window.id);
+                    ++detected;
+                }
+            }
+        }
+        QSet<WindowId> gone = seen;
+        gone.subtract(current);
+        for (WindowId window : gone)
+            seen.remove(window);
+    };
+
+    sweep();
+    QCOMPARE(detected, kBlockedCount * kWindowsPerBlocked);
+
+    QBENCHMARK {
+        sweep();
+    }
+    qInfo("old: %d windows visited per sweep", int(kWindowCount * m_blocked.size()));
+}
+
+void BenchWindowScan::newSweep()
+{
+    resetTestData();
+    Database database;
+    QVERIFY(database.initialize());
+    for (auto it = m_blocked.cbegin(); it != m_blocked.cend(); ++it)
+        QVERIFY(database.addBlockedApp(it.value(), QFileInfo(it.value()).fileName()));
+
+    auto processes = std::make_unique<FakeProcessSource>();
+    for (int i = 0; i < kProcessCount; ++i)
+        processes->add(quint32(1000 + i * 4), processPath(i));
+    auto ownedWindows = std::make_unique<FakeWindowSource>();
+    FakeWindowSource* windows = ownedWindows.get();
+    addWindows(*windows);
+
+    // A Monday morning, inside the default 08:00-17:00 weekday window
+    AppMonitor monitor(&database, std::make_unique<FakeClock>(QDateTime(QDate(2024, 1, 8), QTime(10, 0))),
+                       std::move(processes), std::move(ownedWindows), new FakeProcessEventSource());
+    QSignalSpy launched(&monitor, &AppMonitor::blockedAppLaunched);
+    monitor.startMonitoring();
+
+    // The first full scan resolves the processes and sees every window
+    QVERIFY(QMetaObject::invokeMethod(&monitor, "checkRunningApps", Qt::DirectConnection));
+    monitor.drainDetections();
+    QCOMPARE(int(launched.size()), kBlockedCount * kWindowsPerBlocked);
+
+    const qint64 visitedBefore = windows->visited();
+    int sweeps = 0;
+    QBENCHMARK {
+        QMetaObject::invokeMethod(&monitor, "checkBlockedWindows", Qt::DirectConnection);
+        ++sweeps;
+    }
+    qInfo("new: %d windows visited per sweep", int((windows->visited() - visitedBefore) / qMax(sweeps, 1)));
+
+    // Already seen windows are not reported again
+    monitor.drainDetections();
+    QCOMPARE(int(launched.size()), kBlockedCount * kWindowsPerBlocked);
+    monitor.stopMonitoring();
+}
+
+QTEST_GUILESS_MAIN(BenchWindowScan)
+#include "bench_windowscan.moc"
@@ -0,0 +1,256 @@
+#ifndef TESTFAKES_H
+#define TESTFAKES_H
+
+#include <QDateTime>
+#include <QDir>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QStandardPaths>
+#include <QVector>
+
+#include "core/clock.h"
+#include "core/processsource.h"
+#include "core/processeventsource.h"
+#include "core/windowsource.h"
+
+// Stand-ins for what the monitor reads from the system, so tests can run
+// it anywhere and drive it step by step
+
+// Only moves when told to. A timer armed through wakeAt() fires on the
+// next event loop pass after the clock is moved to or past its time.
+class FakeClock : public Clock
+{
+public:
+    explicit FakeClock(const QDateTime& now) : m_now(now) {}
+
+    QDateTime now() const override { return m_now; }
+
+    void setNow(const QDateTime& now)
+    {
+        m_now = now;
+        if (m_timer && m_wakeAt.isValid() && m_wakeAt <= m_now) {
+            m_wakeAt = QDateTime();
+            m_timer->start(0);
+        }
+    }
+
+    void wakeAt(QTimer& timer, const QDateTime& at) override
+    {
+        timer.stop();
+        m_timer = &timer;
+        m_wakeAt = at;
+        setNow(m_now);
+    }
+
+    // When the armed timer is due, or invalid if nothing is armed
+    QDateTime wakeTime() const { return m_wakeAt; }
+
+private:
+    QDateTime m_now;
+    QTimer* m_timer = nullptr;
+    QDateTime m_wakeAt;
+};
+
+// A fixed set of processes; the start time of each is its PID. exec()
+// replaces the executable of one, keeping PID and start time like execve.
+class FakeProcessSource : public ProcessSource
+{
+public:
+    void add(quint32 pid, const QString& path) { m_paths.insert(pid, path); }
+    void remove(quint32 pid)
+    {
+        m_paths.remove(pid);
+        m_images.remove(pid);
+    }
+    void exec(quint32 pid, const QString& path)
+    {
+        m_paths.insert(pid, path);
+        ++m_images[pid];
+    }
+
+    bool snapshot(QVector<ProcessEntry>& processes) override
+    {
+        processes.clear();
+        for (auto it = m_paths.cbegin(); it != m_paths.cend(); ++it)
+            processes.append(ProcessEntry{it.key(), it.key(), m_images.value(it.key())});
+        return true;
+    }
+
+    bool query(quint32 pid, ProcessEntry& process) override
+    {
+        if (!m_paths.contains(pid))
+            return false;
+        process = ProcessEntry{pid, pid, m_images.value(pid)};
+        return true;
+    }
+
+    QString resolvePath(const ProcessEntry& process) override { return m_paths.value(process.pid); }
+
+private:
+    QHash<quint32, QString> m_paths;
+    QHash<quint32, quint64> m_images;
+};
+
+// Every top-level window in Z-order. Hidden and owned windows are left
+// out of topLevelWindows() like the Windows source does.
+class FakeWindowSource : public WindowSource
+{
+public:
+    struct Window
+    {
+        quint32 pid;
+        WindowId id;
+        bool visible;
+        bool owned;
+    };
+
+    static WindowId windowId(quintptr id) { return WindowId(id); }
+
+    void add(quint32 pid, quintptr id, bool visible = true, bool owned = false)
+    {
+        m_windows.append(Window{pid, windowId(id), visible, owned});
+    }
+
+    const QVector<Window>& zOrder() const { return m_windows; }
+    // Windows looked at so far, over all enumerations
+    qint64 visited() const { return m_visited; }
+
+    void topLevelWindows(QMultiHash<quint32, WindowId>& windowsByPid) override
+    {
+        windowsByPid.clear();
+        for (const Window& window : m_windows) {
+            ++m_visited;
+            if (window.visible && !window.owned)
+                windowsByPid.insert(window.pid, window.id);
+        }
+    }
+
+private:
+    QVector<Window> m_windows;
+    qint64 m_visited = 0;
+};
+
+// Starts only if told it is available; tests emit processStarted() and
+// processExited() on it directly
+class FakeProcessEventSource : public ProcessEventSource
+{
+public:
+    explicit FakeProcessEventSource(bool available = false) : m_available(available) {}
+
+    bool start() override
+    {
+        m_running = m_available;
+        return m_running;
+    }
+
+    void stop() override { m_running = false; }
+    bool isRunning() const override { return m_running; }
+
+private:
+    bool m_available;
+    bool m_running = false;
+};
+
+// A machine with entries uninstall keys spread over the three roots, to
+// be replayed through RecordedInstallSource. Entry i is found by
+// InstalledAppResolver strategy i % 6 + 1 (display icon, install
+// location, key name, uninstall string, name under Program Files),
+// except that i % 6 == 5 resolves to nothing after trying all of them.
+// Every seventh resolvable entry is registered in a second root too.
+// expected gets the executable of every resolvable entry.
+inline QJsonObject generatedInstallFixture(int entries, QStringList* expected = nullptr)
+{
+    const QStringList roots = {
+        "HKEY_LOCAL_MACHINE\\SOFTWARE\\Microsoft\\Windows\\CurrentVersion\\Uninstall",
+        "HKEY_LOCAL_MACHINE\\SOFTWARE\\WOW6432Node\\Microsoft\\Windows\\CurrentVersion\\Uninstall",
+        "HKEY_CURRENT_USER\\SOFTWARE\\Microsoft\\Windows\\CurrentVersion\\Uninstall"
+    };
+    const QString programFiles = "C:/Program Files";
+    const QString programFilesX86 = "C:/Program Files (x86)";
+    const qint64 stamp = QDateTime(QDate(2024, 1, 8), QTime(10, 0)).toMSecsSinceEpoch();
+    auto native = [](QString path) { return path.replace(QLatin1Char('/'), QLatin1Char('\\')); };
+
+    QVector<QJsonArray> keys(roots.size());
+    QJsonObject directories;
+    QJsonObject modified;
+    QJsonArray installed;
+    for (int i = 0; i < entries; ++i) {
+        const QString name = QString("App%1").arg(i);
+        const QString directory = programFiles + "/" + name;
+        const QString exe = directory + "/" + name.toLower() + ".exe";
+
+        QJsonObject key;
+        key["appKey"] = QString("{%1}").arg(i, 8, 16, QLatin1Char('0'));
+        key["displayName"] = name + " Studio (x64)";
+        key["publisher"] = QString("Vendor %1").arg(i % 50);
+        key["lastWriteTime"] = stamp;
+        switch (i % 6) {
+        case 0: key["displayIcon"] = "\"" + native(exe) + "\",0"; break;
+        case 1: key["installLocation"] = native(directory); break;
+        case 2: key["appKey"] = native(exe); break;
+        case 3: key["uninstallString"] = "\"" + native(directory + "/unins000.exe") + "\" /SILENT"; break;
+        case 4: break;
+        case 5:
+            key["displayName"] = QString("Ghost%1 Tool").arg(i);
+            key["installLocation"] = native(programFilesX86 + QString("/Ghost%1").arg(i));
+            break;
+        }
+        keys[i % roots.size()].append(key);
+
+        if (i % 6 == 5)
+            continue;
+        if (i % 7 == 0)
+            keys[(i + 1) % roots.size()].append(key);
+
+        QJsonObject listing;
+        listing["executables"] = QJsonArray{name.toLower() + ".exe", "unins000.exe"};
+        directories[directory] = listing;
+        modified[directory] = stamp;
+        installed.append(name);
+        if (expected)
+            expected->append(exe);
+    }
+
+    // Unrelated 32-bit installs, which name searches have to look through
+    QJsonArray others;
+    for (int i = 0; i < entries / 2; ++i) {
+        const QString directory = programFilesX86 + QString("/Tools%1").arg(i);
+        QJsonObject listing;
+        listing["executables"] = QJsonArray{"tool.exe"};
+        directories[directory] = listing;
+        others.append(QString("Tools%1").arg(i));
+    }
+
+    QJsonObject programListing;
+    programListing["subdirectories"] = installed;
+    directories[programFiles] = programListing;
+    QJsonObject otherListing;
+    otherListing["subdirectories"] = others;
+    directories[programFilesX86] = otherListing;
+
+    QJsonObject registry;
+    QJsonArray rootNames;
+    for (int i = 0; i < roots.size(); ++i) {
+        registry[roots[i]] = keys[i];
+        rootNames.append(roots[i]);
+    }
+
+    QJsonObject fixture;
+    fixture["programDirectories"] = QJsonArray{programFiles, programFilesX86};
+    fixture["registryRoots"] = rootNames;
+    fixture["registry"] = registry;
+    fixture["directories"] = directories;
+    fixture["modified"] = modified;
+    return fixture;
+}
+
+// Database and caches of a test live under the test mode AppData
+// location; call from initTestCase() and init() to start from nothing
+inline void resetTestData()
+{
+    QStandardPaths::setTestModeEnabled(true);
+    QDir(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation)).removeRecursively();
+}
+
+#endif // TESTFAKES_H
@@ -0,0 +1,277 @@
+#include <QtTest>
+#include <QElapsedTimer>
+#include <QSet>
+#include <QThread>
+
+#include "core/appmonitor.h"
+#include "data/blockTimeSettingsModel.h"
+#include "data/database.h"
+#include "testfakes.h"
+
+// The monitor on fakes: a Monday morning, inside the default 08:00-17:00
+// weekday window, with blocked processes that each have windows open
+class TestAppMonitor : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void burstOnMonitorThread();
+    void fullQueueIsRetried();
+    void simulatedWeek();
+    void otherConnectionsWrites();
+    void otherConnectionsRules();
+
+private:
+    static QString processPath(int i);
+    // Monitor over `processes` blocked processes with `windowsEach` windows each
+    AppMonitor* createMonitor(Database& database, int processes, int windowsEach);
+};
+
+static const QDateTime kMondayMorning(QDate(2024, 1, 8), QTime(10, 0));
+
+QString TestAppMonitor::processPath(int i)
+{
+    return QString("C:/Games/Game %1/game%1.exe").arg(i);
+}
+
+void TestAppMonitor::init()
+{
+    resetTestData();
+}
+
+AppMonitor* TestAppMonitor::createMonitor(Database& database, int processes, int windowsEach)
+{
+    auto processSource = std::make_unique<FakeProcessSource>();
+    auto windowSource = std::make_unique<FakeWindowSource>();
+    for (int i = 0; i < processes; ++i) {
+        const quint32 pid = quint32(1000 + i * 4);
+        database.addBlockedApp(processPath(i), QFileInfo(processPath(i)).fileName());
+        processSource->add(pid, processPath(i));
+        for (int w = 0; w < windowsEach; ++w)
+            windowSource->add(pid, quintptr(0x10000 + i * windowsEach + w));
+    }
+
+    return new AppMonitor(&database, std::make_unique<FakeClock>(kMondayMorning),
+                          std::move(processSource), std::move(windowSource), new FakeProcessEventSource());
+}
+
+void TestAppMonitor::burstOnMonitorThread()
+{
+    // 200 windows found in one tick, with the monitor on its own thread
+    // and drained on this one like the main window does
+    Database database;
+    QVERIFY(database.initialize());
+    AppMonitor* monitor = createMonitor(database, 50, 4);
+
+    QThread thread;
+    monitor->moveToThread(&thread);
+    connect(&thread, &QThread::finished, monitor, &QObject::deleteLater);
+
+    int drains = 0;
+    QSet<WindowId> windows;
+    connect(monitor, &AppMonitor::detectionsAvailable, this, [&]() {
+        ++drains;
+        monitor->drainDetections();
+    });
+    connect(monitor, &AppMonitor::blockedAppLaunched, this,
+            [&](const WindowId window, const QString&, const QString&) { windows.insert(window); });
+
+    // Any stall of this thread while the burst is handled shows up as a
+    // gap between two heartbeats
+    QElapsedTimer elapsed;
+    qint64 lastBeat = 0;
+    qint64 longestGap = 0;
+    QTimer heartbeat;
+    connect(&heartbeat, &QTimer::timeout, this, [&]() {
+        const qint64 now = elapsed.elapsed();
+        longestGap = qMax(longestGap, now - lastBeat);
+        lastBeat = now;
+    });
+    elapsed.start();
+    heartbeat.start(5);
+
+    thread.start();
+    QMetaObject::invokeMethod(monitor, &AppMonitor::startMonitoring, Qt::QueuedConnection);
+
+    QTRY_COMPARE_WITH_TIMEOUT(int(windows.size()), 200, 5000);
+    // Let a few more ticks pass; windows already reported stay quiet
+    QTest::qWait(200);
+    heartbeat.stop();
+
+    QMetaObject::invokeMethod(monitor, &AppMonitor::stopMonitoring, Qt::BlockingQueuedConnection);
+    thread.quit();
+    QVERIFY(thread.wait());
+
+    QCOMPARE(int(windows.size()), 200);
+    QCOMPARE(drains, 1);
+    QVERIFY2(longestGap < 100, qPrintable(QString("UI thread stalled for %1 ms").arg(longestGap)));
+}
+
+void TestAppMonitor::fullQueueIsRetried()
+{
+    // More windows in one tick than the detection queue holds
+    Database database;
+    QVERIFY(database.initialize());
+    std::unique_ptr<AppMonitor> monitor(createMonitor(database, 50, 6));
+    QSignalSpy available(monitor.get(), &AppMonitor::detectionsAvailable);
+    int launched = 0;
+    QSet<WindowId> windows;
+    connect(monitor.get(), &AppMonitor::blockedAppLaunched, this,
+            [&](const WindowId window, const QString&, const QString&) {
+                ++launched;
+                windows.insert(window);
+            });
+    monitor->startMonitoring();
+
+    QVERIFY(QMetaObject::invokeMethod(monitor.get(), "checkRunningApps", Qt::DirectConnection));
+    QCOMPARE(int(available.size()), 1);
+    monitor->drainDetections();
+    const int firstTick = launched;
+    QVERIFY(firstTick > 0);
+    QVERIFY(firstTick < 300);
+
+    // What did not fit is picked up by the next sweep, not dropped
+    QVERIFY(QMetaObject::invokeMethod(monitor.get(), "checkBlockedWindows", Qt::DirectConnection));
+    QCOMPARE(int(available.size()), 2);
+    monitor->drainDetections();
+    QCOMPARE(launched, 300);
+    QCOMPARE(int(windows.size()), 300);
+
+    // Nothing is reported twice
+    QVERIFY(QMetaObject::invokeMethod(monitor.get(), "checkBlockedWindows", Qt::DirectConnection));
+    QCOMPARE(int(available.size()), 2);
+    monitor->stopMonitoring();
+}
+
+void TestAppMonitor::simulatedWeek()
+{
+    // A week of the default schedule on a simulated clock, from Monday
+    // midnight, with one blocked app open the whole time
+    Database database;
+    QVERIFY(database.initialize());
+    QVERIFY(database.addBlockedApp(processPath(0), QFileInfo(processPath(0)).fileName()));
+
+    const QDateTime monday(QDate(2024, 1, 8), QTime(0, 0));
+    auto ownedClock = std::make_unique<FakeClock>(monday);
+    FakeClock* clock = ownedClock.get();
+    auto processes = std::make_unique<FakeProcessSource>();
+    processes->add(1000, processPath(0));
+    auto windows = std::make_unique<FakeWindowSource>();
+    windows->add(1000, 0x10000);
+    // Scanning starts and stops the event source with it
+    FakeProcessEventSource* processEvents = new FakeProcessEventSource(true);
+
+    AppMonitor monitor(&database, std::move(ownedClock), std::move(processes),
+                       std::move(windows), processEvents);
+    int launched = 0;
+    connect(&monitor, &AppMonitor::detectionsAvailable, &monitor, &AppMonitor::drainDetections);
+    connect(&monitor, &AppMonitor::blockedAppLaunched, this, [&]() { ++launched; });
+
+    monitor.startMonitoring();
+    QVERIFY(!processEvents->isRunning());
+    QCOMPARE(clock->wakeTime(), QDateTime(QDate(2024, 1, 8), QTime(8, 0)));
+
+    const QDateTime nextMonday = monday.addDays(7);
+    int switches = 0;
+    while (clock->wakeTime().isValid() && clock->wakeTime() < nextMonday) {
+        const QDateTime due = clock->wakeTime();
+        const bool scanning = processEvents->isRunning();
+
+        // A minute early nothing changes and the timer stays armed
+        clock->setNow(due.addSecs(-60));
+        QCoreApplication::processEvents();
+        QCOMPARE(processEvents->isRunning(), scanning);
+        QCOMPARE(clock->wakeTime(), due);
+
+        clock->setNow(due);
+        QTRY_COMPARE(processEvents->isRunning(), !scanning);
+        QCOMPARE(monitor.nextScheduleCheck(), clock->wakeTime());
+        ++switches;
+
+        // Each blocking window starts from nothing, so the open app is
+        // reported once per day
+        if (!scanning)
+            QTRY_COMPARE(launched, (switches + 1) / 2);
+    }
+
+    // Five weekdays on and off, then asleep over the weekend
+    QCOMPARE(switches, 10);
+    QCOMPARE(launched, 5);
+    QVERIFY(!processEvents->isRunning());
+    QCOMPARE(clock->wakeTime(), QDateTime(QDate(2024, 1, 15), QTime(8, 0)));
+
+    // A wall clock jump back into Wednesday is picked up on the next
+    // reschedule, as on a time change notification
+    clock->setNow(QDateTime(QDate(2024, 1, 10), QTime(12, 0)));
+    monitor.rescheduleBlocking();
+    QVERIFY(processEvents->isRunning());
+    QCOMPARE(clock->wakeTime(), QDateTime(QDate(2024, 1, 10), QTime(17, 0)));
+
+    monitor.stopMonitoring();
+    QVERIFY(!processEvents->isRunning());
+    QVERIFY(!clock->wakeTime().isValid());
+}
+
+void TestAppMonitor::otherConnectionsWrites()
+{
+    // Settings committed by another process reach the monitor through the
+    // file watcher alone; a Saturday is outside the default schedule
+    Database database;
+    QVERIFY(database.initialize());
+    auto ownedClock = std::make_unique<FakeClock>(QDateTime(QDate(2024, 1, 13), QTime(12, 0)));
+    FakeProcessEventSource* processEvents = new FakeProcessEventSource(true);
+    AppMonitor monitor(&database, std::move(ownedClock), std::make_unique<FakeProcessSource>(),
+                       std::make_unique<FakeWindowSource>(), processEvents);
+    monitor.startMonitoring();
+    QVERIFY(!processEvents->isRunning());
+
+    const REG_Week everyDay = { true, true, true, true, true, true, true };
+    const REG_Week weekdays = { true, true, true, true, true, false, false };
+    for (int round = 0; round < 3; ++round) {
+        // A second Database has its own connections, like the other process
+        Database other;
+        QVERIFY(other.initialize());
+        const bool weekend = round % 2 == 0;
+        QVERIFY(other.updateBlockTimeSettings(std::make_shared<BlockTimeSettingsModel>(
+            QTime(8, 0), QTime(17, 0), weekend ? everyDay : weekdays, true)));
+        QTRY_COMPARE_WITH_TIMEOUT(processEvents->isRunning(), weekend, 5000);
+    }
+
+    monitor.stopMonitoring();
+}
+
+void TestAppMonitor::otherConnectionsRules()
+{
+    // A rule the other process adds reaches an app that is already
+    // running right away, not on the fallback scan ten seconds later
+    Database database;
+    QVERIFY(database.initialize());
+    auto processes = std::make_unique<FakeProcessSource>();
+    processes->add(1000, processPath(0));
+    auto windows = std::make_unique<FakeWindowSource>();
+    windows->add(1000, 0x10000);
+    FakeProcessEventSource* processEvents = new FakeProcessEventSource(true);
+    AppMonitor monitor(&database, std::make_unique<FakeClock>(kMondayMorning), std::move(processes),
+                       std::move(windows), processEvents);
+    int launched = 0;
+    connect(&monitor, &AppMonitor::detectionsAvailable, &monitor, &AppMonitor::drainDetections);
+    connect(&monitor, &AppMonitor::blockedAppLaunched, this, [&]() { ++launched; });
+
+    monitor.startMonitoring();
+    QVERIFY(processEvents->isRunning());
+    QTest::qWait(100);
+    QCOMPARE(launched, 0);
+
+    {
+        Database other;
+        QVERIFY(other.initialize());
+        QVERIFY(other.addBlockedApp(processPath(0), QFileInfo(processPath(0)).fileName()));
+    }
+    QTRY_COMPARE_WITH_TIMEOUT(launched, 1, 3000);
+
+    monitor.stopMonitoring();
+}
+
+QTEST_GUILESS_MAIN(TestAppMonitor)
+#include "tst_appmonitor.moc"
@@ -0,0 +1,277 @@
+#include <QtTest>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+
+#include "data/database.h"
+#include "data/eventarchive.h"
+#include "testfakes.h"
+
+// The hourly and daily rollups that block event reports read, and the
+// hand-off of old partitions to the archive
+class TestBlockEvents : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void hourlyBuckets();
+    void dailyBucketsFollowLocalDays();
+    void batchesAccumulate();
+    void rangeIsInclusive();
+    void compactionKeepsDailyRollups();
+    void archiveHandOffResumes_data();
+    void archiveHandOffResumes();
+    void lateEventsMergeIntoArchive();
+
+private:
+    static BlockEvent event(const QDateTime& at, BlockEventKind kind, const QString& appPath);
+    // "bucket start (ms) app kind" -> count, independent of row order
+    static QMap<QString, int> tally(const QList<BlockEventCount>& counts);
+    static QString key(const QDateTime& bucketStart, const QString& appPath, BlockEventKind kind);
+    // Runs sql on a connection of its own, as a crash would have left it;
+    // rows gets the first column of the result
+    static bool execute(const Database& database, const QString& sql, QStringList* rows = nullptr);
+    static QList<BlockEvent> januaryEvents(int count);
+    static qint64 archivedCount(const Database& database, const QDate& month);
+};
+
+static const QString kGame = QStringLiteral("C:/Games/game.exe");
+static const QString kTool = QStringLiteral("C:/Tools/tool.exe");
+
+void TestBlockEvents::init()
+{
+    resetTestData();
+}
+
+BlockEvent TestBlockEvents::event(const QDateTime& at, BlockEventKind kind, const QString& appPath)
+{
+    return BlockEvent{at.toMSecsSinceEpoch(), kind, appPath, QFileInfo(appPath).fileName()};
+}
+
+QString TestBlockEvents::key(const QDateTime& bucketStart, const QString& appPath, BlockEventKind kind)
+{
+    return QString("%1 %2 %3").arg(bucketStart.toMSecsSinceEpoch()).arg(appPath).arg(int(kind));
+}
+
+bool TestBlockEvents::execute(const Database& database, const QString& sql, QStringList* rows)
+{
+    bool ok = false;
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", "tst_blockevents");
+        db.setDatabaseName(database.databasePath());
+        if (db.open()) {
+            QSqlQuery query(db);
+            ok = query.exec(sql);
+            while (ok && rows && query.next())
+                rows->append(query.value(0).toString());
+        }
+    }
+    QSqlDatabase::removeDatabase("tst_blockevents");
+    return ok;
+}
+
+QList<BlockEvent> TestBlockEvents::januaryEvents(int count)
+{
+    QList<BlockEvent> events;
+    const QDateTime start(QDate(2024, 1, 10), QTime(12, 0), QTimeZone::UTC);
+    for (int i = 0; i < count; ++i)
+        events.append(event(start.addSecs(i * 60), BlockEventKind::Launched, kGame));
+    return events;
+}
+
+qint64 TestBlockEvents::archivedCount(const Database& database, const QDate& month)
+{
+    EventArchiveReader reader;
+    if (!reader.open(EventArchive::segmentPath(database.eventArchivePath(), month)))
+        return -1;
+    return reader.eventCount();
+}
+
+QMap<QString, int> TestBlockEvents::tally(const QList<BlockEventCount>& counts)
+{
+    QMap<QString, int> result;
+    for (const BlockEventCount& count : counts)
+        result[key(count.bucketStart, count.appPath, count.kind)] += count.count;
+    return result;
+}
+
+void TestBlockEvents::hourlyBuckets()
+{
+    Database database;
+    QVERIFY(database.initialize());
+
+    // Hours are UTC, so no time zone moves an event across a bucket
+    const QDateTime ten(QDate(2024, 3, 4), QTime(10, 0), QTimeZone::UTC);
+    const QDateTime eleven = ten.addSecs(3600);
+    QVERIFY(database.appendBlockEvents({
+        event(ten.addSecs(15 * 60), BlockEventKind::Launched, kGame),
+        event(ten.addSecs(20 * 60), BlockEventKind::Launched, kGame),
+        event(ten.addSecs(45 * 60), BlockEventKind::Dismissed, kGame),
+        event(ten.addSecs(30 * 60), BlockEventKind::Launched, kTool),
+        event(eleven.addSecs(5 * 60), BlockEventKind::Launched, kGame),
+    }));
+
+    const QList<BlockEventCount> counts = database.getHourlyBlockEventCounts(ten, eleven);
+    QMap<QString, int> expected;
+    expected[key(ten, kGame, BlockEventKind::Launched)] = 2;
+    expected[key(ten, kGame, BlockEventKind::Dismissed)] = 1;
+    expected[key(ten, kTool, BlockEventKind::Launched)] = 1;
+    expected[key(eleven, kGame, BlockEventKind::Launched)] = 1;
+    QCOMPARE(tally(counts), expected);
+    // One row per bucket, app and kind
+    QCOMPARE(int(counts.size()), 4);
+
+    // Sorted by bucket
+    for (int i = 1; i < counts.size(); ++i)
+        QVERIFY(counts[i - 1].bucketStart <= counts[i].bucketStart);
+    QCOMPARE(counts.first().appName, QString("game.exe"));
+}
+
+void TestBlockEvents::dailyBucketsFollowLocalDays()
+{
+    Database database;
+    QVERIFY(database.initialize());
+
+    const QDate monday(2024, 3, 4);
+    QVERIFY(database.appendBlockEvents({
+        event(QDateTime(monday, QTime(0, 30)), BlockEventKind::Launched, kGame),
+        event(QDateTime(monday, QTime(23, 30)), BlockEventKind::Launched, kGame),
+        event(QDateTime(monday.addDays(1), QTime(0, 10)), BlockEventKind::Launched, kGame),
+        event(QDateTime(monday.addDays(1), QTime(12, 0)), BlockEventKind::ForceClosed, kGame),
+    }));
+
+    QMap<QString, int> expected;
+    expected[key(monday.startOfDay(), kGame, BlockEventKind::Launched)] = 2;
+    expected[key(monday.addDays(1).startOfDay(), kGame, BlockEventKind::Launched)] = 1;
+    expected[key(monday.addDays(1).startOfDay(), kGame, BlockEventKind::ForceClosed)] = 1;
+    QCOMPARE(tally(database.getDailyBlockEventCounts(monday, monday.addDays(1))), expected);
+}
+
+void TestBlockEvents::batchesAccumulate()
+{
+    Database database;
+    QVERIFY(database.initialize());
+
+    const QDateTime at(QDate(2024, 3, 4), QTime(10, 30), QTimeZone::UTC);
+    for (int batch = 0; batch < 3; ++batch) {
+        QVERIFY(database.appendBlockEvents({
+            event(at, BlockEventKind::Launched, kGame),
+            event(at, BlockEventKind::Launched, "c:\\games\\GAME.EXE"),
+        }));
+    }
+
+    // Spellings of one path count as one app, across batches
+    const QList<BlockEventCount> hourly = database.getHourlyBlockEventCounts(at, at);
+    QCOMPARE(int(hourly.size()), 1);
+    QCOMPARE(hourly.first().count, 6);
+    QCOMPARE(hourly.first().appPath, kGame);
+
+    const QList<BlockEventCount> daily = database.getDailyBlockEventCounts(at.toLocalTime().date(), at.toLocalTime().date());
+    QCOMPARE(int(daily.size()), 1);
+    QCOMPARE(daily.first().count, 6);
+}
+
+void TestBlockEvents::rangeIsInclusive()
+{
+    Database database;
+    QVERIFY(database.initialize());
+
+    const QDate first(2024, 3, 1);
+    QList<BlockEvent> events;
+    for (int day = 0; day < 10; ++day)
+        events.append(event(QDateTime(first.addDays(day), QTime(12, 0)), BlockEventKind::Launched, kGame));
+    QVERIFY(database.appendBlockEvents(events));
+
+    QCOMPARE(int(database.getDailyBlockEventCounts(first.addDays(2), first.addDays(4)).size()), 3);
+    QCOMPARE(int(database.getDailyBlockEventCounts(first.addDays(9), first.addDays(9)).size()), 1);
+    QCOMPARE(int(database.getDailyBlockEventCounts(first.addDays(10), first.addDays(20)).size()), 0);
+
+    const QDateTime noon(first, QTime(12, 0));
+    QCOMPARE(int(database.getHourlyBlockEventCounts(noon, noon).size()), 1);
+    QCOMPARE(int(database.getHourlyBlockEventCounts(noon.addSecs(3600), noon.addDays(1).addSecs(-3600)).size()), 0);
+}
+
+void TestBlockEvents::compactionKeepsDailyRollups()
+{
+    Database database;
+    QVERIFY(database.initialize());
+
+    const QDateTime now(QDate(2024, 6, 15), QTime(12, 0));
+    const QDateTime old = now.addDays(-45);
+    const QDateTime recent = now.addDays(-1);
+    QVERIFY(database.appendBlockEvents({
+        event(old, BlockEventKind::Launched, kGame),
+        event(recent, BlockEventKind::Launched, kGame),
+    }));
+
+    QVERIFY(database.compactBlockEvents(now));
+
+    // Hourly rollups only cover the last 30 days, the daily ones stay
+    QCOMPARE(int(database.getHourlyBlockEventCounts(old, old).size()), 0);
+    QCOMPARE(int(database.getHourlyBlockEventCounts(recent, recent).size()), 1);
+    QCOMPARE(int(database.getDailyBlockEventCounts(old.date(), old.date()).size()), 1);
+    QCOMPARE(int(database.getDailyBlockEventCounts(recent.date(), recent.date()).size()), 1);
+}
+
+void TestBlockEvents::archiveHandOffResumes_data()
+{
+    QTest::addColumn<int>("interruptedAt");
+
+    // How far an earlier compaction got before the process died
+    QTest::newRow("not started") << 0;
+    QTest::newRow("after the rename") << 1;
+    QTest::newRow("after writing the segment") << 2;
+    QTest::newRow("after the drop") << 3;
+}
+
+void TestBlockEvents::archiveHandOffResumes()
+{
+    QFETCH(int, interruptedAt);
+
+    Database database;
+    QVERIFY(database.initialize());
+    const QList<BlockEvent> events = januaryEvents(3);
+    QVERIFY(database.appendBlockEvents(events));
+
+    const QDate january(2024, 1, 1);
+    const QString pending = EventArchive::segmentPath(database.eventArchivePath(), january) + ".pending";
+    if (interruptedAt >= 1 && interruptedAt < 3)
+        QVERIFY(execute(database, "ALTER TABLE block_events_202401 RENAME TO block_events_202401_archiving"));
+    if (interruptedAt >= 2) {
+        QVERIFY(QDir().mkpath(database.eventArchivePath()));
+        QVERIFY(EventArchive::write(pending, events));
+    }
+    if (interruptedAt == 3)
+        QVERIFY(execute(database, "DROP TABLE block_events_202401"));
+
+    // Every later pass leaves the events in the archive exactly once
+    const QDateTime now(QDate(2024, 6, 15), QTime(12, 0));
+    for (int pass = 0; pass < 2; ++pass) {
+        QVERIFY(database.compactBlockEvents(now));
+        QCOMPARE(archivedCount(database, january), qint64(3));
+        QVERIFY(!QFileInfo::exists(pending));
+
+        QStringList tables;
+        QVERIFY(execute(database, "SELECT name FROM sqlite_master WHERE name GLOB 'block_events_2024*'", &tables));
+        QCOMPARE(tables, QStringList());
+    }
+}
+
+void TestBlockEvents::lateEventsMergeIntoArchive()
+{
+    Database database;
+    QVERIFY(database.initialize());
+    QVERIFY(database.appendBlockEvents(januaryEvents(3)));
+
+    const QDateTime now(QDate(2024, 6, 15), QTime(12, 0));
+    QVERIFY(database.compactBlockEvents(now));
+    QCOMPARE(archivedCount(database, QDate(2024, 1, 1)), qint64(3));
+
+    // A new partition for the archived month, added to the segment
+    QVERIFY(database.appendBlockEvents(januaryEvents(2)));
+    QVERIFY(database.compactBlockEvents(now));
+    QCOMPARE(archivedCount(database, QDate(2024, 1, 1)), qint64(5));
+}
+
+QTEST_GUILESS_MAIN(TestBlockEvents)
+#include "tst_blockevents.moc"
@@ -0,0 +1,119 @@
+#include <QtTest>
+#include <QSemaphore>
+
+#include "data/asyncdatabase.h"
+#include "data/blockjournal.h"
+#include "data/database.h"
+#include "testfakes.h"
+
+class TestBlockJournal : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void writtenOnDestruction();
+    void writtenAfterInterval();
+    void writtenAtThreshold();
+    void dropsWhenFull();
+
+private:
+    // Events of kind recorded within a day of now, read from the rollups
+    static int recorded(const Database& database, BlockEventKind kind);
+};
+
+static const QString kGame = QStringLiteral("C:/Games/game.exe");
+
+void TestBlockJournal::init()
+{
+    resetTestData();
+}
+
+int TestBlockJournal::recorded(const Database& database, BlockEventKind kind)
+{
+    const QDateTime now = QDateTime::currentDateTime();
+    int total = 0;
+    for (const BlockEventCount& count : database.getHourlyBlockEventCounts(now.addDays(-1), now.addDays(1))) {
+        if (count.kind == kind)
+            total += count.count;
+    }
+    return total;
+}
+
+void TestBlockJournal::writtenOnDestruction()
+{
+    Database database;
+    QVERIFY(database.initialize());
+    AsyncDatabase async(&database);
+    {
+        BlockJournal journal(&async);
+        journal.record(BlockEventKind::Launched, kGame, "game.exe");
+        journal.record(BlockEventKind::Launched, kGame, "game.exe");
+        journal.record(BlockEventKind::ForceClosed, kGame, "game.exe");
+        // Nothing reaches SQLite on the recording thread
+        QCOMPARE(recorded(database, BlockEventKind::Launched), 0);
+    }
+
+    QCOMPARE(recorded(database, BlockEventKind::Launched), 2);
+    QCOMPARE(recorded(database, BlockEventKind::ForceClosed), 1);
+    QCOMPARE(recorded(database, BlockEventKind::Dismissed), 0);
+
+    const QList<BlockEventCount> counts = database.getDailyBlockEventCounts(QDate::currentDate(), QDate::currentDate());
+    QVERIFY(!counts.isEmpty());
+    QCOMPARE(counts.first().appPath, kGame);
+    QCOMPARE(counts.first().appName, QString("game.exe"));
+}
+
+void TestBlockJournal::writtenAfterInterval()
+{
+    Database database;
+    QVERIFY(database.initialize());
+    AsyncDatabase async(&database);
+    BlockJournal journal(&async);
+
+    // A single event is not left waiting for more
+    journal.record(BlockEventKind::Dismissed, kGame, "game.exe");
+    QTRY_COMPARE_WITH_TIMEOUT(recorded(database, BlockEventKind::Dismissed), 1, 10000);
+    QCOMPARE(journal.droppedEvents(), quint64(0));
+}
+
+void TestBlockJournal::writtenAtThreshold()
+{
+    Database database;
+    QVERIFY(database.initialize());
+    AsyncDatabase async(&database);
+    BlockJournal journal(&async);
+
+    // A burst as large as the flush threshold is written well before the
+    // two second flush interval runs out
+    for (int i = 0; i < 4096; ++i)
+        journal.record(BlockEventKind::Launched, kGame, "game.exe");
+    QTRY_COMPARE_WITH_TIMEOUT(recorded(database, BlockEventKind::Launched), 4096, 1500);
+}
+
+void TestBlockJournal::dropsWhenFull()
+{
+    Database database;
+    QVERIFY(database.initialize());
+    AsyncDatabase async(&database);
+    // The journal's buffer size
+    const int capacity = 16384;
+    const int overflow = 100;
+
+    // Holds the database thread, so nothing drains the buffer
+    QSemaphore held;
+    async.run([&held](Database&) { held.acquire(); });
+    {
+        BlockJournal journal(&async);
+        for (int i = 0; i < capacity + overflow; ++i)
+            journal.record(BlockEventKind::Launched, kGame, "game.exe");
+        // Recording never waits on the stalled writer
+        QCOMPARE(journal.droppedEvents(), quint64(overflow));
+        held.release();
+    }
+
+    QCOMPARE(recorded(database, BlockEventKind::Launched), capacity);
+}
+
+QTEST_GUILESS_MAIN(TestBlockJournal)
+#include "tst_blockjournal.moc"
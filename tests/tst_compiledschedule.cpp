@@ -0,0 +1,206 @@
+#include <QtTest>
+
+#include "data/blockTimeSettingsModel.h"
+#include "data/compiledschedule.h"
+
+// Week of Monday 2024-01-08 to Sunday 2024-01-14
+class TestCompiledSchedule : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void weekScheduleRanges();
+    void weekScheduleNextTransition();
+    void weekdayWindow_data();
+    void weekdayWindow();
+    void inactiveNeverBlocks();
+    void primaryWindowWrapsWithinDay();
+    void intervalWrapsSundayIntoMonday();
+    void nextTransition_data();
+    void nextTransition();
+    void nextTransitionWithoutChange();
+
+private:
+    static QDateTime at(int day, int hour, int minute);
+    static CompiledSchedule weekdays(bool active = true);
+};
+
+static const REG_Week kWeekdays = { true, true, true, true, true, false, false };
+static const REG_Week kNoDays = { false, false, false, false, false, false, false };
+
+QDateTime TestCompiledSchedule::at(int day, int hour, int minute)
+{
+    return QDateTime(QDate(2024, 1, 7 + day), QTime(hour, minute));
+}
+
+CompiledSchedule TestCompiledSchedule::weekdays(bool active)
+{
+    BlockTimeSettingsModel settings(QTime(8, 0), QTime(17, 0), kWeekdays, active);
+    return CompiledSchedule(settings);
+}
+
+void TestCompiledSchedule::weekScheduleRanges()
+{
+    WeekSchedule week;
+    QVERIFY(week.isEmpty());
+
+    // Across a word boundary, end exclusive
+    week.addRange(60, 70);
+    QVERIFY(!week.isBlockedAt(59));
+    QVERIFY(week.isBlockedAt(60));
+    QVERIFY(week.isBlockedAt(64));
+    QVERIFY(week.isBlockedAt(69));
+    QVERIFY(!week.isBlockedAt(70));
+
+    // An end before the start wraps past Sunday midnight
+    week.addRange(WeekSchedule::MinutesPerWeek - 10, 5);
+    QVERIFY(!week.isBlockedAt(WeekSchedule::MinutesPerWeek - 11));
+    QVERIFY(week.isBlockedAt(WeekSchedule::MinutesPerWeek - 1));
+    QVERIFY(week.isBlockedAt(0));
+    QVERIFY(week.isBlockedAt(4));
+    QVERIFY(!week.isBlockedAt(5));
+    // Minutes outside the week map back into it
+    QVERIFY(week.isBlockedAt(WeekSchedule::MinutesPerWeek + 60));
+    QVERIFY(week.isBlockedAt(-1));
+
+    // Round trip through the stored form
+    const WeekSchedule copy = WeekSchedule::fromWords(week.words());
+    for (int minute = 0; minute < WeekSchedule::MinutesPerWeek; ++minute)
+        QCOMPARE(copy.isBlockedAt(minute), week.isBlockedAt(minute));
+}
+
+void TestCompiledSchedule::weekScheduleNextTransition()
+{
+    WeekSchedule week;
+    QCOMPARE(week.nextTransition(100), -1);
+
+    week.addRange(100, 200);
+    QCOMPARE(week.nextTransition(0), 100);
+    QCOMPARE(week.nextTransition(99), 100);
+    QCOMPARE(week.nextTransition(100), 200);
+    QCOMPARE(week.nextTransition(199), 200);
+    // Past the last range it wraps around to the first one
+    QCOMPARE(week.nextTransition(200), 100);
+    QCOMPARE(week.nextTransition(WeekSchedule::MinutesPerWeek - 1), 100);
+
+    WeekSchedule always;
+    always.addRange(0, WeekSchedule::MinutesPerWeek);
+    QCOMPARE(always.nextTransition(0), -1);
+}
+
+void TestCompiledSchedule::weekdayWindow_data()
+{
+    QTest::addColumn<QDateTime>("time");
+    QTest::addColumn<bool>("blocking");
+
+    QTest::newRow("monday before start") << at(1, 7, 59) << false;
+    QTest::newRow("monday at start") << at(1, 8, 0) << true;
+    QTest::newRow("monday last minute") << at(1, 16, 59) << true;
+    QTest::newRow("monday at end") << at(1, 17, 0) << false;
+    // Windows are [start, end) to the minute, seconds are dropped: the
+    // last second before the end still blocks, the end itself no longer
+    QTest::newRow("monday second before start") << QDateTime(QDate(2024, 1, 8), QTime(7, 59, 59)) << false;
+    QTest::newRow("monday second before end") << QDateTime(QDate(2024, 1, 8), QTime(16, 59, 59)) << true;
+    QTest::newRow("monday exactly at end") << QDateTime(QDate(2024, 1, 8), QTime(17, 0, 0)) << false;
+    QTest::newRow("monday inside end minute") << QDateTime(QDate(2024, 1, 8), QTime(17, 0, 30)) << false;
+    QTest::newRow("friday midday") << at(5, 12, 0) << true;
+    QTest::newRow("saturday midday") << at(6, 12, 0) << false;
+    QTest::newRow("sunday midday") << at(7, 12, 0) << false;
+}
+
+void TestCompiledSchedule::weekdayWindow()
+{
+    QFETCH(QDateTime, time);
+    QFETCH(bool, blocking);
+    QCOMPARE(weekdays().isBlockingAt(time), blocking);
+}
+
+void TestCompiledSchedule::inactiveNeverBlocks()
+{
+    const CompiledSchedule schedule = weekdays(false);
+    QVERIFY(!schedule.isActive());
+    QVERIFY(!schedule.isBlockingAt(at(1, 10, 0)));
+    QVERIFY(!schedule.nextTransition(at(1, 10, 0)).isValid());
+
+    // Nor does the default, before any settings are loaded
+    QVERIFY(!CompiledSchedule().isBlockingAt(at(1, 10, 0)));
+}
+
+void TestCompiledSchedule::primaryWindowWrapsWithinDay()
+{
+    // 22:00-06:00 on Sunday blocks the start and the end of Sunday itself
+    REG_Week sunday = kNoDays;
+    sunday.sunday = true;
+    BlockTimeSettingsModel settings(QTime(22, 0), QTime(6, 0), sunday, true);
+    const CompiledSchedule schedule(settings);
+
+    QVERIFY(schedule.isBlockingAt(at(7, 0, 0)));
+    QVERIFY(schedule.isBlockingAt(at(7, 5, 59)));
+    QVERIFY(!schedule.isBlockingAt(at(7, 6, 0)));
+    QVERIFY(!schedule.isBlockingAt(at(7, 21, 59)));
+    QVERIFY(schedule.isBlockingAt(at(7, 22, 0)));
+    QVERIFY(schedule.isBlockingAt(at(7, 23, 59)));
+    QVERIFY(!schedule.isBlockingAt(at(1, 0, 0)));
+    QVERIFY(!schedule.isBlockingAt(at(6, 23, 0)));
+}
+
+void TestCompiledSchedule::intervalWrapsSundayIntoMonday()
+{
+    // An extra window from Sunday 23:00 runs on into Monday
+    BlockTimeSettingsModel settings(QTime(8, 0), QTime(17, 0), kNoDays, true);
+    settings.setIntervals({ REG_Interval{7, QTime(23, 0), QTime(1, 0)} });
+    const CompiledSchedule schedule(settings);
+
+    QVERIFY(!schedule.isBlockingAt(at(7, 22, 59)));
+    QVERIFY(schedule.isBlockingAt(at(7, 23, 0)));
+    QVERIFY(schedule.isBlockingAt(at(1, 0, 0)));
+    QVERIFY(schedule.isBlockingAt(at(1, 0, 59)));
+    QVERIFY(!schedule.isBlockingAt(at(1, 1, 0)));
+
+    QCOMPARE(schedule.nextTransition(at(7, 23, 30)), QDateTime(QDate(2024, 1, 15), QTime(1, 0)));
+    QCOMPARE(schedule.nextTransition(at(1, 0, 30)), at(1, 1, 0));
+    QCOMPARE(schedule.nextTransition(at(1, 1, 0)), at(7, 23, 0));
+
+    // Days outside 1..7 are ignored rather than wrapped
+    settings.setIntervals({ REG_Interval{0, QTime(10, 0), QTime(11, 0)},
+                            REG_Interval{8, QTime(10, 0), QTime(11, 0)} });
+    QVERIFY(CompiledSchedule(settings).week().isEmpty());
+}
+
+void TestCompiledSchedule::nextTransition_data()
+{
+    QTest::addColumn<QDateTime>("time");
+    QTest::addColumn<QDateTime>("next");
+
+    QTest::newRow("before start") << at(1, 7, 0) << at(1, 8, 0);
+    QTest::newRow("at start") << at(1, 8, 0) << at(1, 17, 0);
+    QTest::newRow("inside") << at(1, 10, 30) << at(1, 17, 0);
+    QTest::newRow("at end") << at(1, 17, 0) << at(2, 8, 0);
+    QTest::newRow("friday evening") << at(5, 17, 0) << QDateTime(QDate(2024, 1, 15), QTime(8, 0));
+    QTest::newRow("sunday night") << at(7, 23, 59) << QDateTime(QDate(2024, 1, 15), QTime(8, 0));
+    QTest::newRow("seconds are dropped") << QDateTime(QDate(2024, 1, 8), QTime(16, 59, 45)) << at(1, 17, 0);
+}
+
+void TestCompiledSchedule::nextTransition()
+{
+    QFETCH(QDateTime, time);
+    QFETCH(QDateTime, next);
+    QCOMPARE(weekdays().nextTransition(time), next);
+}
+
+void TestCompiledSchedule::nextTransitionWithoutChange()
+{
+    // Active but no day enabled: never blocks, so there is nothing to wait for
+    BlockTimeSettingsModel none(QTime(8, 0), QTime(17, 0), kNoDays, true);
+    QVERIFY(!CompiledSchedule(none).nextTransition(at(1, 10, 0)).isValid());
+
+    // Blocking around the clock never switches off either
+    const REG_Week everyDay = { true, true, true, true, true, true, true };
+    BlockTimeSettingsModel always(QTime(0, 0), QTime(0, 0), everyDay, true);
+    const CompiledSchedule schedule(always);
+    QVERIFY(schedule.isBlockingAt(at(3, 3, 0)));
+    QVERIFY(!schedule.nextTransition(at(3, 3, 0)).isValid());
+}
+
+QTEST_GUILESS_MAIN(TestCompiledSchedule)
+#include "tst_compiledschedule.moc"
@@ -0,0 +1,139 @@
+#include <QtTest>
+#include <QMutex>
+#include <QSemaphore>
+#include <QThread>
+#include <atomic>
+
+#include "data/connectionpool.h"
+#include "data/database.h"
+#include "testfakes.h"
+
+class TestConnectionPool : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void connectionPerThread();
+    void readersAndWriter();
+};
+
+static const int kReaders = 8;
+static const int kFixedRules = 100;
+static const int kWriterRounds = 300;
+
+void TestConnectionPool::init()
+{
+    resetTestData();
+}
+
+void TestConnectionPool::connectionPerThread()
+{
+    const QDir dir(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation));
+    QVERIFY(dir.mkpath("."));
+    ConnectionPool pool;
+    pool.configure("QSQLITE", dir.filePath("pool.db"), QString(), ConnectionPool::Profile(&Database::applyConnectionProfile));
+
+    // Every thread holds its connection until all of them have one, so
+    // none can hand a finished thread's connection to the next
+    QMutex lock;
+    QSet<QString> names;
+    std::atomic<int> failed(0);
+    QSemaphore opened;
+    QSemaphore release;
+    QVector<QThread*> threads;
+    for (int t = 0; t < kReaders; ++t) {
+        threads.append(QThread::create([&]() {
+            QSqlDatabase db = pool.connection();
+            QSqlQuery& query = pool.statement("SELECT 1");
+            if (!db.isOpen() || !query.exec() || !query.next())
+                ++failed;
+            query.finish();
+            {
+                QMutexLocker locker(&lock);
+                names.insert(db.connectionName());
+            }
+            opened.release();
+            release.acquire();
+        }));
+        threads.last()->start();
+    }
+
+    opened.acquire(kReaders);
+    QCOMPARE(pool.openConnections(), kReaders);
+    release.release(kReaders);
+    for (QThread* thread : threads) {
+        QVERIFY(thread->wait());
+        delete thread;
+    }
+
+    QCOMPARE(int(failed), 0);
+    QCOMPARE(int(names.size()), kReaders);
+    // Closed as their threads exit
+    QCOMPARE(pool.openConnections(), 0);
+}
+
+void TestConnectionPool::readersAndWriter()
+{
+    Database database;
+    QVERIFY(database.initialize());
+    QList<BlockedAppChange> fixed;
+    for (int i = 0; i < kFixedRules; ++i)
+        fixed.append(BlockedAppChange{QString("C:/Fixed/app%1.exe").arg(i), QString("app%1.exe").arg(i)});
+    QVERIFY(database.applyBlockedAppBatch(fixed).success);
+
+    // The writer adds one rule and removes it again, so every consistent
+    // read sees the fixed rules plus at most that one
+    std::atomic<bool> stop(false);
+    std::atomic<int> writeFailures(0);
+    QThread* writer = QThread::create([&]() {
+        for (int round = 0; round < kWriterRounds; ++round) {
+            const QString path = QString("C:/Churn/app%1.exe").arg(round);
+            if (!database.addBlockedApp(path, "churn.exe") || !database.removeBlockedApp(path))
+                ++writeFailures;
+        }
+        stop = true;
+    });
+
+    std::atomic<int> readFailures(0);
+    std::atomic<int> reads(0);
+    QVector<QThread*> readers;
+    for (int t = 0; t < kReaders; ++t) {
+        readers.append(QThread::create([&, t]() {
+            quint64 lastRevision = 0;
+            int i = t;
+            do {
+                const QList<BlockedAppChange> active = database.getBlockedAppEntries(true);
+                if (active.size() != kFixedRules && active.size() != kFixedRules + 1)
+                    ++readFailures;
+                if (!database.isAppBlocked(QString("c:\\fixed\\APP%1.exe").arg(i++ % kFixedRules)))
+                    ++readFailures;
+                const quint64 revision = database.blockedAppsRevision();
+                if (revision < lastRevision)
+                    ++readFailures;
+                lastRevision = revision;
+                ++reads;
+            } while (!stop);
+        }));
+    }
+
+    for (QThread* reader : readers)
+        reader->start();
+    writer->start();
+
+    QVERIFY(writer->wait());
+    delete writer;
+    for (QThread* reader : readers) {
+        QVERIFY(reader->wait());
+        delete reader;
+    }
+
+    QCOMPARE(int(writeFailures), 0);
+    QCOMPARE(int(readFailures), 0);
+    QVERIFY(reads >= kReaders);
+    QCOMPARE(int(database.getBlockedAppEntries(true).size()), kFixedRules);
+    QVERIFY(!database.isAppBlocked("C:/Churn/app0.exe"));
+}
+
+QTEST_GUILESS_MAIN(TestConnectionPool)
+#include "tst_connectionpool.moc"
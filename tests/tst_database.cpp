@@ -0,0 +1,406 @@
+#include <QtTest>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QSqlRecord>
+#include <QThread>
+
+#include "data/blockTimeSettingsModel.h"
+#include "data/blocklistimage.h"
+#include "data/database.h"
+#include "data/pathkey.h"
+#include "testfakes.h"
+
+// The change feed: every write reports the rows it wrote, on top of the
+// revision before it, and revisions come from one counter
+class TestDatabase : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void init();
+    void addReportsRow();
+    void revisionsChain();
+    void ruleTypeChange();
+    void remove();
+    void batchReportsOnlyWrittenRows();
+    void scheduleSharesCounter();
+    void otherConnectionReloads();
+    void imageRetriedAfterLag();
+    void staleImageRejectedAfterCheckpoint();
+    void pathKeyMigration();
+
+private:
+    struct Change
+    {
+        quint64 baseRevision;
+        quint64 revision;
+        QList<BlockedAppChange> rows;
+    };
+
+    void record(Database& database);
+    // Runs sql on a connection of its own to path; rows gets every row
+    // of the result, its columns joined by '|'
+    static bool execute(const QString& path, const QString& sql, QStringList* rows = nullptr);
+
+    QList<Change> m_changes;
+};
+
+static const QString kGame = QStringLiteral("C:/Games/game.exe");
+
+void TestDatabase::initTestCase()
+{
+    qRegisterMetaType<BlockedAppChange>();
+}
+
+void TestDatabase::init()
+{
+    resetTestData();
+    m_changes.clear();
+}
+
+void TestDatabase::record(Database& database)
+{
+    connect(&database, &Database::blockedAppsChanged, this,
+            [this](quint64 baseRevision, quint64 revision, const QList<BlockedAppChange>& rows) {
+                m_changes.append(Change{baseRevision, revision, rows});
+            });
+}
+
+bool TestDatabase::execute(const QString& path, const QString& sql, QStringList* rows)
+{
+    bool ok = false;
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", "tst_database");
+        db.setDatabaseName(path);
+        if (db.open()) {
+            QSqlQuery query(db);
+            ok = query.exec(sql);
+            while (ok && rows && query.next()) {
+                QStringList columns;
+                for (int i = 0; i < query.record().count(); ++i)
+                    columns.append(query.value(i).toString());
+                rows->append(columns.join('|'));
+            }
+        }
+    }
+    QSqlDatabase::removeDatabase("tst_database");
+    return ok;
+}
+
+void TestDatabase::addReportsRow()
+{
+    Database database;
+    QVERIFY(database.initialize());
+    record(database);
+    const quint64 before = database.blockedAppsRevision();
+
+    QVERIFY(database.addBlockedApp("C:\\Games\\.\\game.exe", "game.exe"));
+    QCOMPARE(int(m_changes.size()), 1);
+    const Change& change = m_changes.first();
+    QCOMPARE(change.baseRevision, before);
+    QVERIFY(change.revision > before);
+    QCOMPARE(database.blockedAppsRevision(), change.revision);
+
+    // Reported with the stored spelling
+    QCOMPARE(int(change.rows.size()), 1);
+    QCOMPARE(change.rows[0].appPath, kGame);
+    QCOMPARE(change.rows[0].appName, QString("game.exe"));
+    QCOMPARE(change.rows[0].ruleType, RuleType::Exact);
+    QVERIFY(change.rows[0].blocked);
+    QVERIFY(database.isAppBlocked("c:/games/GAME.exe"));
+}
+
+void TestDatabase::revisionsChain()
+{
+    Database database;
+    QVERIFY(database.initialize());
+    record(database);
+
+    for (int i = 0; i < 5; ++i)
+        QVERIFY(database.addBlockedApp(QString("C:/Games/game%1.exe").arg(i), QString("game%1.exe").arg(i)));
+    QVERIFY(database.removeBlockedApp("C:/Games/game2.exe"));
+
+    // A mirror that applies each change on top of the last one sees no gap
+    QCOMPARE(int(m_changes.size()), 6);
+    for (int i = 1; i < m_changes.size(); ++i) {
+        QCOMPARE(m_changes[i].baseRevision, m_changes[i - 1].revision);
+        QVERIFY(m_changes[i].revision > m_changes[i].baseRevision);
+    }
+
+    // Reading back says nothing changed: these were our own writes
+    QSignalSpy reloaded(&database, &Database::blockedAppsReloaded);
+    QVERIFY(!database.reloadIfChanged());
+    QCOMPARE(int(reloaded.size()), 0);
+    QCOMPARE(database.blockedAppsRevision(), m_changes.last().revision);
+}
+
+void TestDatabase::ruleTypeChange()
+{
+    Database database;
+    QVERIFY(database.initialize());
+    QVERIFY(database.addBlockedApp("C:/Games", "Games", RuleType::Exact));
+    record(database);
+
+    // The same path, case aside, under a new type replaces the row
+    QVERIFY(database.addBlockedApp("c:/games", "Games", RuleType::Prefix));
+    QCOMPARE(int(m_changes.size()), 1);
+    const QList<BlockedAppChange>& rows = m_changes.first().rows;
+    QCOMPARE(int(rows.size()), 2);
+    QVERIFY(!rows[0].blocked);
+    QCOMPARE(rows[0].ruleType, RuleType::Exact);
+    QVERIFY(rows[1].blocked);
+    QCOMPARE(rows[1].ruleType, RuleType::Prefix);
+
+    QVERIFY(database.isAppBlocked("C:/Games/game.exe"));
+    QCOMPARE(int(database.getBlockedAppEntries(true).size()), 1);
+}
+
+void TestDatabase::remove()
+{
+    Database database;
+    QVERIFY(database.initialize());
+    QVERIFY(database.addBlockedApp(kGame, "game.exe", RuleType::Exact));
+    record(database);
+
+    QVERIFY(database.removeBlockedApp("c:\\games\\GAME.EXE"));
+    QCOMPARE(int(m_changes.size()), 1);
+    QCOMPARE(int(m_changes.first().rows.size()), 1);
+    QVERIFY(!m_changes.first().rows[0].blocked);
+    QVERIFY(!database.isAppBlocked(kGame));
+
+    // Nothing active to remove, nothing reported
+    const quint64 revision = database.blockedAppsRevision();
+    QVERIFY(database.removeBlockedApp(kGame));
+    QVERIFY(database.removeBlockedApp("C:/Never/added.exe"));
+    QCOMPARE(int(m_changes.size()), 1);
+    QCOMPARE(database.blockedAppsRevision(), revision);
+}
+
+void TestDatabase::batchReportsOnlyWrittenRows()
+{
+    Database database;
+    QVERIFY(database.initialize());
+    QVERIFY(database.addBlockedApp("C:/Games/a.exe", "a.exe"));
+    QVERIFY(database.addBlockedApp("C:/Games/b.exe", "b.exe"));
+    record(database);
+
+    const QList<BlockedAppChange> batch = {
+        BlockedAppChange{"C:/Games/a.exe", "a.exe", RuleType::Exact, true},   // unchanged
+        BlockedAppChange{"C:/Games/b.exe", "B", RuleType::Exact, true},       // renamed
+        BlockedAppChange{"C:/Games/c.exe", "c.exe", RuleType::Exact, true},   // new
+        BlockedAppChange{"C:/Games/a.exe", "a.exe", RuleType::Exact, false},  // deactivated
+        BlockedAppChange{"C:/Games/d.exe", "d.exe", RuleType::Exact, false},  // never there
+    };
+    const BlockedAppBatchResult result = database.applyBlockedAppBatch(batch);
+    QVERIFY(result.success);
+    QCOMPARE(result.inserted, 1);
+    QCOMPARE(result.updated, 1);
+    QCOMPARE(result.deactivated, 1);
+    QCOMPARE(result.unchanged, 2);
+
+    QCOMPARE(int(m_changes.size()), 1);
+    QCOMPARE(int(m_changes.first().rows.size()), 3);
+    // Names the change it caused, so a caller can tell it from others
+    QCOMPARE(result.revision, m_changes.first().revision);
+    QVERIFY(!database.isAppBlocked("C:/Games/a.exe"));
+    QVERIFY(database.isAppBlocked("C:/Games/b.exe"));
+    QVERIFY(database.isAppBlocked("C:/Games/c.exe"));
+
+    // The same batch again writes nothing and reports nothing
+    const quint64 revision = database.blockedAppsRevision();
+    const BlockedAppBatchResult again = database.applyBlockedAppBatch(batch.mid(1, 2));
+    QVERIFY(again.success);
+    QCOMPARE(again.unchanged, 2);
+    QCOMPARE(again.revision, quint64(0));
+    QCOMPARE(int(m_changes.size()), 1);
+    QCOMPARE(database.blockedAppsRevision(), revision);
+}
+
+void TestDatabase::scheduleSharesCounter()
+{
+    Database database;
+    QVERIFY(database.initialize());
+    record(database);
+    QSignalSpy scheduleChanged(&database, &Database::scheduleChanged);
+
+    QVERIFY(database.addBlockedApp(kGame, "game.exe"));
+    const REG_Week weekend = { false, false, false, false, false, true, true };
+    QVERIFY(database.updateBlockTimeSettings(std::make_shared<BlockTimeSettingsModel>(
+        QTime(9, 0), QTime(12, 0), weekend, true)));
+    QVERIFY(database.addBlockedApp("C:/Games/other.exe", "other.exe"));
+
+    QCOMPARE(int(scheduleChanged.size()), 1);
+    const quint64 scheduleRevision = scheduleChanged.first().at(0).toULongLong();
+    QVERIFY(scheduleRevision > m_changes[0].revision);
+    QVERIFY(m_changes[1].revision > scheduleRevision);
+    // The schedule is not a rule change, so the rule feed has no gap
+    QCOMPARE(m_changes[1].baseRevision, m_changes[0].revision);
+
+    QVERIFY(database.isBlockingAt(QDateTime(QDate(2024, 1, 13), QTime(10, 0))));
+    QVERIFY(!database.isBlockingAt(QDateTime(QDate(2024, 1, 8), QTime(10, 0))));
+}
+
+void TestDatabase::otherConnectionReloads()
+{
+    Database database;
+    QVERIFY(database.initialize());
+    record(database);
+    QSignalSpy reloaded(&database, &Database::blockedAppsReloaded);
+
+    {
+        // Another process: which rows moved is unknown, so it is a reload
+        Database other;
+        QVERIFY(other.initialize());
+        QVERIFY(other.addBlockedApp(kGame, "game.exe"));
+    }
+
+    QVERIFY(database.reloadIfChanged());
+    QCOMPARE(int(reloaded.size()), 1);
+    QCOMPARE(reloaded.first().at(0).toULongLong(), database.blockedAppsRevision());
+    QCOMPARE(int(m_changes.size()), 0);
+    QVERIFY(database.isAppBlocked(kGame));
+}
+
+void TestDatabase::imageRetriedAfterLag()
+{
+    // Every writer is closed before the service looks, so the last
+    // connection checkpoints the database file behind each image
+    {
+        Database other;
+        QVERIFY(other.initialize());
+        QVERIFY(other.addBlockedApp(kGame, "game.exe"));
+    }
+
+    Database service;
+    QVERIFY(service.initializeFromImage());
+    service.setGuardedThread(QThread::currentThread());
+    QVERIFY(service.isAppBlocked(kGame));
+
+    // Stamps are file times, so each commit waits to land on a later one
+    QThread::msleep(20);
+    {
+        Database other;
+        QVERIFY(other.initialize());
+        QVERIFY(other.addBlockedApp("C:/Games/a.exe", "a.exe"));
+    }
+    QVERIFY(service.reloadIfChanged());
+    QVERIFY(service.isAppBlocked("C:/Games/a.exe"));
+    // The checkpoint costs at most the read of the content revision,
+    // the rules still come from the image
+    QVERIFY(service.guardedThreadQueries() <= 1);
+
+    // A commit whose image never came is read from SQLite
+    QThread::msleep(20);
+    {
+        Database other;
+        QVERIFY(other.initialize());
+        QVERIFY(other.addBlockedApp("C:/Games/b.exe", "b.exe"));
+        QVERIFY(QFile::remove(BlocklistImage::pathFor(other.databasePath())));
+    }
+    QVERIFY(service.reloadIfChanged());
+    QVERIFY(service.isAppBlocked("C:/Games/b.exe"));
+    QVERIFY(service.guardedThreadQueries() > 1);
+
+    // and the next one comes from the image again
+    const quint64 queries = service.guardedThreadQueries();
+    QThread::msleep(20);
+    {
+        Database other;
+        QVERIFY(other.initialize());
+        QVERIFY(other.addBlockedApp("C:/Games/c.exe", "c.exe"));
+    }
+    QVERIFY(service.reloadIfChanged());
+    QVERIFY(service.isAppBlocked("C:/Games/c.exe"));
+    QVERIFY(service.guardedThreadQueries() <= queries + 1);
+}
+
+void TestDatabase::staleImageRejectedAfterCheckpoint()
+{
+    QString path;
+    QString stale;
+    {
+        Database other;
+        QVERIFY(other.initialize());
+        QVERIFY(other.addBlockedApp(kGame, "game.exe"));
+        path = BlocklistImage::pathFor(other.databasePath());
+        stale = path + ".stale";
+        QVERIFY(QFile::copy(path, stale));
+
+        QThread::msleep(20);
+        QVERIFY(other.addBlockedApp("C:/Games/a.exe", "a.exe"));
+    }
+
+    // The checkpoint on close left both images older than the database
+    // file, only the content revision shows the first one misses a rule
+    QVERIFY(QFile::remove(path));
+    QVERIFY(QFile::rename(stale, path));
+    Database service;
+    QVERIFY(!service.initializeFromImage());
+
+    QVERIFY(service.initialize());
+    QVERIFY(service.isAppBlocked("C:/Games/a.exe"));
+}
+
+void TestDatabase::pathKeyMigration()
+{
+    // A version 1 file: appPath is the case-sensitive key, so one app can
+    // be stored under several spellings
+    const QString path = Database().databasePath();
+    const QStringList v1 = {
+        "CREATE TABLE blocked_apps (appPath TEXT PRIMARY KEY, appName TEXT NOT NULL, "
+        "isBlocked BOOLEAN NOT NULL, ruleType INTEGER NOT NULL DEFAULT 0)",
+        // Active wins over newer inactive spellings
+        "INSERT INTO blocked_apps VALUES ('C:/Games/game.exe', 'Game 1', 0, 0)",
+        "INSERT INTO blocked_apps VALUES ('c:\\games\\GAME.EXE', 'Game 2', 1, 0)",
+        "INSERT INTO blocked_apps VALUES ('C:\\Games\\game.exe', 'Game 3', 0, 0)",
+        // Among inactive ones, and among active ones, the newest wins
+        "INSERT INTO blocked_apps VALUES ('C:/Tools/tool.exe', 'Tool 1', 0, 0)",
+        "INSERT INTO blocked_apps VALUES ('c:/tools/TOOL.exe', 'Tool 2', 0, 0)",
+        "INSERT INTO blocked_apps VALUES ('D:/Apps', 'Apps 1', 1, 1)",
+        "INSERT INTO blocked_apps VALUES ('d:\\apps', 'Apps 2', 1, 1)",
+        "INSERT INTO blocked_apps VALUES ('E:/Solo/solo.exe', 'Solo', 1, 0)",
+        "PRAGMA user_version = 1"
+    };
+    for (const QString& sql : v1)
+        QVERIFY2(execute(path, sql), qPrintable(sql));
+
+    Database database;
+    QVERIFY(database.initialize());
+
+    QStringList rows;
+    QVERIFY(execute(path, "SELECT appName, appPath, isBlocked, ruleType, pathKey FROM blocked_apps "
+                          "ORDER BY appName", &rows));
+    const QStringList expected = {
+        QString("Apps 2|d:\\apps|1|1|%1").arg(PathKey("d:\\apps").toString()),
+        QString("Game 2|c:\\games\\GAME.EXE|1|0|%1").arg(PathKey(kGame).toString()),
+        QString("Solo|E:/Solo/solo.exe|1|0|%1").arg(PathKey("E:/Solo/solo.exe").toString()),
+        QString("Tool 2|c:/tools/TOOL.exe|0|0|%1").arg(PathKey("C:/Tools/tool.exe").toString()),
+    };
+    QCOMPARE(rows, expected);
+    QCOMPARE(PathKey("d:\\apps").toString(), PathKey("D:/Apps").toString());
+
+    QVERIFY(database.isAppBlocked(kGame));
+    QVERIFY(database.isAppBlocked("D:/Apps/app.exe"));
+    QVERIFY(!database.isAppBlocked("C:/Tools/tool.exe"));
+
+    rows.clear();
+    QVERIFY(execute(path, "PRAGMA user_version", &rows));
+    QCOMPARE(rows, QStringList{"3"});
+
+    // Removal finds its row through the unique index, the active list is
+    // read in order from the covering one
+    rows.clear();
+    QVERIFY(execute(path, QString("EXPLAIN QUERY PLAN UPDATE blocked_apps SET isBlocked = 0 WHERE pathKey = '%1'")
+                              .arg(PathKey(kGame).toString()), &rows));
+    QVERIFY2(rows.join('\n').contains("USING INDEX idx_blocked_apps_pathKey"), qPrintable(rows.join('\n')));
+    rows.clear();
+    QVERIFY(execute(path, "EXPLAIN QUERY PLAN SELECT appPath, appName, isBlocked, ruleType FROM blocked_apps "
+                          "WHERE isBlocked = 1 ORDER BY appName", &rows));
+    const QString plan = rows.join('\n');
+    QVERIFY2(plan.contains("USING COVERING INDEX idx_blocked_apps_active_name"), qPrintable(plan));
+    QVERIFY2(!plan.contains("TEMP B-TREE"), qPrintable(plan));
+}
+
+QTEST_GUILESS_MAIN(TestDatabase)
+#include "tst_database.moc"
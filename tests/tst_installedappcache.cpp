@@ -0,0 +1,248 @@
+#include <QtTest>
+#include <QSignalSpy>
+
+#include "core/appdetector.h"
+#include "core/installedappcache.h"
+#include "core/recordedinstallsource.h"
+#include "data/appmodel.h"
+#include "testfakes.h"
+
+// The installed app cache on its own, and the incremental refresh built
+// on it. Changes to the replayed machine that no stamp shows, like an
+// executable renamed in place, tell whether a key was resolved again.
+class TestInstalledAppCache : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void roundTrip();
+    void unreadableCacheIsIgnored();
+    void unchangedKeysKeepTheirApps();
+    void changedKeyIsResolvedAgain();
+    void changedDirectoryIsResolvedAgain();
+    void removedKeyIsDropped();
+
+private:
+    // Name -> executable after a load or refresh of fixture through a
+    // detector caching in m_cachePath
+    QHash<QString, QString> detect(const QJsonObject& fixture, bool reuseCache);
+    // Lists newName as the first executable of the directory instead
+    static QJsonObject renamed(QJsonObject fixture, const QString& directory, const QString& newName);
+    static QJsonObject touchedKey(QJsonObject fixture, const QString& displayName);
+    static QJsonObject touchedDirectory(QJsonObject fixture, const QString& directory);
+    static QJsonObject removedKey(QJsonObject fixture, const QString& displayName);
+
+    QString m_cachePath;
+};
+
+// Found through its install location, so its first executable is taken
+static const QString kApp = QStringLiteral("App1 Studio");
+static const QString kKey = QStringLiteral("App1 Studio (x64)");
+static const QString kDirectory = QStringLiteral("C:/Program Files/App1");
+static const QString kRenamed = QStringLiteral("C:/Program Files/App1/app1-next.exe");
+
+void TestInstalledAppCache::init()
+{
+    resetTestData();
+    const QString dataPath = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+    QVERIFY(QDir().mkpath(dataPath));
+    m_cachePath = InstalledAppCache::pathFor(QDir(dataPath).filePath("foccuss.db"));
+}
+
+QHash<QString, QString> TestInstalledAppCache::detect(const QJsonObject& fixture, bool reuseCache)
+{
+    QHash<QString, QString> apps;
+    auto source = std::make_unique<RecordedInstallSource>();
+    if (!source->load(fixture))
+        return apps;
+
+    AppDetector detector(std::move(source), m_cachePath);
+    QSignalSpy finished(&detector, &AppDetector::installedAppsChanged);
+    if (reuseCache)
+        detector.loadInstalledApps();
+    else
+        detector.refreshInstalledApps();
+    if (!finished.wait(10000))
+        return apps;
+
+    for (const std::shared_ptr<AppModel>& app : detector.getInstalledApps())
+        apps.insert(app->getName(), app->getPath());
+    return apps;
+}
+
+QJsonObject TestInstalledAppCache::renamed(QJsonObject fixture, const QString& directory, const QString& newName)
+{
+    QJsonObject directories = fixture.value("directories").toObject();
+    QJsonObject listing = directories.value(directory).toObject();
+    listing["executables"] = QJsonArray{newName, "unins000.exe"};
+    directories[directory] = listing;
+    fixture["directories"] = directories;
+    return fixture;
+}
+
+QJsonObject TestInstalledAppCache::touchedKey(QJsonObject fixture, const QString& displayName)
+{
+    QJsonObject registry = fixture.value("registry").toObject();
+    for (const QString& root : registry.keys()) {
+        QJsonArray keys = registry.value(root).toArray();
+        for (int i = 0; i < keys.size(); ++i) {
+            QJsonObject key = keys.at(i).toObject();
+            if (key.value("displayName").toString() == displayName) {
+                key["lastWriteTime"] = key.value("lastWriteTime").toInteger() + 1000;
+                keys[i] = key;
+            }
+        }
+        registry[root] = keys;
+    }
+    fixture["registry"] = registry;
+    return fixture;
+}
+
+QJsonObject TestInstalledAppCache::touchedDirectory(QJsonObject fixture, const QString& directory)
+{
+    QJsonObject modified = fixture.value("modified").toObject();
+    modified[directory] = modified.value(directory).toInteger() + 1000;
+    fixture["modified"] = modified;
+    return fixture;
+}
+
+QJsonObject TestInstalledAppCache::removedKey(QJsonObject fixture, const QString& displayName)
+{
+    QJsonObject registry = fixture.value("registry").toObject();
+    for (const QString& root : registry.keys()) {
+        QJsonArray keys;
+        for (const QJsonValue& key : registry.value(root).toArray()) {
+            if (key.toObject().value("displayName").toString() != displayName)
+                keys.append(key);
+        }
+        registry[root] = keys;
+    }
+    fixture["registry"] = registry;
+    return fixture;
+}
+
+void TestInstalledAppCache::roundTrip()
+{
+    CachedInstalledApp resolved;
+    resolved.registryRoot = "HKEY_LOCAL_MACHINE\\SOFTWARE\\Microsoft\\Windows\\CurrentVersion\\Uninstall";
+    resolved.appKey = "Game";
+    resolved.keyWriteTime = 1704708000000;
+    resolved.exePath = "C:/Games/game.exe";
+    resolved.name = "Game";
+    resolved.directory = "C:/Games";
+    resolved.directoryModified = 1704708000500;
+    // A key nothing was found for, with a missing install location
+    CachedInstalledApp unresolved;
+    unresolved.registryRoot = resolved.registryRoot;
+    unresolved.appKey = "{0000}";
+    unresolved.directory = "C:/Gone";
+
+    QVERIFY(InstalledAppCache::save(m_cachePath, {resolved, unresolved}));
+    QList<CachedInstalledApp> apps;
+    QVERIFY(InstalledAppCache::load(m_cachePath, apps));
+    QCOMPARE(int(apps.size()), 2);
+
+    QCOMPARE(apps[0].registryRoot, resolved.registryRoot);
+    QCOMPARE(apps[0].appKey, resolved.appKey);
+    QCOMPARE(apps[0].keyWriteTime, resolved.keyWriteTime);
+    QCOMPARE(apps[0].exePath, resolved.exePath);
+    QCOMPARE(apps[0].name, resolved.name);
+    QCOMPARE(apps[0].directory, resolved.directory);
+    QCOMPARE(apps[0].directoryModified, resolved.directoryModified);
+
+    QCOMPARE(apps[1].appKey, unresolved.appKey);
+    QVERIFY(apps[1].exePath.isEmpty());
+    QCOMPARE(apps[1].directoryModified, qint64(-1));
+
+    // Next to the database, whatever its name
+    QCOMPARE(InstalledAppCache::pathFor("C:/Data/foccuss.db"), QString("C:/Data/foccuss.apps"));
+}
+
+void TestInstalledAppCache::unreadableCacheIsIgnored()
+{
+    QList<CachedInstalledApp> apps;
+    QVERIFY(!InstalledAppCache::load(m_cachePath, apps));
+
+    QFile file(m_cachePath);
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.write("{\"version\": 1, \"apps\": [");
+    file.close();
+    QVERIFY(!InstalledAppCache::load(m_cachePath, apps));
+    QVERIFY(apps.isEmpty());
+
+    // A cache of another version is not read either
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.write("{\"version\": 0, \"apps\": []}");
+    file.close();
+    QVERIFY(!InstalledAppCache::load(m_cachePath, apps));
+
+    // The detector resolves everything instead, and writes a good cache
+    QStringList expected;
+    const QJsonObject fixture = generatedInstallFixture(12, &expected);
+    QCOMPARE(int(detect(fixture, true).size()), int(expected.size()));
+    QVERIFY(InstalledAppCache::load(m_cachePath, apps));
+    QVERIFY(!apps.isEmpty());
+}
+
+void TestInstalledAppCache::unchangedKeysKeepTheirApps()
+{
+    QStringList expected;
+    const QJsonObject fixture = generatedInstallFixture(12, &expected);
+    const QHash<QString, QString> first = detect(fixture, true);
+    QCOMPARE(int(first.size()), int(expected.size()));
+    QVERIFY(first.value(kApp) != kRenamed);
+
+    // No stamp changed, so the rename goes unnoticed
+    const QJsonObject moved = renamed(fixture, kDirectory, "app1-next.exe");
+    QCOMPARE(detect(moved, true), first);
+
+    // Until the Refresh button resolves everything again
+    const QHash<QString, QString> refreshed = detect(moved, false);
+    QCOMPARE(refreshed.value(kApp), kRenamed);
+    QCOMPARE(int(refreshed.size()), int(expected.size()));
+}
+
+void TestInstalledAppCache::changedKeyIsResolvedAgain()
+{
+    const QJsonObject fixture = generatedInstallFixture(12);
+    const QHash<QString, QString> first = detect(fixture, true);
+
+    const QHash<QString, QString> updated = detect(touchedKey(renamed(fixture, kDirectory, "app1-next.exe"), kKey), true);
+    QCOMPARE(updated.value(kApp), kRenamed);
+
+    // Nothing else changed
+    QHash<QString, QString> expected = first;
+    expected[kApp] = kRenamed;
+    QCOMPARE(updated, expected);
+}
+
+void TestInstalledAppCache::changedDirectoryIsResolvedAgain()
+{
+    const QJsonObject fixture = generatedInstallFixture(12);
+    const QHash<QString, QString> first = detect(fixture, true);
+
+    // Updating an app in place rewrites its directory, not its key
+    const QHash<QString, QString> updated = detect(touchedDirectory(renamed(fixture, kDirectory, "app1-next.exe"), kDirectory), true);
+    QHash<QString, QString> expected = first;
+    expected[kApp] = kRenamed;
+    QCOMPARE(updated, expected);
+}
+
+void TestInstalledAppCache::removedKeyIsDropped()
+{
+    const QJsonObject fixture = generatedInstallFixture(12);
+    const QHash<QString, QString> first = detect(fixture, true);
+    QVERIFY(first.contains(kApp));
+
+    const QHash<QString, QString> uninstalled = detect(removedKey(fixture, kKey), true);
+    QHash<QString, QString> expected = first;
+    expected.remove(kApp);
+    QCOMPARE(uninstalled, expected);
+
+    // And stays gone from the cache it rewrote
+    QCOMPARE(detect(removedKey(fixture, kKey), true), expected);
+}
+
+QTEST_GUILESS_MAIN(TestInstalledAppCache)
+#include "tst_installedappcache.moc"
@@ -0,0 +1,150 @@
+#include <QtTest>
+#include <QThread>
+
+#include "data/pathkey.h"
+
+class TestPathKey : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void normalized_data();
+    void normalized();
+    void sameKeyForSamePath_data();
+    void sameKeyForSamePath();
+    void entriesAreFreed();
+    void copiesAndMoves();
+    void concurrentInternAndRelease();
+};
+
+void TestPathKey::normalized_data()
+{
+    QTest::addColumn<QString>("path");
+    QTest::addColumn<QString>("expected");
+
+    QTest::newRow("unchanged") << "C:/Games/Game.exe" << "C:/Games/Game.exe";
+    QTest::newRow("backslashes") << "C:\\Games\\Game.exe" << "C:/Games/Game.exe";
+    QTest::newRow("dot segments") << "C:\\Games\\.\\bin\\..\\Game.exe" << "C:/Games/Game.exe";
+    QTest::newRow("doubled separators") << "C:/Games//Game.exe" << "C:/Games/Game.exe";
+    QTest::newRow("trailing separator") << "C:/Games/" << "C:/Games";
+}
+
+void TestPathKey::normalized()
+{
+    QFETCH(QString, path);
+    QFETCH(QString, expected);
+    QCOMPARE(PathKey::normalized(path), expected);
+    // The key is the same spelling, case-folded
+    QCOMPARE(PathKey(path).toString(), expected.toCaseFolded());
+}
+
+void TestPathKey::sameKeyForSamePath_data()
+{
+    QTest::addColumn<QString>("first");
+    QTest::addColumn<QString>("second");
+    QTest::addColumn<bool>("same");
+
+    QTest::newRow("case") << "C:/Games/Game.exe" << "c:/GAMES/game.EXE" << true;
+    QTest::newRow("separators") << "C:/Games/Game.exe" << "C:\\Games\\Game.exe" << true;
+    QTest::newRow("unclean") << "C:/Games/Game.exe" << "C:/Games/x/../Game.exe" << true;
+    QTest::newRow("non-ascii") << "C:/Spiele/Größe.exe" << "c:\\SPIELE\\größe.exe" << true;
+    QTest::newRow("different") << "C:/Games/Game.exe" << "C:/Games/Game2.exe" << false;
+}
+
+void TestPathKey::sameKeyForSamePath()
+{
+    QFETCH(QString, first);
+    QFETCH(QString, second);
+    QFETCH(bool, same);
+
+    const PathKey a(first);
+    const PathKey b(second);
+    QCOMPARE(a == b, same);
+    QCOMPARE(a.hash() == b.hash(), same);
+    QCOMPARE(a.toString() == b.toString(), same);
+}
+
+void TestPathKey::entriesAreFreed()
+{
+    const int before = PathKey::internedCount();
+    {
+        // Transient paths, like processes that come and go
+        QVector<PathKey> keys;
+        for (int i = 0; i < 10000; ++i)
+            keys.append(PathKey(QString("C:/Temp/run%1/tool.exe").arg(i)));
+        QCOMPARE(PathKey::internedCount(), before + 10000);
+
+        keys.resize(5000);
+        QCOMPARE(PathKey::internedCount(), before + 5000);
+    }
+    QCOMPARE(PathKey::internedCount(), before);
+
+    // Empty keys are never interned
+    PathKey empty(QString(""));
+    QVERIFY(empty.isEmpty());
+    QCOMPARE(empty, PathKey());
+    QCOMPARE(PathKey::internedCount(), before);
+}
+
+void TestPathKey::copiesAndMoves()
+{
+    const int before = PathKey::internedCount();
+    {
+        PathKey original(QString("C:/Games/Game.exe"));
+        PathKey copy = original;
+        QCOMPARE(PathKey::internedCount(), before + 1);
+
+        // The entry stays while any key still uses it
+        original = PathKey(QString("C:/Games/Other.exe"));
+        QCOMPARE(PathKey::internedCount(), before + 2);
+        QCOMPARE(copy, PathKey(QString("c:/games/game.exe")));
+
+        PathKey moved = std::move(copy);
+        QVERIFY(copy.isEmpty());
+        QCOMPARE(moved.toString(), QString("c:/games/game.exe"));
+        QCOMPARE(PathKey::internedCount(), before + 2);
+
+        copy = moved;
+        moved = std::move(original);
+        QCOMPARE(copy.toString(), QString("c:/games/game.exe"));
+        QCOMPARE(moved.toString(), QString("c:/games/other.exe"));
+
+        // A key for a path still held reuses its entry
+        QSet<PathKey> set;
+        set.insert(PathKey(QString("C:\\Games\\Game.exe")));
+        QVERIFY(set.contains(copy));
+        QCOMPARE(PathKey::internedCount(), before + 2);
+    }
+    QCOMPARE(PathKey::internedCount(), before);
+}
+
+void TestPathKey::concurrentInternAndRelease()
+{
+    // Threads creating and dropping keys for the same few paths, so
+    // entries are freed and interned again while others look them up
+    const int before = PathKey::internedCount();
+    const PathKey held(QString("C:/Held/held.exe"));
+
+    QVector<QThread*> threads;
+    for (int t = 0; t < 8; ++t) {
+        threads.append(QThread::create([t, &held]() {
+            for (int i = 0; i < 20000; ++i) {
+                const PathKey key(QString("C:/Shared/app%1.exe").arg((i + t) % 16));
+                PathKey copy = key;
+                const PathKey again(QString("c:\\shared\\APP%1.EXE").arg((i + t) % 16));
+                if (copy != again || held != PathKey(QString("c:/held/HELD.exe")))
+                    qFatal("keys for the same path differ");
+            }
+        }));
+        threads.last()->start();
+    }
+    for (QThread* thread : threads) {
+        QVERIFY(thread->wait());
+        delete thread;
+    }
+
+    QCOMPARE(PathKey::internedCount(), before + 1);
+}
+
+QTEST_GUILESS_MAIN(TestPathKey)
+#include "tst_pathkey.moc"
@@ -0,0 +1,85 @@
+#include <QtTest>
+
+#include "core/processcache.h"
+#include "testfakes.h"
+
+// A shell that execs a blocked game keeps its PID and start time, which
+// is all the cache used to tell processes apart
+class TestProcessCache : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void unchangedProcessIsCached();
+    void execResolvedOnRefresh();
+    void execResolvedOnEvent();
+
+private:
+    // The decider of a single rule for the game
+    static bool isGame(const PathKey& key);
+};
+
+static const QString kShell = QStringLiteral("/usr/bin/bash");
+static const QString kGame = QStringLiteral("/opt/games/game");
+
+bool TestProcessCache::isGame(const PathKey& key)
+{
+    return key == PathKey(kGame);
+}
+
+void TestProcessCache::unchangedProcessIsCached()
+{
+    auto source = std::make_unique<FakeProcessSource>();
+    source->add(1000, kShell);
+    ProcessCache cache(std::move(source));
+
+    QCOMPARE(int(cache.refresh(1, isGame).size()), 1);
+    QCOMPARE(int(cache.refresh(1, isGame).size()), 1);
+    QCOMPARE(cache.misses(), quint64(1));
+    QCOMPARE(cache.hits(), quint64(1));
+}
+
+void TestProcessCache::execResolvedOnRefresh()
+{
+    auto owned = std::make_unique<FakeProcessSource>();
+    FakeProcessSource* source = owned.get();
+    source->add(1000, kShell);
+    ProcessCache cache(std::move(owned));
+
+    QList<const CachedProcess*> running = cache.refresh(1, isGame);
+    QCOMPARE(int(running.size()), 1);
+    QVERIFY(!running.first()->blocked);
+
+    // The fallback scan sees the new executable, with no event
+    source->exec(1000, kGame);
+    running = cache.refresh(1, isGame);
+    QCOMPARE(int(running.size()), 1);
+    QCOMPARE(running.first()->path, kGame);
+    QCOMPARE(running.first()->name, QString("game"));
+    QVERIFY(running.first()->blocked);
+    QCOMPARE(cache.misses(), quint64(2));
+}
+
+void TestProcessCache::execResolvedOnEvent()
+{
+    auto owned = std::make_unique<FakeProcessSource>();
+    FakeProcessSource* source = owned.get();
+    source->add(1000, kShell);
+    ProcessCache cache(std::move(owned));
+    QVERIFY(!cache.resolve(1000, 1, isGame)->blocked);
+
+    // As the exec notification of the process events resolves it
+    source->exec(1000, kGame);
+    const CachedProcess* process = cache.resolve(1000, 1, isGame);
+    QVERIFY(process);
+    QCOMPARE(process->path, kGame);
+    QVERIFY(process->blocked);
+
+    // A second notification for the same image is a hit
+    QVERIFY(cache.resolve(1000, 1, isGame)->blocked);
+    QCOMPARE(cache.misses(), quint64(2));
+    QCOMPARE(cache.hits(), quint64(1));
+}
+
+QTEST_GUILESS_MAIN(TestProcessCache)
+#include "tst_processcache.moc"
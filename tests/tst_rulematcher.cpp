@@ -0,0 +1,180 @@
+#include <QtTest>
+#include <QRandomGenerator>
+
+#include "data/pathkey.h"
+#include "data/rulematcher.h"
+
+class TestRuleMatcher : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void empty();
+    void matching_data();
+    void matching();
+    void againstModel();
+
+private:
+    // Straightforward reading of each rule type, one rule at a time
+    static bool modelMatches(const QList<BlockRule>& rules, const QString& path);
+    static bool modelGlob(QStringView pattern, QStringView text);
+};
+
+bool TestRuleMatcher::modelGlob(QStringView pattern, QStringView text)
+{
+    if (pattern.isEmpty())
+        return text.isEmpty();
+    if (pattern[0] == u'*')
+        return modelGlob(pattern.mid(1), text) || (!text.isEmpty() && modelGlob(pattern, text.mid(1)));
+    if (text.isEmpty())
+        return false;
+    return (pattern[0] == u'?' || pattern[0] == text[0]) && modelGlob(pattern.mid(1), text.mid(1));
+}
+
+bool TestRuleMatcher::modelMatches(const QList<BlockRule>& rules, const QString& path)
+{
+    const QString key = PathKey(path).toString();
+    if (key.isEmpty())
+        return false;
+
+    for (const BlockRule& rule : rules) {
+        QString pattern = PathKey(rule.pattern).toString();
+        if (pattern.isEmpty())
+            continue;
+
+        switch (rule.type) {
+        case RuleType::Exact:
+            if (key == pattern)
+                return true;
+            break;
+        case RuleType::Prefix:
+            while (pattern.endsWith(u'/'))
+                pattern.chop(1);
+            if (key == pattern || key.startsWith(pattern + QLatin1Char('/')))
+                return true;
+            break;
+        case RuleType::Glob:
+            if (modelGlob(pattern, key))
+                return true;
+            break;
+        }
+    }
+    return false;
+}
+
+void TestRuleMatcher::empty()
+{
+    const RuleMatcher none;
+    QVERIFY(none.isEmpty());
+    QVERIFY(!none.matches(QString("C:/Games/game.exe")));
+
+    // Rules that normalize to nothing are not counted
+    const RuleMatcher blank({ BlockRule{QString(), RuleType::Exact} });
+    QVERIFY(blank.isEmpty());
+
+    const RuleMatcher one({ BlockRule{"C:/Games/game.exe", RuleType::Exact} });
+    QVERIFY(!one.isEmpty());
+    QVERIFY(!one.matches(QString()));
+    QVERIFY(!one.matches(PathKey()));
+}
+
+void TestRuleMatcher::matching_data()
+{
+    QTest::addColumn<QString>("pattern");
+    QTest::addColumn<int>("type");
+    QTest::addColumn<QString>("path");
+    QTest::addColumn<bool>("matches");
+
+    const int exact = int(RuleType::Exact);
+    const int prefix = int(RuleType::Prefix);
+    const int glob = int(RuleType::Glob);
+
+    QTest::newRow("exact") << "C:/Games/game.exe" << exact << "C:/Games/game.exe" << true;
+    QTest::newRow("exact other case and separators") << "C:/Games/game.exe" << exact << "c:\\GAMES\\Game.EXE" << true;
+    QTest::newRow("exact unclean path") << "C:/Games/game.exe" << exact << "C:/Games/./bin/../game.exe" << true;
+    QTest::newRow("exact longer path") << "C:/Games/game.exe" << exact << "C:/Games/game.exe.bak" << false;
+    QTest::newRow("exact shorter path") << "C:/Games/game.exe" << exact << "C:/Games/game" << false;
+    QTest::newRow("exact is not a prefix") << "C:/Games" << exact << "C:/Games/game.exe" << false;
+
+    QTest::newRow("prefix itself") << "C:/Games" << prefix << "C:/Games" << true;
+    QTest::newRow("prefix child") << "C:/Games" << prefix << "C:/Games/game.exe" << true;
+    QTest::newRow("prefix deep child") << "C:/Games" << prefix << "c:\\games\\a\\b\\c.exe" << true;
+    QTest::newRow("prefix sibling") << "C:/Games" << prefix << "C:/GamesX/game.exe" << false;
+    QTest::newRow("prefix parent") << "C:/Games/Steam" << prefix << "C:/Games" << false;
+    QTest::newRow("prefix trailing separator") << "C:/Games/" << prefix << "C:/Games/game.exe" << true;
+    QTest::newRow("prefix drive") << "D:/" << prefix << "D:/Tools/tool.exe" << true;
+    QTest::newRow("prefix other drive") << "D:/" << prefix << "C:/Tools/tool.exe" << false;
+
+    QTest::newRow("glob head") << "C:/Games/*.exe" << glob << "C:/Games/game.exe" << true;
+    QTest::newRow("glob star crosses separators") << "C:/Games/*.exe" << glob << "C:/Games/a/b/game.exe" << true;
+    QTest::newRow("glob head wrong tail") << "C:/Games/*.exe" << glob << "C:/Games/game.dll" << false;
+    QTest::newRow("glob question mark") << "C:/Games/game?.exe" << glob << "C:/Games/game2.exe" << true;
+    QTest::newRow("glob question mark is one char") << "C:/Games/game?.exe" << glob << "C:/Games/game12.exe" << false;
+    QTest::newRow("glob question mark needs a char") << "C:/Games/game?.exe" << glob << "C:/Games/game.exe" << false;
+    QTest::newRow("glob leading star") << "*/steam.exe" << glob << "D:\\Steam\\steam.exe" << true;
+    QTest::newRow("glob leading star wrong name") << "*/steam.exe" << glob << "D:/Steam/notsteam.exe" << false;
+    QTest::newRow("glob leading star bare name") << "*steam.exe" << glob << "D:/Steam/notsteam.exe" << true;
+    QTest::newRow("glob anchored tail") << "*/Steam/*/game?.exe" << glob << "D:/Steam/apps/game1.exe" << true;
+    QTest::newRow("glob anchored tail mismatch") << "*/Steam/*/game?.exe" << glob << "D:/Epic/apps/game1.exe" << false;
+    QTest::newRow("glob floating") << "*steam*" << glob << "C:/Program Files/Steam/bin/x.exe" << true;
+    QTest::newRow("glob floating mismatch") << "*steam*" << glob << "C:/Program Files/Epic/x.exe" << false;
+    QTest::newRow("glob backtracks") << "C:/*a*b.exe" << glob << "C:/xaxbxab.exe" << true;
+    QTest::newRow("glob without wildcards is exact") << "C:/Games/game.exe" << glob << "C:/Games/game.exe" << true;
+}
+
+void TestRuleMatcher::matching()
+{
+    QFETCH(QString, pattern);
+    QFETCH(int, type);
+    QFETCH(QString, path);
+    QFETCH(bool, matches);
+
+    const RuleMatcher matcher({ BlockRule{pattern, RuleType(type)} });
+    QCOMPARE(matcher.matches(path), matches);
+    QCOMPARE(matcher.matches(PathKey(path)), matches);
+}
+
+void TestRuleMatcher::againstModel()
+{
+    // Random rule sets over a small alphabet, so rules share trie nodes
+    // and globs overlap, checked against the one-rule-at-a-time model
+    QRandomGenerator random(20240108);
+    const QStringList segments = { "a", "b", "ab", "ba", "x.exe", "b.exe" };
+    auto randomPath = [&](bool wildcards) {
+        QString path = "C:";
+        const int depth = 1 + random.bounded(3);
+        for (int i = 0; i < depth; ++i) {
+            path += QLatin1Char('/');
+            if (wildcards && random.bounded(4) == 0)
+                path += random.bounded(3) == 0 ? "?" : "*";
+            else
+                path += segments[random.bounded(int(segments.size()))];
+        }
+        if (wildcards && random.bounded(6) == 0)
+            path = QLatin1String("*") + path.mid(2);
+        return path;
+    };
+
+    for (int round = 0; round < 200; ++round) {
+        QList<BlockRule> rules;
+        const int ruleCount = 1 + random.bounded(8);
+        for (int i = 0; i < ruleCount; ++i) {
+            const RuleType type = RuleType(random.bounded(3));
+            rules.append(BlockRule{randomPath(type == RuleType::Glob), type});
+        }
+        const RuleMatcher matcher(rules);
+
+        for (int probe = 0; probe < 50; ++probe) {
+            const QString path = randomPath(false);
+            if (matcher.matches(path) != modelMatches(rules, path)) {
+                QStringList described;
+                for (const BlockRule& rule : rules)
+                    described.append(QString("%1:%2").arg(int(rule.type)).arg(rule.pattern));
+                QFAIL(qPrintable(QString("%1 against %2").arg(path, described.join(", "))));
+            }
+        }
+    }
+}
+
+QTEST_GUILESS_MAIN(TestRuleMatcher)
+#include "tst_rulematcher.moc"
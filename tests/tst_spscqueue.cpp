@@ -0,0 +1,83 @@
+#include <QtTest>
+#include <QThread>
+
+#include "core/spscqueue.h"
+
+class TestSpscQueue : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void fullQueueRejects();
+    void wrapsAround();
+    void producerAndConsumerThreads();
+};
+
+void TestSpscQueue::fullQueueRejects()
+{
+    SpscQueue<int, 4> queue;
+    QVERIFY(queue.isEmpty());
+    for (int i = 0; i < 4; ++i)
+        QVERIFY(queue.push(i));
+    QVERIFY(!queue.push(4));
+
+    // The rejected item did not replace anything
+    int value = -1;
+    for (int i = 0; i < 4; ++i) {
+        QVERIFY(queue.pop(value));
+        QCOMPARE(value, i);
+    }
+    QVERIFY(!queue.pop(value));
+    QVERIFY(queue.isEmpty());
+}
+
+void TestSpscQueue::wrapsAround()
+{
+    SpscQueue<int, 4> queue;
+    int value = -1;
+    for (int i = 0; i < 1000; ++i) {
+        QVERIFY(queue.push(i));
+        QVERIFY(queue.push(i + 1));
+        QVERIFY(queue.pop(value));
+        QCOMPARE(value, i);
+        QVERIFY(queue.pop(value));
+        QCOMPARE(value, i + 1);
+    }
+    QVERIFY(queue.isEmpty());
+}
+
+void TestSpscQueue::producerAndConsumerThreads()
+{
+    // Everything pushed arrives once and in order, with the producer
+    // retrying whenever the consumer falls behind
+    static const int kCount = 200000;
+    SpscQueue<int, 256> queue;
+
+    QThread* producer = QThread::create([&queue]() {
+        for (int i = 0; i < kCount; ++i) {
+            while (!queue.push(i))
+                QThread::yieldCurrentThread();
+        }
+    });
+    producer->start();
+
+    int expected = 0;
+    int value = -1;
+    bool inOrder = true;
+    while (expected < kCount) {
+        if (!queue.pop(value)) {
+            QThread::yieldCurrentThread();
+            continue;
+        }
+        inOrder = inOrder && value == expected;
+        ++expected;
+    }
+
+    QVERIFY(producer->wait());
+    delete producer;
+    QVERIFY(inOrder);
+    QVERIFY(!queue.pop(value));
+}
+
+QTEST_GUILESS_MAIN(TestSpscQueue)
+#include "tst_spscqueue.moc"